@@ -0,0 +1,511 @@
+// Compile-throughput benchmark for ncc.
+//
+//   bench [options] <lines>...
+//
+// For each size, generates a corpus with corpus_gen, compiles it with
+// -S -ftime-report and records lines/sec, tokens/sec, peak RSS and the
+// time of each compiler phase. Results go to JSON, one record per size;
+// with -baseline they are compared against an earlier results file and a
+// slowdown or memory growth beyond the tolerance fails the run. -jobs
+// repeats every size with each -fcodegen-jobs count, reports the codegen
+// speedup over the first count and fails if the assembly differs.
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+
+int main() {
+    fprintf(stderr, "Error: The benchmark harness needs fork() and wait4(), which this build does not have\n");
+    return 1;
+}
+
+#else
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// A size is not repeated once one compile of it took this long
+#define REPEAT_LIMIT_MS 10000.0
+
+// Small corpora are compiled beyond -runs until this much time has been
+// spent on them, up to MAX_RUNS, so the fastest run is not just noise
+#define MIN_SAMPLE_MS 500.0
+#define MAX_RUNS 100
+
+// Rows of -ftime-report, in report order
+static const char* phaseNames[] = {
+    "preprocess", "lex", "parse", "type check", "codegen", "data emission", "other"
+};
+#define PHASE_COUNT (int)(sizeof(phaseNames) / sizeof(phaseNames[0]))
+#define CODEGEN_PHASE 4
+
+// Phases in the summary table; the JSON has them all
+static const int shownPhases[] = {0, 1, 2, 4};
+#define SHOWN_COUNT (int)(sizeof(shownPhases) / sizeof(shownPhases[0]))
+
+typedef struct {
+    long lines;
+    int codegenJobs;    // -fcodegen-jobs of the compile, 0 without -jobs
+    long tokens;
+    long bytes;
+    int runs;
+    double wallMs;      // Of the fastest run
+    double cpuMs;
+    long peakRssKb;
+    double phaseMs[PHASE_COUNT];
+} Result;
+
+typedef struct {
+    const char* ncc;
+    const char* generator;
+    const char* workDir;
+    const char* resultsPath;
+    const char* baselinePath;
+    int runs;
+    double tolerance;   // Percent
+    int* jobs;          // -fcodegen-jobs counts to sweep
+    int jobCount;
+} Options;
+
+static double nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e3 + (double)now.tv_nsec / 1e6;
+}
+
+// Run argv with stdout and stderr sent to the given files (NULL keeps
+// them). Returns the exit status, or -1 if the program did not exit.
+static int runProgram(char* const argv[], const char* stdoutPath, const char* stderrPath, struct rusage* usage) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (stdoutPath) {
+            int fd = open(stdoutPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) dup2(fd, STDOUT_FILENO);
+        }
+        if (stderrPath) {
+            int fd = open(stderrPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) dup2(fd, STDERR_FILENO);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "Error: Could not run %s\n", argv[0]);
+        _exit(127);
+    }
+    if (pid < 0) {
+        fprintf(stderr, "Error: Could not start %s\n", argv[0]);
+        return -1;
+    }
+
+    int status = 0;
+    struct rusage ignored;
+    if (wait4(pid, &status, 0, usage ? usage : &ignored) != pid) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static char* readFile(const char* path, long* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = (char*)malloc(size + 1);
+    if (text) {
+        size = (long)fread(text, 1, size, file);
+        text[size] = '\0';
+    }
+    fclose(file);
+    if (length) *length = size;
+    return text;
+}
+
+static long countLines(const char* path, long* bytes) {
+    long length = 0;
+    char* text = readFile(path, &length);
+    if (!text) return -1;
+    long lines = 0;
+    for (long i = 0; i < length; i++) {
+        if (text[i] == '\n') lines++;
+    }
+    free(text);
+    if (bytes) *bytes += length;
+    return lines;
+}
+
+static const char* operators[] = {
+    "<<=", ">>=", "...", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=",
+    "&&", "||", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^="
+};
+
+// C tokens in preprocessed text, counted the way the lexer splits them
+static long countTokens(const char* text) {
+    long tokens = 0;
+    const char* p = text;
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+        } else if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') p++;
+        } else if (p[0] == '/' && p[1] == '*') {
+            p += 2;
+            while (*p && !(p[0] == '*' && p[1] == '/')) p++;
+            if (*p) p += 2;
+        } else if (*p == '#') {
+            // Line markers and directives left in the output
+            while (*p && *p != '\n') p++;
+        } else if (*p == '"' || *p == '\'') {
+            char quote = *p++;
+            while (*p && *p != quote && *p != '\n') {
+                if (*p == '\\' && p[1]) p++;
+                p++;
+            }
+            if (*p == quote) p++;
+            tokens++;
+        } else if (isalnum((unsigned char)*p) || *p == '_') {
+            while (isalnum((unsigned char)*p) || *p == '_') p++;
+            tokens++;
+        } else {
+            size_t length = 1;
+            for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+                size_t opLength = strlen(operators[i]);
+                if (strncmp(p, operators[i], opLength) == 0) {
+                    length = opLength;
+                    break;
+                }
+            }
+            p += length;
+            tokens++;
+        }
+    }
+    return tokens;
+}
+
+// Pull the phase rows out of a -ftime-report
+static void readTimeReport(const char* path, double* phaseMs) {
+    for (int i = 0; i < PHASE_COUNT; i++) phaseMs[i] = 0;
+    char* text = readFile(path, NULL);
+    if (!text) return;
+    for (char* row = text; row && *row; row = strchr(row, '\n') ? strchr(row, '\n') + 1 : NULL) {
+        while (*row == ' ') row++;
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            size_t length = strlen(phaseNames[i]);
+            if (strncmp(row, phaseNames[i], length) == 0 && row[length] == ' ') {
+                phaseMs[i] = strtod(row + length, NULL);
+                break;
+            }
+        }
+        // The per-function table follows the phases
+        if (strncmp(row, "total ", 6) == 0) break;
+    }
+    free(text);
+}
+
+// Whether two files have the same contents
+static int sameContents(const char* pathA, const char* pathB) {
+    long lengthA = 0, lengthB = 0;
+    char* a = readFile(pathA, &lengthA);
+    char* b = readFile(pathB, &lengthB);
+    int same = a && b && lengthA == lengthB && memcmp(a, b, lengthA) == 0;
+    free(a);
+    free(b);
+    return same;
+}
+
+// Compile a corpus 'runs' times or more and keep the fastest run
+static int measureCompile(const Options* options, char* const compile[], const char* sourcePath,
+                          const char* reportPath, Result* result) {
+    double sampled = 0;
+    for (int run = 0; run < options->runs || (sampled < MIN_SAMPLE_MS && run < MAX_RUNS); run++) {
+        struct rusage usage;
+        double start = nowMs();
+        int status = runProgram(compile, "/dev/null", reportPath, &usage);
+        double wall = nowMs() - start;
+        sampled += wall;
+        if (status != 0) {
+            fprintf(stderr, "Error: Compiling %s failed, see %s\n", sourcePath, reportPath);
+            return 1;
+        }
+        result->runs++;
+
+        if (run == 0 || wall < result->wallMs) {
+            result->wallMs = wall;
+            result->cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+                            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+            readTimeReport(reportPath, result->phaseMs);
+        }
+        // ru_maxrss is in kilobytes on Linux
+        if (usage.ru_maxrss > result->peakRssKb) result->peakRssKb = usage.ru_maxrss;
+        if (wall > REPEAT_LIMIT_MS) break;
+    }
+    return 0;
+}
+
+// Benchmark one size, filling a result per -jobs count (or just one)
+static int benchmarkSize(const Options* options, long size, Result* results) {
+    char sourcePath[1024], headerPath[1024], preprocessedPath[1024], reportPath[1024];
+    char sizeText[32], includeFlag[1040];
+    Result* result = &results[0];
+    snprintf(sourcePath, sizeof(sourcePath), "%s/corpus_%ld.c", options->workDir, size);
+    snprintf(headerPath, sizeof(headerPath), "%s/corpus_%ld.h", options->workDir, size);
+    snprintf(preprocessedPath, sizeof(preprocessedPath), "%s/corpus_%ld.i", options->workDir, size);
+    snprintf(reportPath, sizeof(reportPath), "%s/corpus_%ld.report", options->workDir, size);
+    snprintf(sizeText, sizeof(sizeText), "%ld", size);
+    snprintf(includeFlag, sizeof(includeFlag), "-I%s", options->workDir);
+
+    char* generate[] = {(char*)options->generator, sizeText, sourcePath, NULL};
+    if (runProgram(generate, NULL, NULL, NULL) != 0) {
+        fprintf(stderr, "Error: Could not generate the %ld line corpus\n", size);
+        return 1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    long sourceLines = countLines(sourcePath, &result->bytes);
+    long headerLines = countLines(headerPath, &result->bytes);
+    result->lines = sourceLines + (headerLines > 0 ? headerLines : 0);
+
+    char* preprocess[] = {(char*)options->ncc, "-E", includeFlag, sourcePath, "-o", preprocessedPath, NULL};
+    char* preprocessed = NULL;
+    if (runProgram(preprocess, "/dev/null", "/dev/null", NULL) == 0) {
+        preprocessed = readFile(preprocessedPath, NULL);
+    }
+    if (!preprocessed) {
+        fprintf(stderr, "Error: Could not preprocess %s\n", sourcePath);
+        return 1;
+    }
+    result->tokens = countTokens(preprocessed);
+    free(preprocessed);
+    remove(preprocessedPath);
+
+    if (options->jobCount == 0) {
+        // The assembly is not needed, only the work of producing it
+        char* compile[] = {(char*)options->ncc, "-S", "-ftime-report", includeFlag, sourcePath, "-o", "/dev/null", NULL};
+        return measureCompile(options, compile, sourcePath, reportPath, result);
+    }
+
+    // Each job count writes its assembly, which must match the first one's
+    char firstAsmPath[1024];
+    for (int j = 0; j < options->jobCount; j++) {
+        char jobsFlag[48], asmPath[1024];
+        snprintf(jobsFlag, sizeof(jobsFlag), "-fcodegen-jobs=%d", options->jobs[j]);
+        snprintf(asmPath, sizeof(asmPath), "%s/corpus_%ld.j%d.asm", options->workDir, size, options->jobs[j]);
+        if (j > 0) {
+            results[j] = results[0];
+            results[j].runs = 0;
+        }
+        results[j].codegenJobs = options->jobs[j];
+
+        char* compile[] = {(char*)options->ncc, "-S", "-ftime-report", jobsFlag, includeFlag, sourcePath, "-o", asmPath, NULL};
+        if (measureCompile(options, compile, sourcePath, reportPath, &results[j]) != 0) return 1;
+        if (j == 0) {
+            snprintf(firstAsmPath, sizeof(firstAsmPath), "%s", asmPath);
+        } else if (!sameContents(firstAsmPath, asmPath)) {
+            fprintf(stderr, "Error: %s differs from %s\n", asmPath, firstAsmPath);
+            return 1;
+        } else {
+            remove(asmPath);
+        }
+    }
+    remove(firstAsmPath);
+    return 0;
+}
+
+static double perSecond(long count, double ms) {
+    return ms > 0 ? count * 1e3 / ms : 0;
+}
+
+static int writeResults(const char* path, const Result* results, int count) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write benchmark results %s\n", path);
+        return 1;
+    }
+    // One record per line so results diff cleanly
+    fprintf(out, "{\"benchmark\":\"compile-throughput\",\"results\":[\n");
+    for (int i = 0; i < count; i++) {
+        const Result* r = &results[i];
+        fprintf(out, "{\"lines\":%ld,", r->lines);
+        if (r->codegenJobs > 0) fprintf(out, "\"codegen_jobs\":%d,", r->codegenJobs);
+        fprintf(out, "\"tokens\":%ld,\"bytes\":%ld,\"runs\":%d,\"wall_ms\":%.3f,\"cpu_ms\":%.3f,"
+                "\"lines_per_sec\":%.0f,\"tokens_per_sec\":%.0f,\"peak_rss_kb\":%ld,\"phases_ms\":{",
+                r->tokens, r->bytes, r->runs, r->wallMs, r->cpuMs, perSecond(r->lines, r->wallMs),
+                perSecond(r->tokens, r->wallMs), r->peakRssKb);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(out, "%s\"%s\":%.3f", p ? "," : "", phaseNames[p], r->phaseMs[p]);
+        }
+        fprintf(out, "}}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "]}\n");
+    return fclose(out) != 0;
+}
+
+// A number field of the baseline record for a result's size (and job
+// count), or -1
+static double baselineField(const char* baseline, const Result* result, const char* field) {
+    char key[96];
+    int used = snprintf(key, sizeof(key), "{\"lines\":%ld,", result->lines);
+    if (result->codegenJobs > 0) snprintf(key + used, sizeof(key) - used, "\"codegen_jobs\":%d,", result->codegenJobs);
+    const char* record = strstr(baseline, key);
+    if (!record) return -1;
+    const char* end = strchr(record, '\n');
+    char name[64];
+    snprintf(name, sizeof(name), "\"%s\":", field);
+    const char* value = strstr(record, name);
+    if (!value || (end && value > end)) return -1;
+    return strtod(value + strlen(name), NULL);
+}
+
+// Compare with an earlier run; returns the number of regressions
+static int compareBaseline(const Options* options, const Result* results, int count) {
+    char* baseline = readFile(options->baselinePath, NULL);
+    if (!baseline) {
+        fprintf(stderr, "Error: Could not read baseline %s\n", options->baselinePath);
+        return 1;
+    }
+    int regressions = 0;
+    printf("Against %s (tolerance %.0f%%):\n", options->baselinePath, options->tolerance);
+    for (int i = 0; i < count; i++) {
+        const Result* r = &results[i];
+        double oldSpeed = baselineField(baseline, r, "lines_per_sec");
+        double oldRss = baselineField(baseline, r, "peak_rss_kb");
+        char jobs[32] = "";
+        if (r->codegenJobs > 0) snprintf(jobs, sizeof(jobs), ", %d jobs", r->codegenJobs);
+        if (oldSpeed <= 0 || oldRss <= 0) {
+            printf("  %9ld lines%s: not in baseline\n", r->lines, jobs);
+            continue;
+        }
+        double speedChange = (perSecond(r->lines, r->wallMs) - oldSpeed) * 100 / oldSpeed;
+        double rssChange = (r->peakRssKb - oldRss) * 100 / oldRss;
+        int slower = speedChange < -options->tolerance;
+        int bigger = rssChange > options->tolerance;
+        printf("  %9ld lines%s: speed %+6.1f%%, peak RSS %+6.1f%%%s\n", r->lines, jobs, speedChange, rssChange,
+               slower || bigger ? "  REGRESSION" : "");
+        if (slower || bigger) regressions++;
+    }
+    free(baseline);
+    return regressions;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <lines>...\n", program);
+    fprintf(stderr, "  -ncc <path>        Compiler to measure (default bin/ncc)\n");
+    fprintf(stderr, "  -gen <path>        Corpus generator (default bin/corpus_gen)\n");
+    fprintf(stderr, "  -dir <dir>         Where corpora and reports are written (default bench/out)\n");
+    fprintf(stderr, "  -o <file>          Results JSON (default <dir>/results.json)\n");
+    fprintf(stderr, "  -runs <n>          Minimum compiles per size, the fastest counts (default 3)\n");
+    fprintf(stderr, "  -baseline <file>   Fail on regressions against earlier results\n");
+    fprintf(stderr, "  -tolerance <pct>   Allowed slowdown or memory growth (default 10)\n");
+    fprintf(stderr, "  -jobs <n>,<n>...   Compile each size with these -fcodegen-jobs counts\n");
+}
+
+int main(int argc, char* argv[]) {
+    Options options = {"bin/ncc", "bin/corpus_gen", "bench/out", NULL, NULL, 3, 10.0, NULL, 0};
+    long* sizes = (long*)malloc(argc * sizeof(long));
+    int sizeCount = 0;
+    options.jobs = (int*)malloc(64 * sizeof(int));
+    if (!sizes || !options.jobs) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        int hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-ncc") == 0 && hasValue) {
+            options.ncc = argv[++i];
+        } else if (strcmp(argv[i], "-gen") == 0 && hasValue) {
+            options.generator = argv[++i];
+        } else if (strcmp(argv[i], "-dir") == 0 && hasValue) {
+            options.workDir = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && hasValue) {
+            options.resultsPath = argv[++i];
+        } else if (strcmp(argv[i], "-runs") == 0 && hasValue) {
+            options.runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-baseline") == 0 && hasValue) {
+            options.baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "-tolerance") == 0 && hasValue) {
+            options.tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-jobs") == 0 && hasValue) {
+            for (char* item = argv[++i]; *item && options.jobCount < 64; item += strspn(item, ", ")) {
+                char* end;
+                long jobs = strtol(item, &end, 10);
+                if (end == item || jobs < 1) {
+                    fprintf(stderr, "Error: -jobs takes positive counts separated by commas\n");
+                    return 1;
+                }
+                options.jobs[options.jobCount++] = (int)jobs;
+                item = end;
+            }
+        } else if (isdigit((unsigned char)argv[i][0])) {
+            sizes[sizeCount++] = atol(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (sizeCount == 0 || options.runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char defaultResults[1024];
+    if (!options.resultsPath) {
+        snprintf(defaultResults, sizeof(defaultResults), "%s/results.json", options.workDir);
+        options.resultsPath = defaultResults;
+    }
+    mkdir(options.workDir, 0755);
+    // Measure the compiler itself, not a cache in front of it
+    unsetenv("NCC_CACHE_DIR");
+    unsetenv("NCC_MEM_LIMIT");
+
+    int perSize = options.jobCount > 0 ? options.jobCount : 1;
+    int resultCount = sizeCount * perSize;
+    Result* results = (Result*)calloc(resultCount, sizeof(Result));
+    if (!results) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+
+    printf("%10s %10s %10s %12s %12s %10s", "Lines", "Tokens", "Wall ms", "Lines/s", "Tokens/s", "Peak KB");
+    for (int p = 0; p < SHOWN_COUNT; p++) printf(" %10s", phaseNames[shownPhases[p]]);
+    if (options.jobCount > 0) printf(" %6s %9s", "Jobs", "Codegen x");
+    printf("\n");
+    for (int i = 0; i < sizeCount; i++) {
+        Result* sizeResults = &results[i * perSize];
+        if (benchmarkSize(&options, sizes[i], sizeResults) != 0) return 1;
+        for (int j = 0; j < perSize; j++) {
+            const Result* r = &sizeResults[j];
+            printf("%10ld %10ld %10.1f %12.0f %12.0f %10ld", r->lines, r->tokens, r->wallMs,
+                   perSecond(r->lines, r->wallMs), perSecond(r->tokens, r->wallMs), r->peakRssKb);
+            for (int p = 0; p < SHOWN_COUNT; p++) printf(" %10.1f", r->phaseMs[shownPhases[p]]);
+            if (options.jobCount > 0) {
+                // Speedup over the first job count
+                double first = sizeResults[0].phaseMs[CODEGEN_PHASE];
+                double codegen = r->phaseMs[CODEGEN_PHASE];
+                printf(" %6d %8.2fx", r->codegenJobs, codegen > 0 ? first / codegen : 0);
+            }
+            printf("\n");
+        }
+    }
+
+    if (writeResults(options.resultsPath, results, resultCount) != 0) return 1;
+    printf("Results written to %s\n", options.resultsPath);
+
+    int status = 0;
+    if (options.baselinePath && compareBaseline(&options, results, resultCount) != 0) status = 1;
+    free(results);
+    free(sizes);
+    free(options.jobs);
+    return status;
+}
+
+#endif
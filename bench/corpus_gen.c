@@ -0,0 +1,304 @@
+// Synthetic corpus generator for the compile benchmarks.
+//
+//   corpus_gen <lines> <out.c> [seed]
+//
+// Writes a C file of about <lines> lines, plus a macro-heavy header it
+// includes (<out.h>, a tenth of the lines). The same arguments always give
+// the same files. The code mixes the shapes the compiler sees in practice:
+// struct definitions and member access, functions with locals and control
+// flow, deeply nested expressions, big array initializers and long string
+// tables. Everything is valid for ncc, so -S compiles the whole corpus.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned long rngState;
+
+// Numerical Recipes LCG; good enough for picking shapes and constants
+static unsigned int nextRandom() {
+    rngState = (rngState * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+    return (unsigned int)(rngState >> 8);
+}
+
+static int randomBelow(int limit) {
+    return (int)(nextRandom() % (unsigned int)limit);
+}
+
+static FILE* out;
+static long linesWritten;
+static int macroCount;
+static int structCount;
+static int functionCount;    // Functions of every kind, for unique names
+static int workCount;        // work_fn's, the ones other code calls
+
+static const char* words[] = {
+    "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+    "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa",
+    "quebec", "romeo", "sierra", "tango", "uniform", "victor", "whiskey", "yankee"
+};
+#define WORD_COUNT (int)(sizeof(words) / sizeof(words[0]))
+
+static void line(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(out, format, args);
+    va_end(args);
+    fputc('\n', out);
+    linesWritten++;
+}
+
+// A macro name, an argument or a small constant
+static void writeOperand(int params) {
+    int pick = randomBelow(4);
+    if (pick == 0 && macroCount > 0) {
+        fprintf(out, "BENCH_K%d", randomBelow(macroCount));
+    } else if (pick == 1 && params > 0) {
+        fprintf(out, "p%d", randomBelow(params));
+    } else {
+        fprintf(out, "%d", 1 + randomBelow(99));
+    }
+}
+
+static const char* binaryOperators[] = {"+", "-", "*", "&", "|", "^", "+", "-"};
+
+// A fully parenthesised expression 'depth' levels deep
+static void writeExpression(int depth, int params) {
+    if (depth == 0) {
+        writeOperand(params);
+        return;
+    }
+    fputc('(', out);
+    writeExpression(depth - 1, params);
+    fprintf(out, " %s ", binaryOperators[randomBelow(8)]);
+    if (randomBelow(3) == 0) {
+        writeExpression(depth - 1, params);
+    } else {
+        writeOperand(params);
+    }
+    fputc(')', out);
+}
+
+static void writeHeader(const char* path, long lines) {
+    out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        exit(1);
+    }
+    line("#ifndef BENCH_MACROS_H");
+    line("#define BENCH_MACROS_H");
+    // Constants, guarded groups and conditionals the preprocessor must skip
+    while (linesWritten < lines - 1) {
+        int group = macroCount / 16;
+        if (macroCount % 16 == 0) {
+            line("#ifndef BENCH_GROUP_%d", group);
+            line("#define BENCH_GROUP_%d", group);
+        }
+        line("#define BENCH_K%d %d", macroCount, 1 + randomBelow(1000));
+        if (randomBelow(4) == 0) {
+            line("#ifdef BENCH_UNDEFINED_%d", macroCount);
+            line("#define BENCH_K%d 0", macroCount);
+            line("#endif");
+        }
+        macroCount++;
+        if (macroCount % 16 == 0) line("#endif");
+    }
+    if (macroCount % 16 != 0) line("#endif");
+    line("#endif");
+    fclose(out);
+}
+
+static void writeStruct(int params) {
+    int fields = 3 + randomBelow(6);
+    int id = structCount++;
+    line("struct S%d {", id);
+    for (int i = 0; i < fields; i++) {
+        line("    %s f%d;", randomBelow(3) == 0 ? "char" : "int", i);
+    }
+    line("};");
+    line("");
+    line("int struct_fn%d(struct S%d* s, int p0) {", functionCount++, id);
+    line("    int total = 0;");
+    // Members are only read; ncc does not store through -> yet
+    for (int i = 0; i < fields; i++) {
+        fprintf(out, "    total = total + s->f%d * ", i);
+        writeExpression(1 + randomBelow(2), params);
+        line(";");
+    }
+    line("    return total;");
+    line("}");
+    line("");
+}
+
+static void writeStatement(int indent, int params, int nesting) {
+    int pick = nesting > 2 ? randomBelow(2) : randomBelow(6);
+    fprintf(out, "%*s", indent, "");
+    switch (pick) {
+        case 0:
+            fprintf(out, "total = total + ");
+            writeExpression(2, params);
+            line(";");
+            break;
+        case 1:
+            fprintf(out, "v%d = ", randomBelow(4));
+            writeExpression(1 + randomBelow(3), params);
+            line(";");
+            break;
+        case 2:
+            fprintf(out, "if (v%d > ", randomBelow(4));
+            writeOperand(params);
+            line(") {");
+            writeStatement(indent + 4, params, nesting + 1);
+            line("%*s} else {", indent, "");
+            writeStatement(indent + 4, params, nesting + 1);
+            line("%*s}", indent, "");
+            break;
+        case 3:
+            line("for (i = 0; i < %d; i++) {", 2 + randomBelow(30));
+            writeStatement(indent + 4, params, nesting + 1);
+            line("%*s}", indent, "");
+            break;
+        case 4:
+            line("while (v%d < %d) {", randomBelow(4), 100 + randomBelow(900));
+            fprintf(out, "%*s", indent + 4, "");
+            line("v%d = v%d + %d;", randomBelow(4), randomBelow(4), 1 + randomBelow(9));
+            line("%*s}", indent, "");
+            break;
+        default:
+            if (workCount > 0) {
+                line("total = total + work_fn%d(v0, v1);", randomBelow(workCount));
+            } else {
+                line("total = total + 1;");
+            }
+            break;
+    }
+}
+
+static void writeFunction() {
+    int params = 2;
+    int statements = 4 + randomBelow(12);
+    int id = workCount;
+    functionCount++;
+    line("int work_fn%d(int p0, int p1) {", id);
+    line("    int v0 = p0;");
+    line("    int v1 = p1;");
+    line("    int v2 = %d;", randomBelow(100));
+    line("    int v3 = 0;");
+    line("    int i;");
+    line("    int total = 0;");
+    for (int i = 0; i < statements; i++) writeStatement(4, params, 0);
+    line("    return total + v2 + v3;");
+    line("}");
+    line("");
+    // Only earlier work_fn's are called, so there is no recursion
+    workCount++;
+}
+
+static void writeDeepExpression() {
+    int id = functionCount++;
+    line("int deep_fn%d(int p0, int p1, int p2) {", id);
+    fprintf(out, "    return ");
+    writeExpression(6 + randomBelow(4), 3);
+    line(";");
+    line("}");
+    line("");
+}
+
+static int tableCount;
+
+static void writeInitializer() {
+    int rows = 4 + randomBelow(28);
+    line("int table%d[%d] = {", tableCount++, rows * 8);
+    for (int row = 0; row < rows; row++) {
+        fprintf(out, "   ");
+        for (int i = 0; i < 8; i++) {
+            fprintf(out, " %d%s", randomBelow(30000), row == rows - 1 && i == 7 ? "" : ",");
+        }
+        line("");
+    }
+    line("};");
+    line("");
+}
+
+static void writeStringTable() {
+    int strings = 8 + randomBelow(24);
+    line("void strings_fn%d() {", functionCount++);
+    for (int i = 0; i < strings; i++) {
+        fprintf(out, "    bench_emit(\"");
+        int count = 3 + randomBelow(10);
+        for (int w = 0; w < count; w++) {
+            fprintf(out, "%s%s", w ? " " : "", words[randomBelow(WORD_COUNT)]);
+        }
+        line(" %d\");", randomBelow(100000));
+    }
+    line("}");
+    line("");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <lines> <out.c> [seed]\n", argv[0]);
+        return 1;
+    }
+    long lines = atol(argv[1]);
+    if (lines < 100) {
+        fprintf(stderr, "Error: Corpus needs at least 100 lines\n");
+        return 1;
+    }
+    rngState = argc > 3 ? strtoul(argv[3], NULL, 0) : 12345;
+
+    // The header goes next to the source, named after it
+    const char* sourcePath = argv[2];
+    size_t length = strlen(sourcePath);
+    char* headerPath = (char*)malloc(length + 3);
+    if (!headerPath) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    strcpy(headerPath, sourcePath);
+    char* dot = strrchr(headerPath, '.');
+    char* slash = strrchr(headerPath, '/');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    strcat(headerPath, ".h");
+    const char* headerName = strrchr(headerPath, '/') ? strrchr(headerPath, '/') + 1 : headerPath;
+
+    long headerLines = lines / 10;
+    writeHeader(headerPath, headerLines);
+
+    out = fopen(sourcePath, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", sourcePath);
+        return 1;
+    }
+    linesWritten = headerLines;
+    line("#include \"%s\"", headerName);
+    line("");
+    line("void bench_emit(char* s) {");
+    line("    __asm(\"mov dx, [bp+4]\");");
+    line("}");
+    line("");
+
+    // Leave room for main and the largest chunk
+    while (linesWritten < lines - 48) {
+        int pick = randomBelow(10);
+        if (pick < 4) {
+            writeFunction();
+        } else if (pick < 6) {
+            writeStruct(1);
+        } else if (pick < 7) {
+            writeDeepExpression();
+        } else if (pick < 8) {
+            writeInitializer();
+        } else {
+            writeStringTable();
+        }
+    }
+
+    line("int main() {");
+    line(workCount > 0 ? "    return work_fn0(1, 2);" : "    return 0;");
+    line("}");
+    while (linesWritten < lines) line("");
+    fclose(out);
+    free(headerPath);
+    return 0;
+}
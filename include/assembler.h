@@ -0,0 +1,23 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+// Results of assembleFlatBinary
+#define ASM_OK          0   // Output written
+#define ASM_UNSUPPORTED 1   // Something was not understood; assemble with nas instead
+
+// Assemble NCC assembly text (nas syntax), as the code generator left it
+// in memory, into a flat binary. Returns ASM_UNSUPPORTED without writing
+// anything when the text uses an instruction, operand form or directive
+// the built-in encoder does not know; getAssemblerFailure() then says
+// what it was.
+int assembleFlatBinary(const char* source, const char* outputPath);
+
+// Why the last assembleFlatBinary call gave up
+const char* getAssemblerFailure();
+
+// Lay out assembly text without writing it and return the bytes each
+// line encodes to, indexed by line number from 1, in a new array of
+// *lineCount entries. Gives up like assembleFlatBinary.
+int measureAssembly(const char* source, int** lineSizes, int* lineCount);
+
+#endif // ASSEMBLER_H
@@ -36,6 +36,8 @@ typedef enum {    NODE_PROGRAM,      // Program root
     NODE_WHILE,        // While loop
     NODE_DO_WHILE,     // Do-while loop
     NODE_FOR,          // For loop
+    NODE_SWITCH,       // Switch statement
+    NODE_CASE,         // Case or default label inside a switch
     NODE_CALL,         // Function call
     NODE_ASM_BLOCK,    // Inline assembly block
     NODE_ASM,          // Inline assembly
@@ -124,6 +126,10 @@ struct StructInfo {
     char* name;                     // Name of the struct
     StructMember* members;          // List of struct members
     int size;                       // Total size of the struct in bytes
+    StructMember** member_index;    // Members hashed by name, built by layoutStruct
+    int member_buckets;             // Slots in member_index (a power of two)
+    unsigned int hash;              // Hash of the name in the struct registry
+    struct StructInfo* bucket_next; // Next struct in the same registry bucket
 };
 
 // Function information structure
@@ -145,6 +151,7 @@ typedef struct ASTNode {
     struct ASTNode* left;
     struct ASTNode* right;
     struct ASTNode* next; // For lists of nodes
+    TypeInfo* expr_type;  // Type resolved by annotateTypes(), NULL if unknown
     
     union {
         // For literals
@@ -170,6 +177,8 @@ typedef struct ASTNode {
             char* var_name;
             TypeInfo type_info;
             struct ASTNode* initializer;
+            int frame_offset;     // Stack slot assigned by the frame layout pass
+            int alloc_reg;        // Register chosen by the register allocator (REG_*), 0 if in memory
         } declaration;
           // For binary operations
         struct {
@@ -186,6 +195,8 @@ typedef struct ASTNode {
             FunctionInfo info;
             struct ASTNode* body;
             struct ASTNode* params;
+            int body_start;           // Source offsets of the body, braces included
+            int body_end;
         } function;
           // For inline assembly block (between braces)
         struct {
@@ -233,6 +244,19 @@ typedef struct ASTNode {
             struct ASTNode* if_body;   // If body (true branch)
             struct ASTNode* else_body; // Else body (false branch), NULL if no else
         } if_stmt;
+        
+        // For switch statements
+        struct {
+            struct ASTNode* condition; // Controlling expression
+            struct ASTNode* body;      // Switch body holding the case labels
+        } switch_stmt;
+        
+        // For case and default labels
+        struct {
+            int value;                 // Constant case value
+            int is_default;            // 1 for the default label
+            char* label;               // Assembly label assigned during codegen
+        } case_label;
           // For assignment statements
         struct {
             OperatorType op;  // The operation to perform (OP_PLUS_ASSIGN, etc.)
@@ -255,6 +279,7 @@ typedef struct ASTNode {
         struct {
             OperatorType op;            // OP_DOT or OP_ARROW
             char* member_name;          // Name of the accessed member
+            StructMember* member;       // Resolved member, set by the type annotation pass
         } member_access;
     };
 }ASTNode;
@@ -264,6 +289,7 @@ ASTNode* createNode(NodeType type);
 
 // Function to print the AST for debugging
 void printAST(ASTNode* node, int indent);
+const char* getNodeTypeName(NodeType type);
 
 // Get the size of a data type in bytes
 int getTypeSize(DataType type);
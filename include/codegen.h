@@ -7,38 +7,61 @@
 
 // Optimization levels
 #define OPT_LEVEL_NONE 0    // -O0: No optimization
-#define OPT_LEVEL_BASIC 1   // -O1: Basic optimizations (string merging)
+#define OPT_LEVEL_BASIC 1   // -O1: Basic optimizations (string merging, frame pointer omission, register allocation, strength reduction)
+
+// Target processors (controls which instructions codegen may choose)
+#define CPU_8086 0          // -m8086: Original 8086/8088 instruction set
+#define CPU_186  1          // -m186: 80186 additions (pusha/popa, push imm, shift imm)
+#define CPU_386  2          // -m386: 32-bit registers through the operand-size prefix (real mode)
 
 // Optimization state
 typedef struct {
     int level;              // Current optimization level
-    int mergeStrings;       // Whether to merge identical strings
+    int mergeStrings;       // Whether to merge identical strings and share string tails
+    int omitFramePointer;   // Whether to drop push bp/mov bp, sp when bp is unused
+    int allocateRegisters;  // Whether to keep hot scalar locals in SI/DI
+    int strengthReduce;     // Whether to turn *, / and % by constants into cheaper sequences
 } OptimizationState;
 
 extern OptimizationState optimizationState;
 
-// Initialize code generator with optional origin displacement
-void initCodeGen(const char* outputFilename, unsigned int orgAddress);
+// Initialize code generator with optional origin displacement. The
+// assembly is generated into memory; see takeGeneratedAssembly.
+void initCodeGen(unsigned int orgAddress);
 
 // Initialize code generator with system mode (bootloader) settings
-void initCodeGenSystemMode(const char* outputFilename, unsigned int orgAddress, 
+void initCodeGenSystemMode(unsigned int orgAddress, 
                           int setStackSegmentPointer, unsigned int stackSegment, unsigned int stackPointer);
 
 // Set the optimization level
 void setOptimizationLevel(int level, int quietMode);
 
+// Set the target processor (CPU_8086, CPU_186, ...)
+void setTargetCpu(int cpu);
+
+// Get the target processor
+int getTargetCpu();
+
 // Get the current function name
 const char* getCurrentFunctionName();
 
 // Close code generator
 void finalizeCodeGen();
 
+// The assembly text of the finished compile, NUL-terminated, with its
+// length. The caller frees it with nccFree; later calls return NULL.
+char* takeGeneratedAssembly(size_t* length);
+
 // Generate code from the AST
 void generateCode(ASTNode* root);
 
 // Generate code for a function
 void generateFunction(ASTNode* node);
 
+// Whether a function's code depends on more than its body and the string
+// table (location markers, __start), so it must be generated in place
+int isSpecialFunction(ASTNode* node);
+
 // Generate code for a global variable declaration
 void generateGlobalDeclaration(ASTNode* node);
 
@@ -87,6 +110,9 @@ void generateDoWhileLoop(ASTNode* node);
 // Generate code for an if statement
 void generateIfStatement(ASTNode* node);
 
+// Generate code for a switch statement
+void generateSwitchStatement(ASTNode* node);
+
 // Generate code for a program header
 void generateProgramHeader();
 
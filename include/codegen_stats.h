@@ -0,0 +1,25 @@
+#ifndef CODEGEN_STATS_H
+#define CODEGEN_STATS_H
+
+#include "ast.h"
+
+// Start attributing the code written to the current asmFile (call after
+// initCodeGen). Until then the calls below do nothing.
+void beginCodegenStats();
+
+// Code emitted until the matching leaveCodegen belongs to 'generator'
+// working on 'node' (NULL if none), unless a nested generator claims it.
+// Returns the mark leaveCodegen needs.
+int enterCodegen(const char* generator, ASTNode* node);
+void leaveCodegen(int mark);
+
+// Bracket the code of one function
+void beginCodegenFunction(ASTNode* func);
+void endCodegenFunction();
+
+// Classify the instructions of the finished assembly text and write
+// per-function, per-generator and total counts as JSON to statsPath.
+// Returns nonzero if the file could not be written.
+int writeCodegenStats(const char* text, const char* statsPath, const char* sourceFile);
+
+#endif // CODEGEN_STATS_H
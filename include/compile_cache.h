@@ -0,0 +1,36 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stddef.h>
+
+// Default bound on the size of a cache directory
+#define CACHE_DEFAULT_SIZE (64UL * 1024 * 1024)
+
+// Length of a cache key in hex digits
+#define CACHE_KEY_LEN 16
+
+// Key for one compile: the compiler build, the options that change the
+// output and the preprocessed source
+void computeCacheKey(char key[CACHE_KEY_LEN + 1], const char* flags, const char* source);
+
+// Copy the output cached under key to outputFile. Returns 1 on a hit and
+// 0 on a miss (or if the cache cannot be used); both are counted.
+int cacheLookup(const char* cacheDir, const char* key, const char* outputFile);
+
+// Store a finished output under key, then evict the least recently used
+// entries until the directory fits in maxBytes. Concurrent compilers may
+// store the same key; readers only ever see complete entries.
+void cacheStore(const char* cacheDir, const char* key, const char* outputFile, unsigned long maxBytes);
+
+// Read the function cache entry stored under key into a new buffer
+// (NUL-terminated, *size excludes the NUL). Returns 1 on a hit.
+int cacheLoadFunction(const char* cacheDir, const char* key, char** data, size_t* size);
+
+// Store a function cache entry under key. Eviction is left to the
+// cacheStore at the end of the compile.
+void cacheSaveFunction(const char* cacheDir, const char* key, const char* data, size_t size);
+
+// Print hit/miss counts and the size of a cache directory
+void printCacheStats(const char* cacheDir, unsigned long maxBytes);
+
+#endif // COMPILE_CACHE_H
@@ -0,0 +1,18 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+// Runs one compiler invocation (argv[0] is the program name). The server
+// calls it in a forked process for every request.
+typedef int (*CompilerDriver)(int argc, char* argv[]);
+
+// Serve compile requests on a Unix domain socket until killed. Headers
+// stay cached between requests and are re-read when they change on disk.
+// Returns the exit status for a server that could not start.
+int runCompileServer(const char* socketPath, const char* programName, CompilerDriver driver);
+
+// Send a compile request (arguments without the program name) to a
+// server and relay its output. Returns 1 and sets *status to the
+// compiler's exit status, or 0 if no server answered at socketPath.
+int runCompileClient(const char* socketPath, int argc, char* argv[], int* status);
+
+#endif // COMPILE_SERVER_H
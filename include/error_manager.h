@@ -25,4 +25,7 @@ int getWarningCount();
 // Set the maximum number of errors before giving up
 void setMaxErrors(int max);
 
+// Temporarily silence diagnostics (used while dry-running code generation)
+void suppressDiagnostics(int suppress);
+
 #endif // ERROR_MANAGER_H
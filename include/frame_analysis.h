@@ -0,0 +1,64 @@
+#ifndef FRAME_ANALYSIS_H
+#define FRAME_ANALYSIS_H
+
+#include "ast.h"
+#include <stdio.h>
+
+// Bytes saved by omitting push bp / mov bp, sp / mov sp, bp / pop bp
+#define FRAME_POINTER_BYTES 6
+
+// Result of scanning a function body before code generation
+typedef struct {
+    int hasParams;          // Function takes parameters (accessed via [bp+N])
+    int hasLocals;          // Function declares locals (accessed via [bp-N])
+    int hasCalls;           // Function calls other functions
+    int asmUsesFrame;       // Inline assembly references bp/sp or leaves the stack unbalanced
+    int asmStackBalance;    // Pushes minus pops across all inline assembly in the body
+    int hasAsm;             // Body contains inline assembly
+    int needsFramePointer;  // Function needs push bp / mov bp, sp
+} FrameAnalysis;
+
+// Registers a __stackframe function preserves for its caller
+#define REG_BX 0x01
+#define REG_CX 0x02
+#define REG_DX 0x04
+#define REG_SI 0x08
+#define REG_DI 0x10
+#define REG_PRESERVED_ALL (REG_BX | REG_CX | REG_DX | REG_SI | REG_DI)
+
+// Analyze a function definition and decide whether it needs a frame pointer
+void analyzeFunctionFrame(ASTNode* func, FrameAnalysis* analysis);
+
+// Bytes of element storage a local array occupies
+int getArrayStorageSize(ASTNode* decl);
+
+// Size in bytes of the stack slot a local declaration needs
+int getLocalSlotSize(ASTNode* decl);
+
+// Assign every local declaration in a function a stack slot, packing byte
+// locals together and sharing slots between scopes that never overlap.
+// Returns the number of bytes the frame needs for locals.
+int layoutFunctionLocals(ASTNode* func);
+
+// Pushes minus pops in one piece of inline assembly
+int asmStackDelta(const char* code);
+
+// Scan generated assembly and return the preserved registers (REG_*) it writes
+int scanWrittenRegisters(const char* code);
+
+// Same, but leave out what calls and interrupts might clobber
+int scanExplicitRegisters(const char* code);
+
+// Record that a function was emitted without a frame
+void recordFramelessFunction(const char* funcName);
+
+// Number of functions recorded as frameless so far
+int getFramelessFunctionCount();
+
+// Reset the frame omission statistics
+void resetFrameStats();
+
+// Report how many functions went frameless and the bytes saved
+void reportFrameStats(FILE* asmOut);
+
+#endif // FRAME_ANALYSIS_H
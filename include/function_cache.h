@@ -0,0 +1,48 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include "ast.h"
+#include "compile_cache.h"
+#include <stddef.h>
+
+// What a function's code generation left behind, besides its assembly:
+// the string literals it references, each with where its index is written
+// in the code, and whether it went frameless
+typedef struct {
+    char* code;
+    size_t codeLength;
+    char** strings;
+    long* stringOffsets;
+    int stringCount;
+    int frameless;
+    char* data;     // Backing buffer of a loaded entry
+} CachedFunction;
+
+// Cache the generated code of single functions in cacheDir (NULL turns
+// it off). flags describes the options that change the output and source
+// is the preprocessed text the parser read.
+void initFunctionCache(const char* cacheDir, const char* flags, const char* source, const char* sourceName);
+
+// Hash everything outside function bodies (declarations, prototypes,
+// struct layouts), which every function's key includes
+void beginFunctionCache(ASTNode* program);
+
+// Key of a function: its body, the text outside all bodies, the options
+// and 'state', the codegen state and facts about other functions its code
+// depends on. String literals are not part of it: their indexes are
+// renumbered when the code is spliced in. Returns 0 if the function cannot
+// be cached.
+int functionCacheKey(ASTNode* func, const char* state, char key[CACHE_KEY_LEN + 1]);
+
+// Load the entry for key. Returns 1 on a hit; free it with freeCachedFunction.
+int loadCachedFunction(const char* key, CachedFunction* entry);
+
+void freeCachedFunction(CachedFunction* entry);
+
+// Store what generating a function produced
+void saveCachedFunction(const char* key, const CachedFunction* entry);
+
+// Report how many functions were reused
+void reportFunctionCacheStats();
+
+#endif // FUNCTION_CACHE_H
@@ -30,6 +30,9 @@ typedef enum {
     TOKEN_RETURN,
     TOKEN_BREAK,         // break
     TOKEN_CONTINUE,      // continue
+    TOKEN_SWITCH,        // switch
+    TOKEN_CASE,          // case
+    TOKEN_DEFAULT,       // default
     TOKEN_BOOL,          // bool (C23)
     TOKEN_TRUE,          // true (C23)
     TOKEN_FALSE,         // false (C23)    
@@ -0,0 +1,25 @@
+#ifndef LONG_OPS_H
+#define LONG_OPS_H
+
+#include "ast.h"
+
+// Check if an expression produces a 32-bit long value
+int isLongExpression(ASTNode* expr);
+
+// Evaluate an expression into DX:AX, sign or zero extending 16-bit
+// values. Numeric literals keep all 32 bits.
+void generateLongValue(ASTNode* expr);
+
+// Generate a binary operation on longs using the 386 32-bit registers.
+// Arithmetic leaves the result in DX:AX, comparisons leave 0/1 in AX.
+// Returns 0 if the operation does not involve longs.
+int generateLongBinaryOp386(ASTNode* node);
+
+// Generate an assignment to a long local or parameter with one 32-bit
+// store, leaving the value in DX:AX. Returns 0 for other targets.
+int generateLongAssignment386(ASTNode* node);
+
+// Initialize the long local at [bp-slot] from an expression
+void generateLongInitializer386(ASTNode* init, int slot);
+
+#endif // LONG_OPS_H
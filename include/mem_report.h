@@ -0,0 +1,43 @@
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stddef.h>
+
+// What an allocation is for, the rows of -fmem-report
+typedef enum {
+    MEM_AST,            // Nodes and the names they own
+    MEM_TOKENS,         // Token text from the lexer
+    MEM_MACROS,         // Macro table and include bookkeeping
+    MEM_SOURCE,         // Source files and preprocessed buffers
+    MEM_STRINGS,        // String literal table
+    MEM_ARRAYS,         // Array tables of the code generator
+    MEM_GLOBALS,        // Global declarations
+    MEM_SYMBOLS,        // Locals, structs and types
+    MEM_CODEGEN,        // Labels and other code generator scratch
+    MEM_ASSEMBLER,      // Built-in assembler
+    MEM_OTHER,
+    MEM_TAG_COUNT
+} MemTag;
+
+// Start accounting for a compile. report prints per-tag usage to stderr
+// when it ends; limitBytes (0 for none) makes an allocation that would
+// take the total beyond it fail the compile at once. Without either the
+// wrappers below cost one test each.
+void beginMemReport(int report, unsigned long limitBytes);
+
+// Print the report for sourceFile, including what is still allocated,
+// then stop accounting
+void endMemReport(const char* sourceFile);
+
+// malloc and friends, counted under 'tag'. They return NULL on failure
+// like the originals; memory from them may also be passed to free(), it
+// is then counted as live until its address is reused.
+void* nccMalloc(MemTag tag, size_t size);
+void* nccCalloc(MemTag tag, size_t count, size_t size);
+void* nccRealloc(MemTag tag, void* ptr, size_t size);
+char* nccStrdup(MemTag tag, const char* s);
+
+// free() for any pointer, counted if it came from the wrappers
+void nccFree(void* ptr);
+
+#endif // MEM_REPORT_H
@@ -0,0 +1,40 @@
+#ifndef PARALLEL_CODEGEN_H
+#define PARALLEL_CODEGEN_H
+
+#include "ast.h"
+#include <stdio.h>
+
+// Generate functions in up to 'jobs' worker processes; 1 turns the pool
+// off and 0 uses one worker per CPU
+void setCodegenJobs(int jobs);
+
+// Generates one top-level node into asmFile
+typedef void (*TopLevelGenerator)(ASTNode* node);
+
+// Generate the ordinary functions of the run of top-level nodes that
+// starts at 'first' in worker processes, each function into its own
+// buffer, and append the results in source order, so the output is the
+// same as generating the nodes one by one with 'generate'. Global
+// declarations and special functions end a run. Returns the node after
+// the run, or 'first' itself if it should be generated serially.
+ASTNode* generateFunctionsInParallel(ASTNode* first, TopLevelGenerator generate);
+
+// Where a string literal's index was written in a function's code
+typedef struct {
+    long offset;    // Of the first digit, from the start of the code
+    int index;
+} StringReference;
+
+// The decimal index of string literal 'index' is written to 'file' next;
+// workers and the function cache record these so the index can be
+// renumbered when the code is spliced in
+void noteStringReference(FILE* file, int index);
+
+// Record the string references written to 'file' from now on
+void recordStringReferences(FILE* file);
+
+// Stop recording and return the references recorded, in the order they
+// were written (valid until recording starts again), or -1 if some were lost
+int stopRecordingStringReferences(StringReference** recorded);
+
+#endif // PARALLEL_CODEGEN_H
@@ -52,6 +52,12 @@ ASTNode* parseDoWhileStatement();
 // Parse an if statement
 ASTNode* parseIfStatement();
 
+// Parse a switch statement
+ASTNode* parseSwitchStatement();
+
+// Parse a case or default label
+ASTNode* parseCaseLabel();
+
 // Parse an inline assembly block
 ASTNode* parseAsmBlock();
 
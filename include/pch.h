@@ -0,0 +1,19 @@
+#ifndef PCH_H
+#define PCH_H
+
+// Precompiled headers. Included text never reaches the parser (the
+// preprocessor only keeps what a header does to the macro table), so a
+// PCH holds the macros the header defines or undefines and the files it
+// pulled in, which a later #include of them then skips.
+
+// Preprocess a header and write the state it leaves behind to
+// outputPath. Returns 0 on success, 1 after printing an error.
+int writePrecompiledHeader(const char* headerPath, const char* outputPath);
+
+// Restore the state saved in a PCH into the current preprocessor. The
+// file must come from this compiler build and the macro table must match
+// the one the header was compiled against. Returns 0 on success, 1 after
+// printing an error.
+int loadPrecompiledHeader(const char* pchPath);
+
+#endif // PCH_H
@@ -41,9 +41,51 @@ char* preprocessSource(const char* source);
 // Process a file and return its content after preprocessing
 char* preprocessFile(const char* filename);
 
+// Read a source file and the headers it includes into the file cache,
+// so that processes forked afterwards do not read them again
+void preloadIncludes(const char* filename);
+
+// Make the file cache re-read files whose inode, size or modification
+// time changed since they were cached (for long-lived processes)
+void setFileCacheValidation(int enabled);
+
+// Remember what each #include did to the macro table, the included files
+// and the dependency list, keyed by the state it was included in, and
+// replay that instead of processing the header again (for long-lived
+// processes, with validation on)
+void setHeaderEffectCache(int enabled);
+
+// Write a Makefile rule making target depend on sourceFile and every
+// header an #include pulled in since initPreprocessor
+void writeDependencies(FILE* out, const char* target, const char* sourceFile);
+
+// Follow only the directives (#include, #define, conditionals) and drop
+// all other text, for dependency scans
+void setDirectivesOnly(int enabled);
+
+// Stream the preprocessed text of the outermost file to 'stream' (NULL
+// to stop); preprocessFile then returns what was not yet written, which
+// is nothing
+void setPreprocessOutput(FILE* stream);
+
 // Define a macro programmatically (used for built-in macros)
 void defineMacro(const char* name, const char* value);
 
+// Undefine a macro, as #undef does
+void undefineMacro(const char* name);
+
+// The macro table, including entries that were #undef'd
+const Macro* getMacros(int* count);
+
+// Hash of the macro table, leaving out __FILE__
+unsigned int hashMacroState();
+
+// Files processed so far (every file is included once); NULL past the end
+const char* getIncludedFile(int index);
+
+// Record a file as included, so a later #include of it is skipped
+void markFileIncluded(const char* filename);
+
 // Check if a macro is defined
 int isMacroDefined(const char* name);
 
@@ -54,4 +96,7 @@ const char* getMacroValue(const char* name);
 // Returns 1 if the expression evaluates to non-zero, 0 otherwise
 int evaluatePreprocessorExpression(const char* expr);
 
+// Errors and warnings evaluatePreprocessorExpression has printed so far
+int getExpressionProblemCount();
+
 #endif // PREPROCESSOR_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef REGISTER_ALLOC_H
+#define REGISTER_ALLOC_H
+
+#include "ast.h"
+#include <stdio.h>
+
+// Assign the hottest scalar locals and parameters of a function to SI/DI
+// using linear scan over their live ranges. Sets declaration.alloc_reg on
+// every variable that got a register and returns the registers used (REG_*).
+int allocateFunctionRegisters(ASTNode* func);
+
+// Check whether a call to the named function leaves SI/DI as they were,
+// following its calls through the whole program
+int calleePreservesRegisters(const char* name);
+
+// Describe, for each call a function makes to a function defined in the
+// program, whether the callee preserves SI/DI ("name:1 "), for keys of
+// cached code. Free with nccFree.
+char* describeCalleeRegisters(ASTNode* func);
+
+// Name of an allocatable register bit ("si", "di")
+const char* getAllocatedRegisterName(int reg);
+
+// Write the variables that got registers as an assembly comment
+void emitAllocationSummary(FILE* out);
+
+// Push the allocated registers that are live across a clobbering node
+// (call, inline assembly, stack array copy). Returns the registers saved.
+int emitSaveLiveRegisters(FILE* out, ASTNode* node);
+
+// Pop the registers saved by emitSaveLiveRegisters
+void emitRestoreLiveRegisters(FILE* out, int saved);
+
+// Print every allocation decision to stdout (-dr)
+void setRegisterAllocationDump(int enabled);
+
+#endif // REGISTER_ALLOC_H
@@ -0,0 +1,20 @@
+#ifndef STRENGTH_REDUCTION_H
+#define STRENGTH_REDUCTION_H
+
+#include "ast.h"
+
+// Get the value of a constant integer operand (a literal, possibly negated).
+// Returns 0 if the expression is not a constant.
+int getConstantOperand(ASTNode* expr, int* value);
+
+// Apply *, / or % by a constant to AX using shifts, adds, masks or a
+// multiply by the reciprocal when that is cheaper than imul/idiv on the
+// target. May clobber BX, CX and DX. Returns 0 without emitting anything
+// when the generic instruction is as cheap.
+int emitConstantOperation(OperatorType op, int constant, int isUnsigned);
+
+// Generate a binary *, / or % with a constant operand. Returns 0 if the
+// node is left to the generic code.
+int generateConstantMulDivMod(ASTNode* node, int isUnsigned);
+
+#endif // STRENGTH_REDUCTION_H
@@ -7,6 +7,14 @@
 // Add a string literal to the string literals table and return its index
 int addStringLiteral(const char* str);
 
+// Add an escaped string (as stored in the table), reusing an identical
+// one when strings are merged; the table takes ownership. Returns its index.
+int internStringLiteral(char* escaped);
+
+// Append an escaped string (as stored in the table) without looking for
+// an identical one; the table takes ownership. Returns its index.
+int appendStringLiteral(char* escaped);
+
 // Add an array declaration to track for generation later
 int addArrayDeclaration(const char* name, int size, DataType type, const char* funcName);
 
@@ -24,10 +32,19 @@ void generateArraysAtMarker();
 // Generate string literals and arrays at end of file if not already done
 void generateStringLiteralsSection();
 
+// Report the bytes saved by sharing string tails
+void reportStringStats(FILE* asmOut);
+
 // Get sanitized filename prefix (for use in labels)
 char* getSanitizedFilenamePrefix();
 
 // Clean up allocated memory
 void cleanupStringAndArrayTables();
 
+// Drop string literals added after the first 'count' entries
+void truncateStringLiterals(int count);
+
+// Drop array declarations added after the first 'count' entries
+void truncateArrayDeclarations(int count);
+
 #endif // STRING_LITERALS_H
@@ -0,0 +1,42 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "ast.h"
+
+// What a name refers to
+typedef enum {
+    SYMBOL_GLOBAL,     // File-scope variable
+    SYMBOL_LOCAL,      // Block-scope variable
+    SYMBOL_PARAMETER   // Function parameter
+} SymbolKind;
+
+// A declared name. Code generation fills in where the variable lives.
+typedef struct Symbol {
+    char* name;
+    SymbolKind kind;
+    TypeInfo type;
+    int offset;        // Bytes below bp for locals, negated bytes above bp for parameters
+    int size;          // Slot size in bytes (1 for packed char/bool locals)
+    int isSigned;      // Whether byte locals are sign-extended when loaded
+    int reg;           // Register the allocator placed it in (REG_*), 0 if in memory
+    unsigned int hash;
+    struct Symbol* shadowed;    // Outer declaration hidden by this one
+    struct Symbol* bucketNext;  // Next visible name in the same hash bucket
+} Symbol;
+
+// Open a block scope; returns the level to pass to endSymbolScope
+int beginSymbolScope();
+
+// Close the scope opened at 'level' and every scope inside it
+void endSymbolScope(int level);
+
+// Check if no block scope is open
+int isGlobalSymbolScope();
+
+// Declare a name in the innermost scope, hiding outer declarations
+Symbol* addSymbol(const char* name, SymbolKind kind, TypeInfo type);
+
+// Find the innermost visible declaration of a name, NULL if there is none
+Symbol* findSymbol(const char* name);
+
+#endif // SYMBOL_TABLE_H
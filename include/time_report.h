@@ -0,0 +1,38 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+// Compile phases, the rows of -ftime-report
+#define PHASE_PREPROCESS 0
+#define PHASE_LEX        1
+#define PHASE_PARSE      2
+#define PHASE_TYPES      3
+#define PHASE_CODEGEN    4
+#define PHASE_DATA       5   // String, array and global emission
+#define PHASE_ASSEMBLE   6   // Built-in assembler
+#define PHASE_NAS        7   // External nas run
+#define PHASE_CACHE      8
+#define PHASE_COUNT      9
+
+// Start timing a compile. report prints a per-phase table to stderr when
+// it ends; traceFile (or NULL) receives Chrome trace-event JSON.
+void beginTimeReport(int report, const char* traceFile);
+
+// Print the report and write the trace for sourceFile, then stop timing.
+// Returns nonzero if the trace could not be written.
+int endTimeReport(const char* sourceFile);
+
+// Open a span of 'phase'. Spans nest; a phase is charged only for time
+// not spent in the spans inside it. label names the span in the trace.
+// NULL spans are for very frequent events (tokens): they only count
+// toward the phase, and read the wall clock alone, taking their CPU time
+// to be the same.
+void startTimer(int phase, const char* label);
+
+// Open the codegen span of a function, which also gets a row in the
+// per-function table
+void startFunctionTimer(const char* name);
+
+// Close the innermost span
+void stopTimer();
+
+#endif // TIME_REPORT_H
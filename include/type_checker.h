@@ -12,6 +12,9 @@ TypeInfo* findTypeSymbol(const char* name);
 // Get type information for a symbol (for use in codegen)
 TypeInfo* getTypeInfo(const char* name);
 
+// Find the definition or prototype of a function, NULL if there is none
+ASTNode* findFunctionDeclaration(const char* name);
+
 // Function to check if a node's type is a void pointer
 int isVoidPointer(ASTNode* node);
 
@@ -21,4 +24,11 @@ int isVoidPointerDereference(ASTNode* node);
 // Get type information from an expression
 TypeInfo* getTypeInfoFromExpression(ASTNode* expr);
 
+// Get the struct member named by a member access, NULL if it has none
+StructMember* getAccessedMember(ASTNode* expr);
+
+// Resolve the type of every expression once, after parsing, and cache it
+// on the node so code generation needs no symbol lookups
+void annotateTypes(ASTNode* root);
+
 #endif // TYPE_CHECKER_H
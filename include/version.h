@@ -0,0 +1,13 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// Release of this compiler, as printed by --version
+#define NCC_VERSION "1.48"
+
+// Identifies one build of the compiler. Files that are only valid for the
+// compiler that wrote them (precompiled headers, cache entries) store it.
+// It is a hash of the running executable, so any relink that changes the
+// code changes it, whichever sources were rebuilt.
+const char* compilerBuildId();
+
+#endif // VERSION_H
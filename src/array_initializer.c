@@ -41,9 +41,9 @@ void writeArrayWithInitializers(FILE* outFile, const char* arrayName, int arrayS
     // Determine directive based on element type
     const char* directive;
     if (arrayType == TYPE_CHAR || arrayType == TYPE_UNSIGNED_CHAR || arrayType == TYPE_BOOL) {
-        directive = "db";
+        directive = "#db";
     } else {
-        directive = "dw";
+        directive = "#dw";
     }
     
     // Process initializers
@@ -1,17 +1,19 @@
 #include "array_ops.h"
 #include "codegen.h"
 #include "ast.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Forward declaration of getTypeInfo
-TypeInfo* getTypeInfo(const char* name);
+// Forward declaration of getTypeInfoFromExpression
+TypeInfo* getTypeInfoFromExpression(ASTNode* expr);
 
 // Forward declarations from codegen.c
 extern FILE* asmFile;
 extern int getVariableOffset(const char* name);
 extern int isParameter(const char* name);
+extern const char* getVariableRegister(const char* name);
 extern void generateExpression(ASTNode* node);
 
 // Check if we're accessing a string literal or array
@@ -33,13 +35,25 @@ int isStringLiteralAccess(ASTNode* array, ASTNode* index) {
     return 0;
 }
 
-// Generate optimized code for array indexing with literal index
+static void emitOptimizedArrayAccess(ASTNode* array, ASTNode* index);
+
 void generateOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
+    int mark = enterCodegen("generateOptimizedArrayAccess", NULL);
+    emitOptimizedArrayAccess(array, index);
+    leaveCodegen(mark);
+}
+
+// Generate optimized code for array indexing with literal index
+static void emitOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
     // First generate code to get the array address
     if (array->type == NODE_IDENTIFIER) {
         char* name = array->identifier;
         
-        if (isParameter(name)) {
+        if (getVariableRegister(name)) {
+            // Pointer kept in a register by the allocator
+            fprintf(asmFile, "    mov bx, %s ; Load array pointer from register variable %s\n", 
+                  getVariableRegister(name), name);
+        } else if (isParameter(name)) {
             // Parameter array - get address from BP + offset
             fprintf(asmFile, "    ; Array parameter %s\n", name);
             fprintf(asmFile, "    mov bx, [bp+%d] ; Load array pointer from parameter\n", 
@@ -60,7 +74,7 @@ void generateOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
     int elementSize = 1; // Default to byte size (char)
     
     if (array->type == NODE_IDENTIFIER) {
-        arrayTypeInfo = getTypeInfo(array->identifier);
+        arrayTypeInfo = getTypeInfoFromExpression(array);
         if (arrayTypeInfo) {
             // Check element type (for array of pointers, etc.)
             if (arrayTypeInfo->type == TYPE_INT || 
@@ -0,0 +1,1602 @@
+#include "assembler.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+// Built-in assembler for the nas dialect NCC writes. It knows the
+// 8086/80186 instructions that codegen and typical inline asm use, lays
+// the program out with branch relaxation and writes a flat binary. It
+// picks the same encodings as nas, so the output is byte for byte what
+// nas would produce. Anything it does not recognise makes it give up so
+// the caller can fall back to nas.
+
+#define MAX_OPERANDS 2
+#define MAX_INSN_BYTES 16
+#define MAX_LAYOUT_PASSES 64
+
+typedef enum {
+    OPND_NONE,
+    OPND_REG8,
+    OPND_REG16,
+    OPND_SREG,
+    OPND_IMM,
+    OPND_MEM,
+    OPND_FAR        // seg:offset jump or call target
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int reg;            // Register number for register operands
+    int size;           // 1 or 2 when known, 0 if the other operand decides
+    int segment;        // Segment override of a memory operand, -1 if none
+    int rm;             // ModRM r/m field of a memory operand
+    int direct;         // Memory operand is a bare address (mod 00, r/m 110)
+    char* expr;         // Immediate, displacement or far offset
+    char* segExpr;      // Segment part of a far target
+} Operand;
+
+typedef enum {
+    STMT_LABEL,
+    STMT_INSN,
+    STMT_DATA,
+    STMT_ORIGIN
+} StmtKind;
+
+struct Stmt;
+typedef int (*Encoder)(struct Stmt* stmt, int param, unsigned char* out);
+
+typedef struct {
+    const char* name;
+    Encoder encode;
+    int param;
+} Mnemonic;
+
+typedef struct Stmt {
+    StmtKind kind;
+    int line;
+    char* label;                // STMT_LABEL
+    const Mnemonic* mnemonic;   // STMT_INSN, NULL for a lone prefix
+    int prefix;                 // rep/lock prefix byte, 0 if none
+    Operand ops[MAX_OPERANDS];
+    int opCount;
+    int dataSize;               // STMT_DATA: bytes per item
+    char** items;               // STMT_DATA items, STMT_ORIGIN value
+    int itemCount;
+    char* times;                // Repeat count expression, NULL if none
+    int nearJump;               // Jump needs its long form (never shrinks)
+    int address;
+    int size;
+} Stmt;
+
+// Labels hashed by name
+typedef struct AsmSymbol {
+    char* name;
+    long value;
+    int defined;        // Seen in this or an earlier pass
+    int pass;           // Pass that last set the value
+    struct AsmSymbol* next;
+} AsmSymbol;
+
+#define SYMBOL_BUCKETS 1024
+
+static AsmSymbol* symbols[SYMBOL_BUCKETS];
+static Stmt* stmts = NULL;
+static int stmtCount = 0;
+static int stmtCapacity = 0;
+
+static long origin = 0;
+static int currentPass = 0;
+static int finalPass = 0;
+static int layoutChanged = 0;
+static Stmt* currentStmt = NULL;
+static int failed = 0;
+static char failure[256];
+
+// Flags set while evaluating an expression
+#define EXPR_UNRESOLVED 1   // Uses a label that has no address yet
+#define EXPR_RELOCATABLE 2  // Uses a label or $, so its value depends on layout
+
+static const char* reg16Names[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+static const char* reg8Names[] = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+static const char* sregNames[] = {"es", "cs", "ss", "ds"};
+
+static void fail(const char* format, ...) {
+    if (failed) return;
+    failed = 1;
+
+    int used = 0;
+    if (currentStmt) {
+        used = snprintf(failure, sizeof(failure), "line %d: ", currentStmt->line);
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(failure + used, sizeof(failure) - used, format, args);
+    va_end(args);
+}
+
+const char* getAssemblerFailure() {
+    return failure;
+}
+
+static char* copyRange(const char* start, const char* end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+
+    char* text = (char*)nccMalloc(MEM_ASSEMBLER, end - start + 1);
+    if (!text) {
+        fprintf(stderr, "Error: Out of memory in assembler\n");
+        exit(1);
+    }
+    memcpy(text, start, end - start);
+    text[end - start] = '\0';
+    return text;
+}
+
+static int isIdentStart(char c) {
+    return isalpha((unsigned char)c) || c == '_' || c == '.' || c == '@' || c == '?';
+}
+
+static int isIdentChar(char c) {
+    return isIdentStart(c) || isdigit((unsigned char)c) || c == '$';
+}
+
+// Case-insensitive compare; nas accepts mnemonics and registers in any case
+static int sameWord(const char* a, const char* b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) == tolower((unsigned char)*b);
+}
+
+// Check if 'text' starts with the keyword 'word' as a whole word
+static int startsWord(const char* text, const char* word) {
+    size_t length = strlen(word);
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)text[i]) != word[i]) return 0;
+    }
+    return !isIdentChar(text[length]);
+}
+
+static int findName(const char* name, const char** names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (sameWord(name, names[i])) return i;
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------------------
+// Symbols
+
+static unsigned int hashSymbol(const char* name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash & (SYMBOL_BUCKETS - 1);
+}
+
+static AsmSymbol* lookupSymbol(const char* name, int create) {
+    unsigned int bucket = hashSymbol(name);
+    for (AsmSymbol* symbol = symbols[bucket]; symbol; symbol = symbol->next) {
+        if (strcmp(symbol->name, name) == 0) return symbol;
+    }
+    if (!create) return NULL;
+
+    AsmSymbol* symbol = (AsmSymbol*)nccCalloc(MEM_ASSEMBLER, 1, sizeof(AsmSymbol));
+    if (!symbol) {
+        fprintf(stderr, "Error: Out of memory in assembler\n");
+        exit(1);
+    }
+    symbol->name = copyRange(name, name + strlen(name));
+    symbol->pass = -1;
+    symbol->next = symbols[bucket];
+    symbols[bucket] = symbol;
+    return symbol;
+}
+
+static void defineLabel(const char* name, long value) {
+    AsmSymbol* symbol = lookupSymbol(name, 1);
+    if (symbol->pass == currentPass) {
+        fail("label '%s' is defined twice", name);
+        return;
+    }
+    if (!symbol->defined || symbol->value != value) {
+        layoutChanged = 1;
+    }
+    symbol->value = value;
+    symbol->defined = 1;
+    symbol->pass = currentPass;
+}
+
+// ---------------------------------------------------------------------
+// Expressions: numbers, 'c', labels, $, ( ), unary - ~ +, * / %, + -,
+// << >>, &, ^, |
+
+typedef struct {
+    const char* p;
+    int flags;
+    long here;      // Value of $
+} ExprState;
+
+static long parseOr(ExprState* state);
+
+static void skipSpaces(ExprState* state) {
+    while (isspace((unsigned char)*state->p)) state->p++;
+}
+
+static long parseNumber(ExprState* state) {
+    const char* p = state->p;
+    const char* end = p;
+    while (isalnum((unsigned char)*end)) end++;
+
+    long value = 0;
+    char* stop = NULL;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        value = strtol(p + 2, &stop, 16);
+    } else if (end - p > 2 && p[0] == '0' && (p[1] == 'b' || p[1] == 'B')) {
+        value = strtol(p + 2, &stop, 2);
+    } else if (end[-1] == 'h' || end[-1] == 'H') {
+        value = strtol(p, &stop, 16);
+        if (stop == end - 1) stop = (char*)end;
+    } else {
+        value = strtol(p, &stop, 10);
+    }
+    if (stop != end) {
+        fail("bad number '%.*s'", (int)(end - p), p);
+    }
+    state->p = end;
+    return value;
+}
+
+static long parsePrimary(ExprState* state) {
+    skipSpaces(state);
+    char c = *state->p;
+
+    if (c == '(') {
+        state->p++;
+        long value = parseOr(state);
+        skipSpaces(state);
+        if (*state->p != ')') {
+            fail("missing ')'");
+            return 0;
+        }
+        state->p++;
+        return value;
+    }
+    if (c == '-') {
+        state->p++;
+        return -parsePrimary(state);
+    }
+    if (c == '+') {
+        state->p++;
+        return parsePrimary(state);
+    }
+    if (c == '~') {
+        state->p++;
+        return ~parsePrimary(state);
+    }
+    if (c == '\'' && state->p[1] && state->p[2] == '\'') {
+        long value = (unsigned char)state->p[1];
+        state->p += 3;
+        return value;
+    }
+    if (c == '$' && !isIdentChar(state->p[1])) {
+        state->p++;
+        state->flags |= EXPR_RELOCATABLE;
+        return state->here;
+    }
+    if (isdigit((unsigned char)c)) {
+        return parseNumber(state);
+    }
+    if (isIdentStart(c)) {
+        const char* start = state->p;
+        while (isIdentChar(*state->p)) state->p++;
+
+        char name[256];
+        int length = (int)(state->p - start);
+        if (length >= (int)sizeof(name)) length = sizeof(name) - 1;
+        memcpy(name, start, length);
+        name[length] = '\0';
+
+        state->flags |= EXPR_RELOCATABLE;
+        AsmSymbol* symbol = lookupSymbol(name, 0);
+        if (!symbol || !symbol->defined) {
+            if (finalPass) fail("undefined symbol '%s'", name);
+            state->flags |= EXPR_UNRESOLVED;
+            return 0;
+        }
+        return symbol->value;
+    }
+
+    fail("cannot parse expression at '%s'", state->p);
+    return 0;
+}
+
+static long parseProduct(ExprState* state) {
+    long value = parsePrimary(state);
+    for (;;) {
+        skipSpaces(state);
+        char op = *state->p;
+        if (op != '*' && op != '/' && op != '%') return value;
+        state->p++;
+        long right = parsePrimary(state);
+        if (op == '*') {
+            value *= right;
+        } else if (right == 0) {
+            if (!(state->flags & EXPR_UNRESOLVED)) fail("division by zero");
+            value = 0;
+        } else {
+            value = op == '/' ? value / right : value % right;
+        }
+    }
+}
+
+static long parseSum(ExprState* state) {
+    long value = parseProduct(state);
+    for (;;) {
+        skipSpaces(state);
+        char op = *state->p;
+        if (op != '+' && op != '-') return value;
+        state->p++;
+        long right = parseProduct(state);
+        value = op == '+' ? value + right : value - right;
+    }
+}
+
+static long parseShift(ExprState* state) {
+    long value = parseSum(state);
+    for (;;) {
+        skipSpaces(state);
+        if ((state->p[0] != '<' && state->p[0] != '>') || state->p[1] != state->p[0]) return value;
+        int left = state->p[0] == '<';
+        state->p += 2;
+        long right = parseSum(state);
+        value = left ? value << right : value >> right;
+    }
+}
+
+static long parseAnd(ExprState* state) {
+    long value = parseShift(state);
+    for (;;) {
+        skipSpaces(state);
+        if (*state->p != '&') return value;
+        state->p++;
+        value &= parseShift(state);
+    }
+}
+
+static long parseXor(ExprState* state) {
+    long value = parseAnd(state);
+    for (;;) {
+        skipSpaces(state);
+        if (*state->p != '^') return value;
+        state->p++;
+        value ^= parseAnd(state);
+    }
+}
+
+static long parseOr(ExprState* state) {
+    long value = parseXor(state);
+    for (;;) {
+        skipSpaces(state);
+        if (*state->p != '|') return value;
+        state->p++;
+        value |= parseXor(state);
+    }
+}
+
+// Evaluate an expression for the current statement. 'flags' receives
+// EXPR_UNRESOLVED and EXPR_RELOCATABLE.
+static long evaluate(const char* text, int* flags) {
+    ExprState state;
+    state.p = text;
+    state.flags = 0;
+    state.here = currentStmt ? currentStmt->address : 0;
+
+    long value = parseOr(&state);
+    skipSpaces(&state);
+    if (*state.p) {
+        fail("unexpected '%s' in expression", state.p);
+    }
+    if (flags) *flags = state.flags;
+    return value;
+}
+
+// ---------------------------------------------------------------------
+// Operands
+
+// Parse the inside of [ ]: an optional segment, base/index registers and
+// a displacement
+static int parseMemory(const char* text, Operand* op) {
+    op->kind = OPND_MEM;
+
+    const char* colon = strchr(text, ':');
+    if (colon) {
+        char* segName = copyRange(text, colon);
+        op->segment = findName(segName, sregNames, 4);
+        nccFree(segName);
+        if (op->segment < 0) {
+            fail("bad segment override in '[%s]'", text);
+            return 0;
+        }
+        text = colon + 1;
+    }
+
+    int hasBx = 0, hasBp = 0, hasSi = 0, hasDi = 0;
+    char disp[256] = "";
+    const char* p = text;
+    char sign = '+';
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '+' || *p == '-') {
+            sign = *p++;
+            continue;
+        }
+
+        // One term runs to the next top-level + or -
+        const char* start = p;
+        int depth = 0;
+        while (*p && (depth > 0 || (*p != '+' && *p != '-'))) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+            p++;
+        }
+        char* term = copyRange(start, p);
+
+        int reg = findName(term, reg16Names, 8);
+        if (reg >= 0) {
+            if (sign == '-' || (reg != 3 && reg != 5 && reg != 6 && reg != 7)) {
+                fail("bad address register in '[%s]'", text);
+                nccFree(term);
+                return 0;
+            }
+            if (reg == 3) hasBx++;
+            if (reg == 5) hasBp++;
+            if (reg == 6) hasSi++;
+            if (reg == 7) hasDi++;
+        } else if (*term) {
+            size_t used = strlen(disp);
+            snprintf(disp + used, sizeof(disp) - used, "%s%c(%s)", used ? " " : "", sign, term);
+        }
+        nccFree(term);
+        sign = '+';
+    }
+
+    if (hasBx > 1 || hasBp > 1 || hasSi > 1 || hasDi > 1 ||
+        (hasBx && hasBp) || (hasSi && hasDi)) {
+        fail("bad address registers in '[%s]'", text);
+        return 0;
+    }
+
+    if (hasBx && hasSi) op->rm = 0;
+    else if (hasBx && hasDi) op->rm = 1;
+    else if (hasBp && hasSi) op->rm = 2;
+    else if (hasBp && hasDi) op->rm = 3;
+    else if (hasSi) op->rm = 4;
+    else if (hasDi) op->rm = 5;
+    else if (hasBp) op->rm = 6;
+    else if (hasBx) op->rm = 7;
+    else op->direct = 1;
+
+    if (disp[0]) {
+        op->expr = copyRange(disp, disp + strlen(disp));
+    } else if (op->direct) {
+        fail("empty memory operand");
+        return 0;
+    }
+    return 1;
+}
+
+static int parseOperand(char* text, Operand* op) {
+    memset(op, 0, sizeof(Operand));
+    op->segment = -1;
+
+    // Size and distance keywords
+    for (;;) {
+        int skip = 0;
+        if (startsWord(text, "byte")) {
+            op->size = 1;
+            skip = 4;
+        } else if (startsWord(text, "word")) {
+            op->size = 2;
+            skip = 4;
+        } else if (startsWord(text, "ptr")) {
+            skip = 3;
+        } else if (startsWord(text, "short")) {
+            skip = 5;
+        } else if (startsWord(text, "near")) {
+            skip = 4;
+        }
+        if (!skip) break;
+        text += skip;
+        while (isspace((unsigned char)*text)) text++;
+    }
+
+    size_t length = strlen(text);
+    if (length == 0) {
+        fail("missing operand");
+        return 0;
+    }
+
+    // Segment written in front of the brackets: es:[di]
+    int segment = -1;
+    if (length > 3 && text[2] == ':' && text[3] != ':') {
+        char name[3] = {text[0], text[1], '\0'};
+        segment = findName(name, sregNames, 4);
+        if (segment >= 0) {
+            text += 3;
+            while (isspace((unsigned char)*text)) text++;
+            length = strlen(text);
+        }
+    }
+
+    if (text[0] == '[') {
+        if (text[length - 1] != ']') {
+            fail("missing ']' in '%s'", text);
+            return 0;
+        }
+        char* inner = copyRange(text + 1, text + length - 1);
+        int ok = parseMemory(inner, op);
+        nccFree(inner);
+        if (segment >= 0) op->segment = segment;
+        return ok;
+    }
+    if (segment >= 0) {
+        fail("segment override needs a memory operand");
+        return 0;
+    }
+
+    int reg;
+    if ((reg = findName(text, reg16Names, 8)) >= 0) {
+        op->kind = OPND_REG16;
+        op->reg = reg;
+        op->size = 2;
+        return 1;
+    }
+    if ((reg = findName(text, reg8Names, 8)) >= 0) {
+        op->kind = OPND_REG8;
+        op->reg = reg;
+        op->size = 1;
+        return 1;
+    }
+    if ((reg = findName(text, sregNames, 4)) >= 0) {
+        op->kind = OPND_SREG;
+        op->reg = reg;
+        op->size = 2;
+        return 1;
+    }
+
+    // seg:offset
+    const char* colon = strchr(text, ':');
+    if (colon) {
+        op->kind = OPND_FAR;
+        op->segExpr = copyRange(text, colon);
+        op->expr = copyRange(colon + 1, text + length);
+        return 1;
+    }
+
+    op->kind = OPND_IMM;
+    op->expr = copyRange(text, text + length);
+    return 1;
+}
+
+// ---------------------------------------------------------------------
+// Encoding helpers
+
+static void put16(unsigned char* out, long value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+}
+
+static int isRegister(Operand* op) {
+    return op->kind == OPND_REG8 || op->kind == OPND_REG16;
+}
+
+static int isRegOrMem(Operand* op) {
+    return isRegister(op) || op->kind == OPND_MEM;
+}
+
+static int fitsSigned8(long value) {
+    return value >= -128 && value <= 127;
+}
+
+// Operand size of an instruction from its operands, or 0 if neither says
+static int operandSize(Operand* a, Operand* b) {
+    if (a && a->size) return a->size;
+    if (b && b->size && b->kind != OPND_IMM) return b->size;
+    return 0;
+}
+
+// Write a ModRM byte with its displacement for a register or memory operand
+static int putModRM(unsigned char* out, int regField, Operand* op) {
+    if (isRegister(op) || op->kind == OPND_SREG) {
+        out[0] = 0xC0 | (regField << 3) | op->reg;
+        return 1;
+    }
+
+    if (op->direct) {
+        out[0] = (regField << 3) | 6;
+        put16(out + 1, evaluate(op->expr, NULL));
+        return 3;
+    }
+
+    if (!op->expr && op->rm != 6) {
+        out[0] = (regField << 3) | op->rm;
+        return 1;
+    }
+
+    int flags = 0;
+    long disp = op->expr ? evaluate(op->expr, &flags) : 0;
+    if (!(flags & EXPR_RELOCATABLE) && disp == 0 && op->rm != 6) {
+        out[0] = (regField << 3) | op->rm;
+        return 1;
+    }
+    if (!(flags & EXPR_RELOCATABLE) && fitsSigned8(disp)) {
+        out[0] = 0x40 | (regField << 3) | op->rm;
+        out[1] = disp & 0xFF;
+        return 2;
+    }
+    out[0] = 0x80 | (regField << 3) | op->rm;
+    put16(out + 1, disp);
+    return 3;
+}
+
+static int putImmediate(unsigned char* out, const char* expr, int size) {
+    long value = evaluate(expr, NULL);
+    out[0] = value & 0xFF;
+    if (size == 2) out[1] = (value >> 8) & 0xFF;
+    return size;
+}
+
+static int expectOperands(Stmt* stmt, int count) {
+    if (stmt->opCount != count) {
+        fail("'%s' takes %d operand(s)", stmt->mnemonic->name, count);
+        return 0;
+    }
+    return 1;
+}
+
+static int badOperands(Stmt* stmt) {
+    fail("unsupported operands for '%s'", stmt->mnemonic->name);
+    return -1;
+}
+
+static int needSize(Stmt* stmt, int size) {
+    if (size == 0) {
+        fail("operand size of '%s' is not known (use byte or word)", stmt->mnemonic->name);
+    }
+    return size;
+}
+
+// ---------------------------------------------------------------------
+// Encoders. Each writes the instruction into 'out' and returns its
+// length, or -1 if it cannot be encoded.
+
+// No operands, one opcode byte
+static int encodeFixed(Stmt* stmt, int opcode, unsigned char* out) {
+    if (!expectOperands(stmt, 0)) return -1;
+    out[0] = opcode;
+    return 1;
+}
+
+// add/or/adc/sbb/and/sub/xor/cmp; param is the /digit
+static int encodeAlu(Stmt* stmt, int op, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+
+    if (isRegOrMem(a) && isRegister(b)) {
+        if (isRegister(a) && a->size != b->size) return badOperands(stmt);
+        out[0] = op * 8 + (b->size == 2);
+        return 1 + putModRM(out + 1, b->reg, a);
+    }
+    if (isRegister(a) && b->kind == OPND_MEM) {
+        out[0] = op * 8 + 2 + (a->size == 2);
+        return 1 + putModRM(out + 1, a->reg, b);
+    }
+    if (isRegOrMem(a) && b->kind == OPND_IMM) {
+        int size = needSize(stmt, operandSize(a, NULL));
+        if (!size) return -1;
+        if (size == 1) {
+            out[0] = 0x80;
+            int n = 1 + putModRM(out + 1, op, a);
+            return n + putImmediate(out + n, b->expr, 1);
+        }
+        int flags = 0;
+        long value = evaluate(b->expr, &flags);
+        int shortForm = !(flags & EXPR_RELOCATABLE) && fitsSigned8(value);
+        out[0] = shortForm ? 0x83 : 0x81;
+        int n = 1 + putModRM(out + 1, op, a);
+        return n + putImmediate(out + n, b->expr, shortForm ? 1 : 2);
+    }
+    return badOperands(stmt);
+}
+
+static int encodeMov(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+
+    if (a->kind == OPND_SREG && (b->kind == OPND_REG16 || b->kind == OPND_MEM)) {
+        out[0] = 0x8E;
+        return 1 + putModRM(out + 1, a->reg, b);
+    }
+    if ((a->kind == OPND_REG16 || a->kind == OPND_MEM) && b->kind == OPND_SREG) {
+        out[0] = 0x8C;
+        return 1 + putModRM(out + 1, b->reg, a);
+    }
+    if (isRegOrMem(a) && isRegister(b)) {
+        if (isRegister(a) && a->size != b->size) return badOperands(stmt);
+        out[0] = 0x88 + (b->size == 2);
+        return 1 + putModRM(out + 1, b->reg, a);
+    }
+    if (isRegister(a) && b->kind == OPND_MEM) {
+        out[0] = 0x8A + (a->size == 2);
+        return 1 + putModRM(out + 1, a->reg, b);
+    }
+    if (isRegister(a) && b->kind == OPND_IMM) {
+        out[0] = (a->size == 2 ? 0xB8 : 0xB0) + a->reg;
+        return 1 + putImmediate(out + 1, b->expr, a->size);
+    }
+    if (a->kind == OPND_MEM && b->kind == OPND_IMM) {
+        int size = needSize(stmt, a->size);
+        if (!size) return -1;
+        out[0] = size == 2 ? 0xC7 : 0xC6;
+        int n = 1 + putModRM(out + 1, 0, a);
+        return n + putImmediate(out + n, b->expr, size);
+    }
+    return badOperands(stmt);
+}
+
+static int encodeTest(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+
+    if (isRegOrMem(a) && isRegister(b)) {
+        if (isRegister(a) && a->size != b->size) return badOperands(stmt);
+        out[0] = 0x84 + (b->size == 2);
+        return 1 + putModRM(out + 1, b->reg, a);
+    }
+    if (isRegister(a) && b->kind == OPND_MEM) {
+        out[0] = 0x84 + (a->size == 2);
+        return 1 + putModRM(out + 1, a->reg, b);
+    }
+    if (isRegOrMem(a) && b->kind == OPND_IMM) {
+        int size = needSize(stmt, a->size);
+        if (!size) return -1;
+        out[0] = size == 2 ? 0xF7 : 0xF6;
+        int n = 1 + putModRM(out + 1, 0, a);
+        return n + putImmediate(out + n, b->expr, size);
+    }
+    return badOperands(stmt);
+}
+
+static int encodeXchg(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+
+    if (isRegOrMem(a) && isRegister(b)) {
+        if (isRegister(a) && a->size != b->size) return badOperands(stmt);
+        out[0] = 0x86 + (b->size == 2);
+        return 1 + putModRM(out + 1, b->reg, a);
+    }
+    if (isRegister(a) && b->kind == OPND_MEM) {
+        out[0] = 0x86 + (a->size == 2);
+        return 1 + putModRM(out + 1, a->reg, b);
+    }
+    return badOperands(stmt);
+}
+
+// not/neg/mul/imul/div/idiv; param is the /digit of F6/F7
+static int encodeUnary(Stmt* stmt, int digit, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+    if (!isRegOrMem(a)) return badOperands(stmt);
+
+    int size = needSize(stmt, a->size);
+    if (!size) return -1;
+    out[0] = size == 2 ? 0xF7 : 0xF6;
+    return 1 + putModRM(out + 1, digit, a);
+}
+
+// inc/dec; param is the /digit of FE/FF
+static int encodeIncDec(Stmt* stmt, int digit, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+
+    if (a->kind == OPND_REG16) {
+        out[0] = (digit ? 0x48 : 0x40) + a->reg;
+        return 1;
+    }
+    if (!isRegOrMem(a)) return badOperands(stmt);
+
+    int size = needSize(stmt, a->size);
+    if (!size) return -1;
+    out[0] = size == 2 ? 0xFF : 0xFE;
+    return 1 + putModRM(out + 1, digit, a);
+}
+
+static int encodePush(Stmt* stmt, int param, unsigned char* out) {
+    static const unsigned char pushSreg[] = {0x06, 0x0E, 0x16, 0x1E};
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+
+    switch (a->kind) {
+        case OPND_REG16:
+            out[0] = 0x50 + a->reg;
+            return 1;
+        case OPND_SREG:
+            out[0] = pushSreg[a->reg];
+            return 1;
+        case OPND_IMM: {
+            int flags = 0;
+            long value = evaluate(a->expr, &flags);
+            if (!(flags & EXPR_RELOCATABLE) && fitsSigned8(value)) {
+                out[0] = 0x6A;
+                out[1] = value & 0xFF;
+                return 2;
+            }
+            out[0] = 0x68;
+            put16(out + 1, value);
+            return 3;
+        }
+        case OPND_MEM:
+            if (a->size == 1) return badOperands(stmt);
+            out[0] = 0xFF;
+            return 1 + putModRM(out + 1, 6, a);
+        default:
+            return badOperands(stmt);
+    }
+}
+
+static int encodePop(Stmt* stmt, int param, unsigned char* out) {
+    static const unsigned char popSreg[] = {0x07, 0x00, 0x17, 0x1F};
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+
+    switch (a->kind) {
+        case OPND_REG16:
+            out[0] = 0x58 + a->reg;
+            return 1;
+        case OPND_SREG:
+            if (a->reg == 1) return badOperands(stmt);  // pop cs
+            out[0] = popSreg[a->reg];
+            return 1;
+        case OPND_MEM:
+            if (a->size == 1) return badOperands(stmt);
+            out[0] = 0x8F;
+            return 1 + putModRM(out + 1, 0, a);
+        default:
+            return badOperands(stmt);
+    }
+}
+
+// rol/ror/rcl/rcr/shl/sal/shr/sar; param is the /digit
+static int encodeShift(Stmt* stmt, int digit, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+    if (!isRegOrMem(a)) return badOperands(stmt);
+
+    int size = needSize(stmt, a->size);
+    if (!size) return -1;
+    int wide = size == 2;
+
+    if (b->kind == OPND_REG8 && b->reg == 1) {
+        out[0] = 0xD2 + wide;
+        return 1 + putModRM(out + 1, digit, a);
+    }
+    if (b->kind != OPND_IMM) return badOperands(stmt);
+
+    int flags = 0;
+    long count = evaluate(b->expr, &flags);
+    if (!(flags & EXPR_RELOCATABLE) && count == 1) {
+        out[0] = 0xD0 + wide;
+        return 1 + putModRM(out + 1, digit, a);
+    }
+    out[0] = 0xC0 + wide;
+    int n = 1 + putModRM(out + 1, digit, a);
+    return n + putImmediate(out + n, b->expr, 1);
+}
+
+// Relative branch to an expression; chooses between the short form and
+// the near form, which only ever grows during layout
+static int encodeBranch(Stmt* stmt, Operand* target, const unsigned char* shortOp, int shortLen,
+                        const unsigned char* nearOp, int nearLen, unsigned char* out) {
+    int flags = 0;
+    long value = evaluate(target->expr, &flags);
+
+    if (!stmt->nearJump && nearLen && !(flags & EXPR_UNRESOLVED)) {
+        long rel = value - (origin + stmt->address + shortLen + 1);
+        if (!fitsSigned8(rel)) {
+            stmt->nearJump = 1;
+            layoutChanged = 1;
+        }
+    }
+
+    if (!stmt->nearJump || !nearLen) {
+        long rel = value - (origin + stmt->address + shortLen + 1);
+        if (finalPass && !fitsSigned8(rel)) {
+            fail("short jump out of range");
+            return -1;
+        }
+        memcpy(out, shortOp, shortLen);
+        out[shortLen] = rel & 0xFF;
+        return shortLen + 1;
+    }
+
+    memcpy(out, nearOp, nearLen);
+    put16(out + nearLen, value - (origin + stmt->address + nearLen + 2));
+    return nearLen + 2;
+}
+
+// Conditional jumps; param is the condition code
+static int encodeJcc(Stmt* stmt, int cc, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    if (stmt->ops[0].kind != OPND_IMM) return badOperands(stmt);
+
+    unsigned char shortOp[] = {0x70 + cc};
+    unsigned char nearOp[] = {0x0F, 0x80 + cc};
+    return encodeBranch(stmt, &stmt->ops[0], shortOp, 1, nearOp, 2, out);
+}
+
+// loop/loope/loopne/jcxz, which only have a short form; param is the opcode
+static int encodeLoop(Stmt* stmt, int opcode, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    if (stmt->ops[0].kind != OPND_IMM) return badOperands(stmt);
+
+    unsigned char shortOp[] = {opcode};
+    return encodeBranch(stmt, &stmt->ops[0], shortOp, 1, NULL, 0, out);
+}
+
+static int encodeFarTarget(Operand* a, int opcode, unsigned char* out) {
+    out[0] = opcode;
+    put16(out + 1, evaluate(a->expr, NULL));
+    put16(out + 3, evaluate(a->segExpr, NULL));
+    return 5;
+}
+
+static int encodeJmp(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+
+    if (a->kind == OPND_FAR) {
+        return encodeFarTarget(a, 0xEA, out);
+    }
+    if (a->kind == OPND_IMM) {
+        unsigned char shortOp[] = {0xEB};
+        unsigned char nearOp[] = {0xE9};
+        return encodeBranch(stmt, a, shortOp, 1, nearOp, 1, out);
+    }
+    if (a->kind == OPND_REG16 || a->kind == OPND_MEM) {
+        out[0] = 0xFF;
+        return 1 + putModRM(out + 1, 4, a);
+    }
+    return badOperands(stmt);
+}
+
+static int encodeCall(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+
+    if (a->kind == OPND_FAR) {
+        return encodeFarTarget(a, 0x9A, out);
+    }
+    if (a->kind == OPND_IMM) {
+        out[0] = 0xE8;
+        put16(out + 1, evaluate(a->expr, NULL) - (origin + stmt->address + 3));
+        return 3;
+    }
+    if (a->kind == OPND_REG16 || a->kind == OPND_MEM) {
+        out[0] = 0xFF;
+        return 1 + putModRM(out + 1, 2, a);
+    }
+    return badOperands(stmt);
+}
+
+// ret/retf with an optional byte count; param is the plain opcode
+static int encodeRet(Stmt* stmt, int opcode, unsigned char* out) {
+    if (stmt->opCount == 0) {
+        out[0] = opcode;
+        return 1;
+    }
+    if (stmt->opCount != 1 || stmt->ops[0].kind != OPND_IMM) return badOperands(stmt);
+    out[0] = opcode - 1;
+    return 1 + putImmediate(out + 1, stmt->ops[0].expr, 2);
+}
+
+static int encodeInt(Stmt* stmt, int param, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    if (stmt->ops[0].kind != OPND_IMM) return badOperands(stmt);
+    out[0] = 0xCD;
+    return 1 + putImmediate(out + 1, stmt->ops[0].expr, 1);
+}
+
+// in al/ax, imm8|dx and out imm8|dx, al/ax; param is 1 for out
+static int encodeInOut(Stmt* stmt, int isOut, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* acc = &stmt->ops[isOut ? 1 : 0];
+    Operand* port = &stmt->ops[isOut ? 0 : 1];
+
+    if (!isRegister(acc) || acc->reg != 0) return badOperands(stmt);
+    int wide = acc->kind == OPND_REG16;
+
+    if (port->kind == OPND_REG16 && port->reg == 2) {
+        out[0] = (isOut ? 0xEE : 0xEC) + wide;
+        return 1;
+    }
+    if (port->kind == OPND_IMM) {
+        out[0] = (isOut ? 0xE6 : 0xE4) + wide;
+        return 1 + putImmediate(out + 1, port->expr, 1);
+    }
+    return badOperands(stmt);
+}
+
+// lea/les/lds reg16, mem; param is the opcode
+static int encodeLoadAddress(Stmt* stmt, int opcode, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    if (stmt->ops[0].kind != OPND_REG16 || stmt->ops[1].kind != OPND_MEM) return badOperands(stmt);
+    out[0] = opcode;
+    return 1 + putModRM(out + 1, stmt->ops[0].reg, &stmt->ops[1]);
+}
+
+// lgdt/lidt mem; param is the /digit of 0F 01
+static int encodeDescriptorTable(Stmt* stmt, int digit, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    if (stmt->ops[0].kind != OPND_MEM) return badOperands(stmt);
+    out[0] = 0x0F;
+    out[1] = 0x01;
+    return 2 + putModRM(out + 2, digit, &stmt->ops[0]);
+}
+
+// movzx/movsx reg16, r/m8 (80386); param is the second opcode byte
+static int encodeMoveExtend(Stmt* stmt, int opcode, unsigned char* out) {
+    if (!expectOperands(stmt, 2)) return -1;
+    Operand* a = &stmt->ops[0];
+    Operand* b = &stmt->ops[1];
+    if (a->kind != OPND_REG16 || !(b->kind == OPND_REG8 || (b->kind == OPND_MEM && b->size != 2))) {
+        return badOperands(stmt);
+    }
+    out[0] = 0x0F;
+    out[1] = opcode;
+    return 2 + putModRM(out + 2, a->reg, b);
+}
+
+// setcc r/m8 (80386); param is the condition code
+static int encodeSetcc(Stmt* stmt, int cc, unsigned char* out) {
+    if (!expectOperands(stmt, 1)) return -1;
+    Operand* a = &stmt->ops[0];
+    if (!(a->kind == OPND_REG8 || (a->kind == OPND_MEM && a->size != 2))) return badOperands(stmt);
+    out[0] = 0x0F;
+    out[1] = 0x90 + cc;
+    return 2 + putModRM(out + 2, 0, a);
+}
+
+static const Mnemonic mnemonics[] = {
+    {"add", encodeAlu, 0}, {"or", encodeAlu, 1}, {"adc", encodeAlu, 2}, {"sbb", encodeAlu, 3},
+    {"and", encodeAlu, 4}, {"sub", encodeAlu, 5}, {"xor", encodeAlu, 6}, {"cmp", encodeAlu, 7},
+    {"mov", encodeMov, 0}, {"test", encodeTest, 0}, {"xchg", encodeXchg, 0},
+    {"not", encodeUnary, 2}, {"neg", encodeUnary, 3}, {"mul", encodeUnary, 4},
+    {"imul", encodeUnary, 5}, {"div", encodeUnary, 6}, {"idiv", encodeUnary, 7},
+    {"inc", encodeIncDec, 0}, {"dec", encodeIncDec, 1},
+    {"push", encodePush, 0}, {"pop", encodePop, 0},
+    {"rol", encodeShift, 0}, {"ror", encodeShift, 1}, {"rcl", encodeShift, 2}, {"rcr", encodeShift, 3},
+    {"shl", encodeShift, 4}, {"sal", encodeShift, 4}, {"shr", encodeShift, 5}, {"sar", encodeShift, 7},
+    {"jo", encodeJcc, 0x0}, {"jno", encodeJcc, 0x1},
+    {"jb", encodeJcc, 0x2}, {"jc", encodeJcc, 0x2}, {"jnae", encodeJcc, 0x2},
+    {"jae", encodeJcc, 0x3}, {"jnb", encodeJcc, 0x3}, {"jnc", encodeJcc, 0x3},
+    {"je", encodeJcc, 0x4}, {"jz", encodeJcc, 0x4}, {"jne", encodeJcc, 0x5}, {"jnz", encodeJcc, 0x5},
+    {"jbe", encodeJcc, 0x6}, {"jna", encodeJcc, 0x6}, {"ja", encodeJcc, 0x7}, {"jnbe", encodeJcc, 0x7},
+    {"js", encodeJcc, 0x8}, {"jns", encodeJcc, 0x9},
+    {"jp", encodeJcc, 0xA}, {"jpe", encodeJcc, 0xA}, {"jnp", encodeJcc, 0xB}, {"jpo", encodeJcc, 0xB},
+    {"jl", encodeJcc, 0xC}, {"jnge", encodeJcc, 0xC}, {"jge", encodeJcc, 0xD}, {"jnl", encodeJcc, 0xD},
+    {"jle", encodeJcc, 0xE}, {"jng", encodeJcc, 0xE}, {"jg", encodeJcc, 0xF}, {"jnle", encodeJcc, 0xF},
+    {"loopne", encodeLoop, 0xE0}, {"loopnz", encodeLoop, 0xE0}, {"loope", encodeLoop, 0xE1},
+    {"loopz", encodeLoop, 0xE1}, {"loop", encodeLoop, 0xE2}, {"jcxz", encodeLoop, 0xE3},
+    {"jmp", encodeJmp, 0}, {"call", encodeCall, 0},
+    {"ret", encodeRet, 0xC3}, {"retn", encodeRet, 0xC3}, {"retf", encodeRet, 0xCB},
+    {"int", encodeInt, 0}, {"in", encodeInOut, 0}, {"out", encodeInOut, 1},
+    {"lea", encodeLoadAddress, 0x8D}, {"les", encodeLoadAddress, 0xC4}, {"lds", encodeLoadAddress, 0xC5},
+    {"lgdt", encodeDescriptorTable, 2}, {"lidt", encodeDescriptorTable, 3},
+    {"movzx", encodeMoveExtend, 0xB6}, {"movsx", encodeMoveExtend, 0xBE},
+    {"seto", encodeSetcc, 0x0}, {"setno", encodeSetcc, 0x1}, {"setb", encodeSetcc, 0x2},
+    {"setc", encodeSetcc, 0x2}, {"setae", encodeSetcc, 0x3}, {"setnc", encodeSetcc, 0x3},
+    {"sete", encodeSetcc, 0x4}, {"setz", encodeSetcc, 0x4}, {"setne", encodeSetcc, 0x5},
+    {"setnz", encodeSetcc, 0x5}, {"setbe", encodeSetcc, 0x6}, {"seta", encodeSetcc, 0x7},
+    {"sets", encodeSetcc, 0x8}, {"setns", encodeSetcc, 0x9}, {"setl", encodeSetcc, 0xC},
+    {"setge", encodeSetcc, 0xD}, {"setle", encodeSetcc, 0xE}, {"setg", encodeSetcc, 0xF},
+    {"nop", encodeFixed, 0x90}, {"hlt", encodeFixed, 0xF4}, {"cmc", encodeFixed, 0xF5},
+    {"clc", encodeFixed, 0xF8}, {"stc", encodeFixed, 0xF9}, {"cli", encodeFixed, 0xFA},
+    {"sti", encodeFixed, 0xFB}, {"cld", encodeFixed, 0xFC}, {"std", encodeFixed, 0xFD},
+    {"cbw", encodeFixed, 0x98}, {"cwd", encodeFixed, 0x99}, {"wait", encodeFixed, 0x9B},
+    {"pushf", encodeFixed, 0x9C}, {"popf", encodeFixed, 0x9D}, {"sahf", encodeFixed, 0x9E},
+    {"lahf", encodeFixed, 0x9F}, {"pusha", encodeFixed, 0x60}, {"popa", encodeFixed, 0x61},
+    {"leave", encodeFixed, 0xC9}, {"into", encodeFixed, 0xCE}, {"iret", encodeFixed, 0xCF},
+    {"xlat", encodeFixed, 0xD7}, {"xlatb", encodeFixed, 0xD7},
+    {"movsb", encodeFixed, 0xA4}, {"movsw", encodeFixed, 0xA5}, {"cmpsb", encodeFixed, 0xA6},
+    {"cmpsw", encodeFixed, 0xA7}, {"stosb", encodeFixed, 0xAA}, {"stosw", encodeFixed, 0xAB},
+    {"lodsb", encodeFixed, 0xAC}, {"lodsw", encodeFixed, 0xAD}, {"scasb", encodeFixed, 0xAE},
+    {"scasw", encodeFixed, 0xAF},
+};
+
+static const Mnemonic* findMnemonic(const char* name) {
+    for (size_t i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); i++) {
+        if (sameWord(mnemonics[i].name, name)) return &mnemonics[i];
+    }
+    return NULL;
+}
+
+static int prefixByte(const char* name) {
+    if (sameWord(name, "rep") || sameWord(name, "repe") ||
+        sameWord(name, "repz")) return 0xF3;
+    if (sameWord(name, "repne") || sameWord(name, "repnz")) return 0xF2;
+    if (sameWord(name, "lock")) return 0xF0;
+    return 0;
+}
+
+// Encode one instruction with its prefixes
+static int encodeInstruction(Stmt* stmt, unsigned char* out) {
+    int n = 0;
+    if (stmt->prefix) out[n++] = stmt->prefix;
+    if (!stmt->mnemonic) return n;
+
+    for (int i = 0; i < stmt->opCount; i++) {
+        if (stmt->ops[i].kind == OPND_MEM && stmt->ops[i].segment >= 0) {
+            out[n++] = 0x26 + stmt->ops[i].segment * 8;
+            break;
+        }
+    }
+
+    int length = stmt->mnemonic->encode(stmt, stmt->mnemonic->param, out + n);
+    return length < 0 ? -1 : n + length;
+}
+
+// ---------------------------------------------------------------------
+// Parsing
+
+static Stmt* newStmt(StmtKind kind, int line) {
+    if (stmtCount == stmtCapacity) {
+        stmtCapacity = stmtCapacity ? stmtCapacity * 2 : 1024;
+        stmts = (Stmt*)nccRealloc(MEM_ASSEMBLER, stmts, stmtCapacity * sizeof(Stmt));
+        if (!stmts) {
+            fprintf(stderr, "Error: Out of memory in assembler\n");
+            exit(1);
+        }
+    }
+    Stmt* stmt = &stmts[stmtCount++];
+    memset(stmt, 0, sizeof(Stmt));
+    stmt->kind = kind;
+    stmt->line = line;
+    return stmt;
+}
+
+// Split 'text' at top-level commas, outside brackets, parentheses and quotes
+static char** splitList(const char* text, int* count) {
+    char** items = NULL;
+    int capacity = 0;
+    *count = 0;
+
+    const char* start = text;
+    int depth = 0;
+    char quote = 0;
+    for (const char* p = text; ; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+            if (*p) continue;
+        }
+        if (*p == '\'' || *p == '"') {
+            quote = *p;
+            continue;
+        }
+        if (*p == '[' || *p == '(') depth++;
+        if (*p == ']' || *p == ')') depth--;
+        if (*p == '\0' || (*p == ',' && depth == 0)) {
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : 8;
+                items = (char**)nccRealloc(MEM_ASSEMBLER, items, capacity * sizeof(char*));
+                if (!items) {
+                    fprintf(stderr, "Error: Out of memory in assembler\n");
+                    exit(1);
+                }
+            }
+            items[(*count)++] = copyRange(start, p);
+            start = p + 1;
+        }
+        if (*p == '\0') break;
+    }
+    return items;
+}
+
+static void parseStatementText(char* text, int line, char* times);
+
+static void parseDirective(char* text, int line, char* times) {
+    char* p = text + 1;
+    while (isalpha((unsigned char)*p)) p++;
+    char* name = copyRange(text + 1, p);
+    while (isspace((unsigned char)*p)) p++;
+
+    if (sameWord(name, "times")) {
+        if (times) {
+            fail("nested #times");
+        } else {
+            // The count runs to the next directive, or to the first space
+            // outside parentheses when an instruction is repeated
+            char* rest = strchr(p, '#');
+            if (!rest) {
+                int depth = 0;
+                rest = p;
+                while (*rest && (depth > 0 || !isspace((unsigned char)*rest))) {
+                    if (*rest == '(') depth++;
+                    if (*rest == ')') depth--;
+                    rest++;
+                }
+            }
+            char* count = copyRange(p, rest);
+            parseStatementText(rest, line, count);
+        }
+    } else if (sameWord(name, "db") || sameWord(name, "dw") ||
+               sameWord(name, "dd")) {
+        Stmt* stmt = newStmt(STMT_DATA, line);
+        stmt->dataSize = name[1] == 'b' || name[1] == 'B' ? 1 : (name[1] == 'w' || name[1] == 'W' ? 2 : 4);
+        stmt->items = splitList(p, &stmt->itemCount);
+        stmt->times = times;
+        times = NULL;
+    } else if (sameWord(name, "origin")) {
+        Stmt* stmt = newStmt(STMT_ORIGIN, line);
+        stmt->items = splitList(p, &stmt->itemCount);
+    } else if (sameWord(name, "width")) {
+        if (strtol(p, NULL, 0) != 16) fail("line %d: only #width 16 is supported", line);
+    } else {
+        fail("line %d: unknown directive '#%s'", line, name);
+    }
+
+    nccFree(name);
+    nccFree(times);
+}
+
+static void parseStatementText(char* text, int line, char* times) {
+    while (isspace((unsigned char)*text)) text++;
+    if (!*text) {
+        nccFree(times);
+        return;
+    }
+    if (*text == '#') {
+        parseDirective(text, line, times);
+        return;
+    }
+
+    // Leading prefixes, then the mnemonic
+    int prefix = 0;
+    char* p = text;
+    char word[32];
+    for (;;) {
+        char* start = p;
+        while (isalnum((unsigned char)*p)) p++;
+        int length = (int)(p - start);
+        if (length == 0 || length >= (int)sizeof(word)) {
+            fail("line %d: cannot parse '%s'", line, text);
+            nccFree(times);
+            return;
+        }
+        memcpy(word, start, length);
+        word[length] = '\0';
+        while (isspace((unsigned char)*p)) p++;
+
+        int byte = prefixByte(word);
+        if (!byte || prefix) break;
+        prefix = byte;
+        if (!*p) {
+            word[0] = '\0';
+            break;
+        }
+    }
+
+    Stmt* stmt = newStmt(STMT_INSN, line);
+    stmt->prefix = prefix;
+    stmt->times = times;
+    if (!word[0]) return;
+
+    stmt->mnemonic = findMnemonic(word);
+    if (!stmt->mnemonic) {
+        fail("line %d: unknown instruction '%s'", line, word);
+        return;
+    }
+
+    if (*p) {
+        int count = 0;
+        char** operands = splitList(p, &count);
+        if (count > MAX_OPERANDS) {
+            fail("line %d: too many operands", line);
+        }
+        for (int i = 0; i < count; i++) {
+            if (i < MAX_OPERANDS && !failed) {
+                currentStmt = stmt;
+                parseOperand(operands[i], &stmt->ops[i]);
+                currentStmt = NULL;
+            }
+            nccFree(operands[i]);
+        }
+        nccFree(operands);
+        stmt->opCount = count > MAX_OPERANDS ? MAX_OPERANDS : count;
+    }
+}
+
+// Remove a ; comment, keeping semicolons inside quotes
+static void stripComment(char* line) {
+    char quote = 0;
+    for (char* p = line; *p; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        } else if (*p == '\'' || *p == '"') {
+            quote = *p;
+        } else if (*p == ';') {
+            *p = '\0';
+            return;
+        }
+    }
+}
+
+static void parseLine(char* text, int line) {
+    stripComment(text);
+    while (isspace((unsigned char)*text)) text++;
+
+    // A label is a name directly followed by a colon
+    if (isIdentStart(*text)) {
+        char* p = text;
+        while (isIdentChar(*p)) p++;
+        if (*p == ':') {
+            Stmt* stmt = newStmt(STMT_LABEL, line);
+            stmt->label = copyRange(text, p);
+            text = p + 1;
+        }
+    }
+
+    parseStatementText(text, line, NULL);
+}
+
+// ---------------------------------------------------------------------
+// Layout and output
+
+// Size of a data item: strings are one byte per character
+static int dataItemSize(Stmt* stmt, const char* item) {
+    size_t length = strlen(item);
+    if (stmt->dataSize == 1 && length >= 2 && item[0] == '"' && item[length - 1] == '"') {
+        return (int)length - 2;
+    }
+    return stmt->dataSize;
+}
+
+// Lay out or emit one statement; 'out' is NULL while only sizing
+static int processStatement(Stmt* stmt, unsigned char* image, long address) {
+    currentStmt = stmt;
+    stmt->address = (int)address;
+
+    if (stmt->kind == STMT_LABEL) {
+        defineLabel(stmt->label, origin + address);
+        stmt->size = 0;
+        return 0;
+    }
+
+    if (stmt->kind == STMT_ORIGIN) {
+        if (address != 0) {
+            fail("#origin after code or data");
+            return 0;
+        }
+        origin = stmt->itemCount ? evaluate(stmt->items[0], NULL) : 0;
+        return 0;
+    }
+
+    long repeat = 1;
+    if (stmt->times) {
+        int flags = 0;
+        repeat = evaluate(stmt->times, &flags);
+        if (repeat < 0) {
+            if (finalPass) {
+                fail("negative #times count");
+                return 0;
+            }
+            repeat = 0;
+        }
+    }
+
+    unsigned char one[MAX_INSN_BYTES];
+    int unitSize = 0;
+    if (stmt->kind == STMT_INSN) {
+        unitSize = encodeInstruction(stmt, one);
+        if (unitSize < 0) {
+            fail("cannot encode '%s'", stmt->mnemonic ? stmt->mnemonic->name : "prefix");
+            return 0;
+        }
+    } else {
+        for (int i = 0; i < stmt->itemCount; i++) {
+            unitSize += dataItemSize(stmt, stmt->items[i]);
+        }
+    }
+
+    int size = (int)(unitSize * repeat);
+    if (finalPass && stmt->size != size) {
+        fail("layout did not settle");
+        return 0;
+    }
+    if (stmt->size != size) layoutChanged = 1;
+    stmt->size = size;
+
+    if (image) {
+        unsigned char* out = image + address;
+        for (long r = 0; r < repeat; r++) {
+            if (stmt->kind == STMT_INSN) {
+                memcpy(out, one, unitSize);
+                out += unitSize;
+                continue;
+            }
+            for (int i = 0; i < stmt->itemCount; i++) {
+                const char* item = stmt->items[i];
+                size_t length = strlen(item);
+                if (stmt->dataSize == 1 && length >= 2 && item[0] == '"' && item[length - 1] == '"') {
+                    memcpy(out, item + 1, length - 2);
+                    out += length - 2;
+                    continue;
+                }
+                long value = evaluate(item, NULL);
+                for (int b = 0; b < stmt->dataSize; b++) {
+                    *out++ = (value >> (8 * b)) & 0xFF;
+                }
+            }
+        }
+    }
+    return size;
+}
+
+static long layoutPass(unsigned char* image) {
+    long address = 0;
+    for (int i = 0; i < stmtCount && !failed; i++) {
+        address += processStatement(&stmts[i], image, address);
+    }
+    currentStmt = NULL;
+    return address;
+}
+
+static void freeStatements() {
+    for (int i = 0; i < stmtCount; i++) {
+        Stmt* stmt = &stmts[i];
+        nccFree(stmt->label);
+        nccFree(stmt->times);
+        for (int j = 0; j < stmt->opCount; j++) {
+            nccFree(stmt->ops[j].expr);
+            nccFree(stmt->ops[j].segExpr);
+        }
+        for (int j = 0; j < stmt->itemCount; j++) {
+            nccFree(stmt->items[j]);
+        }
+        nccFree(stmt->items);
+    }
+    nccFree(stmts);
+    stmts = NULL;
+    stmtCount = 0;
+    stmtCapacity = 0;
+
+    for (int i = 0; i < SYMBOL_BUCKETS; i++) {
+        AsmSymbol* symbol = symbols[i];
+        while (symbol) {
+            AsmSymbol* next = symbol->next;
+            nccFree(symbol->name);
+            nccFree(symbol);
+            symbol = next;
+        }
+        symbols[i] = NULL;
+    }
+}
+
+// Parse assembly text and lay it out until every label keeps its
+// address. Returns the size of the image; the statements stay for the
+// caller, who frees them with freeStatements() even on failure.
+static long layOutSource(const char* source) {
+    failed = 0;
+    failure[0] = '\0';
+    origin = 0;
+    currentStmt = NULL;
+
+    // Parse every line once, from a copy since parsing edits the text
+    char* text = NULL;
+    size_t capacity = 0;
+    int line = 1;
+    for (const char* p = source; *p && !failed; line++) {
+        const char* end = strchr(p, '\n');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if (length + 1 > capacity) {
+            capacity = length + 1 > 2 * capacity ? length + 1 : 2 * capacity;
+            nccFree(text);
+            text = (char*)nccMalloc(MEM_ASSEMBLER, capacity);
+            if (!text) {
+                fprintf(stderr, "Error: Out of memory in assembler\n");
+                exit(1);
+            }
+        }
+        memcpy(text, p, length);
+        text[length] = '\0';
+        if (length && text[length - 1] == '\r') text[length - 1] = '\0';
+        parseLine(text, line);
+        if (!end) break;
+        p = end + 1;
+    }
+    nccFree(text);
+
+    // Grow jumps until every label keeps its address
+    long size = 0;
+    int settled = 0;
+    finalPass = 0;
+    for (currentPass = 0; currentPass < MAX_LAYOUT_PASSES && !failed; currentPass++) {
+        layoutChanged = 0;
+        size = layoutPass(NULL);
+        if (!layoutChanged) {
+            settled = 1;
+            break;
+        }
+    }
+    if (!failed && !settled) {
+        fail("layout did not settle after %d passes", MAX_LAYOUT_PASSES);
+    }
+    return size;
+}
+
+// Assemble NCC assembly text into a flat binary
+int assembleFlatBinary(const char* source, const char* outputPath) {
+    long size = layOutSource(source);
+
+    unsigned char* image = NULL;
+    if (!failed) {
+        image = (unsigned char*)nccCalloc(MEM_ASSEMBLER, size ? size : 1, 1);
+        if (!image) {
+            fprintf(stderr, "Error: Out of memory in assembler\n");
+            exit(1);
+        }
+        finalPass = 1;
+        currentPass++;
+        layoutPass(image);
+        finalPass = 0;
+    }
+
+    freeStatements();
+
+    if (failed) {
+        nccFree(image);
+        return ASM_UNSUPPORTED;
+    }
+
+    FILE* output = fopen(outputPath, "wb");
+    if (!output) {
+        nccFree(image);
+        fail("cannot write %s", outputPath);
+        return ASM_UNSUPPORTED;
+    }
+    fwrite(image, 1, size, output);
+    fclose(output);
+    nccFree(image);
+
+    return ASM_OK;
+}
+
+int measureAssembly(const char* source, int** lineSizes, int* lineCount) {
+    *lineSizes = NULL;
+    *lineCount = 0;
+    layOutSource(source);
+    if (!failed) {
+        int lines = stmtCount > 0 ? stmts[stmtCount - 1].line + 1 : 1;
+        *lineSizes = (int*)nccCalloc(MEM_ASSEMBLER, lines, sizeof(int));
+        if (*lineSizes) {
+            for (int i = 0; i < stmtCount; i++) {
+                (*lineSizes)[stmts[i].line] += stmts[i].size;
+            }
+            *lineCount = lines;
+        }
+    }
+    freeStatements();
+    return failed || !*lineSizes ? ASM_UNSUPPORTED : ASM_OK;
+}
@@ -1,4 +1,5 @@
 #include "assembly_buffer.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,7 +17,7 @@ static size_t bufferCapacity = 0;
 void initAssemblyBuffer() {
     bufferSize = 0;
     bufferCapacity = INITIAL_BUFFER_SIZE;
-    assemblyBuffer = (char*)malloc(bufferCapacity);
+    assemblyBuffer = (char*)nccMalloc(MEM_CODEGEN, bufferCapacity);
     if (!assemblyBuffer) {
         fprintf(stderr, "Error: Failed to allocate assembly buffer\n");
         exit(1);
@@ -33,7 +34,7 @@ static void ensureBufferCapacity(size_t additionalSize) {
             newCapacity *= BUFFER_GROWTH_FACTOR;
         }
         
-        char* newBuffer = (char*)realloc(assemblyBuffer, newCapacity);
+        char* newBuffer = (char*)nccRealloc(MEM_CODEGEN, assemblyBuffer, newCapacity);
         if (!newBuffer) {
             fprintf(stderr, "Error: Failed to resize assembly buffer\n");
             exit(1);
@@ -88,7 +89,7 @@ char* getBufferContents() {
 // Free the assembly buffer
 void freeAssemblyBuffer() {
     if (assemblyBuffer) {
-        free(assemblyBuffer);
+        nccFree(assemblyBuffer);
         assemblyBuffer = NULL;
         bufferSize = 0;
         bufferCapacity = 0;
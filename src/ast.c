@@ -1,11 +1,12 @@
 #include "ast.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Create a new AST node
 ASTNode* createNode(NodeType type) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
+    ASTNode* node = (ASTNode*)nccMalloc(MEM_AST, sizeof(ASTNode));
     if (!node) {
         fprintf(stderr, "Error: Failed to allocate memory for AST node\n");
         exit(1);
@@ -37,13 +38,18 @@ const char* getNodeTypeName(NodeType type) {
         case NODE_RETURN: return "RETURN";
         case NODE_IF: return "IF";
         case NODE_WHILE: return "WHILE";
+        case NODE_DO_WHILE: return "DO_WHILE";
         case NODE_FOR: return "FOR";
+        case NODE_SWITCH: return "SWITCH";
+        case NODE_CASE: return "CASE";
         case NODE_CALL: return "CALL";        case NODE_ASM_BLOCK: return "ASM_BLOCK";
         case NODE_ASM: return "ASM";
         case NODE_EXPRESSION: return "EXPRESSION";
         case NODE_TERNARY: return "TERNARY";
         case NODE_BREAK: return "BREAK";
         case NODE_CONTINUE: return "CONTINUE";
+        case NODE_STRUCT_DEF: return "STRUCT_DEF";
+        case NODE_MEMBER_ACCESS: return "MEMBER_ACCESS";
         default: return "UNKNOWN";
     }
 }
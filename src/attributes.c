@@ -4,6 +4,7 @@
 #include "ast.h"
 #include "token_debug.h"  // For getTokenName
 #include "error_manager.h" // For reportError
+#include "mem_report.h"
 
 
 char * strdupc (const char *s)
@@ -44,9 +45,9 @@ void parseFunctionAttributes(FunctionInfo* funcInfo) {
                         if (tokenIs(TOKEN_STRING)) {
                             // Free previous message if there was one
                             if (funcInfo->deprecation_msg) {
-                                free(funcInfo->deprecation_msg);
+                                nccFree(funcInfo->deprecation_msg);
                             }
-                            funcInfo->deprecation_msg = strdupc(getCurrentToken().value);
+                            funcInfo->deprecation_msg = nccStrdup(MEM_AST, getCurrentToken().value);
                             consume(TOKEN_STRING);
                         }
                         expect(TOKEN_RPAREN);
@@ -89,9 +90,9 @@ void parseFunctionAttributes(FunctionInfo* funcInfo) {
                         if (tokenIs(TOKEN_STRING)) {
                             // Free previous message if there was one
                             if (funcInfo->deprecation_msg) {
-                                free(funcInfo->deprecation_msg);
+                                nccFree(funcInfo->deprecation_msg);
                             }
-                            funcInfo->deprecation_msg = strdupc(getCurrentToken().value);
+                            funcInfo->deprecation_msg = nccStrdup(MEM_AST, getCurrentToken().value);
                             consume(TOKEN_STRING);
                         }
                         expect(TOKEN_RPAREN);
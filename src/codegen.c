@@ -1,3 +1,6 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include "codegen.h"
 #include "ast.h"
 #include "string_literals.h"
@@ -6,17 +9,27 @@
 #include "type_checker.h"
 #include "struct_support.h"
 #include "struct_codegen.h"
+#include "frame_analysis.h"
+#include "register_alloc.h"
+#include "long_ops.h"
+#include "strength_reduction.h"
+#include "symbol_table.h"
+#include "function_cache.h"
+#include "time_report.h"
+#include "mem_report.h"
+#include "codegen_stats.h"
+#include "parallel_codegen.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#if __linux__
-#define strdup strdupc
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #endif
 
 // External declarations from type_checker.c
-extern TypeInfo* getTypeInfo(const char* name);
 extern TypeInfo* getTypeInfoFromExpression(ASTNode* expr);
 
 // Forward declarations
@@ -26,12 +39,58 @@ void generateBreakStatement(ASTNode* node);
 // Define the optimization state
 OptimizationState optimizationState = {
     .level = OPT_LEVEL_NONE,
-    .mergeStrings = 0
+    .mergeStrings = 0,
+    .omitFramePointer = 0
 };
 
 // Output file for assembly code
 FILE* asmFile = NULL;
 
+// The assembly is generated into memory and handed to the built-in
+// assembler from there; it only reaches a file for -S or nas
+static char* generatedAssembly = NULL;
+static size_t generatedLength = 0;
+
+// Point asmFile at a new in-memory buffer
+static void openAssemblyBuffer() {
+    nccFree(generatedAssembly);
+    generatedAssembly = NULL;
+    generatedLength = 0;
+#ifdef _WIN32
+    // No open_memstream(): spool through an anonymous temporary file
+    asmFile = tmpfile();
+#else
+    asmFile = open_memstream(&generatedAssembly, &generatedLength);
+#endif
+    if (!asmFile) {
+        fprintf(stderr, "Error: Could not open a buffer for the generated assembly\n");
+        exit(1);
+    }
+}
+
+// Close asmFile, leaving its text in generatedAssembly
+static void closeAssemblyBuffer() {
+#ifdef _WIN32
+    long size = ftell(asmFile);
+    generatedAssembly = size >= 0 ? (char*)nccMalloc(MEM_CODEGEN, size + 1) : NULL;
+    if (generatedAssembly) {
+        rewind(asmFile);
+        generatedLength = fread(generatedAssembly, 1, size, asmFile);
+        generatedAssembly[generatedLength] = '\0';
+    }
+#endif
+    fclose(asmFile);
+    asmFile = NULL;
+}
+
+char* takeGeneratedAssembly(size_t* length) {
+    char* text = generatedAssembly;
+    *length = generatedLength;
+    generatedAssembly = NULL;
+    generatedLength = 0;
+    return text;
+}
+
 // String literals table
 int stringLiteralCount = 0;
 char** stringLiterals = NULL;
@@ -64,24 +123,38 @@ static unsigned int stackPointer = 0;
 // Label counter for unique labels
 int labelCounter = 0;
 
+// Labels made inside a function are named "_func__<prefix><n>" and
+// numbered from 0 per function, so a function's code does not depend on
+// what was generated before it. Outside functions the scope is empty.
+// nas ends a label at any character that is not a letter, digit or
+// underscore, so the scope has to be spellable in C: a function named
+// "main__if_end1" would get the label "_main__if_end1". When a function or
+// global of the program would clash like that, the scope uses more
+// underscores.
+static char* labelScope = NULL;
+static int outerLabelCounter = 0;
+
+// Labels of the program's functions and globals, without the leading
+// underscore, that contain a double underscore and so may clash
+static char** clashingLabels = NULL;
+static int clashingLabelCount = 0;
+
 // Current function being generated
 static char* currentFunction = NULL;
 static int currentFunctionIsNaked = 0;
 
-// Variable tracking for stack offsets
-#define MAX_LOCALS 64
-typedef struct {
-    char* name;
-    int offset;
-} LocalVariable;
-
-static LocalVariable localVars[MAX_LOCALS];
-static int localVarCount = 0;
-static int stackSize = 0;
+// Locals and parameters live in the shared symbol table, in a scope
+// opened for each function
+static int functionScope = -1;
+static int stackSize = 0;       // Bytes reserved below bp (saved registers + locals)
+static int frameBase = 0;       // Bytes below bp taken by saved registers
 
 // Origin address for ORG directive
 static unsigned int originAddress = 0;
 
+// Target processor for instruction selection
+static int targetCpu = CPU_186;
+
 // Loop context tracking for break/continue statements
 #define MAX_LOOP_NESTING 16
 typedef struct {
@@ -99,8 +172,8 @@ void pushLoopContext(const char* continueLabel, const char* breakLabel) {
         return;
     }
     
-    loopStack[loopStackDepth].continueLabel = strdup(continueLabel);
-    loopStack[loopStackDepth].breakLabel = strdup(breakLabel);
+    loopStack[loopStackDepth].continueLabel = continueLabel ? nccStrdup(MEM_CODEGEN, continueLabel) : NULL;
+    loopStack[loopStackDepth].breakLabel = nccStrdup(MEM_CODEGEN, breakLabel);
     loopStackDepth++;
 }
 
@@ -108,8 +181,8 @@ void pushLoopContext(const char* continueLabel, const char* breakLabel) {
 void popLoopContext() {
     if (loopStackDepth > 0) {
         loopStackDepth--;
-        free(loopStack[loopStackDepth].continueLabel);
-        free(loopStack[loopStackDepth].breakLabel);
+        nccFree(loopStack[loopStackDepth].continueLabel);
+        nccFree(loopStack[loopStackDepth].breakLabel);
         loopStack[loopStackDepth].continueLabel = NULL;
         loopStack[loopStackDepth].breakLabel = NULL;
     }
@@ -123,6 +196,13 @@ LoopContext* getCurrentLoopContext() {
     return NULL;
 }
 
+// Get the continue label of the innermost loop, NULL outside loops. A
+// switch inherits it so continue inside a case reaches the loop around it.
+const char* getCurrentContinueLabel() {
+    LoopContext* context = getCurrentLoopContext();
+    return context ? context->continueLabel : NULL;
+}
+
 // Get the current name of the function being generated
 const char* getCurrentFunctionName() {
     return currentFunction ? currentFunction : "global";
@@ -130,83 +210,123 @@ const char* getCurrentFunctionName() {
 
 // Clear local variables when entering a new function
 void clearLocalVars() {
-    for (int i = 0; i < localVarCount; i++) {
-        if (localVars[i].name) {
-            free(localVars[i].name);
-        }
+    if (functionScope >= 0) {
+        endSymbolScope(functionScope);
     }
-    localVarCount = 0;
+    functionScope = beginSymbolScope();
     stackSize = 0;
+    frameBase = 0;
 }
 
-// Get the stack offset for a local variable, return 0 if not found (global)
-int getLocalVarOffset(const char* name) {
-    for (int i = 0; i < localVarCount; i++) {
-        if (localVars[i].name && strcmp(localVars[i].name, name) == 0) {
-            return localVars[i].offset;
-        }
-    }
-    return 0;  // Not a local variable
+// Start a block scope; returns the mark to pass to endLocalScope
+int beginLocalScope() {
+    return beginSymbolScope();
 }
 
-// gcc disable unused variable warnings
-#ifdef __GNUC__
-#pragma GCC diagnostic ignored "-Wunused-parameter"
-#endif
+// Leave a block scope, forgetting the locals declared inside it
+void endLocalScope(int mark) {
+    endSymbolScope(mark);
+}
 
+// Find the innermost local or parameter with the given name
+static Symbol* findLocalVar(const char* name) {
+    Symbol* var = findSymbol(name);
+    return var && var->kind != SYMBOL_GLOBAL ? var : NULL;
+}
 
-// Add a local variable and return its stack offset
-int addLocalVariable(const char* name, int size) {
-    if (localVarCount >= MAX_LOCALS) {
-        fprintf(stderr, "Error: Too many local variables\n");
-        exit(1);
-    }
-      
-    // For long/unsigned long, allocate 4 bytes
-    // For other types, use word-sized (2-byte) allocations on the stack for x86
-    // This ensures proper alignment and simplifies address calculations
-    int allocationSize = size == 4 ? 4 : 2; // Allocate 4 bytes for long types, 2 bytes for others
-    
-    stackSize += allocationSize;
-    localVars[localVarCount].name = strdupc(name);
-    localVars[localVarCount].offset = stackSize;
-    localVarCount++;
-    
-    return stackSize;
+// Declare a local or parameter in the innermost scope
+static Symbol* appendLocalVar(ASTNode* decl, SymbolKind kind, int offset, int size, int isSigned) {
+    Symbol* var = addSymbol(decl->declaration.var_name, kind, decl->declaration.type_info);
+    var->offset = offset;
+    var->size = size;
+    var->isSigned = isSigned;
+    var->reg = decl->declaration.alloc_reg;
+    return var;
 }
 
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
+// Get the stack offset for a local variable, return 0 if not found (global)
+int getLocalVarOffset(const char* name) {
+    Symbol* var = findLocalVar(name);
+    return var ? var->offset : 0;  // 0 means not a local variable
+}
+
+// Add a local declaration at the slot the frame layout gave it and return its offset
+int addLocalVariable(ASTNode* decl) {
+    DataType type = decl->declaration.type_info.type;
+    int size = getLocalSlotSize(decl);
+    int offset = frameBase + decl->declaration.frame_offset;
+    
+    appendLocalVar(decl, SYMBOL_LOCAL, offset, size, type == TYPE_CHAR);
+    return offset;
+}
 
 // Get the stack offset for a variable
 int getVariableOffset(const char* name) {
-    for (int i = 0; i < localVarCount; i++) {
-        if (strcmp(localVars[i].name, name) == 0) {
-            return localVars[i].offset;
-        }
-    }
-      // Variable not found - might be a global
-    return 0;
+    Symbol* var = findLocalVar(name);
+    // Variable not found - might be a global
+    return var ? var->offset : 0;
 }
 
 // Check if a variable is a parameter (parameters have negative offsets)
 int isParameter(const char* name) {
-    for (int i = 0; i < localVarCount; i++) {
-        if (strcmp(localVars[i].name, name) == 0) {
-            return localVars[i].offset < 0;
+    Symbol* var = findLocalVar(name);
+    return var && var->offset < 0;
+}
+
+// Get the register a variable was allocated to, or NULL if it lives in memory
+const char* getVariableRegister(const char* name) {
+    Symbol* var = findLocalVar(name);
+    return var && var->reg ? getAllocatedRegisterName(var->reg) : NULL;
+}
+
+// Check if a local lives in a packed single-byte slot
+int isByteLocal(const char* name) {
+    Symbol* var = findLocalVar(name);
+    return var && !var->reg && var->offset > 0 && var->size == 1;
+}
+
+// Load a local variable into AX, widening packed byte locals
+void emitLoadLocal(const char* name, int offset) {
+    Symbol* var = findLocalVar(name);
+    if (var && var->reg) {
+        fprintf(asmFile, "    mov ax, %s ; Load register variable %s\n", getAllocatedRegisterName(var->reg), name);
+    } else if (var && var->size == 1) {
+        fprintf(asmFile, "    mov al, [bp-%d] ; Load byte local variable %s\n", offset, name);
+        if (var->isSigned) {
+            fprintf(asmFile, "    cbw ; Sign extend to word\n");
+        } else {
+            fprintf(asmFile, "    xor ah, ah ; Zero extend to word\n");
         }
+    } else {
+        fprintf(asmFile, "    mov ax, [bp-%d] ; Load local variable %s\n", offset, name);
     }
-    return 0;
 }
 
-// Initialize code generator
-void initCodeGen(const char* outputFilename, unsigned int orgAddr) {
-    asmFile = fopen(outputFilename, "w");
-    if (!asmFile) {
-        fprintf(stderr, "Error: Could not open output file %s\n", outputFilename);
-        exit(1);
+// Store a word register (ax, bx, cx or dx) into a local, narrowing for byte locals
+void emitStoreLocal(const char* name, int offset, const char* reg) {
+    Symbol* var = findLocalVar(name);
+    if (var && var->reg) {
+        fprintf(asmFile, "    mov %s, %s ; Store in register variable %s\n", getAllocatedRegisterName(var->reg), reg, name);
+    } else if (var && var->size == 1) {
+        fprintf(asmFile, "    mov [bp-%d], %cl ; Store in byte local variable %s\n", offset, reg[0], name);
+    } else {
+        fprintf(asmFile, "    mov [bp-%d], %s ; Store in local variable %s\n", offset, reg, name);
     }
+}
+
+// Set the target processor (CPU_8086, CPU_186, ...)
+void setTargetCpu(int cpu) {
+    targetCpu = cpu;
+}
+
+// Get the target processor
+int getTargetCpu() {
+    return targetCpu;
+}
+
+// Initialize code generator
+void initCodeGen(unsigned int orgAddr) {
+    openAssemblyBuffer();
     labelCounter = 0;
     
     // Initialize string tracking
@@ -229,13 +349,9 @@ void initCodeGen(const char* outputFilename, unsigned int orgAddr) {
 }
 
 // Initialize code generator for system mode (bootloader)
-void initCodeGenSystemMode(const char* outputFilename, unsigned int orgAddr,
+void initCodeGenSystemMode(unsigned int orgAddr,
                           int setStkSegmentPointer, unsigned int stkSegment, unsigned int stkPointer) {
-    asmFile = fopen(outputFilename, "w");
-    if (!asmFile) {
-        fprintf(stderr, "Error: Could not open output file %s\n", outputFilename);
-        exit(1);
-    }
+    openAssemblyBuffer();
     labelCounter = 0;
     
     // Initialize string tracking
@@ -270,35 +386,44 @@ void initCodeGenSystemMode(const char* outputFilename, unsigned int orgAddr,
 // Close code generator
 void finalizeCodeGen() {
     if (asmFile) {
+        startTimer(PHASE_DATA, "strings and globals");
+        
         // Generate any global variables that weren't emitted at a marker
         generateRemainingGlobals(asmFile);
         
         // Generate string literals section before closing
         generateStringLiteralsSection();
+        stopTimer();
+        
+        // Report frame pointer omission results
+        reportFrameStats(asmFile);
+        resetFrameStats();
+        
+        // Report string tail sharing results
+        reportStringStats(asmFile);
         
         // Free string literals
         for (int i = 0; i < stringLiteralCount; i++) {
             if (stringLiterals[i]) {
-                free(stringLiterals[i]);
+                nccFree(stringLiterals[i]);
             }
         }
-        free(stringLiterals);
+        nccFree(stringLiterals);
         
         // Free array tracking
         for (int i = 0; i < arrayCount; i++) {
             if (arrayNames[i]) {
-                free(arrayNames[i]);
+                nccFree(arrayNames[i]);
             }
         }
-        free(arrayNames);
-        free(arraySizes);
-        free(arrayTypes);
+        nccFree(arrayNames);
+        nccFree(arraySizes);
+        nccFree(arrayTypes);
         
         // Clean up global variables
         cleanupGlobals();
         
-        fclose(asmFile);
-        asmFile = NULL;
+        closeAssemblyBuffer();
     }
 }
 
@@ -318,9 +443,9 @@ int isPointerType(ASTNode* node) {
         }
     }
     
-    // For identifiers, check the symbol table
+    // For identifiers, check the declared type
     if (node->type == NODE_IDENTIFIER) {
-        TypeInfo* typeInfo = getTypeInfo(node->identifier);
+        TypeInfo* typeInfo = getTypeInfoFromExpression(node);
         return typeInfo && typeInfo->is_pointer;
     }
     
@@ -334,13 +459,108 @@ int getNextLabelId() {
     return labelCounter++;
 }
 
+// Prefix for labels in the current function; "" outside functions
+const char* getLabelScope() {
+    return labelScope ? labelScope : "";
+}
+
+// Start numbering labels in the namespace of a function
+// Remember the labels of the program's functions and globals that could
+// be spelled like a function's local labels
+static void collectClashingLabels(ASTNode* program) {
+    for (int i = 0; i < clashingLabelCount; i++) {
+        nccFree(clashingLabels[i]);
+    }
+    nccFree(clashingLabels);
+    clashingLabels = NULL;
+    clashingLabelCount = 0;
+    
+    char* prefix = getSanitizedFilenamePrefix();
+    if (!prefix) prefix = nccStrdup(MEM_CODEGEN, "unknown");
+    int capacity = 0;
+    for (ASTNode* node = program->left; node; node = node->next) {
+        const char* name;
+        int prefixed;
+        if (node->type == NODE_FUNCTION) {
+            name = node->function.func_name;
+            prefixed = node->function.info.is_static;
+        } else if (node->type == NODE_DECLARATION) {
+            name = node->declaration.var_name;
+            prefixed = 1;
+        } else {
+            continue;
+        }
+        if (!name) continue;
+        
+        char* label = nccMalloc(MEM_CODEGEN, strlen(prefix) + strlen(name) + 2);
+        if (prefixed) {
+            sprintf(label, "%s_%s", prefix, name);
+        } else {
+            strcpy(label, name);
+        }
+        if (!strstr(label, "__")) {
+            nccFree(label);
+            continue;
+        }
+        if (clashingLabelCount == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            clashingLabels = nccRealloc(MEM_CODEGEN, clashingLabels, capacity * sizeof(char*));
+        }
+        clashingLabels[clashingLabelCount++] = label;
+    }
+    nccFree(prefix);
+}
+
+// Check if a program label starts with the function name followed by
+// this many underscores
+static int isLabelScopeTaken(const char* funcName, int underscores) {
+    size_t length = strlen(funcName);
+    for (int i = 0; i < clashingLabelCount; i++) {
+        const char* label = clashingLabels[i];
+        if (strncmp(label, funcName, length) != 0) continue;
+        if ((int)strspn(label + length, "_") >= underscores) return 1;
+    }
+    return 0;
+}
+
+static void beginFunctionLabels(const char* funcName) {
+    int underscores = 2;
+    while (isLabelScopeTaken(funcName, underscores)) underscores++;
+    
+    size_t length = strlen(funcName);
+    nccFree(labelScope);
+    labelScope = nccMalloc(MEM_CODEGEN, length + underscores + 2);
+    sprintf(labelScope, "_%s", funcName);
+    memset(labelScope + 1 + length, '_', underscores);
+    labelScope[1 + length + underscores] = '\0';
+    outerLabelCounter = labelCounter;
+    labelCounter = 0;
+}
+
+static void endFunctionLabels() {
+    nccFree(labelScope);
+    labelScope = NULL;
+    labelCounter = outerLabelCounter;
+}
+
 // Generate a label with prefix
 char* generateLabel(const char* prefix) {
-    char* label = malloc(strlen(prefix) + 10);
-    sprintf(label, "%s%d", prefix, getNextLabelId());
+    const char* scope = getLabelScope();
+    char* label = nccMalloc(MEM_CODEGEN, strlen(scope) + strlen(prefix) + 12);
+    sprintf(label, "%s%s%d", scope, prefix, getNextLabelId());
     return label;
 }
 
+// Bytes a parameter takes on the stack: longs are pushed as two words,
+// everything else as one
+static int getParameterSize(ASTNode* param) {
+    TypeInfo* type = &param->declaration.type_info;
+    if (!type->is_pointer && (type->type == TYPE_LONG || type->type == TYPE_UNSIGNED_LONG)) {
+        return 4;
+    }
+    return 2;
+}
+
 void generateGlobalDeclaration(ASTNode* node);
 void generateFunction(ASTNode* node);
 void generateBlock(ASTNode* node);
@@ -354,6 +574,27 @@ void generateFunctionCall(ASTNode* node);
 void generateAsmBlock(ASTNode* node);
 void generateAsmStmt(ASTNode* node);
 void generateForLoop(ASTNode* node);
+static void generateFunctionCached(ASTNode* node);
+
+// Generate one top-level declaration or function
+static void generateTopLevelNode(ASTNode* node) {
+    switch (node->type) {
+        case NODE_FUNCTION:
+            startFunctionTimer(node->function.func_name);
+            beginCodegenFunction(node);
+            generateFunctionCached(node);
+            endCodegenFunction();
+            stopTimer();
+            break;
+        case NODE_DECLARATION:
+            startTimer(PHASE_DATA, NULL);
+            generateGlobalDeclaration(node);
+            stopTimer();
+            break;
+        default:
+            fprintf(stderr, "Warning: Unsupported top-level node type: %d\n", node->type);
+    }
+}
 
 // Generate the header for the program
 void generateProgramHeader() {
@@ -384,29 +625,192 @@ void generateCode(ASTNode* root) {
             fprintf(stderr, "Warning: Program node has no children (empty program)\n");
         }
         
+        beginFunctionCache(root);
+        collectClashingLabels(root);
+        
         int nodeCount = 0;
         while (current) {
             nodeCount++;
-              switch (current->type) {
-                case NODE_FUNCTION:
-                    // Debug message removed to reduce output verbosity
-                    generateFunction(current);
-                    break;
-                case NODE_DECLARATION:
-                    // Debug message removed to reduce output verbosity 
-                    generateGlobalDeclaration(current);
-                    break;
-                default:
-                    fprintf(stderr, "Warning: Unsupported top-level node type: %d\n", current->type);
+            // Runs of ordinary functions may be spread over workers
+            ASTNode* next = generateFunctionsInParallel(current, generateTopLevelNode);
+            if (next != current) {
+                current = next;
+                continue;
             }
+            generateTopLevelNode(current);
             current = current->next;
         }
+        reportFunctionCacheStats();
     }
 }
 
 // Forward declaration from preprocessor.h
 extern int isMacroDefined(const char* name);
 
+// Registers a __stackframe function may have to preserve, in push order
+static const struct {
+    int bit;
+    const char* name;
+} preservedRegisters[] = {
+    { REG_BX, "bx" },
+    { REG_CX, "cx" },
+    { REG_DX, "dx" },
+    { REG_SI, "si" },
+    { REG_DI, "di" }
+};
+#define PRESERVED_REGISTER_COUNT (int)(sizeof(preservedRegisters) / sizeof(preservedRegisters[0]))
+
+// Work out which preserved registers a function body writes by generating
+// it into a scratch file and scanning the result. The dry run happens in a
+// forked child, so none of the state it touches (labels, strings, arrays,
+// locals, statistics) reaches the real emission. Local offsets in the dry
+// run don't match the final frame, but the registers written do.
+#ifdef _WIN32
+// No fork(): assume the body writes every preserved register
+static int findWrittenRegisters(ASTNode* node) {
+    return REG_PRESERVED_ALL;
+}
+#else
+static int findWrittenRegisters(ASTNode* node) {
+    FILE* scratch = tmpfile();
+    if (!scratch) return REG_PRESERVED_ALL;
+    
+    // Nothing buffered before the fork may be written twice
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        asmFile = scratch;
+        suppressDiagnostics(1);
+        generateBlock(node->function.body);
+        _exit(fflush(scratch) == 0 ? 0 : 1);
+    }
+    int status = 0;
+    int generated = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    
+    // Read the generated body back and scan it
+    int written = REG_PRESERVED_ALL;
+    long size = generated && fseek(scratch, 0, SEEK_END) == 0 ? ftell(scratch) : -1;
+    char* code = size >= 0 ? (char*)nccMalloc(MEM_CODEGEN, size + 1) : NULL;
+    if (code) {
+        rewind(scratch);
+        size_t got = fread(code, 1, size, scratch);
+        code[got] = '\0';
+        written = scanWrittenRegisters(code);
+        nccFree(code);
+    }
+    fclose(scratch);
+    
+    return written;
+}
+#endif
+
+
+// Functions whose code depends on more than their body and the string
+// table: location markers, __start and anything after a locals redefinition
+int isSpecialFunction(ASTNode* node) {
+    const char* funcName = node->function.func_name;
+    return strncmp(funcName, "_NCC_", 5) == 0 || (systemModeEnabled && strcmp(funcName, "__start") == 0) ||
+           redefineLocalsFound || isMacroDefined("__NCC_REDEFINE_LOCALS");
+}
+
+// Append cached code, renumbering the string indexes written in it. Each
+// referenced string is interned in order, exactly as generating the code
+// again would add it, so the labels match an uncached build.
+static void spliceCachedFunction(const CachedFunction* entry) {
+    long at = 0;
+    for (int i = 0; i < entry->stringCount; i++) {
+        fwrite(entry->code + at, 1, entry->stringOffsets[i] - at, asmFile);
+        int index = internStringLiteral(nccStrdup(MEM_STRINGS, entry->strings[i]));
+        fprintf(asmFile, "%d", index);
+        at = entry->stringOffsets[i];
+        while (at < (long)entry->codeLength && isdigit((unsigned char)entry->code[at])) at++;
+    }
+    fwrite(entry->code + at, 1, entry->codeLength - at, asmFile);
+}
+
+// Generate a function, or splice in its code from the function cache.
+// A miss generates into a scratch file so the code can be stored as well.
+// Functions that change more than the string table and frame statistics
+// (arrays, diagnostics, location markers, __start) are never cached. The
+// key includes whether each function it calls preserves SI/DI, since that
+// decides the saves around the calls.
+static void generateFunctionCached(ASTNode* node) {
+    const char* funcName = node->function.func_name;
+    char key[CACHE_KEY_LEN + 1];
+    char* callees = describeCalleeRegisters(node);
+    char* state = (char*)nccMalloc(MEM_CODEGEN, strlen(callees) + 96);
+    if (!state) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(state, "arrays%d markers%d%d%d callees %s", arrayCount,
+            stringMarkerFound, arrayMarkerFound, isGlobalMarkerFound(), callees);
+    nccFree(callees);
+    int cacheable = !isSpecialFunction(node) && functionCacheKey(node, state, key);
+    nccFree(state);
+    if (!cacheable) {
+        generateFunction(node);
+        return;
+    }
+    
+    CachedFunction entry;
+    if (loadCachedFunction(key, &entry)) {
+        spliceCachedFunction(&entry);
+        if (entry.frameless) recordFramelessFunction(funcName);
+        freeCachedFunction(&entry);
+        return;
+    }
+    
+    FILE* scratch = tmpfile();
+    if (!scratch) {
+        generateFunction(node);
+        return;
+    }
+    
+    FILE* realFile = asmFile;
+    int savedArrayCount = arrayCount;
+    int savedFrameless = getFramelessFunctionCount();
+    int savedDiagnostics = getErrorCount() + getWarningCount();
+    
+    asmFile = scratch;
+    recordStringReferences(scratch);
+    generateFunction(node);
+    StringReference* references = NULL;
+    int referenceCount = stopRecordingStringReferences(&references);
+    asmFile = realFile;
+    
+    long size = ftell(scratch);
+    char* code = size >= 0 ? (char*)nccMalloc(MEM_CODEGEN, size + 1) : NULL;
+    char** strings = (char**)nccMalloc(MEM_CODEGEN, (referenceCount + 1) * sizeof(char*));
+    long* offsets = (long*)nccMalloc(MEM_CODEGEN, (referenceCount + 1) * sizeof(long));
+    if (code) {
+        rewind(scratch);
+        size_t got = fread(code, 1, size, scratch);
+        fwrite(code, 1, got, asmFile);
+        
+        if (got == (size_t)size && referenceCount >= 0 && strings && offsets &&
+            arrayCount == savedArrayCount && getErrorCount() + getWarningCount() == savedDiagnostics) {
+            for (int i = 0; i < referenceCount; i++) {
+                strings[i] = stringLiterals[references[i].index];
+                offsets[i] = references[i].offset;
+            }
+            CachedFunction generated;
+            memset(&generated, 0, sizeof(generated));
+            generated.code = code;
+            generated.codeLength = got;
+            generated.strings = strings;
+            generated.stringOffsets = offsets;
+            generated.stringCount = referenceCount;
+            generated.frameless = getFramelessFunctionCount() != savedFrameless;
+            saveCachedFunction(key, &generated);
+        }
+    }
+    nccFree(code);
+    nccFree(strings);
+    nccFree(offsets);
+    fclose(scratch);
+}
+
 // Generate code for a function
 void generateFunction(ASTNode* node) {
     if (!node || node->type != NODE_FUNCTION) return;
@@ -432,7 +836,9 @@ void generateFunction(ASTNode* node) {
     // Check if this is a special marker function
     if (strcmp(funcName, "_NCC_STRING_LOC") == 0) {
         // This is where string literals should go
+        startTimer(PHASE_DATA, "strings at marker");
         generateStringsAtMarker();
+        stopTimer();
         
         // Output only a comment for the marker when redefining locations
         if (!redefineLocalsFound) {
@@ -445,7 +851,9 @@ void generateFunction(ASTNode* node) {
     }
     else if (strcmp(funcName, "_NCC_ARRAY_LOC") == 0) {
         // This is where arrays should go
+        startTimer(PHASE_DATA, "arrays at marker");
         generateArraysAtMarker();
+        stopTimer();
         
         // Output only a comment for the marker when redefining locations
         if (!redefineLocalsFound) {
@@ -458,7 +866,9 @@ void generateFunction(ASTNode* node) {
     }
     else if (strcmp(funcName, "_NCC_GLOBAL_LOC") == 0) {
         // This is where global variables should go
+        startTimer(PHASE_DATA, "globals at marker");
         generateGlobalsAtMarker(asmFile);
+        stopTimer();
         
         // Output only a comment for the marker when redefining locations
         if (!redefineLocalsFound) {
@@ -496,6 +906,9 @@ void generateFunction(ASTNode* node) {
         clearLocalVars();
         currentFunction = funcName;
         currentFunctionIsNaked = node->function.info.is_naked;
+        beginFunctionLabels(funcName);
+        allocateFunctionRegisters(NULL); // __start keeps its locals in memory
+        layoutFunctionLocals(node);
         
         // Skip function prologue for __start as it's the entry point
         // Generate code for function body
@@ -505,6 +918,7 @@ void generateFunction(ASTNode* node) {
         
         // No epilogue for __start function as it should not return
         fprintf(asmFile, "\n");
+        endFunctionLabels();
         currentFunction = NULL;
         currentFunctionIsNaked = 0;
         return;
@@ -515,6 +929,7 @@ void generateFunction(ASTNode* node) {
     funcName = node->function.func_name;
     currentFunction = funcName;
     currentFunctionIsNaked = node->function.info.is_naked;
+    beginFunctionLabels(funcName);
     
     fprintf(asmFile, "; Function: %s\n", funcName);
     
@@ -522,7 +937,7 @@ void generateFunction(ASTNode* node) {
     if (node->function.info.is_static) {
         // Get sanitized filename for prefix
         const char* filename = getCurrentSourceFilename();
-        char* prefix = strdupc(filename);
+        char* prefix = nccStrdup(MEM_CODEGEN, filename);
         
         // Remove extension and sanitize for label use
         char* dot = strrchr(prefix, '.');
@@ -536,11 +951,60 @@ void generateFunction(ASTNode* node) {
         }
         
         fprintf(asmFile, "_%s_%s: ; static function (file-local)\n", prefix, funcName);
-        free(prefix);
+        nccFree(prefix);
     } else {
         fprintf(asmFile, "_%s:\n", funcName);  // Prepend underscore to function names
     }
-      // Check if this is a naked function (no prologue/epilogue)
+    // Keep the hottest scalar locals and parameters in SI/DI
+    int allocatedRegs = allocateFunctionRegisters(node);
+    
+    // Add function parameters to local variable table
+    // Parameters start at bp+4 (return address is at bp+2)
+    int paramOffset = 4;
+    ASTNode* param = node->function.params;
+    while (param) {
+        // Parameters are accessed via positive offsets from bp
+        if (param->type == NODE_DECLARATION) {
+            int size = getParameterSize(param);
+            // Negative offset means it's a parameter
+            appendLocalVar(param, SYMBOL_PARAMETER, -paramOffset, size, 0);
+            paramOffset += size;
+        }
+        param = param->next;
+    }
+    
+    // Lay out the locals that stayed in memory
+    int localBytes = layoutFunctionLocals(node);
+    
+    // Decide up front whether the function needs bp at all; locals that
+    // all went to registers don't need one
+    FrameAnalysis frame;
+    analyzeFunctionFrame(node, &frame);
+    int hasFrame = !optimizationState.omitFramePointer || frame.hasParams ||
+                   frame.asmUsesFrame || node->function.info.is_stackframe || localBytes > 0;
+    
+    // For stackframe functions, only preserve the registers the body writes
+    int returnsLong = node->function.info.return_type.type == TYPE_LONG ||
+                      node->function.info.return_type.type == TYPE_UNSIGNED_LONG;
+    int savedRegs = 0;
+    int usePusha = 0;
+    if (!currentFunctionIsNaked && node->function.info.is_stackframe) {
+        savedRegs = findWrittenRegisters(node) | allocatedRegs;
+        if (returnsLong) {
+            savedRegs &= ~REG_DX; // DX carries the high word of the result
+        }
+        
+        // pusha/popa is 2 bytes, plus a store per result register so popa doesn't undo it
+        int savedCount = 0;
+        for (int i = 0; i < PRESERVED_REGISTER_COUNT; i++) {
+            if (savedRegs & preservedRegisters[i].bit) savedCount++;
+        }
+        int pushCost = 2 * savedCount;
+        int pushaCost = 2 + 3 + (returnsLong ? 3 : 0);
+        usePusha = targetCpu >= CPU_186 && pushaCost < pushCost;
+    }
+
+    // Check if this is a naked function (no prologue/epilogue)
     if (currentFunctionIsNaked) {
         fprintf(asmFile, "    ; Naked function - no prologue generated\n");
     }
@@ -549,34 +1013,62 @@ void generateFunction(ASTNode* node) {
         fprintf(asmFile, "    ; Setup stackframe with register preservation\n");
         fprintf(asmFile, "    push bp\n");
         fprintf(asmFile, "    mov bp, sp\n");
-        fprintf(asmFile, "    push bx\n");
-        fprintf(asmFile, "    push cx\n");
-        fprintf(asmFile, "    push dx\n");
-        fprintf(asmFile, "    push si\n");
-        fprintf(asmFile, "    push di\n");
         
-        // We'll calculate the actual space needed after processing all declarations
-        fprintf(asmFile, "    ; Space for local variables will be allocated later\n\n");
+        if (usePusha) {
+            fprintf(asmFile, "    pusha ; Save general registers (shorter than separate pushes)\n");
+            stackSize = 16;
+        } else if (savedRegs) {
+            for (int i = 0; i < PRESERVED_REGISTER_COUNT; i++) {
+                if (savedRegs & preservedRegisters[i].bit) {
+                    fprintf(asmFile, "    push %s ; Written by function body\n", preservedRegisters[i].name);
+                    stackSize += 2;
+                }
+            }
+        } else {
+            fprintf(asmFile, "    ; Body writes no preserved registers\n");
+        }
     } else {
-        // Standard function prologue
-        fprintf(asmFile, "    push bp\n");
-        fprintf(asmFile, "    mov bp, sp\n\n");
+        if (!hasFrame) {
+            // Nothing in the body addresses the stack through bp
+            fprintf(asmFile, "    ; Frameless function - bp not needed\n");
+            recordFramelessFunction(funcName);
+        } else {
+            // Standard function prologue
+            fprintf(asmFile, "    push bp\n");
+            fprintf(asmFile, "    mov bp, sp\n");
+        }
+        
+        // Callers don't expect SI/DI to change, so registers the allocator used are saved
+        for (int i = 0; i < PRESERVED_REGISTER_COUNT; i++) {
+            if (allocatedRegs & preservedRegisters[i].bit) {
+                fprintf(asmFile, "    push %s ; Holds register variables\n", preservedRegisters[i].name);
+                stackSize += 2;
+            }
+        }
     }
-      // Add function parameters to local variable table
-    // Parameters start at bp+4 (return address is at bp+2)
-    int paramOffset = 4;
-    ASTNode* param = node->function.params;
-    while (param) {
-        // Parameters are accessed via positive offsets from bp
-        if (param->type == NODE_DECLARATION) {
-            // Store parameters in reverse order for easier access
-            localVars[localVarCount].name = strdupc(param->declaration.var_name);
-            localVars[localVarCount].offset = -paramOffset; // Negative offset means it's a parameter
-            localVarCount++;
-              // Parameters always take 2 bytes on the stack in 16-bit mode
-            paramOffset += 2;
+    int savedBytes = stackSize;
+    
+    // Reserve all locals with a single sub, below the saved registers
+    frameBase = savedBytes;
+    stackSize = savedBytes + localBytes;
+    if (!currentFunctionIsNaked) {
+        if (localBytes > 0) {
+            fprintf(asmFile, "    sub sp, %d ; Reserve space for local variables\n", localBytes);
         }
-        param = param->next;
+        
+        // Load register parameters once
+        int loadOffset = 4;
+        for (ASTNode* p = node->function.params; p; p = p->next) {
+            if (p->type != NODE_DECLARATION) continue;
+            if (p->declaration.alloc_reg) {
+                fprintf(asmFile, "    mov %s, [bp+%d] ; Keep parameter %s in a register\n",
+                        getAllocatedRegisterName(p->declaration.alloc_reg), loadOffset,
+                        p->declaration.var_name);
+            }
+            loadOffset += getParameterSize(p);
+        }
+        emitAllocationSummary(asmFile);
+        fprintf(asmFile, "\n");
     }
     
     // For variadic functions, add a comment about how to access additional arguments
@@ -619,28 +1111,61 @@ void generateFunction(ASTNode* node) {
     else if (node->function.info.is_stackframe) {
         fprintf(asmFile, "    ; Restore stackframe with registers\n");
         
-        // If we allocated space for locals, deallocate it here
-        if (stackSize > 0) {
-            fprintf(asmFile, "    add sp, %d ; Remove space for local variables\n", stackSize);
+        if (usePusha) {
+            // popa reloads AX (and DX), so write the result into the saved image
+            fprintf(asmFile, "    mov [bp-2], ax ; Keep return value across popa\n");
+            if (returnsLong) {
+                fprintf(asmFile, "    mov [bp-6], dx ; Keep high word of return value across popa\n");
+            }
         }
         
+        // Drop the locals, leaving sp at the saved registers
         fprintf(asmFile, "    mov sp, bp\n");
-        fprintf(asmFile, "    pop di\n");
-        fprintf(asmFile, "    pop si\n");
-        fprintf(asmFile, "    pop dx\n");
-        fprintf(asmFile, "    pop cx\n");
-        fprintf(asmFile, "    pop bx\n");
+        if (savedBytes > 0) {
+            fprintf(asmFile, "    sub sp, %d ; Point at saved registers\n", savedBytes);
+        }
+        
+        if (usePusha) {
+            fprintf(asmFile, "    popa\n");
+        } else {
+            for (int i = PRESERVED_REGISTER_COUNT - 1; i >= 0; i--) {
+                if (savedRegs & preservedRegisters[i].bit) {
+                    fprintf(asmFile, "    pop %s\n", preservedRegisters[i].name);
+                }
+            }
+        }
         fprintf(asmFile, "    pop bp\n");
         fprintf(asmFile, "    ret\n");
         fprintf(asmFile, "\n");
     } else {
-        fprintf(asmFile, "    ; Standard function epilogue\n");
-        fprintf(asmFile, "    mov sp, bp\n");
-        fprintf(asmFile, "    pop bp\n");
+        if (!hasFrame) {
+            fprintf(asmFile, "    ; Frameless function epilogue\n");
+        } else {
+            fprintf(asmFile, "    ; Standard function epilogue\n");
+        }
+        
+        if (allocatedRegs) {
+            // The stack is balanced here, so dropping the locals reaches the saved registers
+            if (localBytes > 0) {
+                fprintf(asmFile, "    add sp, %d ; Drop locals\n", localBytes);
+            }
+            for (int i = PRESERVED_REGISTER_COUNT - 1; i >= 0; i--) {
+                if (allocatedRegs & preservedRegisters[i].bit) {
+                    fprintf(asmFile, "    pop %s\n", preservedRegisters[i].name);
+                }
+            }
+            if (hasFrame) {
+                fprintf(asmFile, "    pop bp\n");
+            }
+        } else if (hasFrame) {
+            fprintf(asmFile, "    mov sp, bp\n");
+            fprintf(asmFile, "    pop bp\n");
+        }
         fprintf(asmFile, "    ret\n");
         fprintf(asmFile, "\n");
     }
     
+    endFunctionLabels();
     currentFunction = NULL;
     currentFunctionIsNaked = 0;
 }
@@ -650,15 +1175,26 @@ void generateBlock(ASTNode* node) {
     if (!node || node->type != NODE_BLOCK) return;
     
     ASTNode* statement = node->left;
+    int scope = beginLocalScope();
     
     while (statement) {
         generateStatement(statement);
         statement = statement->next;
     }
+    
+    endLocalScope(scope);
 }
 
-// Generate code for a statement
+static void emitStatement(ASTNode* node);
+
 void generateStatement(ASTNode* node) {
+    int mark = enterCodegen("generateStatement", node);
+    emitStatement(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a statement
+static void emitStatement(ASTNode* node) {
     if (!node) return;
     
     switch (node->type) {
@@ -667,21 +1203,25 @@ void generateStatement(ASTNode* node) {
             break;
               case NODE_ASSIGNMENT:
             fprintf(asmFile, "    ; Assignment statement\n");
+            if (targetCpu >= CPU_386 && generateLongAssignment386(node)) {
+                break;
+            }
             // Generate code for right-hand side
             if (node->assignment.op != 0 && node->left->type == NODE_IDENTIFIER) {                // Compound assignment: compute old value and RHS
                 // Load current LHS value
                 int varOffset = getVariableOffset(node->left->identifier);
-                if (isParameter(node->left->identifier)) {
+                if (getVariableRegister(node->left->identifier)) {
+                    emitLoadLocal(node->left->identifier, varOffset);
+                } else if (isParameter(node->left->identifier)) {
                     fprintf(asmFile, "    mov ax, [bp+%d] ; Load parameter %s for compound assignment\n", 
                             -varOffset, node->left->identifier);
                 } else if (varOffset > 0) {
-                    fprintf(asmFile, "    mov ax, [bp-%d] ; Load local variable %s for compound assignment\n", 
-                            varOffset, node->left->identifier);
+                    emitLoadLocal(node->left->identifier, varOffset);
                 } else {
                     // Load from global variable
                     // Get sanitized filename prefix
                     const char* filename = getCurrentSourceFilename();
-                    char* prefix = (char*)malloc(strlen(filename) + 1);
+                    char* prefix = (char*)nccMalloc(MEM_CODEGEN, strlen(filename) + 1);
                     if (prefix) {
                         strcpy(prefix, filename);
                         char* dot = strrchr(prefix, '.');
@@ -695,72 +1235,89 @@ void generateStatement(ASTNode* node) {
                         fprintf(asmFile, "    ; Loading global variable %s for compound assignment\n", node->left->identifier);
                         fprintf(asmFile, "    mov ax, [_%s_%s] ; Load global variable\n", 
                                 prefix, node->left->identifier);
-                        free(prefix);
+                        nccFree(prefix);
                     } else {
                         fprintf(asmFile, "    ; Loading global variable %s for compound assignment\n", node->left->identifier);
                         fprintf(asmFile, "    mov ax, [_%s] ; Load global variable (fallback)\n", node->left->identifier);
                     }
                 }
-                fprintf(asmFile, "    push ax ; Save old value\n");
-                // Evaluate RHS
-                generateExpression(node->right);
-                fprintf(asmFile, "    push ax ; Save RHS value\n");
-                // Pop into registers: BX=rhs, AX=old
-                fprintf(asmFile, "    pop bx ; RHS value\n");
-                fprintf(asmFile, "    pop ax ; Old LHS value\n");
-                // Apply operation
-                switch (node->assignment.op) {
-                    case OP_PLUS_ASSIGN:
-                        fprintf(asmFile, "    add ax, bx ; +=\n");
-                        break;
-                    case OP_MINUS_ASSIGN:
-                        fprintf(asmFile, "    sub ax, bx ; -=\n");
-                        break;
-                    case OP_MUL_ASSIGN:
-                        fprintf(asmFile, "    imul bx ; *=\n");
-                        break;                    
+                // Multiplying or dividing by a constant needs no RHS evaluation
+                int constant;
+                TypeInfo* lhsType = getTypeInfoFromExpression(node->left);
+                OperatorType reducedOp = node->assignment.op == OP_MUL_ASSIGN ? OP_MUL :
+                                         node->assignment.op == OP_DIV_ASSIGN ? OP_DIV :
+                                         node->assignment.op == OP_MOD_ASSIGN ? OP_MOD : OP_COMMA;
+                int lhsUnsigned = lhsType && (lhsType->type == TYPE_UNSIGNED_INT || 
+                                              lhsType->type == TYPE_UNSIGNED_SHORT ||
+                                              lhsType->type == TYPE_UNSIGNED_CHAR);
+                if (optimizationState.strengthReduce && reducedOp != OP_COMMA &&
+                    lhsType && !lhsType->is_pointer &&
+                    lhsType->type != TYPE_LONG && lhsType->type != TYPE_UNSIGNED_LONG &&
+                    getConstantOperand(node->right, &constant) &&
+                    emitConstantOperation(reducedOp, constant, lhsUnsigned)) {
+                    // Old value in AX was updated in place
+                } else {
+                    fprintf(asmFile, "    push ax ; Save old value\n");
+                    // Evaluate RHS
+                    generateExpression(node->right);
+                    fprintf(asmFile, "    push ax ; Save RHS value\n");
+                    // Pop into registers: BX=rhs, AX=old
+                    fprintf(asmFile, "    pop bx ; RHS value\n");
+                    fprintf(asmFile, "    pop ax ; Old LHS value\n");
+                    // Apply operation
+                    switch (node->assignment.op) {
+                        case OP_PLUS_ASSIGN:
+                            fprintf(asmFile, "    add ax, bx ; +=\n");
+                            break;
+                        case OP_MINUS_ASSIGN:
+                            fprintf(asmFile, "    sub ax, bx ; -=\n");
+                            break;
+                        case OP_MUL_ASSIGN:
+                            fprintf(asmFile, "    imul bx ; *=\n");
+                            break;                    
                         
-                    case OP_DIV_ASSIGN:
-                        {
-                            // Check if variable is unsigned
-                            TypeInfo* typeInfo = getTypeInfo(node->left->identifier);
-                            if (typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT || 
-                                          typeInfo->type == TYPE_UNSIGNED_SHORT ||
-                                          typeInfo->type == TYPE_UNSIGNED_CHAR)) {
-                                fprintf(asmFile, "    xor dx, dx ; Zero extend AX into DX:AX for unsigned division\n");
-                                fprintf(asmFile, "    div bx ; /= (unsigned)\n");
-                            } else {
-                                fprintf(asmFile, "    cwd ; Sign extend AX into DX:AX for division\n");
-                                fprintf(asmFile, "    idiv bx ; /=\n");
+                        case OP_DIV_ASSIGN:
+                            {
+                                // Check if variable is unsigned
+                                TypeInfo* typeInfo = getTypeInfoFromExpression(node->left);
+                                if (typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT || 
+                                              typeInfo->type == TYPE_UNSIGNED_SHORT ||
+                                              typeInfo->type == TYPE_UNSIGNED_CHAR)) {
+                                    fprintf(asmFile, "    xor dx, dx ; Zero extend AX into DX:AX for unsigned division\n");
+                                    fprintf(asmFile, "    div bx ; /= (unsigned)\n");
+                                } else {
+                                    fprintf(asmFile, "    cwd ; Sign extend AX into DX:AX for division\n");
+                                    fprintf(asmFile, "    idiv bx ; /=\n");
+                                }
                             }
-                        }
-                        break;                    case OP_MOD_ASSIGN:
-                        {
-                            // Check if variable is unsigned
-                            TypeInfo* typeInfo = getTypeInfo(node->left->identifier);
-                            if (typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT || 
-                                          typeInfo->type == TYPE_UNSIGNED_SHORT ||
-                                          typeInfo->type == TYPE_UNSIGNED_CHAR)) {
-                                fprintf(asmFile, "    xor dx, dx ; Zero extend AX into DX:AX for unsigned mod\n");
-                                fprintf(asmFile, "    div bx ; (unsigned)\n");
-                                fprintf(asmFile, "    mov ax, dx ; remainder in DX\n");
-                            } else {
-                                fprintf(asmFile, "    cwd ; Sign extend AX into DX:AX for mod\n");
-                                fprintf(asmFile, "    idiv bx ;\n");
-                                fprintf(asmFile, "    mov ax, dx ; remainder in DX\n");
+                            break;                    case OP_MOD_ASSIGN:
+                            {
+                                // Check if variable is unsigned
+                                TypeInfo* typeInfo = getTypeInfoFromExpression(node->left);
+                                if (typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT || 
+                                              typeInfo->type == TYPE_UNSIGNED_SHORT ||
+                                              typeInfo->type == TYPE_UNSIGNED_CHAR)) {
+                                    fprintf(asmFile, "    xor dx, dx ; Zero extend AX into DX:AX for unsigned mod\n");
+                                    fprintf(asmFile, "    div bx ; (unsigned)\n");
+                                    fprintf(asmFile, "    mov ax, dx ; remainder in DX\n");
+                                } else {
+                                    fprintf(asmFile, "    cwd ; Sign extend AX into DX:AX for mod\n");
+                                    fprintf(asmFile, "    idiv bx ;\n");
+                                    fprintf(asmFile, "    mov ax, dx ; remainder in DX\n");
+                                }
                             }
-                        }
-                        break;
-                    case OP_LEFT_SHIFT_ASSIGN:
-                        fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
-                        fprintf(asmFile, "    shl ax, cl ; Shift left (<<= operator)\n");
-                        break;
-                    case OP_RIGHT_SHIFT_ASSIGN:
-                        fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
-                        fprintf(asmFile, "    sar ax, cl ; Shift right (arithmetic) (>>= operator)\n");
-                        break;
-                    default:
-                        break;
+                            break;
+                        case OP_LEFT_SHIFT_ASSIGN:
+                            fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
+                            fprintf(asmFile, "    shl ax, cl ; Shift left (<<= operator)\n");
+                            break;
+                        case OP_RIGHT_SHIFT_ASSIGN:
+                            fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
+                            fprintf(asmFile, "    sar ax, cl ; Shift right (arithmetic) (>>= operator)\n");
+                            break;
+                        default:
+                            break;
+                    }
                 }
             } else if (node->assignment.op == 0) {
                 // Simple assignment: evaluate RHS
@@ -772,19 +1329,20 @@ void generateStatement(ASTNode* node) {
             if (node->left->type == NODE_IDENTIFIER) {
                 // Check if this is a parameter or local variable
                 int varOffset = getVariableOffset(node->left->identifier);
-                if (isParameter(node->left->identifier)) {
+                if (getVariableRegister(node->left->identifier)) {
+                    emitStoreLocal(node->left->identifier, varOffset, "ax");
+                } else if (isParameter(node->left->identifier)) {
                     // Parameters have positive offsets from bp
                     fprintf(asmFile, "    mov [bp+%d], ax ; Store in parameter %s\n", 
                             -varOffset, node->left->identifier);
                 } else if (varOffset > 0) {
                     // Local variables have negative offsets from bp
-                    fprintf(asmFile, "    mov [bp-%d], ax ; Store in local variable %s\n", 
-                            varOffset, node->left->identifier);
+                    emitStoreLocal(node->left->identifier, varOffset, "ax");
                 } else {
                     // Must be a global variable
                     // Get sanitized filename prefix
                     const char* filename = getCurrentSourceFilename();
-                    char* prefix = (char*)malloc(strlen(filename) + 1);
+                    char* prefix = (char*)nccMalloc(MEM_CODEGEN, strlen(filename) + 1);
                     if (prefix) {
                         strcpy(prefix, filename);
                         char* dot = strrchr(prefix, '.');
@@ -797,7 +1355,7 @@ void generateStatement(ASTNode* node) {
                         
                         fprintf(asmFile, "    mov [_%s_%s], ax ; Store in global variable %s\n", 
                                 prefix, node->left->identifier, node->left->identifier);
-                        free(prefix);
+                        nccFree(prefix);
                     } else {
                         // Fallback if memory allocation fails
                         fprintf(asmFile, "    mov [_%s], ax ; Store in global variable %s (fallback)\n", 
@@ -884,6 +1442,19 @@ void generateStatement(ASTNode* node) {
             generateIfStatement(node);
             break;
             
+        case NODE_BLOCK:
+            // Compound statement, e.g. a braced case body
+            generateBlock(node);
+            break;
+            
+        case NODE_SWITCH:
+            generateSwitchStatement(node);
+            break;
+            
+        case NODE_CASE:
+            fprintf(asmFile, "%s:\n", node->case_label.label);
+            break;
+            
         case NODE_BREAK:
             generateBreakStatement(node);
             break;
@@ -897,91 +1468,116 @@ void generateStatement(ASTNode* node) {
     }
 }
 
-// Generate code for variable declaration
+// Build the data label of the most recently registered local array
+static void formatLocalArrayLabel(char* label, size_t size, const char* name) {
+    char* prefix = getSanitizedFilenamePrefix();
+    snprintf(label, size, "_%s_%s_%s_%d", prefix ? prefix : "unknown",
+             currentFunction ? currentFunction : "global", name, arrayCount - 1);
+    nccFree(prefix);
+}
+
+// Static local arrays keep a data section blob; the local slot holds its address
+static void generateStaticLocalArray(ASTNode* node) {
+    char label[256];
+    
+    if (node->declaration.initializer) {
+        fprintf(asmFile, "    ; Static array with initializers: %s[%d]\n", 
+                node->declaration.var_name, 
+                node->declaration.type_info.array_size);
+        generateArrayWithInitializers(node);
+    } else {
+        fprintf(asmFile, "    ; Static array without initializers: %s[%d]\n", 
+                node->declaration.var_name, 
+                node->declaration.type_info.array_size);
+        addArrayDeclaration(node->declaration.var_name,
+                            node->declaration.type_info.array_size,
+                            node->declaration.type_info.type,
+                            currentFunction);
+    }
+    
+    formatLocalArrayLabel(label, sizeof(label), node->declaration.var_name);
+    fprintf(asmFile, "    mov ax, %s ; Address of array\n", label);
+    
+    int slot = addLocalVariable(node);
+    fprintf(asmFile, "    mov [bp-%d], ax ; Store pointer to array\n", slot);
+}
+
+// Arrays live in the frame: the pointer slot sits at [bp-slot] and the
+// elements directly above it, starting at [bp-(slot-2)]
+static void generateStackArray(ASTNode* node) {
+    const char* name = node->declaration.var_name;
+    int slot = addLocalVariable(node);
+    int storage = slot - 2;
+    
+    fprintf(asmFile, "    ; Stack array %s[%d] at [bp-%d]\n", 
+            name, node->declaration.type_info.array_size, storage);
+    
+    if (node->declaration.initializer) {
+        char label[256];
+        int words = (getArrayStorageSize(node) + 1) / 2;
+        
+        // Initial values come from a read-only template in the data section
+        generateArrayWithInitializers(node);
+        formatLocalArrayLabel(label, sizeof(label), name);
+        
+        // SI/DI are callee-saved, so the copy puts them back itself
+        fprintf(asmFile, "    push si\n");
+        fprintf(asmFile, "    push di\n");
+        fprintf(asmFile, "    mov si, %s ; Initializer template\n", label);
+        fprintf(asmFile, "    mov di, bp\n");
+        fprintf(asmFile, "    sub di, %d ; Destination: stack array\n", storage);
+        fprintf(asmFile, "    mov cx, %d ; Words to copy\n", words);
+        fprintf(asmFile, "    mov ax, es\n");
+        fprintf(asmFile, "    push ax ; Save ES\n");
+        fprintf(asmFile, "    mov ax, ss\n");
+        fprintf(asmFile, "    mov es, ax ; movsw stores through ES:DI\n");
+        fprintf(asmFile, "    cld\n");
+        fprintf(asmFile, "    #db 0xF3 ; rep prefix\n");
+        fprintf(asmFile, "    movsw\n");
+        fprintf(asmFile, "    pop ax\n");
+        fprintf(asmFile, "    mov es, ax ; Restore ES\n");
+        fprintf(asmFile, "    pop di\n");
+        fprintf(asmFile, "    pop si\n");
+    }
+    
+    fprintf(asmFile, "    mov ax, bp\n");
+    fprintf(asmFile, "    sub ax, %d ; Address of stack array\n", storage);
+    fprintf(asmFile, "    mov [bp-%d], ax ; Store pointer to array\n", slot);
+}
+
+static void emitVariableDeclaration(ASTNode* node);
+
 void generateVariableDeclaration(ASTNode* node) {
+    int mark = enterCodegen("generateVariableDeclaration", node);
+    emitVariableDeclaration(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for variable declaration
+static void emitVariableDeclaration(ASTNode* node) {
     if (!node || node->type != NODE_DECLARATION) return;
     
     // Check if this is an array with a fixed size
     if (node->declaration.type_info.is_array && node->declaration.type_info.array_size > 0) {
-        // Check if this array has initializers
-        if (node->declaration.initializer) {
-            fprintf(asmFile, "    ; Array variable with initializers: %s[%d]\n", 
-                    node->declaration.var_name, 
-                    node->declaration.type_info.array_size);
-            // Register the array with its initializers for generation at the right location
-            generateArrayWithInitializers(node);
-        } else {
-            // Register the array for generation with zeros
-            fprintf(asmFile, "    ; Array variable without initializers: %s[%d]\n", 
-                    node->declaration.var_name, 
-                    node->declaration.type_info.array_size);
-            addArrayDeclaration(node->declaration.var_name,
-                                node->declaration.type_info.array_size,
-                                node->declaration.type_info.type,
-                                currentFunction);
-        }
-        
-        // Set up a pointer to the array
-        fprintf(asmFile, "    ; Setting up pointer to array %s[%d]\n", 
-                node->declaration.var_name, 
-                node->declaration.type_info.array_size);
-                
-        // Get sanitized filename prefix
-        const char* filename = getCurrentSourceFilename();
-        char* prefix = (char*)malloc(strlen(filename) + 1);
-        if (prefix) {
-            strcpy(prefix, filename);
-            char* dot = strrchr(prefix, '.');
-            if (dot) *dot = '\0';
-            for (char* c = prefix; *c; c++) {
-                if (!isalnum(*c) && *c != '_') {
-                    *c = '_';
-                }
-            }
-            
-            // Get the array index from addArrayDeclaration (should be the most recent one)
-            int arrIndex = arrayCount - 1;
-            
-            // Generate pointer to array with full unique label (file_function_name_index)
-            fprintf(asmFile, "    mov ax, _%s_%s_%s_%d ; Address of array\n", 
-                    prefix, currentFunction ? currentFunction : "global", 
-                    node->declaration.var_name, arrIndex);
-            free(prefix);
+        if (node->declaration.type_info.is_static) {
+            generateStaticLocalArray(node);
         } else {
-            // Fallback with at least function name and index if we couldn't get a prefix
-            int arrIndex = arrayCount - 1;
-            fprintf(asmFile, "    mov ax, _%s_%s_%d ; Address of array (fallback)\n", 
-                    currentFunction ? currentFunction : "global", 
-                    node->declaration.var_name, arrIndex);
+            generateStackArray(node);
         }
-        fprintf(asmFile, "    push ax ; Store pointer to array\n");
-        
-        // Add to local variable table
-        addLocalVariable(node->declaration.var_name, 2);  // Pointer size is 2 bytes
-        
         return;
     }
     
-    // For non-array local variables, proceed as before
-    fprintf(asmFile, "    ; Local variable declaration: %s\n", node->declaration.var_name);    // Determine variable size based on type
-    int varSize = 2; // Default for int, short
-    if (node->declaration.type_info.type == TYPE_CHAR || 
-        node->declaration.type_info.type == TYPE_UNSIGNED_CHAR) {
-        varSize = 1;
-    } else if (node->declaration.type_info.type == TYPE_LONG || 
-              node->declaration.type_info.type == TYPE_UNSIGNED_LONG) {
-        varSize = 4; // 32-bit size for long types
-    } else if (node->declaration.type_info.type == TYPE_STRUCT && 
-              node->declaration.type_info.struct_info) {
-        // For structs, use the calculated struct size
-        varSize = node->declaration.type_info.struct_info->size;
-    }    // If there's an initializer, generate code for the assignment
+    // For non-array local variables, the slot was assigned by the frame layout
+    fprintf(asmFile, "    ; Local variable declaration: %s\n", node->declaration.var_name);
+    
+    // If there's an initializer, generate code for the assignment
     if (node->declaration.initializer) {
         // For struct initializers, we need to handle each member
         if (node->declaration.type_info.type == TYPE_STRUCT && 
             node->declaration.type_info.struct_info) {
             
             StructInfo* structInfo = node->declaration.type_info.struct_info;
+            int slot = frameBase + node->declaration.frame_offset;
             
             // Check if we have a compound initializer (brace-enclosed)
             if (node->declaration.initializer->next) {
@@ -989,42 +1585,31 @@ void generateVariableDeclaration(ASTNode* node) {
                 ASTNode* initValue = node->declaration.initializer;
                 StructMember* member = structInfo->members;
                 
-                // Calculate the total struct size to reserve space
-                int structSize = structInfo->size;
-                
-                // Reserve space for the struct on stack
-                if (structSize >= 2) {
-                    fprintf(asmFile, "    sub sp, %d  ; Reserve space for struct\n", structSize);
-                } else {
-                    fprintf(asmFile, "    push 0      ; Reserve space for small struct\n");
-                }
-                
                 // Initialize each member with the corresponding initializer
-                int offset = 0;
                 while (initValue && member) {
                     // Generate the member initializer value
                     generateExpression(initValue);
                     
-                    // Determine base pointer and offset for storing member
-                    int memberOffset = member->offset;
+                    // The struct starts at [bp-slot], members go upwards from there
+                    int memberSlot = slot - member->offset;
                     
                     // Store the value in the appropriate member location
                     if (member->type_info.type == TYPE_CHAR || 
                         member->type_info.type == TYPE_UNSIGNED_CHAR || 
                         member->type_info.type == TYPE_BOOL) {
-                        fprintf(asmFile, "    mov byte [bp-%d-%d], al  ; Initialize struct member %s\n", 
-                                stackSize, memberOffset, member->name);
+                        fprintf(asmFile, "    mov byte [bp-%d], al  ; Initialize struct member %s\n", 
+                                memberSlot, member->name);
                     } else if (member->type_info.type == TYPE_LONG || 
                               member->type_info.type == TYPE_UNSIGNED_LONG) {
                         // Assume 32-bit value in dx:ax
-                        fprintf(asmFile, "    mov word [bp-%d-%d], ax  ; Initialize struct member %s low word\n", 
-                                stackSize, memberOffset, member->name);
-                        fprintf(asmFile, "    mov word [bp-%d-%d], dx  ; Initialize struct member %s high word\n", 
-                                stackSize, memberOffset + 2, member->name);
+                        fprintf(asmFile, "    mov word [bp-%d], ax  ; Initialize struct member %s low word\n", 
+                                memberSlot, member->name);
+                        fprintf(asmFile, "    mov word [bp-%d], dx  ; Initialize struct member %s high word\n", 
+                                memberSlot - 2, member->name);
                     } else {
                         // Default case for 16-bit values
-                        fprintf(asmFile, "    mov word bp-%d-%d], ax  ; Initialize struct member %s\n", 
-                                stackSize, memberOffset, member->name);
+                        fprintf(asmFile, "    mov word [bp-%d], ax  ; Initialize struct member %s\n", 
+                                memberSlot, member->name);
                     }
                     
                     // Move to next member and initializer
@@ -1033,62 +1618,40 @@ void generateVariableDeclaration(ASTNode* node) {
                 }
             } else {
                 // Single-value initializer - not directly supported for structs
-                // Just reserve space
                 fprintf(asmFile, "    ; Warning: Single value initializer not supported for struct, leaving uninitialized\n");
-                
-                int structSize = structInfo->size;
-                int wordsToPush = (structSize + 1) / 2; // Round up to nearest word
-                
-                for (int i = 0; i < wordsToPush; i++) {
-                    fprintf(asmFile, "    push 0 ; Uninitialized struct space\n");
-                }
             }
+            
+            addLocalVariable(node);
+        }
+        // A 386 initializes longs with a single 32-bit store
+        else if (targetCpu >= CPU_386 && !node->declaration.type_info.is_pointer &&
+                 (node->declaration.type_info.type == TYPE_LONG ||
+                  node->declaration.type_info.type == TYPE_UNSIGNED_LONG)) {
+            int slot = addLocalVariable(node);
+            generateLongInitializer386(node->declaration.initializer, slot);
         }
         // For regular values
         else {
             // Generate the value
             generateExpression(node->declaration.initializer);
             
+            int slot = addLocalVariable(node);
+            
             // For long values, need to handle 32-bit initialization
             if (node->declaration.type_info.type == TYPE_LONG || 
                 node->declaration.type_info.type == TYPE_UNSIGNED_LONG) {
                 // For now, we'll initialize with lower 16 bits in AX and assume upper 16 bits are zero
                 // This would need to be expanded for full 32-bit literal support
-                fprintf(asmFile, "    push 0 ; Push high word (upper 16 bits)\n");
-                fprintf(asmFile, "    push ax ; Push low word (lower 16 bits)\n");
+                fprintf(asmFile, "    mov word [bp-%d], ax ; Low word (lower 16 bits)\n", slot);
+                fprintf(asmFile, "    mov word [bp-%d], 0 ; High word (upper 16 bits)\n", slot - 2);
             } else {
-                // For regular values, just push AX
-                fprintf(asmFile, "    push ax ; Initialize local variable\n");
+                emitStoreLocal(node->declaration.var_name, slot, "ax");
             }
         }
     } else {
-        // Reserve space by pushing zeros
-        if (node->declaration.type_info.type == TYPE_STRUCT && 
-            node->declaration.type_info.struct_info) {
-            // For structs, push enough zeros to reserve the required space
-            int structSize = node->declaration.type_info.struct_info->size;
-            int wordsToPush = (structSize + 1) / 2; // Round up to nearest word
-            
-            fprintf(asmFile, "    ; Reserving %d bytes for uninit struct %s\n", 
-                   structSize, node->declaration.var_name);
-            
-            for (int i = 0; i < wordsToPush; i++) {
-                fprintf(asmFile, "    push 0 ; Uninitialized struct space\n");
-            }
-        }
-        else if (node->declaration.type_info.type == TYPE_LONG || 
-                node->declaration.type_info.type == TYPE_UNSIGNED_LONG) {
-            // For 32-bit long, push two 16-bit zeros
-            fprintf(asmFile, "    push 0 ; Uninitialized long variable (high word)\n");
-            fprintf(asmFile, "    push 0 ; Uninitialized long variable (low word)\n");
-        } else {
-            // Just reserve space by pushing a zero
-            fprintf(asmFile, "    push 0 ; Uninitialized local variable\n");
-        }
+        // Uninitialized locals just occupy their reserved slot
+        addLocalVariable(node);
     }
-    
-    // Add to local variable table
-    addLocalVariable(node->declaration.var_name, varSize);
 }
 
 // Generate code for global variable declaration
@@ -1119,9 +1682,17 @@ void generateGlobalDeclaration(ASTNode* node) {
 
 
 
+static void emitExpression(ASTNode* node);
+
+void generateExpression(ASTNode* node) {
+    int mark = enterCodegen("generateExpression", node);
+    emitExpression(node);
+    leaveCodegen(mark);
+}
+
 // Generate all collected global variables
 // Generate code for an expression
-void generateExpression(ASTNode* node) {
+static void emitExpression(ASTNode* node) {
     if (!node) return;
     
     switch (node->type) {
@@ -1150,16 +1721,17 @@ void generateExpression(ASTNode* node) {
                     generateExpression(node->left);
                     fprintf(asmFile, "    mov bx, ax    ; Load struct pointer into BX\n");
                     
-                    // Calculate the member offset within the struct
-                    int offset = getMemberOffset(baseType->struct_info, node->member_access.member_name);
-                    if (offset < 0) {
+                    // The member was resolved by the type annotation pass
+                    StructMember* member = getAccessedMember(node);
+                    if (!member) {
                         reportError(-1, "Struct %s has no member named %s", 
                                   baseType->struct_info->name, node->member_access.member_name);
                         return;
                     }
+                    int offset = member->offset;
                     
-                    // Get the member's type to determine load size
-                    TypeInfo* memberType = getMemberType(baseType->struct_info, node->member_access.member_name);
+                    // The member's type determines the load size
+                    TypeInfo* memberType = &member->type_info;
                     
                     // Load the member value from the pointer + offset into AX
                     if (memberType->type == TYPE_CHAR || memberType->type == TYPE_UNSIGNED_CHAR || memberType->type == TYPE_BOOL) {
@@ -1185,16 +1757,17 @@ void generateExpression(ASTNode* node) {
                     generateAddressOf(node->left);
                     fprintf(asmFile, "    mov bx, ax    ; Load struct address into BX\n");
                     
-                    // Calculate the member offset within the struct
-                    int offset = getMemberOffset(baseType->struct_info, node->member_access.member_name);
-                    if (offset < 0) {
+                    // The member was resolved by the type annotation pass
+                    StructMember* member = getAccessedMember(node);
+                    if (!member) {
                         reportError(-1, "Struct %s has no member named %s", 
                                   baseType->struct_info->name, node->member_access.member_name);
                         return;
                     }
+                    int offset = member->offset;
                     
-                    // Get the member's type to determine load size
-                    TypeInfo* memberType = getMemberType(baseType->struct_info, node->member_access.member_name);
+                    // The member's type determines the load size
+                    TypeInfo* memberType = &member->type_info;
                     
                     // Load the member value from the address + offset into AX
                     if (memberType->type == TYPE_CHAR || memberType->type == TYPE_UNSIGNED_CHAR || memberType->type == TYPE_BOOL) {
@@ -1220,7 +1793,7 @@ void generateExpression(ASTNode* node) {
                 if (strIndex >= 0) {
                     // Get sanitized filename prefix
                     const char* filename = getCurrentSourceFilename();
-                    char* prefix = (char*)malloc(strlen(filename) + 1);
+                    char* prefix = (char*)nccMalloc(MEM_CODEGEN, strlen(filename) + 1);
                     if (prefix) {
                         strcpy(prefix, filename);
                         char* dot = strrchr(prefix, '.');
@@ -1233,11 +1806,15 @@ void generateExpression(ASTNode* node) {
                         
                         // Load the address of the string into AX
                         fprintf(asmFile, "    ; String literal: %s\n", node->literal.string_value);
-                        fprintf(asmFile, "    mov ax, %s_string_%d ; Address of string\n", prefix, strIndex);
-                        free(prefix);
+                        fprintf(asmFile, "    mov ax, %s_string_", prefix);
+                        noteStringReference(asmFile, strIndex);
+                        fprintf(asmFile, "%d ; Address of string\n", strIndex);
+                        nccFree(prefix);
                     } else {
                         fprintf(asmFile, "    ; String literal: %s\n", node->literal.string_value);
-                        fprintf(asmFile, "    mov ax, string_%d ; Address of string (fallback)\n", strIndex);
+                        fprintf(asmFile, "    mov ax, string_");
+                        noteStringReference(asmFile, strIndex);
+                        fprintf(asmFile, "%d ; Address of string (fallback)\n", strIndex);
                     }
                 } else {
                     fprintf(asmFile, "    ; Error processing string literal: %s\n", 
@@ -1267,10 +1844,12 @@ void generateExpression(ASTNode* node) {
             }
             break;
           case NODE_IDENTIFIER:
-            // Check if this is a parameter or local variable
-            if (isParameter(node->identifier)) {
+            // Check if this is a register variable, parameter or local variable
+            if (getVariableRegister(node->identifier)) {
+                emitLoadLocal(node->identifier, 0);
+            } else if (isParameter(node->identifier)) {
                 // Check if it's a long type
-                TypeInfo* typeInfo = getTypeInfo(node->identifier);
+                TypeInfo* typeInfo = getTypeInfoFromExpression(node);
                 if (typeInfo && (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG)) {
                     // For 32-bit types, load low word into AX and high word into DX
                     fprintf(asmFile, "    ; Loading long parameter %s\n", node->identifier);
@@ -1289,13 +1868,13 @@ void generateExpression(ASTNode* node) {
                    if (varOffset == 0) {
                     // Global variable or array
                     const char* filename = getCurrentSourceFilename();
-                    char* prefix = (char*)malloc(strlen(filename) + 1);
+                    char* prefix = (char*)nccMalloc(MEM_CODEGEN, strlen(filename) + 1);
                     if (prefix) {
                         strcpy(prefix, filename);
                         char* dot = strrchr(prefix, '.'); if (dot) *dot = '\0';
                         for (char* c = prefix; *c; c++) if (!isalnum(*c) && *c != '_') *c = '_';
                     }                    // Determine if this global is an array
-                    TypeInfo* tinfo = getTypeInfo(node->identifier);
+                    TypeInfo* tinfo = getTypeInfoFromExpression(node);
                     if (tinfo && tinfo->is_array) {
                         extern int arrayCount; extern char** arrayNames; extern char** arrayFunctions;
                         int idx = -1;
@@ -1305,7 +1884,7 @@ void generateExpression(ASTNode* node) {
                             }
                         }                        if (idx >= 0 && prefix) {
                             fprintf(asmFile, "    mov ax, _%s_global_%s_%d ; Address of global array\n", prefix, node->identifier, idx);
-                            free(prefix);
+                            nccFree(prefix);
                             break;
                         }
                     }
@@ -1313,23 +1892,23 @@ void generateExpression(ASTNode* node) {
                     if (prefix) {
                         fprintf(asmFile, "    ; Loading global variable %s\n", node->identifier);
                         fprintf(asmFile, "    mov ax, [_%s_%s] ; Load global variable\n", prefix, node->identifier);
-                        free(prefix);
+                        nccFree(prefix);
                     } else {
                         fprintf(asmFile, "    ; Loading global variable %s\n", node->identifier);
                         fprintf(asmFile, "    mov ax, [_%s] ; Load global variable (fallback)\n", node->identifier);
                     }
                  } else {
                      // Check if it's a long type
-                     TypeInfo* typeInfo = getTypeInfo(node->identifier);
-                     if (typeInfo && (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG)) {
+                     TypeInfo* typeInfo = getTypeInfoFromExpression(node);
+                     if (typeInfo && !isByteLocal(node->identifier) &&
+                         (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG)) {
                          // For 32-bit types, load low word into AX and high word into DX
                          fprintf(asmFile, "    ; Loading long variable %s\n", node->identifier);
                          fprintf(asmFile, "    mov ax, [bp-%d] ; Load low word\n", varOffset);
                          fprintf(asmFile, "    mov dx, [bp-%d] ; Load high word\n", varOffset - 2);
                      } else {
-                         // Ensure we use word-aligned offsets for local variables
-                         fprintf(asmFile, "    mov ax, [bp-%d] ; Load local variable %s\n", 
-                                 varOffset, node->identifier);
+                         // Byte locals are packed, so they are widened on load
+                         emitLoadLocal(node->identifier, varOffset);
                      }
                  }
              }
@@ -1361,8 +1940,16 @@ void generateExpression(ASTNode* node) {
     }
 }
 
-// Generate code for binary operations
+static void emitBinaryOp(ASTNode* node);
+
 void generateBinaryOp(ASTNode* node) {
+    int mark = enterCodegen("generateBinaryOp", node);
+    emitBinaryOp(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for binary operations
+static void emitBinaryOp(ASTNode* node) {
     // Short-circuit logical operators
     if (node->operation.op == OP_LAND) {
         char* falseLabel = generateLabel("land_false");
@@ -1378,8 +1965,8 @@ void generateBinaryOp(ASTNode* node) {
         fprintf(asmFile, "%s:\n", falseLabel);
         fprintf(asmFile, "    mov ax, 0 ; false\n");
         fprintf(asmFile, "%s:\n", endLabel);
-        free(falseLabel);
-        free(endLabel);
+        nccFree(falseLabel);
+        nccFree(endLabel);
         return;
     }
     if (node->operation.op == OP_LOR) {
@@ -1396,8 +1983,8 @@ void generateBinaryOp(ASTNode* node) {
         fprintf(asmFile, "%s:\n", trueLabel);
         fprintf(asmFile, "    mov ax, 1 ; true\n");
         fprintf(asmFile, "%s:\n", endLabel);
-        free(trueLabel);
-        free(endLabel);
+        nccFree(trueLabel);
+        nccFree(endLabel);
         return;    }
     
     // Check if we're operating on long types
@@ -1405,6 +1992,25 @@ void generateBinaryOp(ASTNode* node) {
     TypeInfo* rightType = getTypeInfoFromExpression(node->right);
     int isLongOperation = (leftType && (leftType->type == TYPE_LONG || leftType->type == TYPE_UNSIGNED_LONG)) ||
                         (rightType && (rightType->type == TYPE_LONG || rightType->type == TYPE_UNSIGNED_LONG));
+    
+    // A 386 computes longs in the 32-bit registers
+    if (targetCpu >= CPU_386 &&
+        !isPointerType(node->left) && !isPointerType(node->right) &&
+        generateLongBinaryOp386(node)) {
+        return;
+    }
+    
+    // Multiplication, division and modulus by a constant
+    if (optimizationState.strengthReduce && !isLongOperation &&
+        !isPointerType(node->left) && !isPointerType(node->right)) {
+        TypeInfo* typeInfo = getTypeInfoFromExpression(node->left);
+        int isUnsigned = typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT || 
+                                      typeInfo->type == TYPE_UNSIGNED_SHORT || 
+                                      typeInfo->type == TYPE_UNSIGNED_CHAR);
+        if (generateConstantMulDivMod(node, isUnsigned)) {
+            return;
+        }
+    }
                         
     if (isLongOperation) {
         // For 32-bit operations, we need to handle the upper 16 bits (DX register)
@@ -1702,56 +2308,56 @@ void generateBinaryOp(ASTNode* node) {
         case OP_EQ:
             fprintf(asmFile, "    cmp ax, bx ; Equal comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    je eq_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp eq_end_%d\n", labelCounter);
-            fprintf(asmFile, "eq_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    je %seq_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %seq_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%seq_true_%d:\n", getLabelScope(), labelCounter);
             fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "eq_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%seq_end_%d:\n", getLabelScope(), labelCounter++);
             break;
         case OP_NEQ:
             fprintf(asmFile, "    cmp ax, bx ; Not equal comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    jne neq_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp neq_end_%d\n", labelCounter);
-            fprintf(asmFile, "neq_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    jne %sneq_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %sneq_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%sneq_true_%d:\n", getLabelScope(), labelCounter);
                        fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "neq_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%sneq_end_%d:\n", getLabelScope(), labelCounter++);
             break;
         case OP_LT:
             fprintf(asmFile, "    cmp ax, bx ; Less than comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    jl lt_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp lt_end_%d\n", labelCounter);
-            fprintf(asmFile, "lt_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    jl %slt_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %slt_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%slt_true_%d:\n", getLabelScope(), labelCounter);
             fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "lt_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%slt_end_%d:\n", getLabelScope(), labelCounter++);
             break;
         case OP_LTE:
             fprintf(asmFile, "    cmp ax, bx ; Less than or equal comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    jle lte_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp lte_end_%d\n", labelCounter);
-            fprintf(asmFile, "lte_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    jle %slte_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %slte_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%slte_true_%d:\n", getLabelScope(), labelCounter);
             fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "lte_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%slte_end_%d:\n", getLabelScope(), labelCounter++);
             break;
         case OP_GT:
             fprintf(asmFile, "    cmp ax, bx ; Greater than comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    jg gt_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp gt_end_%d\n", labelCounter);
-            fprintf(asmFile, "gt_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    jg %sgt_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %sgt_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%sgt_true_%d:\n", getLabelScope(), labelCounter);
             fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "gt_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%sgt_end_%d:\n", getLabelScope(), labelCounter++);
             break;
         case OP_GTE:
             fprintf(asmFile, "    cmp ax, bx ; Greater than or equal comparison\n");
             fprintf(asmFile, "    mov ax, 0  ; Assume false\n");
-            fprintf(asmFile, "    jge gte_true_%d\n", labelCounter);
-            fprintf(asmFile, "    jmp gte_end_%d\n", labelCounter);
-            fprintf(asmFile, "gte_true_%d:\n", labelCounter);
+            fprintf(asmFile, "    jge %sgte_true_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "    jmp %sgte_end_%d\n", getLabelScope(), labelCounter);
+            fprintf(asmFile, "%sgte_true_%d:\n", getLabelScope(), labelCounter);
             fprintf(asmFile, "    mov ax, 1  ; Set true\n");
-            fprintf(asmFile, "gte_end_%d:\n", labelCounter++);
+            fprintf(asmFile, "%sgte_end_%d:\n", getLabelScope(), labelCounter++);
             break;
               case OP_BITWISE_AND:
             fprintf(asmFile, "    and ax, bx ; Bitwise AND\n");
@@ -1789,8 +2395,16 @@ void generateBinaryOp(ASTNode* node) {
     }
 }
 
-// Generate code for a ternary conditional expression
+static void emitTernaryExpression(ASTNode* node);
+
 void generateTernaryExpression(ASTNode* node) {
+    int mark = enterCodegen("generateTernaryExpression", node);
+    emitTernaryExpression(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a ternary conditional expression
+static void emitTernaryExpression(ASTNode* node) {
     if (!node || node->type != NODE_TERNARY) return;
     
     // Generate unique labels
@@ -1822,66 +2436,94 @@ void generateTernaryExpression(ASTNode* node) {
     fprintf(asmFile, "%s: ; End of ternary expression\n", endLabel);
     
     // Free the allocated labels
-    free(falseLabel);
-    free(endLabel);
+    nccFree(falseLabel);
+    nccFree(endLabel);
 }
 
-// Generate code for a function call
+static void emitFunctionCall(ASTNode* node);
+
 void generateFunctionCall(ASTNode* node) {
+    int mark = enterCodegen("generateFunctionCall", node);
+    emitFunctionCall(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a function call
+static void emitFunctionCall(ASTNode* node) {
     if (!node || node->type != NODE_CALL) return;
     
     fprintf(asmFile, "    ; Function call to %s\n", node->call.func_name);
     
+    // Naked, inline-asm and external callees may overwrite SI/DI
+    int savedRegs = emitSaveLiveRegisters(asmFile, node);
+    
     // Count arguments and store them in an array
     int argCount = 0;
     ASTNode* arg = node->call.args;
     ASTNode* args[32]; // Maximum 32 arguments
+    int argSizes[32];
     
     // Collect arguments in an array first
     while (arg) {
         args[argCount++] = arg;
         arg = arg->next;
     }
-      // Push arguments in reverse order (right-to-left) as per C calling convention
+    
+    // Each argument takes the size of the parameter it is passed to, so a
+    // long parameter gets both words even for an int argument. Arguments
+    // beyond the declared parameters keep their own size.
+    ASTNode* callee = findFunctionDeclaration(node->call.func_name);
+    ASTNode* param = callee ? callee->function.params : NULL;
+    for (int i = 0; i < argCount; i++) {
+        while (param && param->type != NODE_DECLARATION) param = param->next;
+        if (param) {
+            argSizes[i] = getParameterSize(param);
+            param = param->next;
+        } else {
+            argSizes[i] = isLongExpression(args[i]) ? 4 : 2;
+        }
+    }
+    
+    // Push arguments in reverse order (right-to-left) as per C calling convention
     for (int i = argCount - 1; i >= 0; i--) {
-        // Get argument type information to check if it's a long type
-        TypeInfo* typeInfo = getTypeInfoFromExpression(args[i]);
-        
-        // Generate code for each argument
-        generateExpression(args[i]);
-        
-        if (typeInfo && (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG)) {
+        if (argSizes[i] == 4) {
             // For 32-bit long values, push high word (DX) then low word (AX)
+            generateLongValue(args[i]);
             fprintf(asmFile, "    push dx ; Argument %d (high word)\n", i + 1);
             fprintf(asmFile, "    push ax ; Argument %d (low word)\n", i + 1);
         } else {
             // For normal values, just push AX
+            generateExpression(args[i]);
             fprintf(asmFile, "    push ax ; Argument %d\n", i + 1);
         }
     }
     
     // Call the function
     fprintf(asmFile, "    call _%s\n", node->call.func_name);
-      // Clean up stack (caller-cleanup convention)
+    
+    // Clean up stack (caller-cleanup convention)
     if (argCount > 0) {
-        // Calculate how many bytes to clean up based on argument types
         int bytesToCleanup = 0;
-        
         for (int i = 0; i < argCount; i++) {
-            TypeInfo* typeInfo = getTypeInfoFromExpression(args[i]);
-            if (typeInfo && (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG)) {
-                bytesToCleanup += 4; // 32-bit args take 4 bytes
-            } else {
-                bytesToCleanup += 2; // Normal args take 2 bytes
-            }
+            bytesToCleanup += argSizes[i];
         }
         
         fprintf(asmFile, "    add sp, %d ; Remove arguments\n", bytesToCleanup);
     }
+    
+    emitRestoreLiveRegisters(asmFile, savedRegs);
 }
 
-// Generate code for a return statement
+static void emitReturnStatement(ASTNode* node);
+
 void generateReturnStatement(ASTNode* node) {
+    int mark = enterCodegen("generateReturnStatement", node);
+    emitReturnStatement(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a return statement
+static void emitReturnStatement(ASTNode* node) {
     if (!node || node->type != NODE_RETURN) return;
     
     fprintf(asmFile, "    ; Return statement\n");    // Generate code for return value if present
@@ -1914,7 +2556,7 @@ void generateBreakStatement(ASTNode* node) {
     
     LoopContext* context = getCurrentLoopContext();
     if (!context) {
-        reportError(-1, "break statement not within a loop");
+        reportError(-1, "break statement not within a loop or switch");
         return;
     }
     
@@ -1927,7 +2569,7 @@ void generateContinueStatement(ASTNode* node) {
     if (!node || node->type != NODE_CONTINUE) return;
     
     LoopContext* context = getCurrentLoopContext();
-    if (!context) {
+    if (!context || !context->continueLabel) {
         reportError(-1, "continue statement not within a loop");
         return;
     }
@@ -1936,23 +2578,43 @@ void generateContinueStatement(ASTNode* node) {
     fprintf(asmFile, "    jmp %s ; Jump to loop condition/update\n", context->continueLabel);
 }
 
-// Generate code for an inline assembly block
+static void emitAsmBlock(ASTNode* node);
+
 void generateAsmBlock(ASTNode* node) {
+    int mark = enterCodegen("generateAsmBlock", node);
+    emitAsmBlock(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for an inline assembly block
+static void emitAsmBlock(ASTNode* node) {
     if (!node || node->type != NODE_ASM_BLOCK || !node->asm_block.code) return;
     
     fprintf(asmFile, "    ; Inline assembly block\n");
+    int savedRegs = emitSaveLiveRegisters(asmFile, node);
     fprintf(asmFile, "%s\n", node->asm_block.code);
+    emitRestoreLiveRegisters(asmFile, savedRegs);
 }
 
-// Generate code for an inline assembly statement
+static void emitAsmStmt(ASTNode* node);
+
 void generateAsmStmt(ASTNode* node) {
+    int mark = enterCodegen("generateAsmStmt", node);
+    emitAsmStmt(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for an inline assembly statement
+static void emitAsmStmt(ASTNode* node) {
     if (!node || node->type != NODE_ASM || !node->asm_stmt.code) return;
     
     fprintf(asmFile, "    ; Inline assembly statement\n");
     
     // If there are no operands, just output the code directly
     if (node->asm_stmt.operand_count == 0) {
+        int savedRegs = emitSaveLiveRegisters(asmFile, node);
         fprintf(asmFile, "    %s\n", node->asm_stmt.code);
+        emitRestoreLiveRegisters(asmFile, savedRegs);
         return;
     }
     
@@ -1963,15 +2625,18 @@ void generateAsmStmt(ASTNode* node) {
     fprintf(asmFile, "    ; Inline assembly with %d operands\n", node->asm_stmt.operand_count);
     
     // Arrays to store register assignments and operand types
-    char** registers = (char**)malloc(sizeof(char*) * node->asm_stmt.operand_count);
-    int* isOutput = (int*)malloc(sizeof(int) * node->asm_stmt.operand_count);
+    char** registers = (char**)nccMalloc(MEM_CODEGEN, sizeof(char*) * node->asm_stmt.operand_count);
+    int* isOutput = (int*)nccMalloc(MEM_CODEGEN, sizeof(int) * node->asm_stmt.operand_count);
     
     if (!registers || !isOutput) {
         fprintf(stderr, "Memory allocation failed for assembly registers\n");
-        if (registers) free(registers);
-        if (isOutput) free(isOutput);
+        if (registers) nccFree(registers);
+        if (isOutput) nccFree(isOutput);
         return;
     }
+    
+    // Save allocated registers the assembly (or its operand registers) may overwrite
+    int savedRegs = emitSaveLiveRegisters(asmFile, node);
       // Commonly used registers based on constraint type
     const char* word_reg_choices[] = {"ax", "bx", "cx", "dx", "si", "di"};
     const char* byte_reg_choices[] = {"al", "bl", "cl", "dl"}; // Byte-sized registers
@@ -2003,10 +2668,10 @@ void generateAsmStmt(ASTNode* node) {
             if (is_byte_register) {
                 // Byte register constraint ("rb")
                 if (reg_index < 4) { // Only 4 byte registers available
-                    registers[i] = strdupc(byte_reg_choices[reg_index++]);
+                    registers[i] = nccStrdup(MEM_CODEGEN, byte_reg_choices[reg_index++]);
                 } else {
                     // Fall back to al if we run out of preferred registers
-                    registers[i] = strdupc("al");
+                    registers[i] = nccStrdup(MEM_CODEGEN, "al");
                 }
                 
                 // For input operands, move result to the assigned byte register
@@ -2020,10 +2685,10 @@ void generateAsmStmt(ASTNode* node) {
             } else {
                 // Standard word register constraint ("r")
                 if (reg_index < 6) {
-                    registers[i] = strdupc(word_reg_choices[reg_index++]);
+                    registers[i] = nccStrdup(MEM_CODEGEN, word_reg_choices[reg_index++]);
                 } else {
                     // Run out of preferred registers, just use ax
-                    registers[i] = strdupc("ax");
+                    registers[i] = nccStrdup(MEM_CODEGEN, "ax");
                 }
                 
                 // For input operands, move result to the assigned register
@@ -2035,10 +2700,10 @@ void generateAsmStmt(ASTNode* node) {
             // 'q' is a GCC constraint that means a,b,c,d registers (in any size)
             // In our case, we'll use it specifically for byte registers (al, bl, cl, dl)
             if (reg_index < 4) { // Only 4 byte registers available
-                registers[i] = strdupc(byte_reg_choices[reg_index++]);
+                registers[i] = nccStrdup(MEM_CODEGEN, byte_reg_choices[reg_index++]);
             } else {
                 // Fall back to al if we run out of preferred registers
-                registers[i] = strdupc("al");
+                registers[i] = nccStrdup(MEM_CODEGEN, "al");
             }
             
             // For input operands, handle byte-sized parameters properly
@@ -2077,21 +2742,22 @@ void generateAsmStmt(ASTNode* node) {
             }
         } else {
             // Default to ax for unknown constraints
-            registers[i] = strdupc("ax");
+            registers[i] = nccStrdup(MEM_CODEGEN, "ax");
         }
     }
     
     // Now process the assembly code string, replacing %0, %1, etc.
-    char* asmCode = strdupc(node->asm_stmt.code);
-    char* result = (char*)malloc(strlen(asmCode) * 2); // Allocate double space for substitutions
+    char* asmCode = nccStrdup(MEM_CODEGEN, node->asm_stmt.code);
+    char* result = (char*)nccMalloc(MEM_CODEGEN, strlen(asmCode) * 2); // Allocate double space for substitutions
     if (!result) {
         fprintf(stderr, "Memory allocation failed for assembly code processing\n");
-        free(asmCode);
+        nccFree(asmCode);
         for (int i = 0; i < node->asm_stmt.operand_count; i++) {
-            free(registers[i]);
+            nccFree(registers[i]);
         }
-        free(registers);
-        free(isOutput);
+        nccFree(registers);
+        nccFree(isOutput);
+        emitRestoreLiveRegisters(asmFile, savedRegs);
         return;
     }
     
@@ -2136,6 +2802,11 @@ void generateAsmStmt(ASTNode* node) {
                 if (isParameter(varName)) {
                     fprintf(asmFile, "    mov [bp+%d], %s ; Store output operand %d to parameter %s\n", 
                             -offset, registers[i], i, varName);
+                } else if (isByteLocal(varName) && strlen(registers[i]) == 2 &&
+                           registers[i][1] == 'x') {
+                    // Only the low byte fits in a packed byte local
+                    fprintf(asmFile, "    mov [bp-%d], %cl ; Store output operand %d to byte local variable %s\n", 
+                            offset, registers[i][0], i, varName);
                 } else {
                     fprintf(asmFile, "    mov [bp-%d], %s ; Store output operand %d to local variable %s\n", 
                             offset, registers[i], i, varName);
@@ -2147,12 +2818,14 @@ void generateAsmStmt(ASTNode* node) {
         }
     }
     
+    emitRestoreLiveRegisters(asmFile, savedRegs);
+    
     // Clean up
-    free(asmCode);
-    free(result);
-    free(isOutput);
+    nccFree(asmCode);
+    nccFree(result);
+    nccFree(isOutput);
     for (int i = 0; i < node->asm_stmt.operand_count; i++) {
-        free(registers[i]);
+        nccFree(registers[i]);
     }
-    free(registers);
+    nccFree(registers);
 }
\ No newline at end of file
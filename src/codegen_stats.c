@@ -0,0 +1,466 @@
+#include "codegen_stats.h"
+#include "assembler.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+extern FILE* asmFile;
+
+// Deepest nesting of generators that is attributed
+#define MAX_GENERATOR_DEPTH 256
+
+typedef enum {
+    CAT_MOVE,
+    CAT_ARITHMETIC,
+    CAT_LOGIC,
+    CAT_COMPARE,
+    CAT_BRANCH,
+    CAT_CALL,
+    CAT_STACK,
+    CAT_STRING,
+    CAT_OTHER,
+    CAT_COUNT
+} Category;
+
+static const char* categoryNames[CAT_COUNT] = {
+    "move", "arithmetic", "logic", "compare", "branch", "call", "stack", "string", "other"
+};
+
+typedef struct {
+    unsigned long instructions;
+    unsigned long bytes;
+    unsigned long categories[CAT_COUNT];
+    unsigned long pushes;
+    unsigned long pops;
+    unsigned long pairs;        // Pops that undo an earlier push
+    unsigned long loads;
+    unsigned long stores;
+} Counts;
+
+typedef struct {
+    const char* generator;
+    int nodeType;               // -1 without a node
+    Counts counts;
+} Producer;
+
+typedef struct {
+    long offset;
+    int producer;
+} Transition;
+
+typedef struct {
+    char* name;
+    long start;
+    long end;
+    Counts counts;
+} FunctionStats;
+
+static int enabled = 0;
+static FILE* trackedFile = NULL;
+
+static Producer* producers = NULL;
+static int producerCount = 0;
+static int producerCapacity = 0;
+
+static int stack[MAX_GENERATOR_DEPTH];
+static int depth = 0;
+
+static Transition* transitions = NULL;
+static int transitionCount = 0;
+static int transitionCapacity = 0;
+
+static FunctionStats* functions = NULL;
+static int functionCount = 0;
+static int functionCapacity = 0;
+
+// Grow an array of 'size'-byte elements to hold one more
+static void* reserve(void* array, int count, int* capacity, size_t size) {
+    if (count < *capacity) return array;
+    int grown = *capacity ? *capacity * 2 : 64;
+    void* resized = nccRealloc(MEM_CODEGEN, array, grown * size);
+    if (!resized) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    *capacity = grown;
+    return resized;
+}
+
+static int findProducer(const char* generator, int nodeType) {
+    for (int i = producerCount - 1; i >= 0; i--) {
+        if (producers[i].nodeType == nodeType && strcmp(producers[i].generator, generator) == 0) return i;
+    }
+    producers = (Producer*)reserve(producers, producerCount, &producerCapacity, sizeof(Producer));
+    memset(&producers[producerCount], 0, sizeof(Producer));
+    producers[producerCount].generator = generator;
+    producers[producerCount].nodeType = nodeType;
+    return producerCount++;
+}
+
+// Code from here on belongs to whatever is on top of the stack. Writes
+// to scratch files (dry runs) are not followed.
+static void markTransition() {
+    if (asmFile != trackedFile) return;
+    long offset = ftell(asmFile);
+    int producer = depth > 0 && depth <= MAX_GENERATOR_DEPTH ? stack[depth - 1] : 0;
+    if (transitionCount > 0 && transitions[transitionCount - 1].offset == offset) {
+        transitions[transitionCount - 1].producer = producer;
+        return;
+    }
+    transitions = (Transition*)reserve(transitions, transitionCount, &transitionCapacity, sizeof(Transition));
+    transitions[transitionCount].offset = offset;
+    transitions[transitionCount].producer = producer;
+    transitionCount++;
+}
+
+void beginCodegenStats() {
+    enabled = 1;
+    trackedFile = asmFile;
+    producerCount = 0;
+    transitionCount = 0;
+    functionCount = 0;
+    depth = 0;
+    findProducer("(outside functions)", -1);
+}
+
+int enterCodegen(const char* generator, ASTNode* node) {
+    if (!enabled) return 0;
+    int mark = depth;
+    if (depth < MAX_GENERATOR_DEPTH) {
+        stack[depth] = findProducer(generator, node ? (int)node->type : -1);
+    }
+    depth++;
+    markTransition();
+    return mark;
+}
+
+void leaveCodegen(int mark) {
+    if (!enabled) return;
+    depth = mark;
+    markTransition();
+}
+
+void beginCodegenFunction(ASTNode* func) {
+    if (!enabled || asmFile != trackedFile) return;
+    functions = (FunctionStats*)reserve(functions, functionCount, &functionCapacity, sizeof(FunctionStats));
+    FunctionStats* stats = &functions[functionCount++];
+    memset(stats, 0, sizeof(FunctionStats));
+    stats->name = nccStrdup(MEM_CODEGEN, func->function.func_name);
+    stats->start = ftell(asmFile);
+    stats->end = -1;
+    enterCodegen("generateFunction", func);
+}
+
+void endCodegenFunction() {
+    if (!enabled || functionCount == 0) return;
+    leaveCodegen(0);
+    functions[functionCount - 1].end = ftell(asmFile);
+}
+
+// ---------------------------------------------------------------------
+// Classifying instructions
+
+static int isWordIn(const char* word, const char* const* list) {
+    for (int i = 0; list[i]; i++) {
+        if (strcmp(word, list[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static const char* const moveWords[] = {
+    "mov", "movzx", "movsx", "lea", "xchg", "les", "lds", "lss", "lfs", "lgs",
+    "cbw", "cwd", "cwde", "cdq", "xlat", "lahf", "sahf", NULL
+};
+static const char* const arithmeticWords[] = {
+    "add", "sub", "adc", "sbb", "inc", "dec", "neg", "mul", "imul", "div", "idiv", NULL
+};
+static const char* const logicWords[] = {
+    "and", "or", "xor", "not", "shl", "shr", "sal", "sar", "rol", "ror", "rcl", "rcr", NULL
+};
+static const char* const stackWords[] = {
+    "push", "pop", "pusha", "popa", "pushf", "popf", "pushad", "popad", "enter", "leave", NULL
+};
+static const char* const callWords[] = {
+    "call", "ret", "retf", "retn", "iret", "int", "into", NULL
+};
+static const char* const stringWords[] = {
+    "movsb", "movsw", "stosb", "stosw", "lodsb", "lodsw", "cmpsb", "cmpsw", "scasb", "scasw", NULL
+};
+static const char* const prefixWords[] = {
+    "rep", "repe", "repz", "repne", "repnz", "lock", NULL
+};
+static const char* const registerNames[] = {
+    "ax", "bx", "cx", "dx", "si", "di", "bp", "sp", "al", "ah", "bl", "bh", "cl", "ch", "dl", "dh",
+    "cs", "ds", "es", "ss", "fs", "gs", "eax", "ebx", "ecx", "edx", "esi", "edi", "ebp", "esp", NULL
+};
+static const char* const byteRegisters[] = {
+    "al", "ah", "bl", "bh", "cl", "ch", "dl", "dh", NULL
+};
+
+static Category classify(const char* mnemonic) {
+    if (isWordIn(mnemonic, moveWords)) return CAT_MOVE;
+    if (isWordIn(mnemonic, arithmeticWords)) return CAT_ARITHMETIC;
+    if (isWordIn(mnemonic, logicWords) || strncmp(mnemonic, "set", 3) == 0) return CAT_LOGIC;
+    if (strcmp(mnemonic, "cmp") == 0 || strcmp(mnemonic, "test") == 0) return CAT_COMPARE;
+    if (mnemonic[0] == 'j' || strncmp(mnemonic, "loop", 4) == 0) return CAT_BRANCH;
+    if (isWordIn(mnemonic, callWords)) return CAT_CALL;
+    if (isWordIn(mnemonic, stackWords)) return CAT_STACK;
+    if (isWordIn(mnemonic, stringWords)) return CAT_STRING;
+    return CAT_OTHER;
+}
+
+typedef struct {
+    char mnemonic[16];
+    char operands[2][64];
+    int operandCount;
+} Instruction;
+
+static void trimCopy(char* out, size_t size, const char* start, const char* end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    size_t length = (size_t)(end - start) < size - 1 ? (size_t)(end - start) : size - 1;
+    for (size_t i = 0; i < length; i++) out[i] = (char)tolower((unsigned char)start[i]);
+    out[length] = '\0';
+}
+
+// Parse one line of assembly; returns 0 for lines without an instruction
+static int parseInstruction(const char* line, const char* end, Instruction* insn) {
+    // Drop the comment, outside quotes
+    const char* stop = line;
+    char quote = 0;
+    for (; stop < end; stop++) {
+        if (quote) {
+            if (*stop == quote) quote = 0;
+        } else if (*stop == '\'' || *stop == '"') {
+            quote = *stop;
+        } else if (*stop == ';') {
+            break;
+        }
+    }
+    end = stop;
+
+    const char* p = line;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    if (p == end || *p == '#') return 0;
+
+    // A leading label
+    const char* word = p;
+    while (p < end && (isalnum((unsigned char)*p) || *p == '_' || *p == '.')) p++;
+    if (p < end && *p == ':') {
+        p++;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p == end || *p == '#') return 0;
+        word = p;
+        while (p < end && isalnum((unsigned char)*p)) p++;
+    }
+
+    memset(insn, 0, sizeof(*insn));
+    trimCopy(insn->mnemonic, sizeof(insn->mnemonic), word, p);
+    if (!insn->mnemonic[0]) return 0;
+
+    // rep/lock apply to the instruction after them
+    if (isWordIn(insn->mnemonic, prefixWords)) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        word = p;
+        while (p < end && isalnum((unsigned char)*p)) p++;
+        if (p > word) trimCopy(insn->mnemonic, sizeof(insn->mnemonic), word, p);
+    }
+
+    // Operands, split at commas outside brackets
+    int brackets = 0;
+    const char* operandStart = p;
+    for (const char* q = p; q <= end; q++) {
+        if (q < end && *q == '[') brackets++;
+        if (q < end && *q == ']') brackets--;
+        if (q == end || (*q == ',' && brackets == 0)) {
+            if (insn->operandCount < 2) {
+                trimCopy(insn->operands[insn->operandCount], sizeof(insn->operands[0]), operandStart, q);
+                if (insn->operands[insn->operandCount][0]) insn->operandCount++;
+            }
+            operandStart = q + 1;
+        }
+    }
+    return 1;
+}
+
+static int isMemory(const char* operand) {
+    return strchr(operand, '[') != NULL;
+}
+
+static int isRegister(const char* operand) {
+    return isWordIn(operand, registerNames);
+}
+
+// Rough size of an instruction, for files the built-in assembler cannot lay out
+static int estimateBytes(const Instruction* insn, Category category) {
+    if (category == CAT_BRANCH) return strcmp(insn->mnemonic, "jmp") == 0 ? 3 : 2;
+    if (category == CAT_CALL) return insn->operandCount ? (strcmp(insn->mnemonic, "int") == 0 ? 2 : 3) : 1;
+    if (insn->operandCount == 0) return 1;
+    if (category == CAT_STACK && isRegister(insn->operands[0])) return 1;
+
+    int bytes = 2;
+    for (int i = 0; i < insn->operandCount; i++) {
+        const char* operand = insn->operands[i];
+        if (isMemory(operand)) {
+            if (strpbrk(operand, "+-0123456789_")) bytes += strstr(operand, "bp") ? 1 : 2;
+        } else if (!isRegister(operand)) {
+            bytes += isWordIn(insn->operands[0], byteRegisters) ? 1 : 2;
+        }
+    }
+    return bytes;
+}
+
+static void countInstruction(Counts* counts, const Instruction* insn, Category category, int bytes,
+                             int pairsPop) {
+    counts->instructions++;
+    counts->bytes += bytes;
+    counts->categories[category]++;
+
+    const char* m = insn->mnemonic;
+    if (strcmp(m, "push") == 0) counts->pushes++;
+    if (strcmp(m, "pop") == 0) counts->pops++;
+    if (pairsPop) counts->pairs++;
+
+    // Memory traffic: sources are read; a memory destination is written,
+    // and also read unless the instruction only stores
+    if (strcmp(m, "lea") == 0) return;
+    for (int i = 1; i < insn->operandCount; i++) {
+        if (isMemory(insn->operands[i])) counts->loads++;
+    }
+    if (insn->operandCount > 0 && isMemory(insn->operands[0])) {
+        int storeOnly = strcmp(m, "mov") == 0 || strcmp(m, "pop") == 0 || strncmp(m, "set", 3) == 0;
+        int loadOnly = category == CAT_COMPARE || category == CAT_BRANCH || category == CAT_CALL ||
+                       strcmp(m, "push") == 0 || strcmp(m, "mul") == 0 || strcmp(m, "imul") == 0 ||
+                       strcmp(m, "div") == 0 || strcmp(m, "idiv") == 0;
+        if (!storeOnly) counts->loads++;
+        if (!loadOnly) counts->stores++;
+    }
+    if (strncmp(m, "lods", 4) == 0 || strncmp(m, "cmps", 4) == 0 || strncmp(m, "scas", 4) == 0) counts->loads++;
+    if (strncmp(m, "stos", 4) == 0) counts->stores++;
+    if (strcmp(m, "movsb") == 0 || strcmp(m, "movsw") == 0) {
+        counts->loads++;
+        counts->stores++;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Output
+
+static void writeJsonString(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void writeCounts(FILE* out, const Counts* counts) {
+    fprintf(out, "\"instructions\": %lu, \"bytes\": %lu", counts->instructions, counts->bytes);
+    for (int i = 0; i < CAT_COUNT; i++) {
+        fprintf(out, ", \"%s\": %lu", categoryNames[i], counts->categories[i]);
+    }
+    fprintf(out, ", \"pushes\": %lu, \"pops\": %lu, \"push_pop_pairs\": %lu, \"loads\": %lu, \"stores\": %lu",
+            counts->pushes, counts->pops, counts->pairs, counts->loads, counts->stores);
+}
+
+static int compareProducers(const void* a, const void* b) {
+    const Producer* left = (const Producer*)a;
+    const Producer* right = (const Producer*)b;
+    int order = strcmp(left->generator, right->generator);
+    if (order) return order;
+    return left->nodeType - right->nodeType;
+}
+
+int writeCodegenStats(const char* text, const char* statsPath, const char* sourceFile) {
+    if (!enabled) return 0;
+    enabled = 0;
+
+    long size = (long)strlen(text);
+
+    // Exact sizes from the built-in assembler's layout when it can read
+    // the text, estimates otherwise
+    int* lineSizes = NULL;
+    int lineCount = 0;
+    int exact = measureAssembly(text, &lineSizes, &lineCount) == ASM_OK;
+
+    Counts total;
+    memset(&total, 0, sizeof(total));
+    int transition = 0;
+    int function = 0;
+    int producer = 0;
+    unsigned long pendingPushes = 0;
+    int line = 1;
+    for (const char* p = text; p < text + size; line++) {
+        const char* end = strchr(p, '\n');
+        if (!end) end = text + size;
+        long offset = (long)(p - text);
+
+        while (transition < transitionCount && transitions[transition].offset <= offset) {
+            producer = transitions[transition++].producer;
+        }
+        while (function < functionCount && functions[function].end >= 0 && functions[function].end <= offset) {
+            function++;
+            pendingPushes = 0;
+        }
+        FunctionStats* current = function < functionCount && functions[function].start <= offset ? &functions[function] : NULL;
+
+        Instruction insn;
+        if (parseInstruction(p, end, &insn)) {
+            Category category = classify(insn.mnemonic);
+            int bytes = exact ? (line < lineCount ? lineSizes[line] : 0) : estimateBytes(&insn, category);
+            int pairsPop = 0;
+            if (strcmp(insn.mnemonic, "push") == 0) {
+                pendingPushes++;
+            } else if (strcmp(insn.mnemonic, "pop") == 0 && pendingPushes > 0) {
+                pendingPushes--;
+                pairsPop = 1;
+            }
+            countInstruction(&total, &insn, category, bytes, pairsPop);
+            countInstruction(&producers[producer].counts, &insn, category, bytes, pairsPop);
+            if (current) countInstruction(&current->counts, &insn, category, bytes, pairsPop);
+        }
+        p = end + 1;
+    }
+    nccFree(lineSizes);
+
+    FILE* out = fopen(statsPath, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write codegen statistics %s\n", statsPath);
+        return 1;
+    }
+
+    // One record per line, in a stable order, so runs can be diffed
+    fprintf(out, "{\n\"source\": ");
+    writeJsonString(out, sourceFile);
+    fprintf(out, ",\n\"bytes_exact\": %s,\n\"total\": {", exact ? "true" : "false");
+    writeCounts(out, &total);
+    fprintf(out, "},\n\"functions\": [");
+    for (int i = 0; i < functionCount; i++) {
+        fprintf(out, "%s\n{\"name\": ", i ? "," : "");
+        writeJsonString(out, functions[i].name ? functions[i].name : "");
+        fprintf(out, ", ");
+        writeCounts(out, &functions[i].counts);
+        fprintf(out, "}");
+        nccFree(functions[i].name);
+    }
+    fprintf(out, "\n],\n\"generators\": [");
+    qsort(producers, producerCount, sizeof(Producer), compareProducers);
+    int written = 0;
+    for (int i = 0; i < producerCount; i++) {
+        if (producers[i].counts.instructions == 0) continue;
+        fprintf(out, "%s\n{\"generator\": ", written++ ? "," : "");
+        writeJsonString(out, producers[i].generator);
+        fprintf(out, ", \"node\": ");
+        writeJsonString(out, producers[i].nodeType >= 0 ? getNodeTypeName((NodeType)producers[i].nodeType) : "");
+        fprintf(out, ", ");
+        writeCounts(out, &producers[i].counts);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]\n}\n");
+    functionCount = 0;
+    return fclose(out) != 0;
+}
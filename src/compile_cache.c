@@ -0,0 +1,332 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "compile_cache.h"
+#include "version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 64-bit FNV-1a over each part, with a separator so that moving bytes
+// from one part to the next changes the key
+static unsigned long long hashPart(unsigned long long hash, const char* text) {
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash = (hash ^ *p) * 1099511628211ULL;
+    }
+    return (hash ^ 0xFF) * 1099511628211ULL;
+}
+
+void computeCacheKey(char key[CACHE_KEY_LEN + 1], const char* flags, const char* source) {
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hashPart(hash, compilerBuildId());
+    hash = hashPart(hash, flags);
+    hash = hashPart(hash, source);
+    snprintf(key, CACHE_KEY_LEN + 1, "%016llx", hash);
+}
+
+#ifdef _WIN32
+
+int cacheLookup(const char* cacheDir, const char* key, const char* outputFile) {
+    return 0;
+}
+
+int cacheLoadFunction(const char* cacheDir, const char* key, char** data, size_t* size) {
+    return 0;
+}
+
+void cacheSaveFunction(const char* cacheDir, const char* key, const char* data, size_t size) {
+}
+
+void cacheStore(const char* cacheDir, const char* key, const char* outputFile, unsigned long maxBytes) {
+}
+
+void printCacheStats(const char* cacheDir, unsigned long maxBytes) {
+    fprintf(stderr, "Error: The compile cache is not available in this build\n");
+}
+
+#else
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Layout of a cache directory: one file per entry, named by its key, and
+// a 'stats' file holding the running lookup counts as one line of text.
+// The counts are updated under a lock, so concurrent compilers never lose
+// one, and the file stays a few bytes however many lookups there are.
+// Whole compiles and single functions share the directory and its size
+// bound. Entries are written to a temporary name and renamed into place;
+// a hit touches the entry, so its modification time orders the entries
+// for eviction.
+#define STATS_FILE "stats"
+
+typedef enum {
+    STATS_HIT,
+    STATS_MISS,
+    STATS_FUNCTION_HIT,
+    STATS_FUNCTION_MISS,
+    STATS_COUNT
+} StatsCounter;
+
+// Eviction trims the directory to this share of its bound, so it does
+// not run again on the very next store
+#define EVICT_TARGET_PERCENT 90
+
+static int entryPath(char* path, size_t size, const char* cacheDir, const char* name) {
+    return snprintf(path, size, "%s/%s", cacheDir, name) < (int)size;
+}
+
+// Parse the counts in a stats file
+static void parseStats(const char* text, unsigned long counts[STATS_COUNT]) {
+    memset(counts, 0, STATS_COUNT * sizeof(unsigned long));
+    if (sscanf(text, "%lu %lu %lu %lu", &counts[STATS_HIT], &counts[STATS_MISS],
+               &counts[STATS_FUNCTION_HIT], &counts[STATS_FUNCTION_MISS]) != STATS_COUNT) {
+        memset(counts, 0, STATS_COUNT * sizeof(unsigned long));
+    }
+}
+
+// Read a whole small file into a new NUL-terminated buffer
+static char* readStatsFile(int fd) {
+    struct stat info;
+    if (fstat(fd, &info) != 0) return NULL;
+    char* text = (char*)malloc((size_t)info.st_size + 1);
+    if (!text) return NULL;
+    ssize_t got = pread(fd, text, (size_t)info.st_size, 0);
+    text[got > 0 ? got : 0] = '\0';
+    return text;
+}
+
+// Wait for a lock on the whole stats file
+static int lockStats(int fd, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    return fcntl(fd, F_SETLKW, &lock) == 0;
+}
+
+static void countLookup(const char* cacheDir, StatsCounter counter) {
+    char path[4096];
+    if (!entryPath(path, sizeof(path), cacheDir, STATS_FILE)) return;
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) return;
+
+    if (!lockStats(fd, F_WRLCK)) {
+        close(fd);
+        return;
+    }
+
+    unsigned long counts[STATS_COUNT];
+    char* text = readStatsFile(fd);
+    parseStats(text ? text : "", counts);
+    free(text);
+    counts[counter]++;
+
+    char line[128];
+    int length = snprintf(line, sizeof(line), "%lu %lu %lu %lu\n", counts[STATS_HIT], counts[STATS_MISS],
+                          counts[STATS_FUNCTION_HIT], counts[STATS_FUNCTION_MISS]);
+    if (ftruncate(fd, 0) == 0) {
+        ssize_t written = pwrite(fd, line, (size_t)length, 0);
+        (void)written;
+    }
+    // Closing the file releases the lock
+    close(fd);
+}
+
+static int copyFile(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (!in) return 0;
+    FILE* out = fopen(to, "wb");
+    if (!out) {
+        fclose(in);
+        return 0;
+    }
+
+    char buffer[8192];
+    size_t got;
+    int ok = 1;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, got, out) != got) {
+            ok = 0;
+            break;
+        }
+    }
+    if (ferror(in)) ok = 0;
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    return ok;
+}
+
+int cacheLookup(const char* cacheDir, const char* key, const char* outputFile) {
+    char path[4096];
+    if (!entryPath(path, sizeof(path), cacheDir, key)) return 0;
+    if (mkdir(cacheDir, 0777) != 0 && errno != EEXIST) return 0;
+
+    int hit = access(path, R_OK) == 0 && copyFile(path, outputFile);
+    if (hit) {
+        // Mark the entry as recently used
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+    countLookup(cacheDir, hit ? STATS_HIT : STATS_MISS);
+    return hit;
+}
+
+int cacheLoadFunction(const char* cacheDir, const char* key, char** data, size_t* size) {
+    char path[4096];
+    *data = NULL;
+    if (!entryPath(path, sizeof(path), cacheDir, key)) return 0;
+
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        *data = length >= 0 ? (char*)malloc(length + 1) : NULL;
+        if (*data && fread(*data, 1, length, file) == (size_t)length) {
+            (*data)[length] = '\0';
+            *size = (size_t)length;
+            utimensat(AT_FDCWD, path, NULL, 0);
+        } else {
+            free(*data);
+            *data = NULL;
+        }
+        fclose(file);
+    }
+    countLookup(cacheDir, *data ? STATS_FUNCTION_HIT : STATS_FUNCTION_MISS);
+    return *data != NULL;
+}
+
+void cacheSaveFunction(const char* cacheDir, const char* key, const char* data, size_t size) {
+    char path[4096];
+    char temp[4096];
+    if (!entryPath(path, sizeof(path), cacheDir, key)) return;
+    if (snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(temp)) return;
+
+    FILE* out = fopen(temp, "wb");
+    if (!out) return;
+    int ok = fwrite(data, 1, size, out) == size;
+    if (fclose(out) != 0) ok = 0;
+    if (!ok || rename(temp, path) != 0) unlink(temp);
+}
+
+static int isEntryName(const char* name) {
+    if (strlen(name) != CACHE_KEY_LEN) return 0;
+    for (int i = 0; i < CACHE_KEY_LEN; i++) {
+        if (!strchr("0123456789abcdef", name[i])) return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    char name[CACHE_KEY_LEN + 1];
+    struct timespec lastUse;
+    unsigned long size;
+} CacheEntry;
+
+static int compareLastUse(const void* a, const void* b) {
+    const CacheEntry* left = (const CacheEntry*)a;
+    const CacheEntry* right = (const CacheEntry*)b;
+    if (left->lastUse.tv_sec != right->lastUse.tv_sec) return left->lastUse.tv_sec < right->lastUse.tv_sec ? -1 : 1;
+    if (left->lastUse.tv_nsec != right->lastUse.tv_nsec) return left->lastUse.tv_nsec < right->lastUse.tv_nsec ? -1 : 1;
+    return strcmp(left->name, right->name);
+}
+
+// List the entries of a cache directory; the caller frees the list
+static CacheEntry* listEntries(const char* cacheDir, int* count, unsigned long* totalSize) {
+    *count = 0;
+    *totalSize = 0;
+    DIR* dir = opendir(cacheDir);
+    if (!dir) return NULL;
+
+    int capacity = 0;
+    CacheEntry* entries = NULL;
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        char path[4096];
+        struct stat info;
+        if (!isEntryName(item->d_name) || !entryPath(path, sizeof(path), cacheDir, item->d_name)) continue;
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) continue;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry* grown = (CacheEntry*)realloc(entries, capacity * sizeof(CacheEntry));
+            if (!grown) break;
+            entries = grown;
+        }
+        strcpy(entries[*count].name, item->d_name);
+        entries[*count].lastUse = info.st_mtim;
+        entries[*count].size = (unsigned long)info.st_size;
+        *totalSize += entries[*count].size;
+        (*count)++;
+    }
+    closedir(dir);
+    return entries;
+}
+
+static void evictEntries(const char* cacheDir, unsigned long maxBytes) {
+    int count;
+    unsigned long totalSize;
+    CacheEntry* entries = listEntries(cacheDir, &count, &totalSize);
+    if (totalSize > maxBytes) {
+        unsigned long target = maxBytes / 100 * EVICT_TARGET_PERCENT;
+        qsort(entries, count, sizeof(CacheEntry), compareLastUse);
+        for (int i = 0; i < count && totalSize > target; i++) {
+            char path[4096];
+            // Another compiler may have removed it already
+            if (entryPath(path, sizeof(path), cacheDir, entries[i].name) && unlink(path) == 0) {
+                totalSize -= entries[i].size;
+            }
+        }
+    }
+    free(entries);
+}
+
+void cacheStore(const char* cacheDir, const char* key, const char* outputFile, unsigned long maxBytes) {
+    char path[4096];
+    char temp[4096];
+    if (!entryPath(path, sizeof(path), cacheDir, key)) return;
+    if (snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(temp)) return;
+
+    if (mkdir(cacheDir, 0777) != 0 && errno != EEXIST) return;
+    if (!copyFile(outputFile, temp) || rename(temp, path) != 0) {
+        unlink(temp);
+        return;
+    }
+    evictEntries(cacheDir, maxBytes);
+}
+
+void printCacheStats(const char* cacheDir, unsigned long maxBytes) {
+    unsigned long counts[STATS_COUNT];
+    char path[4096];
+    int fd = entryPath(path, sizeof(path), cacheDir, STATS_FILE) ? open(path, O_RDONLY) : -1;
+    char* text = fd >= 0 && lockStats(fd, F_RDLCK) ? readStatsFile(fd) : NULL;
+    parseStats(text ? text : "", counts);
+    free(text);
+    if (fd >= 0) close(fd);
+    unsigned long hits = counts[STATS_HIT];
+    unsigned long misses = counts[STATS_MISS];
+    unsigned long functionHits = counts[STATS_FUNCTION_HIT];
+    unsigned long functionMisses = counts[STATS_FUNCTION_MISS];
+
+    int count;
+    unsigned long totalSize;
+    CacheEntry* entries = listEntries(cacheDir, &count, &totalSize);
+    free(entries);
+
+    printf("Compile cache %s:\n", cacheDir);
+    printf("  - Hits: %lu\n", hits);
+    printf("  - Misses: %lu\n", misses);
+    if (hits + misses > 0) {
+        printf("  - Hit rate: %lu%%\n", hits * 100 / (hits + misses));
+    }
+    if (functionHits + functionMisses > 0) {
+        printf("  - Functions reused: %lu of %lu\n", functionHits, functionHits + functionMisses);
+    }
+    printf("  - Entries: %d\n", count);
+    printf("  - Size: %lu of %lu KB\n", (totalSize + 1023) / 1024, maxBytes / 1024);
+}
+
+#endif
@@ -0,0 +1,412 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "compile_server.h"
+#include "preprocessor.h"
+#include "error_manager.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+int runCompileServer(const char* socketPath, const char* programName, CompilerDriver driver) {
+    fprintf(stderr, "Error: --server needs Unix domain sockets, which this build does not have\n");
+    return 1;
+}
+
+int runCompileClient(const char* socketPath, int argc, char* argv[], int* status) {
+    return 0;
+}
+
+#else
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// Protocol. The client sends its working directory, then one entry per
+// forwarded environment variable ("NAME=value", or "NAME" when it is
+// unset) in the order of forwardedVariables, then each argument, every
+// one terminated by a NUL, and shuts down its side. The server answers
+// with frames of a type byte, a 4-byte little-endian length and the
+// data: 'o' for stdout, 'e' for stderr and finally 'x' with the 4-byte
+// exit status.
+#define FRAME_STDOUT 'o'
+#define FRAME_STDERR 'e'
+#define FRAME_EXIT   'x'
+
+// The environment a compile reads, which must be the client's rather
+// than the server's: the temporary directory for nas and -j, the default
+// -cache directory and the default -fmem-limit
+static const char* forwardedVariables[] = { "TMPDIR", "NCC_CACHE_DIR", "NCC_MEM_LIMIT" };
+#define FORWARDED_COUNT (int)(sizeof(forwardedVariables) / sizeof(forwardedVariables[0]))
+
+#define MAX_REQUEST_SIZE (1 << 20)
+
+static const char* serverSocketPath = NULL;
+static pid_t serverPid = 0;     // Forked handlers and workers must leave the socket alone
+
+static int writeAll(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        p += written;
+        length -= written;
+    }
+    return 1;
+}
+
+static int readAll(int fd, void* data, size_t length) {
+    char* p = (char*)data;
+    while (length > 0) {
+        ssize_t got = read(fd, p, length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        p += got;
+        length -= got;
+    }
+    return 1;
+}
+
+static int sendFrame(int fd, char type, const void* data, unsigned int length) {
+    unsigned char header[5];
+    header[0] = (unsigned char)type;
+    for (int i = 0; i < 4; i++) {
+        header[1 + i] = (length >> (8 * i)) & 0xFF;
+    }
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, data, length);
+}
+
+static void sendStatus(int fd, int status) {
+    unsigned char data[4];
+    for (int i = 0; i < 4; i++) {
+        data[i] = ((unsigned int)status >> (8 * i)) & 0xFF;
+    }
+    sendFrame(fd, FRAME_EXIT, data, sizeof(data));
+}
+
+// Send what a worker wrote to one of its log files
+static void sendLog(int fd, char type, FILE* log) {
+    if (!log) return;
+    char buffer[4096];
+    size_t got;
+    rewind(log);
+    while ((got = fread(buffer, 1, sizeof(buffer), log)) > 0) {
+        if (!sendFrame(fd, type, buffer, (unsigned int)got)) break;
+    }
+    fclose(log);
+}
+
+static void sendError(int fd, const char* message) {
+    sendFrame(fd, FRAME_STDERR, message, (unsigned int)strlen(message));
+    sendStatus(fd, 1);
+}
+
+static int openSocket(const char* socketPath, struct sockaddr_un* address) {
+    if (strlen(socketPath) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Error: Socket path %s is too long\n", socketPath);
+        return -1;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socketPath);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+static void removeSocket() {
+    if (serverSocketPath && getpid() == serverPid) unlink(serverSocketPath);
+}
+
+static void stopServer(int signalNumber) {
+    removeSocket();
+    _exit(0);
+}
+
+// Read a whole request; the buffer ends with a NUL
+static char* readRequest(int fd, size_t* length) {
+    size_t capacity = 4096;
+    size_t used = 0;
+    char* buffer = (char*)malloc(capacity);
+    while (buffer) {
+        if (used == capacity) {
+            if (capacity >= MAX_REQUEST_SIZE) break;
+            capacity *= 2;
+            char* grown = (char*)realloc(buffer, capacity);
+            if (!grown) break;
+            buffer = grown;
+        }
+        ssize_t got = read(fd, buffer + used, capacity - used);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) break;
+        if (got == 0) {
+            if (used == 0 || buffer[used - 1] != '\0') break;
+            *length = used;
+            return buffer;
+        }
+        used += got;
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Whether argv[i] names a source file rather than an option or its value
+static int isSourceArgument(int i, char* argv[]) {
+    if (argv[i][0] == '-' || argv[i][0] == '@') return 0;
+    if (strcmp(argv[i - 1], "-o") == 0 || strcmp(argv[i - 1], "-x") == 0 || strcmp(argv[i - 1], "-include-pch") == 0 ||
+        strcmp(argv[i - 1], "-MF") == 0 || strcmp(argv[i - 1], "-MT") == 0) return 0;
+
+    struct stat info;
+    return stat(argv[i], &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Read the headers of the request's source files into this process's
+// cache, and follow their directives so the cache also holds what each
+// header does to the macros, so that every later worker forked from it
+// starts warm
+static void warmCache(int argc, char* argv[]) {
+    int usesPch = 0;
+    initPreprocessor();
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-I", 2) == 0) {
+            if (argv[i][2]) addIncludePath(argv[i] + 2);
+            else if (i + 1 < argc) addIncludePath(argv[++i]);
+        } else if (strcmp(argv[i], "-include-pch") == 0) {
+            usesPch = 1;
+        }
+    }
+    addIncludePath(".");
+
+    for (int i = 1; i < argc; i++) {
+        if (isSourceArgument(i, argv)) preloadIncludes(argv[i]);
+    }
+
+    // A precompiled header changes the macros the headers see, and the
+    // worker would not find the effects recorded without it
+    if (usesPch) return;
+
+    // Start each source from the state compileSource gives it
+    setDirectivesOnly(1);
+    suppressDiagnostics(1);
+    for (int i = 1; i < argc; i++) {
+        if (!isSourceArgument(i, argv)) continue;
+        initPreprocessor();
+        addIncludePath(".");
+        nccFree(preprocessFile(argv[i]));
+    }
+    suppressDiagnostics(0);
+    setDirectivesOnly(0);
+}
+
+// Whether a request field is the entry for forwarded variable i
+static int isForwardedEntry(int i, const char* entry) {
+    size_t length = strlen(forwardedVariables[i]);
+    return strncmp(entry, forwardedVariables[i], length) == 0 && (entry[length] == '=' || entry[length] == '\0');
+}
+
+// Take on the client's value of each forwarded variable. 'entries' has
+// FORWARDED_COUNT strings from the request.
+static void applyClientEnvironment(char* entries[]) {
+    for (int i = 0; i < FORWARDED_COUNT; i++) {
+        char* value = strchr(entries[i], '=');
+        if (value) {
+            *value = '\0';
+            setenv(entries[i], value + 1, 1);
+        } else {
+            unsetenv(entries[i]);
+        }
+    }
+}
+
+// Run one request in a worker and send back its output and exit status
+static void handleRequest(int connection, int argc, char* argv[], char* environment[], CompilerDriver driver) {
+    signal(SIGCHLD, SIG_DFL);
+    applyClientEnvironment(environment);
+
+    FILE* out = tmpfile();
+    FILE* err = tmpfile();
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t worker = fork();
+    if (worker == 0) {
+        close(connection);
+        if (out) dup2(fileno(out), STDOUT_FILENO);
+        if (err) dup2(fileno(err), STDERR_FILENO);
+        exit(driver(argc, argv));
+    }
+
+    int status = 1;
+    int raw = 0;
+    if (worker > 0 && waitpid(worker, &raw, 0) == worker && WIFEXITED(raw)) {
+        status = WEXITSTATUS(raw);
+    }
+
+    sendLog(connection, FRAME_STDOUT, out);
+    sendLog(connection, FRAME_STDERR, err);
+    sendStatus(connection, status);
+}
+
+int runCompileServer(const char* socketPath, const char* programName, CompilerDriver driver) {
+    struct sockaddr_un address;
+    int listener = openSocket(socketPath, &address);
+    if (listener < 0) {
+        fprintf(stderr, "Error: Could not create a socket for the compile server\n");
+        return 1;
+    }
+
+    unlink(socketPath);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        fprintf(stderr, "Error: Could not listen on %s\n", socketPath);
+        close(listener);
+        return 1;
+    }
+
+    serverSocketPath = socketPath;
+    serverPid = getpid();
+    atexit(removeSocket);
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGCHLD, SIG_IGN);   // Request handlers are never waited for
+    signal(SIGPIPE, SIG_IGN);   // A client that went away must not stop the server
+
+    setFileCacheValidation(1);
+    setHeaderEffectCache(1);
+    printf("NCC compile server listening on %s\n", socketPath);
+    fflush(stdout);
+
+    for (;;) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            if (errno != EINTR) perror("accept");
+            continue;
+        }
+
+        size_t length = 0;
+        char* request = readRequest(connection, &length);
+        if (!request) {
+            close(connection);
+            continue;
+        }
+
+        // Working directory, the environment, then the arguments; argv[0]
+        // is our own name
+        int fields = 0;
+        for (size_t i = 0; i < length; i += strlen(request + i) + 1) {
+            fields++;
+        }
+        char** argv = (char**)malloc((fields + 1) * sizeof(char*));
+        char* environment[FORWARDED_COUNT];
+        if (!argv) {
+            fprintf(stderr, "Error: Out of memory in compile server\n");
+            exit(1);
+        }
+        argv[0] = (char*)programName;
+        int argc = 1;
+        int field = 0;
+        int wellFormed = 1;
+        for (size_t i = 0; i < length; i += strlen(request + i) + 1, field++) {
+            if (field == 0) continue;
+            if (field <= FORWARDED_COUNT) {
+                environment[field - 1] = request + i;
+                wellFormed = wellFormed && isForwardedEntry(field - 1, request + i);
+            } else {
+                argv[argc++] = request + i;
+            }
+        }
+        argv[argc] = NULL;
+
+        if (!wellFormed || field <= FORWARDED_COUNT) {
+            sendError(connection, "Error: Compile server got a request from a different version of ncc\n");
+        } else if (chdir(request) != 0) {
+            sendError(connection, "Error: Compile server cannot enter the client's working directory\n");
+        } else {
+            warmCache(argc, argv);
+
+            pid_t handler = fork();
+            if (handler == 0) {
+                close(listener);
+                handleRequest(connection, argc, argv, environment, driver);
+                _exit(0);
+            }
+            if (handler < 0) {
+                sendError(connection, "Error: Compile server could not start a worker\n");
+            }
+        }
+
+        close(connection);
+        free(argv);
+        free(request);
+    }
+}
+
+int runCompileClient(const char* socketPath, int argc, char* argv[], int* status) {
+    struct sockaddr_un address;
+    int fd = openSocket(socketPath, &address);
+    if (fd < 0) return 0;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return 0;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        close(fd);
+        return 0;
+    }
+
+    int sent = writeAll(fd, cwd, strlen(cwd) + 1);
+    for (int i = 0; sent && i < FORWARDED_COUNT; i++) {
+        const char* value = getenv(forwardedVariables[i]);
+        sent = writeAll(fd, forwardedVariables[i], strlen(forwardedVariables[i])) &&
+               (!value || (writeAll(fd, "=", 1) && writeAll(fd, value, strlen(value)))) &&
+               writeAll(fd, "", 1);
+    }
+    for (int i = 0; sent && i < argc; i++) {
+        sent = writeAll(fd, argv[i], strlen(argv[i]) + 1);
+    }
+    shutdown(fd, SHUT_WR);
+
+    // Relay output until the exit status arrives
+    int gotStatus = 0;
+    unsigned char header[5];
+    while (!gotStatus && readAll(fd, header, sizeof(header))) {
+        unsigned int length = header[1] | (header[2] << 8) | (header[3] << 16) | ((unsigned int)header[4] << 24);
+        char buffer[4096];
+        unsigned char code[4] = {0, 0, 0, 0};
+
+        if (header[0] == FRAME_EXIT) {
+            if (length != sizeof(code) || !readAll(fd, code, sizeof(code))) break;
+            *status = code[0] | (code[1] << 8) | (code[2] << 16) | (code[3] << 24);
+            gotStatus = 1;
+            break;
+        }
+
+        FILE* stream = header[0] == FRAME_STDERR ? stderr : stdout;
+        while (length > 0) {
+            unsigned int chunk = length < sizeof(buffer) ? length : (unsigned int)sizeof(buffer);
+            if (!readAll(fd, buffer, chunk)) break;
+            fwrite(buffer, 1, chunk, stream);
+            length -= chunk;
+        }
+        if (length > 0) break;
+    }
+    close(fd);
+
+    if (!gotStatus) {
+        fprintf(stderr, "Error: Compile server at %s did not finish the request\n", socketPath);
+        *status = 1;
+    }
+    return 1;
+}
+
+#endif
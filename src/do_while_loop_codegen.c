@@ -1,5 +1,7 @@
 #include "codegen.h"
 #include "ast.h"
+#include "mem_report.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,8 +15,16 @@ extern void generateBlock(ASTNode* node);
 extern void pushLoopContext(const char* continueLabel, const char* breakLabel);
 extern void popLoopContext();
 
-// Generate code for a do-while loop
+static void emitDoWhileLoop(ASTNode* node);
+
 void generateDoWhileLoop(ASTNode* node) {
+    int mark = enterCodegen("generateDoWhileLoop", node);
+    emitDoWhileLoop(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a do-while loop
+static void emitDoWhileLoop(ASTNode* node) {
     if (!node || node->type != NODE_DO_WHILE) return;
     
     // Generate labels for loop body start, condition check and end
@@ -58,7 +68,7 @@ void generateDoWhileLoop(ASTNode* node) {
     popLoopContext();
     
     // Free the allocated labels
-    free(bodyLabel);
-    free(condLabel);
-    free(endLabel);
+    nccFree(bodyLabel);
+    nccFree(condLabel);
+    nccFree(endLabel);
 }
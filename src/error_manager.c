@@ -11,6 +11,7 @@ static int errorCount = 0;
 static int warningCount = 0;
 static int maxErrors = 20;
 static int quietMode = 0;
+static int diagnosticsSuppressed = 0;
 
 // ANSI color codes for terminal output
 #define COLOR_RED     "\033[1;31m"
@@ -115,7 +116,7 @@ static void printCodeSnippet(const char* buffer, int position) {
 
 // Report an error
 void reportError(int position, const char* format, ...) {
-    if (errorCount >= maxErrors) {
+    if (diagnosticsSuppressed || errorCount >= maxErrors) {
         return;
     }
 
@@ -148,6 +149,8 @@ void reportError(int position, const char* format, ...) {
 
 // Report a warning
 void reportWarning(int position, const char* format, ...) {
+    if (diagnosticsSuppressed) return;
+    
     warningCount++;
     
     fprintf(stderr, "%swarning:%s ", COLOR_YELLOW, COLOR_RESET);
@@ -172,7 +175,7 @@ void reportWarning(int position, const char* format, ...) {
 
 // Report a note (additional information)
 void reportNote(int position, const char* format, ...) {
-    if (quietMode) return;
+    if (quietMode || diagnosticsSuppressed) return;
     
     fprintf(stderr, "%snote:%s ", COLOR_BLUE, COLOR_RESET);
     
@@ -208,3 +211,8 @@ int getWarningCount() {
 void setMaxErrors(int max) {
     maxErrors = max;
 }
+
+// Temporarily silence diagnostics (used while dry-running code generation)
+void suppressDiagnostics(int suppress) {
+    diagnosticsSuppressed = suppress;
+}
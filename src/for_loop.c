@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "lexer.h"
 #include "ast.h"
+#include "symbol_table.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,8 +22,11 @@ ASTNode* parseForStatement() {
     // Expect opening parenthesis
     expect(TOKEN_LPAREN);
     
+    // A declaration in the init part is visible to the loop only
+    int scope = beginSymbolScope();
+    
     // Parse initialization part: can be either a declaration or an expression
-    if (tokenIs(TOKEN_INT) || tokenIs(TOKEN_SHORT) || tokenIs(TOKEN_CHAR) || 
+    if (tokenIs(TOKEN_INT) || tokenIs(TOKEN_SHORT) || tokenIs(TOKEN_LONG) || tokenIs(TOKEN_CHAR) || 
         tokenIs(TOKEN_VOID) || tokenIs(TOKEN_UNSIGNED)) {
         // This is a declaration
         node->for_loop.init = parseDeclaration();
@@ -68,6 +72,7 @@ ASTNode* parseForStatement() {
     
     // Parse the loop body
     node->for_loop.body = parseStatement();
+    endSymbolScope(scope);
     
     return node;
 }
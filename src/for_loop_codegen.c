@@ -1,5 +1,7 @@
 #include "codegen.h"
 #include "ast.h"
+#include "mem_report.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,9 +15,19 @@ extern void generateExpression(ASTNode* node);
 extern void generateBlock(ASTNode* node);
 extern void pushLoopContext(const char* continueLabel, const char* breakLabel);
 extern void popLoopContext();
+extern int beginLocalScope();
+extern void endLocalScope(int mark);
+
+static void emitForLoop(ASTNode* node);
 
-// Generate code for a for loop
 void generateForLoop(ASTNode* node) {
+    int mark = enterCodegen("generateForLoop", node);
+    emitForLoop(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a for loop
+static void emitForLoop(ASTNode* node) {
     if (!node || node->type != NODE_FOR) return;
     
     fprintf(asmFile, "    ; For loop\n");
@@ -26,6 +38,9 @@ void generateForLoop(ASTNode* node) {
     char* updateLabel = generateLabel("for_update");
     char* endLabel = generateLabel("for_end");
     
+    // A declaration in the initializer is scoped to the loop
+    int scope = beginLocalScope();
+    
     // Generate initialization code
     if (node->for_loop.init) {
         fprintf(asmFile, "    ; For loop initialization\n");
@@ -76,10 +91,11 @@ void generateForLoop(ASTNode* node) {
     
     // Pop loop context
     popLoopContext();
+    endLocalScope(scope);
     
     // Free the labels
-    free(startLabel);
-    free(condLabel);
-    free(updateLabel);
-    free(endLabel);
+    nccFree(startLabel);
+    nccFree(condLabel);
+    nccFree(updateLabel);
+    nccFree(endLabel);
 }
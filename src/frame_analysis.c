@@ -0,0 +1,439 @@
+#include "frame_analysis.h"
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// Frame omission statistics
+static int framelessFunctionCount = 0;
+static int framelessBytesSaved = 0;
+
+// Check if an assembly word matches a register or mnemonic we care about
+static int asmWordIs(const char* start, int len, const char* word) {
+    return (int)strlen(word) == len && strncmp(start, word, len) == 0;
+}
+
+// Scan inline assembly text. Anything that names bp/sp keeps the frame;
+// pushes and pops are tallied so unbalanced asm can be caught afterwards.
+static void analyzeAsmText(const char* code, FrameAnalysis* analysis) {
+    if (!code) return;
+
+    const char* p = code;
+
+    while (*p) {
+        // Skip comments up to the end of the line
+        if (*p == ';') {
+            while (*p && *p != '\n') p++;
+            continue;
+        }
+
+        if (isalpha((unsigned char)*p) || *p == '_') {
+            const char* start = p;
+            while (isalnum((unsigned char)*p) || *p == '_') p++;
+            int len = (int)(p - start);
+
+            if (asmWordIs(start, len, "bp") || asmWordIs(start, len, "ebp") ||
+                asmWordIs(start, len, "sp") || asmWordIs(start, len, "esp") ||
+                asmWordIs(start, len, "enter") || asmWordIs(start, len, "leave")) {
+                analysis->asmUsesFrame = 1;
+            } else if (asmWordIs(start, len, "push") || asmWordIs(start, len, "pusha") ||
+                       asmWordIs(start, len, "pushf")) {
+                analysis->asmStackBalance++;
+            } else if (asmWordIs(start, len, "pop") || asmWordIs(start, len, "popa") ||
+                       asmWordIs(start, len, "popf")) {
+                analysis->asmStackBalance--;
+            }
+            continue;
+        }
+        p++;
+    }
+}
+
+// Pushes minus pops in one piece of inline assembly
+int asmStackDelta(const char* code) {
+    FrameAnalysis scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    analyzeAsmText(code, &scratch);
+    return scratch.asmStackBalance;
+}
+
+// Walk a node (and its siblings) looking for anything that needs bp
+static void analyzeFrameNode(ASTNode* node, FrameAnalysis* analysis) {
+    while (node) {
+        switch (node->type) {
+            case NODE_DECLARATION:
+                analysis->hasLocals = 1;
+                analyzeFrameNode(node->declaration.initializer, analysis);
+                break;
+            case NODE_CALL:
+                analysis->hasCalls = 1;
+                analyzeFrameNode(node->call.args, analysis);
+                break;
+            case NODE_ASM_BLOCK:
+                analysis->hasAsm = 1;
+                analyzeAsmText(node->asm_block.code, analysis);
+                break;
+            case NODE_ASM:
+                analysis->hasAsm = 1;
+                analyzeAsmText(node->asm_stmt.code, analysis);
+                for (int i = 0; i < node->asm_stmt.operand_count; i++) {
+                    analyzeFrameNode(node->asm_stmt.operands[i], analysis);
+                }
+                break;
+            case NODE_RETURN:
+                analyzeFrameNode(node->return_stmt.expr, analysis);
+                break;
+            case NODE_FOR:
+                analyzeFrameNode(node->for_loop.init, analysis);
+                analyzeFrameNode(node->for_loop.condition, analysis);
+                analyzeFrameNode(node->for_loop.update, analysis);
+                analyzeFrameNode(node->for_loop.body, analysis);
+                break;
+            case NODE_WHILE:
+                analyzeFrameNode(node->while_loop.condition, analysis);
+                analyzeFrameNode(node->while_loop.body, analysis);
+                break;
+            case NODE_DO_WHILE:
+                analyzeFrameNode(node->do_while_loop.condition, analysis);
+                analyzeFrameNode(node->do_while_loop.body, analysis);
+                break;
+            case NODE_SWITCH:
+                analyzeFrameNode(node->switch_stmt.condition, analysis);
+                analyzeFrameNode(node->switch_stmt.body, analysis);
+                break;
+            case NODE_IF:
+                analyzeFrameNode(node->if_stmt.condition, analysis);
+                analyzeFrameNode(node->if_stmt.if_body, analysis);
+                analyzeFrameNode(node->if_stmt.else_body, analysis);
+                break;
+            case NODE_TERNARY:
+                analyzeFrameNode(node->ternary.condition, analysis);
+                analyzeFrameNode(node->ternary.true_expr, analysis);
+                analyzeFrameNode(node->ternary.false_expr, analysis);
+                break;
+            default:
+                analyzeFrameNode(node->left, analysis);
+                analyzeFrameNode(node->right, analysis);
+                break;
+        }
+        node = node->next;
+    }
+}
+
+// Analyze a function definition and decide whether it needs a frame pointer
+void analyzeFunctionFrame(ASTNode* func, FrameAnalysis* analysis) {
+    memset(analysis, 0, sizeof(FrameAnalysis));
+    analysis->needsFramePointer = 1;
+    if (!func || func->type != NODE_FUNCTION) return;
+
+    analysis->hasParams = func->function.params != NULL || func->function.info.is_variadic;
+    analyzeFrameNode(func->function.body, analysis);
+
+    // Pushes left on the stack by inline asm are only undone by mov sp, bp
+    if (analysis->asmStackBalance != 0) {
+        analysis->asmUsesFrame = 1;
+    }
+
+    // Calls don't need bp: arguments are pushed and popped around the call
+    analysis->needsFramePointer = analysis->hasParams || analysis->hasLocals ||
+                                  analysis->asmUsesFrame ||
+                                  func->function.info.is_stackframe;
+}
+
+// Bytes of element storage a local array occupies
+int getArrayStorageSize(ASTNode* decl) {
+    TypeInfo* type = &decl->declaration.type_info;
+    
+    // Same element widths the array data writer and indexing code use
+    int elementSize = 2;
+    if (!type->is_pointer && (type->type == TYPE_CHAR || 
+        type->type == TYPE_UNSIGNED_CHAR || type->type == TYPE_BOOL)) {
+        elementSize = 1;
+    }
+    return type->array_size * elementSize;
+}
+
+// Size in bytes of the stack slot a local declaration needs
+int getLocalSlotSize(ASTNode* decl) {
+    TypeInfo* type = &decl->declaration.type_info;
+    
+    // Stack arrays get their storage plus the pointer slot the name decays to;
+    // static arrays live in the data section and only need the pointer
+    if (type->is_array && !type->is_static && type->array_size > 0) {
+        return 2 + ((getArrayStorageSize(decl) + 1) & ~1);
+    }
+    if (type->is_array || type->is_pointer) return 2;
+    
+    switch (type->type) {
+        case TYPE_CHAR:
+        case TYPE_UNSIGNED_CHAR:
+        case TYPE_BOOL:
+            return 1;
+        case TYPE_LONG:
+        case TYPE_UNSIGNED_LONG:
+        case TYPE_FAR_POINTER:
+            return 4;
+        case TYPE_STRUCT:
+            if (type->struct_info) {
+                return (type->struct_info->size + 1) & ~1;
+            }
+            return 2;
+        default:
+            return 2;
+    }
+}
+
+static int layoutScope(ASTNode* statements, int base);
+
+// Lay out the scopes nested inside a statement, starting at 'base'
+static int layoutNestedScopes(ASTNode* stmt, int base) {
+    switch (stmt->type) {
+        case NODE_BLOCK:
+            return layoutScope(stmt->left, base);
+        case NODE_FOR: {
+            // The init declaration lives as long as the loop body
+            int end = base;
+            if (stmt->for_loop.init && stmt->for_loop.init->type == NODE_DECLARATION) {
+                end = layoutScope(stmt->for_loop.init, base);
+            }
+            int bodyEnd = stmt->for_loop.body ? layoutScope(stmt->for_loop.body, end) : end;
+            return bodyEnd > end ? bodyEnd : end;
+        }
+        case NODE_WHILE:
+            return stmt->while_loop.body ? layoutScope(stmt->while_loop.body, base) : base;
+        case NODE_DO_WHILE:
+            return stmt->do_while_loop.body ? layoutScope(stmt->do_while_loop.body, base) : base;
+        case NODE_SWITCH:
+            return stmt->switch_stmt.body ? layoutScope(stmt->switch_stmt.body, base) : base;
+        case NODE_IF: {
+            // Both branches start at the same offset and share slots
+            int thenEnd = stmt->if_stmt.if_body ? layoutScope(stmt->if_stmt.if_body, base) : base;
+            int elseEnd = stmt->if_stmt.else_body ? layoutScope(stmt->if_stmt.else_body, base) : base;
+            return thenEnd > elseEnd ? thenEnd : elseEnd;
+        }
+        default:
+            return base;
+    }
+}
+
+// Lay out one scope: its own declarations first (words, then packed
+// bytes), then every nested scope on top of them. Locals the register
+// allocator placed in a register get no slot. Returns the deepest
+// offset used by the scope or anything nested in it.
+static int layoutScope(ASTNode* statements, int base) {
+    int end = base;
+    
+    // Word-sized and larger locals, kept on even offsets
+    for (ASTNode* stmt = statements; stmt; stmt = stmt->next) {
+        if (stmt->type == NODE_DECLARATION && !stmt->declaration.alloc_reg &&
+            getLocalSlotSize(stmt) > 1) {
+            end = (end + 1) & ~1;
+            end += getLocalSlotSize(stmt);
+            stmt->declaration.frame_offset = end;
+        }
+    }
+    
+    // Byte-sized locals packed after them
+    for (ASTNode* stmt = statements; stmt; stmt = stmt->next) {
+        if (stmt->type == NODE_DECLARATION && !stmt->declaration.alloc_reg &&
+            getLocalSlotSize(stmt) == 1) {
+            end += 1;
+            stmt->declaration.frame_offset = end;
+        }
+    }
+    
+    // Nested scopes reuse everything past this scope's own locals
+    int deepest = end;
+    for (ASTNode* stmt = statements; stmt; stmt = stmt->next) {
+        int nestedEnd = layoutNestedScopes(stmt, end);
+        if (nestedEnd > deepest) deepest = nestedEnd;
+    }
+    
+    return deepest;
+}
+
+// Assign every local declaration in a function a stack slot
+int layoutFunctionLocals(ASTNode* func) {
+    if (!func || func->type != NODE_FUNCTION || !func->function.body) return 0;
+    
+    int size = layoutScope(func->function.body->left, 0);
+    return (size + 1) & ~1;
+}
+
+// Map a register name (any width) to its preserved register bit
+static int registerBit(const char* start, int len) {
+    char name[8];
+    if (len < 2 || len > 3) return 0;
+    for (int i = 0; i < len; i++) {
+        name[i] = (char)tolower((unsigned char)start[i]);
+    }
+    name[len] = '\0';
+
+    // Accept the 32-bit forms as well (ebx, esi, ...)
+    const char* reg = (len == 3 && name[0] == 'e') ? name + 1 : name;
+
+    if (strcmp(reg, "bx") == 0 || strcmp(name, "bl") == 0 || strcmp(name, "bh") == 0) return REG_BX;
+    if (strcmp(reg, "cx") == 0 || strcmp(name, "cl") == 0 || strcmp(name, "ch") == 0) return REG_CX;
+    if (strcmp(reg, "dx") == 0 || strcmp(name, "dl") == 0 || strcmp(name, "dh") == 0) return REG_DX;
+    if (strcmp(reg, "si") == 0) return REG_SI;
+    if (strcmp(reg, "di") == 0) return REG_DI;
+    return 0;
+}
+
+// Return the register bit for an operand, or 0 if it is memory/immediate
+static int operandRegister(const char* start, const char* end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    if (start < end && *start == '[') return 0;
+    return registerBit(start, (int)(end - start));
+}
+
+// Registers written implicitly by a mnemonic, regardless of its operands.
+// Control transfers count only when 'transfers' is set.
+static int implicitWrites(const char* m, int transfers) {
+    if (strcmp(m, "mul") == 0 || strcmp(m, "div") == 0 || strcmp(m, "idiv") == 0 ||
+        strcmp(m, "cwd") == 0 || strcmp(m, "cdq") == 0) {
+        return REG_DX;
+    }
+    if (strncmp(m, "movs", 4) == 0 || strncmp(m, "cmps", 4) == 0) return REG_SI | REG_DI;
+    if (strncmp(m, "stos", 4) == 0 || strncmp(m, "scas", 4) == 0 || strncmp(m, "ins", 3) == 0) return REG_DI;
+    if (strncmp(m, "lods", 4) == 0 || strncmp(m, "outs", 4) == 0) return REG_SI;
+    if (strncmp(m, "loop", 4) == 0) return REG_CX;
+    // Anything that transfers control elsewhere may clobber everything
+    if (strcmp(m, "popa") == 0 || strcmp(m, "popad") == 0) return REG_PRESERVED_ALL;
+    if (transfers && (strcmp(m, "call") == 0 || strcmp(m, "int") == 0 || strcmp(m, "into") == 0)) {
+        return REG_PRESERVED_ALL;
+    }
+    return 0;
+}
+
+// Mnemonics whose first operand is only read
+static int readsOnly(const char* m) {
+    static const char* readers[] = {
+        "cmp", "test", "push", "out", "jmp", "ret", "retf", "iret", "nop",
+        "mul", "div", "idiv", NULL
+    };
+    for (int i = 0; readers[i]; i++) {
+        if (strcmp(m, readers[i]) == 0) return 1;
+    }
+    // Conditional jumps
+    return m[0] == 'j';
+}
+
+// Scan assembly for the preserved registers it writes
+static int scanRegisters(const char* code, int transfers) {
+    int written = 0;
+    const char* line = code;
+
+    while (line && *line) {
+        const char* end = strchr(line, '\n');
+        if (!end) end = line + strlen(line);
+
+        // Cut the line at its comment
+        const char* stop = line;
+        while (stop < end && *stop != ';') stop++;
+
+        const char* p = line;
+        while (p < stop) {
+            while (p < stop && isspace((unsigned char)*p)) p++;
+            if (p >= stop || *p == '#') break;
+
+            // Read the mnemonic
+            char mnemonic[16];
+            int len = 0;
+            while (p < stop && !isspace((unsigned char)*p) && *p != ':' && len < 15) {
+                mnemonic[len++] = (char)tolower((unsigned char)*p++);
+            }
+            mnemonic[len] = '\0';
+
+            // Labels are followed by the real instruction, if any
+            if (p < stop && *p == ':') {
+                p++;
+                continue;
+            }
+
+            // Repeat prefixes count down CX and wrap the real instruction
+            if (strncmp(mnemonic, "rep", 3) == 0) {
+                written |= REG_CX;
+                continue;
+            }
+            if (strcmp(mnemonic, "lock") == 0) continue;
+
+            written |= implicitWrites(mnemonic, transfers);
+
+            // Split the operand list at top-level commas
+            const char* operands[3];
+            const char* operandEnds[3];
+            int count = 0;
+            int depth = 0;
+            const char* start = p;
+            for (const char* q = p; q <= stop && count < 3; q++) {
+                if (q < stop && *q == '[') depth++;
+                else if (q < stop && *q == ']') depth--;
+                else if (q == stop || (*q == ',' && depth == 0)) {
+                    operands[count] = start;
+                    operandEnds[count] = q;
+                    count++;
+                    start = q + 1;
+                }
+            }
+
+            if (strcmp(mnemonic, "xchg") == 0 && count == 2) {
+                written |= operandRegister(operands[0], operandEnds[0]);
+                written |= operandRegister(operands[1], operandEnds[1]);
+            } else if (strcmp(mnemonic, "imul") == 0 && count == 1) {
+                written |= REG_DX;
+            } else if (count > 0 && !readsOnly(mnemonic)) {
+                written |= operandRegister(operands[0], operandEnds[0]);
+            }
+            break;
+        }
+
+        line = *end ? end + 1 : end;
+    }
+
+    return written;
+}
+
+// Scan generated assembly and return the preserved registers (REG_*) it writes
+int scanWrittenRegisters(const char* code) {
+    return scanRegisters(code, 1);
+}
+
+// Same, but leave out what calls and interrupts might clobber
+int scanExplicitRegisters(const char* code) {
+    return scanRegisters(code, 0);
+}
+
+// Record that a function was emitted without a frame
+void recordFramelessFunction(const char* funcName) {
+    framelessFunctionCount++;
+    framelessBytesSaved += FRAME_POINTER_BYTES;
+}
+
+// Number of functions recorded as frameless so far
+int getFramelessFunctionCount() {
+    return framelessFunctionCount;
+}
+
+// Reset the frame omission statistics
+void resetFrameStats() {
+    framelessFunctionCount = 0;
+    framelessBytesSaved = 0;
+}
+
+// Report how many functions went frameless and the bytes saved
+void reportFrameStats(FILE* asmOut) {
+    if (!optimizationState.omitFramePointer) return;
+
+    if (asmOut) {
+        fprintf(asmOut, "\n; Frame pointer omission: %d function(s) frameless, %d bytes saved\n",
+                framelessFunctionCount, framelessBytesSaved);
+    }
+
+    #ifndef QUIET_MODE
+    printf("  - Frame pointer omission: %d function(s) frameless, %d bytes saved\n",
+           framelessFunctionCount, framelessBytesSaved);
+    #endif
+}
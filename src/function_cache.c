@@ -0,0 +1,196 @@
+#include "function_cache.h"
+#include "mem_report.h"
+#include "version.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entry layout:
+//   "NCCFN3\n"
+//   "build <compiler build id>\n"
+//   "frameless <0|1>\n"
+//   "strings <count>\n", then per string reference
+//       "<offset>\n<length>\n<bytes>\n"
+//   "code <length>\n<assembly>"
+#define ENTRY_MAGIC "NCCFN3\n"
+
+static const char* functionCacheDir = NULL;
+static const char* cacheFlags = "";
+static const char* cacheSource = NULL;
+static const char* cacheSourceName = "";
+static char contextKey[CACHE_KEY_LEN + 1];
+
+static int functionsSeen = 0;
+static int functionsReused = 0;
+
+void initFunctionCache(const char* cacheDir, const char* flags, const char* source, const char* sourceName) {
+    functionCacheDir = cacheDir;
+    cacheFlags = flags ? flags : "";
+    cacheSource = source;
+    cacheSourceName = sourceName ? sourceName : "";
+    functionsSeen = 0;
+    functionsReused = 0;
+}
+
+static int hasBodySpan(ASTNode* func) {
+    return func->function.body && func->function.body_end > func->function.body_start;
+}
+
+void beginFunctionCache(ASTNode* program) {
+    if (!functionCacheDir || !cacheSource || !program) return;
+
+    // Copy the source without the function bodies, in order
+    size_t length = strlen(cacheSource);
+    char* outside = (char*)nccMalloc(MEM_CODEGEN, length + 1);
+    if (!outside) {
+        functionCacheDir = NULL;
+        return;
+    }
+    size_t used = 0;
+    size_t from = 0;
+    for (ASTNode* node = program->left; node; node = node->next) {
+        if (node->type != NODE_FUNCTION || !hasBodySpan(node)) continue;
+        size_t start = (size_t)node->function.body_start;
+        if (start < from || (size_t)node->function.body_end > length) continue;
+        memcpy(outside + used, cacheSource + from, start - from);
+        used += start - from;
+        from = (size_t)node->function.body_end;
+    }
+    memcpy(outside + used, cacheSource + from, length - from);
+    used += length - from;
+    outside[used] = '\0';
+
+    computeCacheKey(contextKey, "context", outside);
+    nccFree(outside);
+}
+
+int functionCacheKey(ASTNode* func, const char* state, char key[CACHE_KEY_LEN + 1]) {
+    if (!functionCacheDir || !cacheSource || !hasBodySpan(func)) return 0;
+    functionsSeen++;
+
+    size_t bodyLength = (size_t)(func->function.body_end - func->function.body_start);
+    char* body = (char*)nccMalloc(MEM_CODEGEN, bodyLength + 1);
+    size_t describedLength = strlen(cacheFlags) + strlen(cacheSourceName) + strlen(state) +
+                             strlen(func->function.func_name) + 96;
+    char* described = (char*)nccMalloc(MEM_CODEGEN, describedLength);
+    if (!body || !described) {
+        nccFree(body);
+        nccFree(described);
+        return 0;
+    }
+    memcpy(body, cacheSource + func->function.body_start, bodyLength);
+    body[bodyLength] = '\0';
+    snprintf(described, describedLength, "function %s %s %s %s %s",
+             func->function.func_name, cacheFlags, cacheSourceName, contextKey, state);
+
+    computeCacheKey(key, described, body);
+    nccFree(described);
+    nccFree(body);
+    return 1;
+}
+
+// Read a "<word> <number>\n" line
+static int readField(char** p, char* end, const char* word, size_t* value) {
+    size_t wordLength = strlen(word);
+    if ((size_t)(end - *p) <= wordLength || strncmp(*p, word, wordLength) != 0) return 0;
+    char* after = NULL;
+    *value = (size_t)strtoul(*p + wordLength, &after, 10);
+    if (!after || after >= end || *after != '\n') return 0;
+    *p = after + 1;
+    return 1;
+}
+
+int loadCachedFunction(const char* key, CachedFunction* entry) {
+    memset(entry, 0, sizeof(*entry));
+    size_t size = 0;
+    if (!functionCacheDir || !cacheLoadFunction(functionCacheDir, key, &entry->data, &size)) return 0;
+
+    char* p = entry->data;
+    char* end = entry->data + size;
+    size_t value = 0;
+    size_t magicLength = strlen(ENTRY_MAGIC);
+    int ok = size >= magicLength && memcmp(p, ENTRY_MAGIC, magicLength) == 0;
+    if (ok) p += magicLength;
+
+    // The key already covers the build; the copy in the entry guards
+    // against entries written by a compiler that keyed them differently
+    char build[96];
+    int buildLength = snprintf(build, sizeof(build), "build %s\n", compilerBuildId());
+    ok = ok && (size_t)(end - p) > (size_t)buildLength && memcmp(p, build, buildLength) == 0;
+    if (ok) p += buildLength;
+
+    ok = ok && readField(&p, end, "frameless ", &value);
+    entry->frameless = (int)value;
+    ok = ok && readField(&p, end, "strings ", &value);
+    if (ok && value > 0) {
+        entry->strings = (char**)nccCalloc(MEM_CODEGEN, value, sizeof(char*));
+        entry->stringOffsets = (long*)nccCalloc(MEM_CODEGEN, value, sizeof(long));
+        ok = entry->strings != NULL && entry->stringOffsets != NULL;
+    }
+    for (size_t i = 0; ok && entry->strings && i < value; i++) {
+        size_t offset = 0;
+        size_t length = 0;
+        ok = readField(&p, end, "", &offset) && readField(&p, end, "", &length) &&
+             (size_t)(end - p) > length && p[length] == '\n';
+        if (ok) {
+            p[length] = '\0';
+            entry->stringOffsets[entry->stringCount] = (long)offset;
+            entry->strings[entry->stringCount++] = p;
+            p += length + 1;
+        }
+    }
+    ok = ok && readField(&p, end, "code ", &value) && (size_t)(end - p) == value;
+
+    // References must be in order and inside the code
+    for (int i = 0; ok && i < entry->stringCount; i++) {
+        ok = (size_t)entry->stringOffsets[i] <= value &&
+             (i == 0 || entry->stringOffsets[i] >= entry->stringOffsets[i - 1]);
+    }
+    if (!ok) {
+        freeCachedFunction(entry);
+        return 0;
+    }
+    entry->code = p;
+    entry->codeLength = value;
+    functionsReused++;
+    return 1;
+}
+
+void freeCachedFunction(CachedFunction* entry) {
+    nccFree(entry->strings);
+    nccFree(entry->stringOffsets);
+    nccFree(entry->data);
+    memset(entry, 0, sizeof(*entry));
+}
+
+void saveCachedFunction(const char* key, const CachedFunction* entry) {
+    if (!functionCacheDir) return;
+
+    size_t size = strlen(ENTRY_MAGIC) + strlen(compilerBuildId()) + 72 + entry->codeLength;
+    for (int i = 0; i < entry->stringCount; i++) {
+        size += strlen(entry->strings[i]) + 48;
+    }
+    char* data = (char*)nccMalloc(MEM_CODEGEN, size);
+    if (!data) return;
+
+    size_t used = (size_t)sprintf(data, "%sbuild %s\nframeless %d\nstrings %d\n", ENTRY_MAGIC, compilerBuildId(),
+                                  entry->frameless ? 1 : 0, entry->stringCount);
+    for (int i = 0; i < entry->stringCount; i++) {
+        used += (size_t)sprintf(data + used, "%ld\n%lu\n%s\n", entry->stringOffsets[i],
+                                (unsigned long)strlen(entry->strings[i]), entry->strings[i]);
+    }
+    used += (size_t)sprintf(data + used, "code %lu\n", (unsigned long)entry->codeLength);
+    memcpy(data + used, entry->code, entry->codeLength);
+    used += entry->codeLength;
+
+    cacheSaveFunction(functionCacheDir, key, data, used);
+    nccFree(data);
+}
+
+void reportFunctionCacheStats() {
+    #ifndef QUIET_MODE
+    if (functionCacheDir && functionsSeen > 0) {
+        printf("  - Function cache: %d of %d functions reused\n", functionsReused, functionsSeen);
+    }
+    #endif
+}
@@ -1,6 +1,7 @@
 #include "codegen.h"
 #include "ast.h"
 #include "error_manager.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,9 +44,9 @@ static int globalExists(const char* name) {
     }
     
     // Add new entry
-    entry = (GlobalEntry*)malloc(sizeof(GlobalEntry));
+    entry = (GlobalEntry*)nccMalloc(MEM_GLOBALS, sizeof(GlobalEntry));
     if (entry) {
-        entry->name = strdupc(name);
+        entry->name = nccStrdup(MEM_GLOBALS, name);
         entry->next = globalHashTable[hash];
         globalHashTable[hash] = entry;
     }
@@ -59,9 +60,9 @@ void addGlobalDeclaration(ASTNode* node) {
     
     // Resize the array if needed
     if (globalCount == 0) {
-        globalDeclarations = malloc(sizeof(ASTNode*));
+        globalDeclarations = nccMalloc(MEM_GLOBALS, sizeof(ASTNode*));
     } else {
-        globalDeclarations = realloc(globalDeclarations, (globalCount + 1) * sizeof(ASTNode*));
+        globalDeclarations = nccRealloc(MEM_GLOBALS, globalDeclarations, (globalCount + 1) * sizeof(ASTNode*));
     }
     
     if (!globalDeclarations) {
@@ -104,7 +105,7 @@ void generateGlobalsAtMarker(FILE* asmFile) {
     
     // Get sanitized filename prefix
     char* prefix = getSanitizedFilenamePrefix();
-    if (!prefix) prefix = strdupc("unknown");
+    if (!prefix) prefix = nccStrdup(MEM_GLOBALS, "unknown");
     
     // First, build the hash table of existing globals if redefining
     if (redefineLocalsFound && redefineGlobalStartIndex > 0) {
@@ -193,7 +194,7 @@ void generateGlobalsAtMarker(FILE* asmFile) {
     }
     
     // Free the prefix
-    free(prefix);
+    nccFree(prefix);
 }
 
 // Generate any remaining globals that weren't emitted at a marker
@@ -208,7 +209,7 @@ void generateRemainingGlobals(FILE* asmFile) {
 // Free allocated memory
 void cleanupGlobals() {
     if (globalDeclarations) {
-        free(globalDeclarations);
+        nccFree(globalDeclarations);
         globalDeclarations = NULL;
     }
     globalCount = 0;
@@ -219,8 +220,8 @@ void cleanupGlobals() {
         GlobalEntry* entry = globalHashTable[i];
         while (entry) {
             GlobalEntry* temp = entry->next;
-            free(entry->name);
-            free(entry);
+            nccFree(entry->name);
+            nccFree(entry);
             entry = temp;
         }
         globalHashTable[i] = NULL;
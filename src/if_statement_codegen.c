@@ -1,5 +1,6 @@
 #include "codegen.h"
 #include "ast.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,8 +11,16 @@ extern char* generateLabel(const char* prefix);
 extern void generateStatement(ASTNode* node);
 extern void generateExpression(ASTNode* node);
 
-// Generate code for an if statement
+static void emitIfStatement(ASTNode* node);
+
 void generateIfStatement(ASTNode* node) {
+    int mark = enterCodegen("generateIfStatement", node);
+    emitIfStatement(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for an if statement
+static void emitIfStatement(ASTNode* node) {
     if (!node || node->type != NODE_IF) return;
     
     // Generate labels for the else part and end of if
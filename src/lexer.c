@@ -1,6 +1,8 @@
 #include "lexer.h"
 #include "error_manager.h"
 #include "ast.h"
+#include "time_report.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -100,6 +102,9 @@ static int isKeyword(const char* str) {
     if (strcmp(str, "return") == 0) return TOKEN_RETURN;
     if (strcmp(str, "break") == 0) return TOKEN_BREAK;
     if (strcmp(str, "continue") == 0) return TOKEN_CONTINUE;
+    if (strcmp(str, "switch") == 0) return TOKEN_SWITCH;
+    if (strcmp(str, "case") == 0) return TOKEN_CASE;
+    if (strcmp(str, "default") == 0) return TOKEN_DEFAULT;
     if (strcmp(str, "bool") == 0) return TOKEN_BOOL;
     if (strcmp(str, "true") == 0) return TOKEN_TRUE;
     if (strcmp(str, "false") == 0) return TOKEN_FALSE;
@@ -107,8 +112,8 @@ static int isKeyword(const char* str) {
     return TOKEN_IDENTIFIER;
 }
 
-// Get the next token
-Token getNextToken() {
+// Scan the next token
+static Token scanToken() {
     Token token;
     token.value = NULL;
     token.line = line;
@@ -133,7 +138,7 @@ Token getNextToken() {
         }
         
         size_t length = position - start;
-        token.value = (char*)malloc(length + 1);
+        token.value = (char*)nccMalloc(MEM_TOKENS, length + 1);
         strncpy(token.value, &source[start], length);
         token.value[length] = '\0';
 
@@ -166,7 +171,7 @@ Token getNextToken() {
         }
         
         size_t length = position - start;
-        token.value = (char*)malloc(length + 1);
+        token.value = (char*)nccMalloc(MEM_TOKENS, length + 1);
         strncpy(token.value, &source[start], length);
         token.value[length] = '\0';
         token.type = TOKEN_NUMBER;
@@ -194,7 +199,7 @@ Token getNextToken() {
         }
         
         size_t length = position - start;
-        token.value = (char*)malloc(length + 1);
+        token.value = (char*)nccMalloc(MEM_TOKENS, length + 1);
         strncpy(token.value, &source[start], length);
         token.value[length] = '\0';
         token.type = TOKEN_STRING;
@@ -261,7 +266,7 @@ Token getNextToken() {
         }
         
         token.type = TOKEN_CHAR_LITERAL;
-        token.value = malloc(2);
+        token.value = nccMalloc(MEM_TOKENS, 2);
         token.value[0] = charValue;
         token.value[1] = '\0';
         
@@ -524,7 +529,7 @@ Token getNextToken() {
             position++;  // Skip the unrecognized character
             column++;
             reportWarning(errorPos, "Unexpected character '%c'", errorChar);
-            return getNextToken();  // Try again with the next character
+            return scanToken();  // Try again with the next character
     }
     
     token.line = line;
@@ -533,6 +538,14 @@ Token getNextToken() {
     return token;
 }
 
+// Get the next token
+Token getNextToken() {
+    startTimer(PHASE_LEX, NULL);
+    Token token = scanToken();
+    stopTimer();
+    return token;
+}
+
 // Peek at the next token without consuming it
 Token peekNextToken() {
     size_t oldPos = position;
@@ -564,7 +577,7 @@ int tokenIs(TokenType type) {
 int consume(TokenType type) {
     if (tokenIs(type)) {
         if (currentToken.value) {
-            free(currentToken.value);
+            nccFree(currentToken.value);
         }
         currentToken = getNextToken();
         return 1;
@@ -575,7 +588,7 @@ int consume(TokenType type) {
 // Consume the current token and return its value
 char* consumeAndGetValue(TokenType type) {
     if (tokenIs(type)) {
-        char* value = currentToken.value ? strdupc(currentToken.value) : NULL;
+        char* value = currentToken.value ? nccStrdup(MEM_TOKENS, currentToken.value) : NULL;
         currentToken = getNextToken();
         return value;
     }
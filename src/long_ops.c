@@ -0,0 +1,353 @@
+#include "long_ops.h"
+#include "codegen.h"
+#include "type_checker.h"
+#include "codegen_stats.h"
+#include <stdio.h>
+#include <stddef.h>
+
+// Forward declarations from codegen.c
+extern FILE* asmFile;
+extern int labelCounter;
+extern const char* getLabelScope();
+extern int getVariableOffset(const char* name);
+extern int isParameter(const char* name);
+extern const char* getVariableRegister(const char* name);
+extern int isByteLocal(const char* name);
+
+// Real mode code on a 386 can still use EAX..EDX: any instruction carrying
+// the 0x66 operand-size prefix works on the 32-bit register. nas only knows
+// the 16-bit register names, so "#db 0x66" followed by "add ax, bx" is how
+// add eax, ebx is written. Longs are still passed around in DX:AX; a tree of
+// long arithmetic keeps its intermediate values in EAX and is only split
+// back into DX:AX once the whole tree has been evaluated.
+
+// Emit one instruction with the operand-size prefix
+static void emit32(const char* insn, const char* comment) {
+    fprintf(asmFile, "    #db 0x66 ; 32-bit operand\n");
+    fprintf(asmFile, "    %s ; %s\n", insn, comment);
+}
+
+static int isLongType(TypeInfo* typeInfo) {
+    return typeInfo && !typeInfo->is_pointer &&
+           (typeInfo->type == TYPE_LONG || typeInfo->type == TYPE_UNSIGNED_LONG);
+}
+
+// Operators whose result has the type of their (promoted) operands
+static int isArithmeticOp(OperatorType op) {
+    switch (op) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_BITWISE_AND: case OP_BITWISE_OR: case OP_BITWISE_XOR:
+        case OP_LEFT_SHIFT: case OP_RIGHT_SHIFT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int isComparisonOp(OperatorType op) {
+    return op == OP_EQ || op == OP_NEQ || op == OP_LT ||
+           op == OP_LTE || op == OP_GT || op == OP_GTE;
+}
+
+// Check if an expression produces a 32-bit long value
+int isLongExpression(ASTNode* expr) {
+    if (!expr) return 0;
+    if (expr->type == NODE_BINARY_OP) {
+        if (!isArithmeticOp(expr->operation.op)) return 0;
+        // The shift count does not widen the result
+        if (expr->operation.op == OP_LEFT_SHIFT || expr->operation.op == OP_RIGHT_SHIFT) {
+            return isLongExpression(expr->left);
+        }
+        return isLongExpression(expr->left) || isLongExpression(expr->right);
+    }
+    return isLongType(getTypeInfoFromExpression(expr));
+}
+
+// Check if an expression is an unsigned long (unsigned wins in mixed operations)
+static int isUnsignedLongExpression(ASTNode* expr) {
+    if (!expr) return 0;
+    if (expr->type == NODE_BINARY_OP && isArithmeticOp(expr->operation.op)) {
+        if (expr->operation.op == OP_LEFT_SHIFT || expr->operation.op == OP_RIGHT_SHIFT) {
+            return isUnsignedLongExpression(expr->left);
+        }
+        return isUnsignedLongExpression(expr->left) || isUnsignedLongExpression(expr->right);
+    }
+    TypeInfo* typeInfo = getTypeInfoFromExpression(expr);
+    return isLongType(typeInfo) && typeInfo->type == TYPE_UNSIGNED_LONG;
+}
+
+// Check if a 16-bit value must be zero extended rather than sign extended
+static int isUnsignedWord(ASTNode* expr) {
+    TypeInfo* typeInfo = getTypeInfoFromExpression(expr);
+    if (!typeInfo) return 0;
+    return typeInfo->is_pointer || typeInfo->type == TYPE_UNSIGNED_INT ||
+           typeInfo->type == TYPE_UNSIGNED_SHORT || typeInfo->type == TYPE_UNSIGNED_CHAR ||
+           typeInfo->type == TYPE_BOOL;
+}
+
+// Format the frame address of a long local or parameter. Returns 0 for
+// variables that do not live in the frame as a full 32-bit value.
+static int getLongVariableAddress(ASTNode* var, char* buffer, size_t size) {
+    const char* name = var->identifier;
+    if (!isLongType(getTypeInfoFromExpression(var)) || getVariableRegister(name) || isByteLocal(name)) return 0;
+    int offset = getVariableOffset(name);
+    if (isParameter(name)) {
+        snprintf(buffer, size, "[bp+%d]", -offset);
+        return 1;
+    }
+    if (offset > 0) {
+        snprintf(buffer, size, "[bp-%d]", offset);
+        return 1;
+    }
+    return 0;
+}
+
+static void generateLongArithmetic(ASTNode* node);
+
+// Evaluate an operand of a long operation into EAX
+static void loadLongOperand(ASTNode* expr) {
+    if (expr->type == NODE_BINARY_OP && isArithmeticOp(expr->operation.op) && isLongExpression(expr)) {
+        // Nested long arithmetic stays in EAX
+        generateLongArithmetic(expr);
+        return;
+    }
+
+    if (expr->type == NODE_LITERAL &&
+        (expr->literal.data_type == TYPE_INT || expr->literal.data_type == TYPE_LONG ||
+         expr->literal.data_type == TYPE_UNSIGNED_LONG)) {
+        // Numeric literals keep all 32 bits of their value
+        unsigned int value = (unsigned int)expr->literal.int_value;
+        fprintf(asmFile, "    push %u ; Long literal %d (high word)\n", (value >> 16) & 0xFFFF, expr->literal.int_value);
+        fprintf(asmFile, "    push %u ; (low word)\n", value & 0xFFFF);
+        emit32("pop ax", "into eax");
+        return;
+    }
+
+    if (expr->type == NODE_UNARY_OP && isLongExpression(expr) &&
+        (expr->unary_op.op == UNARY_NEGATE || expr->unary_op.op == UNARY_BITWISE_NOT)) {
+        loadLongOperand(expr->right);
+        if (expr->unary_op.op == UNARY_NEGATE) {
+            emit32("neg ax", "32-bit negation");
+        } else {
+            emit32("not ax", "32-bit complement");
+        }
+        return;
+    }
+
+    char address[32];
+    if (expr->type == NODE_IDENTIFIER && getLongVariableAddress(expr, address, sizeof(address))) {
+        char insn[64];
+        snprintf(insn, sizeof(insn), "mov ax, %s", address);
+        emit32(insn, "Load long variable into eax");
+        return;
+    }
+
+    generateExpression(expr);
+    if (!isLongExpression(expr)) {
+        if (isUnsignedWord(expr)) {
+            fprintf(asmFile, "    xor dx, dx ; Zero extend to long\n");
+        } else {
+            emit32("cbw", "cwde: sign extend ax into eax");
+            return;
+        }
+    }
+    fprintf(asmFile, "    push dx ; Combine DX:AX\n");
+    fprintf(asmFile, "    push ax\n");
+    emit32("pop ax", "into eax");
+}
+
+// Evaluate both operands: left in EAX, right in EBX
+static void loadLongOperands(ASTNode* node) {
+    loadLongOperand(node->left);
+    emit32("push ax", "Save left operand (eax)");
+    loadLongOperand(node->right);
+    emit32("mov bx, ax", "Right operand to ebx");
+    emit32("pop ax", "Restore left operand (eax)");
+}
+
+// Apply an operator to EAX and EBX, leaving the result in EAX
+static void applyLongOperator(OperatorType op, int isUnsigned) {
+    switch (op) {
+        case OP_ADD:
+            emit32("add ax, bx", "32-bit addition");
+            break;
+        case OP_SUB:
+            emit32("sub ax, bx", "32-bit subtraction");
+            break;
+        case OP_MUL:
+            // The low 32 bits of the product are the same signed or unsigned
+            emit32("imul bx", "32-bit multiplication (edx:eax)");
+            break;
+        case OP_DIV:
+        case OP_MOD:
+            if (isUnsigned) {
+                emit32("xor dx, dx", "Zero extend eax into edx:eax");
+                emit32("div bx", "32-bit division (unsigned)");
+            } else {
+                emit32("cwd", "cdq: sign extend eax into edx:eax");
+                emit32("idiv bx", "32-bit division (signed)");
+            }
+            if (op == OP_MOD) {
+                emit32("mov ax, dx", "Remainder is in edx");
+            }
+            break;
+        case OP_BITWISE_AND:
+            emit32("and ax, bx", "32-bit bitwise AND");
+            break;
+        case OP_BITWISE_OR:
+            emit32("or ax, bx", "32-bit bitwise OR");
+            break;
+        case OP_BITWISE_XOR:
+            emit32("xor ax, bx", "32-bit bitwise XOR");
+            break;
+        case OP_LEFT_SHIFT:
+            fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
+            emit32("shl ax, cl", "32-bit shift left");
+            break;
+        case OP_RIGHT_SHIFT:
+            fprintf(asmFile, "    mov cx, bx ; Set shift count in CX\n");
+            if (isUnsigned) {
+                emit32("shr ax, cl", "32-bit shift right (logical)");
+            } else {
+                emit32("sar ax, cl", "32-bit shift right (arithmetic)");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Generate long arithmetic, leaving the result in EAX
+static void generateLongArithmetic(ASTNode* node) {
+    loadLongOperands(node);
+    applyLongOperator(node->operation.op, isUnsignedLongExpression(node));
+}
+
+// Split EAX into DX:AX, the form longs take outside of an expression tree
+static void splitLongResult() {
+    emit32("push ax", "Split eax into DX:AX");
+    fprintf(asmFile, "    pop ax\n");
+    fprintf(asmFile, "    pop dx\n");
+}
+
+static int emitLongBinaryOp386(ASTNode* node);
+
+int generateLongBinaryOp386(ASTNode* node) {
+    int mark = enterCodegen("generateLongBinaryOp386", node);
+    int handled = emitLongBinaryOp386(node);
+    leaveCodegen(mark);
+    return handled;
+}
+
+// Generate a binary operation on longs using the 386 32-bit registers
+static int emitLongBinaryOp386(ASTNode* node) {
+    OperatorType op = node->operation.op;
+
+    if (isArithmeticOp(op) && isLongExpression(node)) {
+        fprintf(asmFile, "    ; 32-bit long operation (386)\n");
+        generateLongArithmetic(node);
+        splitLongResult();
+        return 1;
+    }
+
+    if (isComparisonOp(op) && (isLongExpression(node->left) || isLongExpression(node->right))) {
+        int isUnsigned = isUnsignedLongExpression(node->left) || isUnsignedLongExpression(node->right);
+        const char* jump;
+        switch (op) {
+            case OP_EQ:  jump = "je"; break;
+            case OP_NEQ: jump = "jne"; break;
+            case OP_LT:  jump = isUnsigned ? "jb" : "jl"; break;
+            case OP_LTE: jump = isUnsigned ? "jbe" : "jle"; break;
+            case OP_GT:  jump = isUnsigned ? "ja" : "jg"; break;
+            default:     jump = isUnsigned ? "jae" : "jge"; break;
+        }
+
+        fprintf(asmFile, "    ; 32-bit long comparison (386)\n");
+        loadLongOperands(node);
+        emit32("cmp ax, bx", "32-bit comparison");
+        fprintf(asmFile, "    mov ax, 1 ; Assume true\n");
+        fprintf(asmFile, "    %s %slcmp_end_%d\n", jump, getLabelScope(), labelCounter);
+        fprintf(asmFile, "    xor ax, ax ; False\n");
+        fprintf(asmFile, "%slcmp_end_%d:\n", getLabelScope(), labelCounter++);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Map a compound assignment to the operator it applies
+static OperatorType getCompoundOperator(OperatorType op) {
+    switch (op) {
+        case OP_PLUS_ASSIGN: return OP_ADD;
+        case OP_MINUS_ASSIGN: return OP_SUB;
+        case OP_MUL_ASSIGN: return OP_MUL;
+        case OP_DIV_ASSIGN: return OP_DIV;
+        case OP_MOD_ASSIGN: return OP_MOD;
+        case OP_LEFT_SHIFT_ASSIGN: return OP_LEFT_SHIFT;
+        case OP_RIGHT_SHIFT_ASSIGN: return OP_RIGHT_SHIFT;
+        default: return OP_COMMA;
+    }
+}
+
+// Generate an assignment to a long local or parameter in one 32-bit store
+int generateLongAssignment386(ASTNode* node) {
+    char address[32];
+    ASTNode* target = node->left;
+    if (target->type != NODE_IDENTIFIER ||
+        !getLongVariableAddress(target, address, sizeof(address))) {
+        return 0;
+    }
+
+    int isUnsigned = isUnsignedLongExpression(target);
+    if (node->assignment.op != 0) {
+        OperatorType op = getCompoundOperator(node->assignment.op);
+        if (op == OP_COMMA) return 0;
+        loadLongOperand(target);
+        emit32("push ax", "Save old value (eax)");
+        loadLongOperand(node->right);
+        emit32("mov bx, ax", "Right operand to ebx");
+        emit32("pop ax", "Restore old value (eax)");
+        applyLongOperator(op, isUnsigned || isUnsignedLongExpression(node->right));
+    } else {
+        loadLongOperand(node->right);
+    }
+
+    char insn[64];
+    snprintf(insn, sizeof(insn), "mov %s, ax", address);
+    emit32(insn, "Store long variable from eax");
+    splitLongResult();
+    return 1;
+}
+
+// Evaluate an expression as a long into DX:AX
+void generateLongValue(ASTNode* expr) {
+    if (getTargetCpu() >= CPU_386) {
+        loadLongOperand(expr);
+        splitLongResult();
+        return;
+    }
+
+    if (expr->type == NODE_LITERAL && expr->literal.data_type == TYPE_INT) {
+        unsigned int value = (unsigned int)expr->literal.int_value;
+        fprintf(asmFile, "    mov ax, %u ; Long literal %d (low word)\n", value & 0xFFFF, expr->literal.int_value);
+        fprintf(asmFile, "    mov dx, %u ; (high word)\n", (value >> 16) & 0xFFFF);
+        return;
+    }
+
+    generateExpression(expr);
+    if (!isLongExpression(expr)) {
+        if (isUnsignedWord(expr)) {
+            fprintf(asmFile, "    xor dx, dx ; Zero extend to long\n");
+        } else {
+            fprintf(asmFile, "    cwd ; Sign extend to long\n");
+        }
+    }
+}
+
+// Initialize a long local at [bp-slot]
+void generateLongInitializer386(ASTNode* init, int slot) {
+    char insn[64];
+    loadLongOperand(init);
+    snprintf(insn, sizeof(insn), "mov [bp-%d], ax", slot);
+    emit32(insn, "Initialize long variable from eax");
+}
@@ -12,6 +12,8 @@
 #else
 #define _POSIX_C_SOURCE 200809L
     #include <unistd.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
     #include <libgen.h>
     #include <limits.h>
     #include <stdio.h>
@@ -25,14 +27,25 @@
 #include "error_manager.h"
 #include "preprocessor.h"
 #include "codegen.h"
+#include "register_alloc.h"
+#include "assembler.h"
+#include "compile_server.h"
+#include "pch.h"
+#include "compile_cache.h"
+#include "function_cache.h"
+#include "time_report.h"
+#include "codegen_stats.h"
+#include "mem_report.h"
+#include "parallel_codegen.h"
 
 // Forward declarations
 typedef struct ASTNode ASTNode;
 void initLexer(const char* src);
 void initParser();
 ASTNode* parseProgram();
-void initCodeGen(const char* outputFilename, unsigned int originAddress);
-void initCodeGenSystemMode(const char* outputFilename, unsigned int originAddress, 
+void annotateTypes(ASTNode* root);
+void initCodeGen(unsigned int originAddress);
+void initCodeGenSystemMode(unsigned int originAddress, 
                           int setStackSegmentPointer, unsigned int stackSegment, unsigned int stackPointer);
 void generateCode(ASTNode* root);
 void finalizeCodeGen();
@@ -42,19 +55,44 @@ extern void printLineMappings();
 
 void printUsage(const char* programName) {
     fprintf(stderr, "NCC: Nathan's C Compiler\n");
-    fprintf(stderr, "Usage: %s [options] <source file>\n", programName);
+    fprintf(stderr, "Usage: %s [options] <source file>...\n", programName);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -o <file>    Output to <file> (default: output.asm)\n");
     fprintf(stderr, "  -d           Debug mode (print AST)\n");
     fprintf(stderr, "  -dl          Debug line tracking (show preprocessor line mappings)\n");
+    fprintf(stderr, "  -dr          Debug register allocation (show live ranges and decisions)\n");
     fprintf(stderr, "  -I<path>     Add <path> to include search paths\n");
     fprintf(stderr, "  -disp <addr> Set origin displacement address\n");
     fprintf(stderr, "  -O<level>    Set optimization level (0=none, 1=basic)\n");
     fprintf(stderr, "  -com         Target MS-DOS executable (ORG 0x100)\n");
     fprintf(stderr, "  -sys         Target bootloader (ORG 0x7C00)\n");
+    fprintf(stderr, "  -m8086       Only choose 8086 instructions where codegen has a choice\n");
+    fprintf(stderr, "  -m186        Allow 80186 instructions such as pusha/popa (default)\n");
+    fprintf(stderr, "  -m386        Compute long arithmetic in 32-bit registers (still real mode)\n");
 #ifndef NO_nas
     fprintf(stderr, "  -S           Stop after generating assembly (don't assemble)\n");
+    fprintf(stderr, "  -nas         Assemble with the external nas instead of the built-in assembler\n");
 #endif
+    fprintf(stderr, "  -x c-header  Treat the sources as headers and write precompiled headers\n");
+    fprintf(stderr, "  -include-pch <file>  Start from the state saved in a precompiled header\n");
+    fprintf(stderr, "  -E           Only preprocess; write the result to -o <file> or stdout\n");
+    fprintf(stderr, "  -M           Only list the files a source depends on, as a Makefile rule\n");
+    fprintf(stderr, "  -MD          Also write that rule to <output>.d while compiling\n");
+    fprintf(stderr, "  -MF <file>   Write the dependency rule to <file>\n");
+    fprintf(stderr, "  -MT <target> Name the rule's target (default: the output file)\n");
+    fprintf(stderr, "  -cache <dir> Reuse outputs of identical compiles from <dir> (or $NCC_CACHE_DIR)\n");
+    fprintf(stderr, "  -cache-size <MB>  Evict least recently used cache entries beyond <MB>\n");
+    fprintf(stderr, "  -cache-stats Print the cache's hit/miss counts and size\n");
+    fprintf(stderr, "  -ftime-report  Print the time spent in each compile phase and function\n");
+    fprintf(stderr, "  -ftime-trace[=<file>]  Write a Chrome trace of the compile (default: <output>.json)\n");
+    fprintf(stderr, "  -fcodegen-stats[=<file>]  Write instruction counts per function and generator as JSON\n");
+    fprintf(stderr, "  -fcodegen-jobs=<n>  Generate functions in <n> worker processes (0: one per CPU)\n");
+    fprintf(stderr, "  -fmem-report Print the memory used by each part of the compiler\n");
+    fprintf(stderr, "  -fmem-limit=<MB>  Fail a compile that needs more than <MB> (or $NCC_MEM_LIMIT)\n");
+    fprintf(stderr, "  -j <n>       Compile up to <n> source files at once\n");
+    fprintf(stderr, "  @<file>      Read more arguments from <file>\n");
+    fprintf(stderr, "  --server <socket>  Run as a compile server on a Unix socket (first option)\n");
+    fprintf(stderr, "  --client <socket>  Compile through a server, or locally if none runs (first option)\n");
     fprintf(stderr, "  -h           Display this help and exit\n");
 }
 
@@ -80,86 +118,211 @@ char* getExecutableDir() {
     if (lastSeparator) *lastSeparator = '\0';
     return buffer;
 }
+
+// Assembly handed to nas; removed at exit
+static char tempAsmPath[MAX_PATH_LEN + 1] = "";
+#ifndef _WIN32
+static pid_t tempAsmOwner = 0;  // Forked codegen workers must leave it alone
 #endif
 
-int main(int argc, char* argv[]) {
-    char* sourceFile = NULL;
-    char* outputFile = "output.asm";
-    int debugMode = 0;
-    int debugLineMode = 0;
-    unsigned int originAddress = 0;
-    int optimizationLevel = OPT_LEVEL_NONE;
-#ifndef NO_nas
-    int stopAfterAsm = 0;
+static void removeTempAsm() {
+#ifndef _WIN32
+    if (getpid() != tempAsmOwner) return;
 #endif
-    int systemMode = 0;  // Flag for bootloader mode
-    int setStackSegmentPointer = 0;
-    unsigned int stackSegment = 0;
-    unsigned int stackPointer = 0;
+    if (tempAsmPath[0]) remove(tempAsmPath);
+}
 
-    for (int i = 1; i < argc; i++) {
-        if (strncmp(argv[i], "-I", 2) == 0) {
-            const char* path = argv[i] + 2;
-            if (*path) {
-                addIncludePath(path);
-            } else if (i + 1 < argc) {
-                addIncludePath(argv[++i]);
-            }
-        } else if (strncmp(argv[i], "-O", 2) == 0) {
-            if (isdigit(argv[i][2])) optimizationLevel = argv[i][2] - '0';
-            else if (i + 1 < argc && isdigit(argv[i+1][0])) optimizationLevel = argv[++i][0] - '0';
-        } else if ((strcmp(argv[i], "-disp") == 0 || strcmp(argv[i], "-DISP") == 0) && i + 1 < argc) {
-            originAddress = (unsigned int)strtoul(argv[++i], NULL, 0);
-        } else if (strcmp(argv[i], "-com") == 0 || strcmp(argv[i], "-COM") == 0) {
-            originAddress = 0x100;
-            systemMode = 0;  // COM mode, not system mode
-        } else if (strcmp(argv[i], "-sys") == 0 || strcmp(argv[i], "-SYS") == 0) {
-            originAddress = 0x7C00;  // Standard bootloader address
-        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
-            outputFile = argv[++i];
-        } else if (strcmp(argv[i], "-d") == 0) {
-            debugMode = 1;
-        } else if (strcmp(argv[i], "-dl") == 0) {
-            debugLineMode = 1;
-#ifndef NO_nas
-        } else if (strcmp(argv[i], "-S") == 0) {
-            stopAfterAsm = 1;
+// Create a uniquely named file for the assembly so that compilations
+// running side by side (make -j) never write to the same one
+const char* createTempAsm() {
+#ifdef _WIN32
+    char dir[MAX_PATH];
+    if (!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, "ncc", 0, tempAsmPath)) {
+        tempAsmPath[0] = '\0';
+        return NULL;
+    }
+#else
+    const char* dir = getenv("TMPDIR");
+    if (!dir || !*dir) dir = "/tmp";
+    if (snprintf(tempAsmPath, sizeof(tempAsmPath), "%s/ncc-XXXXXX", dir) >= (int)sizeof(tempAsmPath)) {
+        tempAsmPath[0] = '\0';
+        return NULL;
+    }
+    int fd = mkstemp(tempAsmPath);
+    if (fd < 0) {
+        tempAsmPath[0] = '\0';
+        return NULL;
+    }
+    close(fd);
+    tempAsmOwner = getpid();
 #endif
-        } else if (strcmp(argv[i], "-h") == 0) {
-            printUsage(argv[0]);
-            return 0;
-        } else if (strcmp(argv[i], "--help") == 0) {
-            printUsage(argv[0]);
-            return 0;
-        } else if (strcmp(argv[i], "--version") == 0) {
-            #ifdef _WIN32
-            printf("ncc [ncc-win-x64] ntos(6.2025.1.4) - 1.48\n");
-            printf("Copyright (C) 2025 Nathan's Compiler Collection\n");
-            printf("This is free software; see the source for copying conditions.  There is NO\n");
-            printf("warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n");
-            #else
-            printf("ncc [ncc-linux-x64] any-linux(6.2025.1.4) - 1.48\n");
-            printf("Copyright (C) 2025 Nathan's Compiler Collection\n");
-            printf("This is free software; see the source for copying conditions.  There is NO\n");
-            printf("warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n\r");
-            #endif
-            return 0;
-        } 
-        else if (argv[i][0] == '-') {
-            fprintf(stderr, "Unknown option: %s\n", argv[i]);
-            printUsage(argv[0]);
-            return 1;
-        } else {
-            sourceFile = argv[i];
-        }
+    atexit(removeTempAsm);
+    return tempAsmPath;
+}
+#endif
+
+// Write the generated assembly to a file, for -S or nas
+static int writeAssemblyFile(const char* path, const char* text, size_t length) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", path);
+        return 1;
     }
+    size_t written = fwrite(text, 1, length, file);
+    if (fclose(file) != 0 || written != length) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
 
-    if (!sourceFile) {
-        fprintf(stderr, "Error: No source file specified\n");
-        printUsage(argv[0]);
+// Settings that apply to every source file of one invocation
+typedef struct {
+    int debugMode;
+    int debugLineMode;
+    unsigned int originAddress;
+    int optimizationLevel;
+    int targetCpu;
+    int stopAfterAsm;
+    int externalAssembler;
+    int systemMode;  // Flag for bootloader mode
+    int setStackSegmentPointer;
+    unsigned int stackSegment;
+    unsigned int stackPointer;
+    int precompileHeader;       // -x c-header: write a PCH instead of code
+    const char* includePch;     // -include-pch <file>
+    int dumpRegisters;
+    int preprocessOnly;         // -E
+    int listDependencies;       // -M
+    int writeDependencyFile;    // -MD
+    const char* dependencyFile; // -MF <file>
+    const char* dependencyTarget; // -MT <target>
+    const char* cacheDir;       // Compile cache, NULL when not caching
+    unsigned long cacheSize;
+    int timeReport;             // -ftime-report
+    int timeTrace;              // -ftime-trace
+    const char* timeTraceFile;  // -ftime-trace=<file>
+    int codegenStats;           // -fcodegen-stats
+    const char* codegenStatsFile; // -fcodegen-stats=<file>
+    int memReport;              // -fmem-report
+    unsigned long memLimit;     // Bytes, 0 for no limit
+    int codegenJobs;            // -fcodegen-jobs=<n>, 0 for one per CPU
+} CompileOptions;
+
+// Everything besides the preprocessed source that changes the generated
+// assembly; withOutput adds what changes the output file on top of that
+static void describeOptions(char* buffer, size_t size, const CompileOptions* options, int withOutput) {
+    int used = snprintf(buffer, size, "O%d org%x sys%d cpu%d stack%d:%x:%x",
+                        options->optimizationLevel, options->originAddress, options->systemMode,
+                        options->targetCpu, options->setStackSegmentPointer, options->stackSegment,
+                        options->stackPointer);
+    if (withOutput && used > 0 && (size_t)used < size) {
+        snprintf(buffer + used, size - used, " S%d nas%d", options->stopAfterAsm, options->externalAssembler);
+    }
+}
+
+// path with its extension replaced by 'extension'
+static char* replaceExtension(const char* path, const char* extension) {
+    const char* slash = strrchr(path, PATH_SEPARATOR);
+    const char* dot = strrchr(path, '.');
+    size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - path) : strlen(path);
+
+    char* name = (char*)nccMalloc(MEM_OTHER, stem + strlen(extension) + 1);
+    if (!name) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(name, path, stem);
+    strcpy(name + stem, extension);
+    return name;
+}
+
+static char* batchOutputName(const char* sourceFile, const CompileOptions* options);
+
+// Write the -MD rule for a compile that produced outputFile (NULL for stdout)
+static int writeDependencyRule(const char* sourceFile, const char* outputFile, const CompileOptions* options) {
+    char* defaultOutput = outputFile ? NULL : batchOutputName(sourceFile, options);
+    const char* target = options->dependencyTarget ? options->dependencyTarget : (outputFile ? outputFile : defaultOutput);
+    const char* base = outputFile ? outputFile : defaultOutput;
+
+    // <output>.d, with the output's extension replaced
+    char* path = options->dependencyFile ? NULL : replaceExtension(base, ".d");
+
+    const char* depPath = options->dependencyFile ? options->dependencyFile : path;
+    FILE* out = fopen(depPath, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write dependency file %s\n", depPath);
+        nccFree(path);
+        nccFree(defaultOutput);
+        return 1;
+    }
+    writeDependencies(out, target, sourceFile);
+    fclose(out);
+    nccFree(path);
+    nccFree(defaultOutput);
+    return 0;
+}
+
+// -E and -M: run the preprocessor alone. -E streams the text to the
+// output; -M follows only the directives and prints the dependency rule.
+// Either fails, without a rule or a .d file, if it reported errors.
+static int runPreprocessorOnly(const char* sourceFile, const char* outputFile, const CompileOptions* options) {
+    initPreprocessor();
+    addIncludePath(".");
+    if (options->includePch && loadPrecompiledHeader(options->includePch) != 0) {
+        return 1;
+    }
+
+    // -M prints the rule where -E would print the text
+    const char* textPath = options->listDependencies && options->dependencyFile ? options->dependencyFile : outputFile;
+    FILE* out = textPath ? fopen(textPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Could not open output file %s\n", textPath);
         return 1;
     }
 
+    if (options->listDependencies) {
+        setDirectivesOnly(1);
+    } else {
+        setPreprocessOutput(out);
+    }
+    int errorsBefore = getErrorCount();
+    startTimer(PHASE_PREPROCESS, sourceFile);
+    char* processed = preprocessFile(sourceFile);
+    stopTimer();
+    setDirectivesOnly(0);
+    setPreprocessOutput(NULL);
+
+    int status = processed && getErrorCount() == errorsBefore ? 0 : 1;
+    nccFree(processed);
+    if (status == 0 && options->listDependencies) {
+        char* defaultTarget = batchOutputName(sourceFile, options);
+        writeDependencies(out, options->dependencyTarget ? options->dependencyTarget : defaultTarget, sourceFile);
+        nccFree(defaultTarget);
+    }
+    if (out != stdout) fclose(out);
+    else fflush(stdout);
+    // No half-written -MF file for make to pick up
+    if (status != 0 && options->listDependencies && textPath) remove(textPath);
+
+    if (status == 0 && !options->listDependencies && options->writeDependencyFile) {
+        status = writeDependencyRule(sourceFile, outputFile, options);
+    }
+    cleanupPreprocessor();
+    return status;
+}
+
+// Compile one translation unit. Everything the compiler keeps in
+// file-level statics is set up here, so a process compiles one file.
+static int compileSource(const char* sourceFile, const char* outputFile, const CompileOptions* options) {
+    if (options->precompileHeader) {
+        startTimer(PHASE_PREPROCESS, sourceFile);
+        return writePrecompiledHeader(sourceFile, outputFile);
+    }
+    if (options->preprocessOnly || options->listDependencies) {
+        return runPreprocessorOnly(sourceFile, outputFile, options);
+    }
+
     FILE* file = fopen(sourceFile, "r");
     if (!file) {
         fprintf(stderr, "Error: Could not open source file %s\n", sourceFile);
@@ -169,7 +332,7 @@ int main(int argc, char* argv[]) {
     fseek(file, 0, SEEK_END);
     long fileSize = ftell(file);
     fseek(file, 0, SEEK_SET);
-    char* sourceCode = (char*)malloc(fileSize + 1);
+    char* sourceCode = (char*)nccMalloc(MEM_SOURCE, fileSize + 1);
     if (!sourceCode) {
         fprintf(stderr, "Error: Memory allocation failed\n");
         fclose(file);
@@ -181,96 +344,683 @@ int main(int argc, char* argv[]) {
 
     initPreprocessor();
     addIncludePath(".");
+    if (options->includePch && loadPrecompiledHeader(options->includePch) != 0) {
+        nccFree(sourceCode);
+        return 1;
+    }
 
     char* processedSource = NULL;
+    int errorsBefore = getErrorCount();
+    startTimer(PHASE_PREPROCESS, sourceFile);
     if (strchr(sourceFile, '.')) {
         processedSource = preprocessFile(sourceFile);
     } else {
         processedSource = preprocessSource(sourceCode);
     }
+    stopTimer();
+    // initErrorManager below starts the count again for the compile
+    int preprocessErrors = getErrorCount() - errorsBefore;
 
     if (processedSource) {
-        free(sourceCode);
+        nccFree(sourceCode);
         sourceCode = processedSource;
     }
 
-    initErrorManager(sourceFile, sourceCode, !debugMode);
+    // Diagnostics and dumps are not cached, so compiles that print them
+    // always run
+    char cacheKey[CACHE_KEY_LEN + 1];
+    char flags[128];
+    char codegenFlags[128];
+    int useCache = options->cacheDir && !options->debugMode && !options->debugLineMode && !options->dumpRegisters &&
+                   !options->codegenStats;
+    if (useCache) {
+        describeOptions(flags, sizeof(flags), options, 1);
+        describeOptions(codegenFlags, sizeof(codegenFlags), options, 0);
+        // Labels are named after the source file, so two files with the
+        // same text still differ
+        const char* labelName = sourceFile;
+        const char* slash = strrchr(labelName, '/');
+        const char* backslash = strrchr(labelName, '\\');
+        if (backslash > slash) slash = backslash;
+        if (slash) labelName = slash + 1;
+        char keyFlags[sizeof(flags) + 256];
+        snprintf(keyFlags, sizeof(keyFlags), "%s name=%s", flags, labelName);
+        startTimer(PHASE_CACHE, "cache lookup");
+        computeCacheKey(cacheKey, keyFlags, sourceCode);
+        int hit = cacheLookup(options->cacheDir, cacheKey, outputFile);
+        stopTimer();
+#ifndef QUIET_MODE
+        printf("Compile cache: %s (%s)\n", hit ? "hit" : "miss", cacheKey);
+#endif
+        if (hit) {
+            int status = 0;
+            if (options->writeDependencyFile) {
+                status = preprocessErrors > 0 ? 1 : writeDependencyRule(sourceFile, outputFile, options);
+            }
+            cleanupPreprocessor();
+            nccFree(sourceCode);
+            return status;
+        }
+        initFunctionCache(options->cacheDir, codegenFlags, sourceCode, sourceFile);
+    }
+
+    initErrorManager(sourceFile, sourceCode, !options->debugMode);
     initLexer(sourceCode);
     initParser();
 
-#ifndef NO_nas
-    // Use temp.asm if we're going to assemble
-    const char* asmFile = stopAfterAsm ? outputFile : "temp.asm";
-#else
-    const char* asmFile = outputFile;
-#endif
-    
     // Initialize code generator based on mode
-    if (systemMode) {
-        initCodeGenSystemMode(asmFile, originAddress, setStackSegmentPointer, stackSegment, stackPointer);
+    if (options->systemMode) {
+        initCodeGenSystemMode(options->originAddress, options->setStackSegmentPointer, options->stackSegment, options->stackPointer);
     } else {
-        initCodeGen(asmFile, originAddress);
+        initCodeGen(options->originAddress);
     }
     
-    setOptimizationLevel(optimizationLevel, debugMode);
+    setOptimizationLevel(options->optimizationLevel, options->debugMode);
+    setTargetCpu(options->targetCpu);
+    // Cached functions and -fcodegen-stats follow asmFile as it is written,
+    // so they keep codegen in this process
+    setCodegenJobs(useCache || options->codegenStats ? 1 : options->codegenJobs);
+    if (options->codegenStats) beginCodegenStats();
 
+    startTimer(PHASE_PARSE, "parse");
     ASTNode* ast = parseProgram();
+    stopTimer();
     if (!ast) {
         fprintf(stderr, "Compilation failed\n");
         finalizeCodeGen();
-        free(sourceCode);
+        size_t unused;
+        nccFree(takeGeneratedAssembly(&unused));
+        nccFree(sourceCode);
         return 1;
     }
 
-    if (debugMode) printAST(ast, 0);
+    startTimer(PHASE_TYPES, "type check");
+    annotateTypes(ast);
+    stopTimer();
+    if (options->debugMode) printAST(ast, 0);
+    startTimer(PHASE_CODEGEN, "codegen");
     generateCode(ast);
+    stopTimer();
     finalizeCodeGen();
     cleanupPreprocessor();
-    free(sourceCode);
+    nccFree(sourceCode);
+
+    size_t asmLength = 0;
+    char* asmText = takeGeneratedAssembly(&asmLength);
+    if (!asmText) {
+        fprintf(stderr, "Error: Out of memory for the generated assembly\n");
+        return 1;
+    }
+
+    if (options->codegenStats) {
+        char* statsPath = options->codegenStatsFile ? NULL : replaceExtension(outputFile, ".stats.json");
+        int failed = writeCodegenStats(asmText, options->codegenStatsFile ? options->codegenStatsFile : statsPath,
+                                       sourceFile);
+        nccFree(statsPath);
+        if (failed) {
+            nccFree(asmText);
+            return 1;
+        }
+    }
 
 #ifndef NO_nas
-    // Assemble if not stopping after ASM
-    if (!stopAfterAsm) {
+    // Assemble if not stopping after ASM. The built-in assembler handles
+    // everything codegen emits straight from memory; nas is only needed
+    // for inline asm it does not understand, and reads a temporary file.
+    int assembled = options->stopAfterAsm;
+    if (assembled && writeAssemblyFile(outputFile, asmText, asmLength) != 0) {
+        nccFree(asmText);
+        return 1;
+    }
+    if (!assembled && !options->externalAssembler) {
+        startTimer(PHASE_ASSEMBLE, "assemble");
+        int result = assembleFlatBinary(asmText, outputFile);
+        stopTimer();
+        if (result == ASM_OK) {
+            assembled = 1;
+        } else if (options->debugMode) {
+            printf("Built-in assembler gave up (%s), using NAS\n", getAssemblerFailure());
+        }
+    }
+
+    const char* asmFile = assembled ? NULL : createTempAsm();
+    if (!assembled && (!asmFile || writeAssemblyFile(asmFile, asmText, asmLength) != 0)) {
+        if (!asmFile) fprintf(stderr, "Error: Could not create a temporary file for the assembly\n");
+        nccFree(asmText);
+        return 1;
+    }
+    nccFree(asmText);
+
+    if (!assembled) {
         char command[1024];
         char* exeDir = getExecutableDir();
         
 #ifdef _WIN32
-        if (debugMode)
+        if (options->debugMode)
         {
             snprintf(command, sizeof(command),
-            "cmd /C \"\"%s%ctooling%cnas.exe\" -m16 -v -f bin temp.asm -o \"%s\"\"",
-            exeDir, PATH_SEPARATOR, PATH_SEPARATOR, outputFile);
+            "cmd /C \"\"%s%ctooling%cnas.exe\" -m16 -v -f bin \"%s\" -o \"%s\"\"",
+            exeDir, PATH_SEPARATOR, PATH_SEPARATOR, asmFile, outputFile);
         }
         else
         {
             snprintf(command, sizeof(command),
-            "cmd /C \"\"%s%ctooling%cnas.exe\" -m16 -f bin temp.asm -o \"%s\"\"",
-            exeDir, PATH_SEPARATOR, PATH_SEPARATOR, outputFile);
+            "cmd /C \"\"%s%ctooling%cnas.exe\" -m16 -f bin \"%s\" -o \"%s\"\"",
+            exeDir, PATH_SEPARATOR, PATH_SEPARATOR, asmFile, outputFile);
         }
 #else
-        if (debugMode)
+        if (options->debugMode)
         {
             snprintf(command, sizeof(command),
-                    "\"%s%ctooling%cnas\" -m16 -v -f bin temp.asm -o \"%s\"",
-                    exeDir, PATH_SEPARATOR, PATH_SEPARATOR, outputFile);
+                    "\"%s%ctooling%cnas\" -m16 -v -f bin \"%s\" -o \"%s\"",
+                    exeDir, PATH_SEPARATOR, PATH_SEPARATOR, asmFile, outputFile);
         }
         else
         {
             snprintf(command, sizeof(command),
-                    "\"%s%ctooling%cnas\" -m16 -f bin temp.asm -o \"%s\"",
-                    exeDir, PATH_SEPARATOR, PATH_SEPARATOR, outputFile);
+                    "\"%s%ctooling%cnas\" -m16 -f bin \"%s\" -o \"%s\"",
+                    exeDir, PATH_SEPARATOR, PATH_SEPARATOR, asmFile, outputFile);
         }
 #endif
 
+        startTimer(PHASE_NAS, "nas");
         int result = system(command);
+        stopTimer();
         if (result != 0) {
             fprintf(stderr, "NAS failed\n");
             return 1;
         }
-        remove("temp.asm");
     }
+#else
+    int failed = writeAssemblyFile(outputFile, asmText, asmLength);
+    nccFree(asmText);
+    if (failed) return 1;
 #endif
 
-    if (debugMode) printf("Compilation successful. Output written to %s\n", outputFile);
+    if (useCache) {
+        startTimer(PHASE_CACHE, "cache store");
+        cacheStore(options->cacheDir, cacheKey, outputFile, options->cacheSize);
+        stopTimer();
+    }
+    // A compile that reported errors gets no -MD rule and fails
+    if (options->writeDependencyFile &&
+        (preprocessErrors + getErrorCount() > 0 || writeDependencyRule(sourceFile, outputFile, options) != 0)) {
+        return 1;
+    }
+    if (options->debugMode) printf("Compilation successful. Output written to %s\n", outputFile);
     return 0;
 }
+
+// Compile one translation unit, timing it for -ftime-report and
+// -ftime-trace and counting its memory for -fmem-report and the memory
+// limit. A bare -ftime-trace writes <output>.json.
+static int compileFile(const char* sourceFile, const char* outputFile, const CompileOptions* options) {
+    char* tracePath = NULL;
+    if (options->timeTrace && !options->timeTraceFile) {
+        tracePath = replaceExtension(outputFile ? outputFile : sourceFile, ".json");
+    }
+    beginMemReport(options->memReport, options->memLimit);
+    beginTimeReport(options->timeReport, options->timeTraceFile ? options->timeTraceFile : tracePath);
+    int status = compileSource(sourceFile, outputFile, options);
+    if (endTimeReport(sourceFile) != 0) status = 1;
+    endMemReport(sourceFile);
+    nccFree(tracePath);
+    return status;
+}
+
+// Arguments after @file expansion
+static char** arguments = NULL;
+static int argumentCount = 0;
+static int argumentCapacity = 0;
+
+static void addArgument(char* argument) {
+    if (argumentCount == argumentCapacity) {
+        argumentCapacity = argumentCapacity ? argumentCapacity * 2 : 32;
+        arguments = (char**)nccRealloc(MEM_OTHER, arguments, argumentCapacity * sizeof(char*));
+        if (!arguments) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    arguments[argumentCount++] = argument;
+}
+
+// Add the arguments listed in a response file. They are separated by
+// whitespace and may be quoted; @file inside one is expanded as well.
+static int readResponseFile(const char* path, int depth) {
+    if (depth > 16) {
+        fprintf(stderr, "Error: Response files nested too deeply at %s\n", path);
+        return 0;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open response file %s\n", path);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = (char*)nccMalloc(MEM_OTHER, fileSize + 1);
+    if (!text) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        fclose(file);
+        return 0;
+    }
+    text[fread(text, 1, fileSize, file)] = '\0';
+    fclose(file);
+
+    int ok = 1;
+    char* p = text;
+    while (ok && *p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+
+        // Copy the word over itself, dropping the quotes
+        char* word = p;
+        char* out = p;
+        char quote = 0;
+        while (*p && (quote || !isspace((unsigned char)*p))) {
+            if (quote && *p == quote) {
+                quote = 0;
+                p++;
+            } else if (!quote && (*p == '"' || *p == '\'')) {
+                quote = *p++;
+            } else {
+                *out++ = *p++;
+            }
+        }
+        if (*p) p++;
+        *out = '\0';
+
+        if (word[0] == '@') {
+            ok = readResponseFile(word + 1, depth + 1);
+        } else {
+            addArgument(nccStrdup(MEM_OTHER, word));
+        }
+    }
+
+    nccFree(text);
+    return ok;
+}
+
+// Output name for a source file in a batch build: the source name with
+// its extension replaced by the one for the output kind
+static char* batchOutputName(const char* sourceFile, const CompileOptions* options) {
+#ifdef NO_nas
+    const char* extension = ".asm";
+#else
+    const char* extension = options->stopAfterAsm ? ".asm" : (options->originAddress == 0x100 ? ".com" : ".bin");
+#endif
+    if (options->precompileHeader) extension = ".pch";
+    if (options->preprocessOnly) extension = ".i";
+    return replaceExtension(sourceFile, extension);
+}
+
+// A translation unit of a batch build
+typedef struct {
+    const char* sourceFile;
+    char* outputFile;
+#ifndef _WIN32
+    pid_t pid;
+    FILE* out;      // What the worker printed, replayed in source order
+    FILE* err;
+#endif
+    int status;
+    int done;
+} BatchJob;
+
+#ifndef _WIN32
+static void replayLog(FILE* log, FILE* stream) {
+    if (!log) return;
+    char buffer[4096];
+    size_t got;
+    rewind(log);
+    while ((got = fread(buffer, 1, sizeof(buffer), log)) > 0) {
+        fwrite(buffer, 1, got, stream);
+    }
+    fclose(log);
+}
+#endif
+
+// Compile several files, up to 'workers' at a time. Each one is compiled
+// in its own forked process, which gives it a fresh copy of the
+// compiler's static state; headers are read once up front and shared
+// through the preprocessor's file cache. Diagnostics are printed per
+// file in source order, so the output does not depend on scheduling.
+static int compileBatch(BatchJob* jobs, int count, int workers, const CompileOptions* options,
+                        const char* programName, char** optionArgs, int optionCount) {
+    int failures = 0;
+
+#ifdef _WIN32
+    // No fork(): run the compiler once per file, one after another
+    for (int i = 0; i < count; i++) {
+        char command[4096];
+        int used = snprintf(command, sizeof(command), "cmd /C \"\"%s\"", programName);
+        for (int j = 0; j < optionCount && used < (int)sizeof(command); j++) {
+            used += snprintf(command + used, sizeof(command) - used, " \"%s\"", optionArgs[j]);
+        }
+        if (jobs[i].outputFile && used < (int)sizeof(command)) {
+            used += snprintf(command + used, sizeof(command) - used, " -o \"%s\"", jobs[i].outputFile);
+        }
+        if (used < (int)sizeof(command)) {
+            snprintf(command + used, sizeof(command) - used, " \"%s\"\"", jobs[i].sourceFile);
+        }
+        if (system(command) != 0) failures++;
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        preloadIncludes(jobs[i].sourceFile);
+    }
+
+    int started = 0;
+    int running = 0;
+    int printed = 0;
+    while (printed < count) {
+        while (running < workers && started < count) {
+            BatchJob* job = &jobs[started++];
+            job->out = tmpfile();
+            job->err = tmpfile();
+            fflush(stdout);
+            fflush(stderr);
+
+            job->pid = fork();
+            if (job->pid == 0) {
+                if (job->out) dup2(fileno(job->out), STDOUT_FILENO);
+                if (job->err) dup2(fileno(job->err), STDERR_FILENO);
+                exit(compileFile(job->sourceFile, job->outputFile, options));
+            }
+            if (job->pid < 0) {
+                fprintf(stderr, "Error: Could not start a worker for %s\n", job->sourceFile);
+                job->status = 1;
+                job->done = 1;
+            } else {
+                running++;
+            }
+        }
+
+        // Print every finished file that has no unfinished file before it
+        while (printed < started && jobs[printed].done) {
+            replayLog(jobs[printed].out, stdout);
+            replayLog(jobs[printed].err, stderr);
+            if (jobs[printed].status != 0) failures++;
+            printed++;
+        }
+        if (printed == count || running == 0) continue;
+
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            fprintf(stderr, "Error: Lost track of batch workers\n");
+            return 1;
+        }
+        for (int i = 0; i < started; i++) {
+            if (jobs[i].pid == pid && !jobs[i].done) {
+                jobs[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+                jobs[i].done = 1;
+                running--;
+                break;
+            }
+        }
+    }
+#endif
+
+    return failures ? 1 : 0;
+}
+
+// Handle one command line: parse the options and compile the sources
+static int runDriver(int argc, char* argv[]) {
+    char* outputFile = NULL;
+    int workers = 1;
+    CompileOptions options;
+    memset(&options, 0, sizeof(options));
+    options.optimizationLevel = OPT_LEVEL_NONE;
+    options.targetCpu = CPU_186;
+    options.codegenJobs = 1;
+    options.cacheDir = getenv("NCC_CACHE_DIR");
+    options.cacheSize = CACHE_DEFAULT_SIZE;
+    const char* memLimit = getenv("NCC_MEM_LIMIT");
+    if (memLimit) options.memLimit = strtoul(memLimit, NULL, 0) * 1024 * 1024;
+    int cacheStats = 0;
+
+    // Source files, and the options to pass on when a batch build has to
+    // re-run the compiler per file
+    char** sourceFiles = (char**)nccMalloc(MEM_OTHER, (argc + 1) * sizeof(char*));
+    char** optionArgs = (char**)nccMalloc(MEM_OTHER, (argc + 1) * sizeof(char*));
+    int sourceCount = 0;
+    int optionCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '@') {
+            if (!readResponseFile(argv[i] + 1, 0)) return 1;
+        } else {
+            addArgument(argv[i]);
+        }
+    }
+    if (argumentCount > argc) {
+        sourceFiles = (char**)nccRealloc(MEM_OTHER, sourceFiles, (argumentCount + 1) * sizeof(char*));
+        optionArgs = (char**)nccRealloc(MEM_OTHER, optionArgs, (argumentCount + 1) * sizeof(char*));
+    }
+    if (!sourceFiles || !optionArgs) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+
+    char** args = arguments;
+    int count = argumentCount;
+    for (int i = 0; i < count; i++) {
+        int first = i;
+        if (strncmp(args[i], "-I", 2) == 0) {
+            const char* path = args[i] + 2;
+            if (*path) {
+                addIncludePath(path);
+            } else if (i + 1 < count) {
+                addIncludePath(args[++i]);
+            }
+        } else if (strncmp(args[i], "-O", 2) == 0) {
+            if (isdigit(args[i][2])) options.optimizationLevel = args[i][2] - '0';
+            else if (i + 1 < count && isdigit(args[i+1][0])) options.optimizationLevel = args[++i][0] - '0';
+        } else if (strncmp(args[i], "-j", 2) == 0) {
+            const char* value = args[i][2] ? args[i] + 2 : (i + 1 < count ? args[++i] : "");
+            workers = atoi(value);
+            if (workers < 1) {
+                fprintf(stderr, "Error: -j needs a positive number of workers\n");
+                return 1;
+            }
+            continue;
+        } else if ((strcmp(args[i], "-disp") == 0 || strcmp(args[i], "-DISP") == 0) && i + 1 < count) {
+            options.originAddress = (unsigned int)strtoul(args[++i], NULL, 0);
+        } else if (strcmp(args[i], "-com") == 0 || strcmp(args[i], "-COM") == 0) {
+            options.originAddress = 0x100;
+            options.systemMode = 0;  // COM mode, not system mode
+        } else if (strcmp(args[i], "-sys") == 0 || strcmp(args[i], "-SYS") == 0) {
+            options.originAddress = 0x7C00;  // Standard bootloader address
+        } else if (strcmp(args[i], "-m8086") == 0) {
+            options.targetCpu = CPU_8086;
+        } else if (strcmp(args[i], "-m186") == 0) {
+            options.targetCpu = CPU_186;
+        } else if (strcmp(args[i], "-m386") == 0) {
+            options.targetCpu = CPU_386;
+        } else if (strcmp(args[i], "-x") == 0 && i + 1 < count) {
+            const char* language = args[++i];
+            if (strcmp(language, "c-header") == 0) {
+                options.precompileHeader = 1;
+            } else if (strcmp(language, "c") == 0) {
+                options.precompileHeader = 0;
+            } else {
+                fprintf(stderr, "Error: Unknown language '%s' for -x\n", language);
+                return 1;
+            }
+        } else if (strcmp(args[i], "-include-pch") == 0 && i + 1 < count) {
+            options.includePch = args[++i];
+        } else if (strcmp(args[i], "-E") == 0) {
+            options.preprocessOnly = 1;
+        } else if (strcmp(args[i], "-M") == 0) {
+            options.listDependencies = 1;
+        } else if (strcmp(args[i], "-MD") == 0) {
+            options.writeDependencyFile = 1;
+        } else if (strcmp(args[i], "-MF") == 0 && i + 1 < count) {
+            options.dependencyFile = args[++i];
+            continue;
+        } else if (strcmp(args[i], "-MT") == 0 && i + 1 < count) {
+            options.dependencyTarget = args[++i];
+        } else if (strcmp(args[i], "-cache") == 0 && i + 1 < count) {
+            options.cacheDir = args[++i];
+        } else if (strcmp(args[i], "-cache-size") == 0 && i + 1 < count) {
+            options.cacheSize = strtoul(args[++i], NULL, 0) * 1024 * 1024;
+        } else if (strcmp(args[i], "-ftime-report") == 0) {
+            options.timeReport = 1;
+        } else if (strcmp(args[i], "-ftime-trace") == 0) {
+            options.timeTrace = 1;
+            options.timeTraceFile = NULL;
+        } else if (strncmp(args[i], "-ftime-trace=", 13) == 0 && args[i][13]) {
+            options.timeTrace = 1;
+            options.timeTraceFile = args[i] + 13;
+        } else if (strcmp(args[i], "-fcodegen-stats") == 0) {
+            options.codegenStats = 1;
+            options.codegenStatsFile = NULL;
+        } else if (strncmp(args[i], "-fcodegen-stats=", 16) == 0 && args[i][16]) {
+            options.codegenStats = 1;
+            options.codegenStatsFile = args[i] + 16;
+        } else if (strncmp(args[i], "-fcodegen-jobs=", 15) == 0) {
+            char* end;
+            long jobs = strtol(args[i] + 15, &end, 10);
+            if (end == args[i] + 15 || *end || jobs < 0) {
+                fprintf(stderr, "Error: -fcodegen-jobs needs a number of workers (0 for one per CPU)\n");
+                return 1;
+            }
+            options.codegenJobs = (int)jobs;
+        } else if (strcmp(args[i], "-fmem-report") == 0) {
+            options.memReport = 1;
+        } else if (strncmp(args[i], "-fmem-limit=", 12) == 0) {
+            options.memLimit = strtoul(args[i] + 12, NULL, 0) * 1024 * 1024;
+        } else if (strcmp(args[i], "-cache-stats") == 0) {
+            cacheStats = 1;
+            continue;
+        } else if (strcmp(args[i], "-o") == 0 && i + 1 < count) {
+            outputFile = args[++i];
+            continue;
+        } else if (strcmp(args[i], "-d") == 0) {
+            options.debugMode = 1;
+        } else if (strcmp(args[i], "-dl") == 0) {
+            options.debugLineMode = 1;
+        } else if (strcmp(args[i], "-dr") == 0) {
+            setRegisterAllocationDump(1);
+            options.dumpRegisters = 1;
+#ifndef NO_nas
+        } else if (strcmp(args[i], "-S") == 0) {
+            options.stopAfterAsm = 1;
+        } else if (strcmp(args[i], "-nas") == 0) {
+            options.externalAssembler = 1;
+#endif
+        } else if (strcmp(args[i], "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (strcmp(args[i], "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (strcmp(args[i], "--version") == 0) {
+            #ifdef _WIN32
+            printf("ncc [ncc-win-x64] ntos(6.2025.1.4) - 1.48\n");
+            printf("Copyright (C) 2025 Nathan's Compiler Collection\n");
+            printf("This is free software; see the source for copying conditions.  There is NO\n");
+            printf("warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n");
+            #else
+            printf("ncc [ncc-linux-x64] any-linux(6.2025.1.4) - 1.48\n");
+            printf("Copyright (C) 2025 Nathan's Compiler Collection\n");
+            printf("This is free software; see the source for copying conditions.  There is NO\n");
+            printf("warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n\r");
+            #endif
+            return 0;
+        } 
+        else if (args[i][0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", args[i]);
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            sourceFiles[sourceCount++] = args[i];
+            continue;
+        }
+
+        while (first <= i) optionArgs[optionCount++] = args[first++];
+    }
+
+    if (cacheStats && !options.cacheDir) {
+        fprintf(stderr, "Error: -cache-stats needs a cache directory (-cache <dir> or NCC_CACHE_DIR)\n");
+        return 1;
+    }
+    if (cacheStats && sourceCount == 0) {
+        printCacheStats(options.cacheDir, options.cacheSize);
+        return 0;
+    }
+
+    if (sourceCount == 0) {
+        fprintf(stderr, "Error: No source file specified\n");
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (sourceCount == 1) {
+        // -E and -M write to stdout unless given a file
+        if (!outputFile && !options.preprocessOnly && !options.listDependencies) {
+            outputFile = options.precompileHeader ? batchOutputName(sourceFiles[0], &options) : "output.asm";
+        }
+        int status = compileFile(sourceFiles[0], outputFile, &options);
+        if (cacheStats) printCacheStats(options.cacheDir, options.cacheSize);
+        return status;
+    }
+
+    if (outputFile) {
+        fprintf(stderr, "Error: -o cannot be used with more than one source file\n");
+        return 1;
+    }
+    if (options.dependencyFile) {
+        fprintf(stderr, "Error: -MF cannot be used with more than one source file\n");
+        return 1;
+    }
+    if (options.codegenStatsFile) {
+        fprintf(stderr, "Error: -fcodegen-stats=<file> cannot be used with more than one source file\n");
+        return 1;
+    }
+    if (options.timeTraceFile) {
+        fprintf(stderr, "Error: -ftime-trace=<file> cannot be used with more than one source file\n");
+        return 1;
+    }
+
+    BatchJob* jobs = (BatchJob*)nccCalloc(MEM_OTHER, sourceCount, sizeof(BatchJob));
+    if (!jobs) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    for (int i = 0; i < sourceCount; i++) {
+        jobs[i].sourceFile = sourceFiles[i];
+        jobs[i].outputFile = options.listDependencies ? NULL : batchOutputName(sourceFiles[i], &options);
+    }
+    int status = compileBatch(jobs, sourceCount, workers, &options, argv[0], optionArgs, optionCount);
+    if (cacheStats) printCacheStats(options.cacheDir, options.cacheSize);
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    // ncc --server <socket>: keep headers warm and compile on request
+    if (argc >= 2 && strcmp(argv[1], "--server") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: %s --server <socket>\n", argv[0]);
+            return 1;
+        }
+        return runCompileServer(argv[2], argv[0], runDriver);
+    }
+
+    // ncc --client <socket> <options...>: compile through a server, or
+    // here if none is running
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0) {
+        int status = 1;
+        if (runCompileClient(argv[2], argc - 3, argv + 3, &status)) {
+            return status;
+        }
+        argv[2] = argv[0];
+        return runDriver(argc - 2, argv + 2);
+    }
+
+    return runDriver(argc, argv);
+}
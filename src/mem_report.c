@@ -0,0 +1,207 @@
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static const char* tagNames[MEM_TAG_COUNT] = {
+    "ast", "tokens", "macros", "source", "strings", "arrays",
+    "globals", "symbols", "codegen", "assembler", "other"
+};
+
+typedef struct {
+    size_t current;
+    size_t peak;
+    unsigned long allocations;
+    unsigned long liveBlocks;
+} TagUsage;
+
+// Live blocks, in an open-addressed table keyed by address. Sizes are
+// kept beside the blocks rather than in a header before them, so memory
+// from the wrappers stays plain malloc memory that any code may free.
+typedef struct {
+    void* ptr;          // NULL for an empty slot, REMOVED for a deleted one
+    size_t size;
+    int tag;
+} Block;
+
+#define REMOVED ((void*)1)
+#define MIN_TABLE_SIZE 1024
+
+static int accounting = 0;
+static int printReport = 0;
+static unsigned long memoryLimit = 0;
+
+static TagUsage usage[MEM_TAG_COUNT];
+static size_t totalCurrent = 0;
+static size_t totalPeak = 0;
+
+static Block* blocks = NULL;
+static size_t tableSize = 0;    // Power of two
+static size_t slotsUsed = 0;    // Live and removed slots
+
+static size_t slotFor(void* ptr) {
+    uintptr_t key = (uintptr_t)ptr >> 4;
+    return (size_t)(key * 0x9E3779B97F4A7C15ULL) & (tableSize - 1);
+}
+
+static Block* findBlock(void* ptr) {
+    if (!blocks) return NULL;
+    for (size_t i = slotFor(ptr); blocks[i].ptr; i = (i + 1) & (tableSize - 1)) {
+        if (blocks[i].ptr == ptr) return &blocks[i];
+    }
+    return NULL;
+}
+
+static void growTable() {
+    size_t live = 0;
+    for (size_t i = 0; i < tableSize; i++) {
+        if (blocks[i].ptr && blocks[i].ptr != REMOVED) live++;
+    }
+    size_t newSize = MIN_TABLE_SIZE;
+    while (newSize < live * 4) newSize *= 2;
+
+    Block* old = blocks;
+    size_t oldSize = tableSize;
+    blocks = (Block*)calloc(newSize, sizeof(Block));
+    if (!blocks) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    tableSize = newSize;
+    slotsUsed = live;
+    for (size_t i = 0; i < oldSize; i++) {
+        if (!old[i].ptr || old[i].ptr == REMOVED) continue;
+        size_t slot = slotFor(old[i].ptr);
+        while (blocks[slot].ptr) slot = (slot + 1) & (tableSize - 1);
+        blocks[slot] = old[i];
+    }
+    free(old);
+}
+
+static void forgetBlock(Block* block) {
+    usage[block->tag].current -= block->size;
+    usage[block->tag].liveBlocks--;
+    totalCurrent -= block->size;
+    block->ptr = REMOVED;
+}
+
+static void recordBlock(void* ptr, size_t size, MemTag tag) {
+    // The address may belong to a block released with a plain free()
+    Block* stale = findBlock(ptr);
+    if (stale) forgetBlock(stale);
+
+    if ((slotsUsed + 1) * 2 > tableSize) growTable();
+    size_t slot = slotFor(ptr);
+    while (blocks[slot].ptr && blocks[slot].ptr != REMOVED) slot = (slot + 1) & (tableSize - 1);
+    if (!blocks[slot].ptr) slotsUsed++;
+    blocks[slot].ptr = ptr;
+    blocks[slot].size = size;
+    blocks[slot].tag = tag;
+
+    TagUsage* tagUsage = &usage[tag];
+    tagUsage->current += size;
+    tagUsage->allocations++;
+    tagUsage->liveBlocks++;
+    if (tagUsage->current > tagUsage->peak) tagUsage->peak = tagUsage->current;
+    totalCurrent += size;
+    if (totalCurrent > totalPeak) totalPeak = totalCurrent;
+}
+
+// Fail the compile before an allocation that would pass the limit
+static void checkLimit(MemTag tag, size_t size, size_t released) {
+    if (memoryLimit && totalCurrent - released + size > memoryLimit) {
+        fprintf(stderr, "Error: Memory limit of %lu KB exceeded allocating %lu bytes for %s (%lu KB in use)\n",
+                memoryLimit / 1024, (unsigned long)size, tagNames[tag], (unsigned long)(totalCurrent / 1024));
+        exit(1);
+    }
+}
+
+void beginMemReport(int report, unsigned long limitBytes) {
+    accounting = report || limitBytes;
+    printReport = report;
+    memoryLimit = limitBytes;
+    memset(usage, 0, sizeof(usage));
+    totalCurrent = 0;
+    totalPeak = 0;
+    free(blocks);
+    blocks = NULL;
+    tableSize = 0;
+    slotsUsed = 0;
+    if (!accounting) return;
+
+    blocks = (Block*)calloc(MIN_TABLE_SIZE, sizeof(Block));
+    if (!blocks) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    tableSize = MIN_TABLE_SIZE;
+}
+
+void endMemReport(const char* sourceFile) {
+    if (!accounting) return;
+    accounting = 0;
+
+    if (printReport) {
+        fprintf(stderr, "Memory report for %s:\n", sourceFile);
+        fprintf(stderr, "  %-12s %10s %10s %12s %10s\n", "Tag", "Peak KB", "Allocs", "Live blocks", "Live KB");
+        unsigned long allocations = 0;
+        unsigned long liveBlocks = 0;
+        for (int i = 0; i < MEM_TAG_COUNT; i++) {
+            allocations += usage[i].allocations;
+            liveBlocks += usage[i].liveBlocks;
+            if (usage[i].allocations == 0) continue;
+            fprintf(stderr, "  %-12s %10.1f %10lu %12lu %10.1f\n", tagNames[i], usage[i].peak / 1024.0,
+                    usage[i].allocations, usage[i].liveBlocks, usage[i].current / 1024.0);
+        }
+        fprintf(stderr, "  %-12s %10.1f %10lu %12lu %10.1f\n", "total", totalPeak / 1024.0, allocations,
+                liveBlocks, totalCurrent / 1024.0);
+    }
+
+    free(blocks);
+    blocks = NULL;
+    tableSize = 0;
+    slotsUsed = 0;
+}
+
+void* nccMalloc(MemTag tag, size_t size) {
+    if (!accounting) return malloc(size);
+    checkLimit(tag, size, 0);
+    void* ptr = malloc(size);
+    if (ptr) recordBlock(ptr, size, tag);
+    return ptr;
+}
+
+void* nccCalloc(MemTag tag, size_t count, size_t size) {
+    if (!accounting) return calloc(count, size);
+    checkLimit(tag, count * size, 0);
+    void* ptr = calloc(count, size);
+    if (ptr) recordBlock(ptr, count * size, tag);
+    return ptr;
+}
+
+void* nccRealloc(MemTag tag, void* ptr, size_t size) {
+    if (!accounting) return realloc(ptr, size);
+    Block* old = ptr ? findBlock(ptr) : NULL;
+    checkLimit(tag, size, old ? old->size : 0);
+    void* grown = realloc(ptr, size);
+    if (!grown) return NULL;
+    if (old) forgetBlock(old);
+    recordBlock(grown, size, tag);
+    return grown;
+}
+
+char* nccStrdup(MemTag tag, const char* s) {
+    size_t length = strlen(s) + 1;
+    char* copy = (char*)nccMalloc(tag, length);
+    if (copy) memcpy(copy, s, length);
+    return copy;
+}
+
+void nccFree(void* ptr) {
+    if (accounting && ptr) {
+        Block* block = findBlock(ptr);
+        if (block) forgetBlock(block);
+    }
+    free(ptr);
+}
@@ -10,17 +10,26 @@ void setOptimizationLevel(int level, int debugMode) {
         case OPT_LEVEL_NONE:
             // No optimizations
             optimizationState.mergeStrings = 0;
+            optimizationState.omitFramePointer = 0;
+            optimizationState.allocateRegisters = 0;
+            optimizationState.strengthReduce = 0;
             break;
             
         case OPT_LEVEL_BASIC:
             // Basic optimizations
             optimizationState.mergeStrings = 1;
+            optimizationState.omitFramePointer = 1;
+            optimizationState.allocateRegisters = 1;
+            optimizationState.strengthReduce = 1;
             break;
             
         default:
             // Unknown level, use no optimizations
             optimizationState.level = OPT_LEVEL_NONE;
             optimizationState.mergeStrings = 0;
+            optimizationState.omitFramePointer = 0;
+            optimizationState.allocateRegisters = 0;
+            optimizationState.strengthReduce = 0;
             break;
     }
     
@@ -30,5 +39,14 @@ void setOptimizationLevel(int level, int debugMode) {
     if (optimizationState.mergeStrings) {
         printf("  - String merging: enabled\n");
     }
+    if (optimizationState.omitFramePointer) {
+        printf("  - Frame pointer omission: enabled\n");
+    }
+    if (optimizationState.allocateRegisters) {
+        printf("  - Register allocation: enabled\n");
+    }
+    if (optimizationState.strengthReduce) {
+        printf("  - Strength reduction: enabled\n");
+    }
     #endif
 }
@@ -0,0 +1,449 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "parallel_codegen.h"
+#include "codegen.h"
+#include "string_literals.h"
+#include "error_manager.h"
+#include "global_variables.h"
+#include "frame_analysis.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static int codegenJobs = 1;
+
+// String references of the function being recorded; writes to other
+// files (dry runs) are not recorded
+static FILE* recordingFile = NULL;
+static StringReference* references = NULL;
+static int referenceCount = 0;
+static int referenceCapacity = 0;
+static int referencesLost = 0;
+
+void recordStringReferences(FILE* file) {
+    recordingFile = file;
+    referenceCount = 0;
+    referencesLost = 0;
+}
+
+int stopRecordingStringReferences(StringReference** recorded) {
+    recordingFile = NULL;
+    *recorded = references;
+    return referencesLost ? -1 : referenceCount;
+}
+
+void noteStringReference(FILE* file, int index) {
+    if (!file || file != recordingFile) return;
+    if (referenceCount == referenceCapacity) {
+        int grown = referenceCapacity ? referenceCapacity * 2 : 16;
+        StringReference* resized = (StringReference*)nccRealloc(MEM_CODEGEN, references, grown * sizeof(StringReference));
+        if (!resized) {
+            referencesLost = 1;
+            return;
+        }
+        references = resized;
+        referenceCapacity = grown;
+    }
+    references[referenceCount].offset = ftell(file);
+    references[referenceCount].index = index;
+    referenceCount++;
+}
+
+
+#ifdef _WIN32
+
+// No fork(): functions are always generated one after another
+
+void setCodegenJobs(int jobs) {
+    codegenJobs = jobs > 0 ? jobs : 1;
+}
+
+ASTNode* generateFunctionsInParallel(ASTNode* first, TopLevelGenerator generate) {
+    return first;
+}
+
+#else
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern FILE* asmFile;
+extern int stringLiteralCount;
+extern char** stringLiterals;
+extern int arrayCount;
+extern int stringMarkerFound;
+extern int arrayMarkerFound;
+extern int redefineLocalsFound;
+
+// What a worker sends back per function, followed by the code, the new
+// strings (each a size_t length and the bytes) and the string references
+typedef struct {
+    int function;       // Position in the run
+    int redo;           // It changed more than the string table and frame stats
+    int frameless;
+    int stringCount;    // New strings, numbered from the table size at the fork
+    int referenceCount;
+    long codeLength;
+    long outStart;      // What it printed, as ranges of the worker's logs
+    long outEnd;
+    long errStart;
+    long errEnd;
+} ResultHeader;
+
+typedef struct {
+    ResultHeader header;
+    char* code;
+    char** strings;
+    StringReference* references;
+    int loaded;
+} FunctionResult;
+
+typedef struct {
+    pid_t pid;
+    FILE* results;
+    FILE* out;
+    FILE* err;
+    long load;          // Source bytes of the functions it was given
+} Worker;
+
+void setCodegenJobs(int jobs) {
+    if (jobs == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    codegenJobs = jobs > 0 ? jobs : 1;
+}
+
+static int markerState() {
+    return stringMarkerFound | arrayMarkerFound << 1 | isGlobalMarkerFound() << 2 | redefineLocalsFound << 3;
+}
+
+static long logOffset(int fd) {
+    return (long)lseek(fd, 0, SEEK_CUR);
+}
+
+static int writeResult(FILE* results, const ResultHeader* header, const char* code,
+                       const StringReference* references, int firstString) {
+    if (fwrite(header, sizeof(*header), 1, results) != 1) return 0;
+    if (header->codeLength > 0 && fwrite(code, 1, header->codeLength, results) != (size_t)header->codeLength) return 0;
+    for (int i = 0; i < header->stringCount; i++) {
+        const char* string = stringLiterals[firstString + i];
+        size_t length = strlen(string);
+        if (fwrite(&length, sizeof(length), 1, results) != 1 || fwrite(string, 1, length, results) != length) return 0;
+    }
+    if (header->referenceCount > 0 &&
+        fwrite(references, sizeof(StringReference), header->referenceCount, results) != (size_t)header->referenceCount) {
+        return 0;
+    }
+    return 1;
+}
+
+// Body of a worker process: generate the functions given to it in source
+// order, each into the start of a scratch file, and roll the string and
+// array tables back after each one. Global declarations are generated too,
+// so the array table a function sees is the one it would see in the
+// parent; one that adds strings stops the worker, and the parent does the
+// rest. Never returns.
+static void runWorker(ASTNode** nodes, const int* owner, int count, int self, Worker* worker,
+                      TopLevelGenerator generate) {
+    if (worker->out) dup2(fileno(worker->out), STDOUT_FILENO);
+    if (worker->err) dup2(fileno(worker->err), STDERR_FILENO);
+
+    FILE* scratch = tmpfile();
+    int ok = scratch != NULL;
+    for (int i = 0; i < count && ok; i++) {
+        if (nodes[i]->type == NODE_DECLARATION) {
+            int savedStringCount = stringLiteralCount;
+            FILE* realFile = asmFile;
+            asmFile = scratch;
+            generate(nodes[i]);
+            asmFile = realFile;
+            if (stringLiteralCount != savedStringCount) break;
+            continue;
+        }
+        if (owner[i] != self) continue;
+
+        ResultHeader header;
+        memset(&header, 0, sizeof(header));
+        header.function = i;
+        int savedStringCount = stringLiteralCount;
+        int savedArrayCount = arrayCount;
+        int savedFrameless = getFramelessFunctionCount();
+        int savedDiagnostics = getErrorCount() + getWarningCount();
+        int savedMarkers = markerState();
+        fflush(stdout);
+        fflush(stderr);
+        header.outStart = logOffset(STDOUT_FILENO);
+        header.errStart = logOffset(STDERR_FILENO);
+
+        // Whatever an earlier function left past the end is never read
+        rewind(scratch);
+        FILE* realFile = asmFile;
+        asmFile = scratch;
+        recordStringReferences(scratch);
+        generate(nodes[i]);
+        StringReference* recorded = NULL;
+        int recordedCount = stopRecordingStringReferences(&recorded);
+        asmFile = realFile;
+
+        long size = ftell(scratch);
+        char* code = size >= 0 ? (char*)nccMalloc(MEM_CODEGEN, size + 1) : NULL;
+        if (code) {
+            rewind(scratch);
+            header.codeLength = (long)fread(code, 1, size, scratch);
+        }
+        fflush(stdout);
+        fflush(stderr);
+        header.outEnd = logOffset(STDOUT_FILENO);
+        header.errEnd = logOffset(STDERR_FILENO);
+
+        header.redo = !code || header.codeLength != size || recordedCount < 0 || arrayCount != savedArrayCount ||
+                      getErrorCount() + getWarningCount() != savedDiagnostics || markerState() != savedMarkers;
+        if (header.redo) {
+            header.codeLength = 0;
+        } else {
+            header.frameless = getFramelessFunctionCount() != savedFrameless;
+            header.stringCount = stringLiteralCount - savedStringCount;
+            header.referenceCount = recordedCount;
+        }
+        ok = writeResult(worker->results, &header, code, recorded, savedStringCount);
+
+        nccFree(code);
+        truncateStringLiterals(savedStringCount);
+        truncateArrayDeclarations(savedArrayCount);
+    }
+
+    if (scratch) fclose(scratch);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(ok && fflush(worker->results) == 0 ? 0 : 1);
+}
+
+// Read one result back. Returns 0 at the end of the file or on a short
+// or inconsistent record.
+static int readResult(FILE* results, FunctionResult* result) {
+    ResultHeader* header = &result->header;
+    if (fread(header, sizeof(*header), 1, results) != 1) return 0;
+    if (header->codeLength < 0 || header->stringCount < 0 || header->referenceCount < 0) return 0;
+
+    result->code = (char*)nccMalloc(MEM_CODEGEN, header->codeLength + 1);
+    result->strings = (char**)nccCalloc(MEM_CODEGEN, header->stringCount + 1, sizeof(char*));
+    result->references = (StringReference*)nccMalloc(MEM_CODEGEN, (header->referenceCount + 1) * sizeof(StringReference));
+    if (!result->code || !result->strings || !result->references) return 0;
+    if (fread(result->code, 1, header->codeLength, results) != (size_t)header->codeLength) return 0;
+
+    for (int i = 0; i < header->stringCount; i++) {
+        size_t length;
+        if (fread(&length, sizeof(length), 1, results) != 1) return 0;
+        result->strings[i] = (char*)nccMalloc(MEM_STRINGS, length + 1);
+        if (!result->strings[i] || fread(result->strings[i], 1, length, results) != length) return 0;
+        result->strings[i][length] = '\0';
+    }
+
+    if (fread(result->references, sizeof(StringReference), header->referenceCount, results) !=
+        (size_t)header->referenceCount) {
+        return 0;
+    }
+    long last = 0;
+    for (int i = 0; i < header->referenceCount; i++) {
+        if (result->references[i].offset < last || result->references[i].offset > header->codeLength) return 0;
+        last = result->references[i].offset;
+    }
+    return 1;
+}
+
+static void freeResult(FunctionResult* result) {
+    if (result->strings) {
+        for (int i = 0; i < result->header.stringCount; i++) nccFree(result->strings[i]);
+    }
+    nccFree(result->code);
+    nccFree(result->strings);
+    nccFree(result->references);
+    memset(result, 0, sizeof(*result));
+}
+
+// Copy bytes [start, end) of a worker's log to stream
+static void replayRange(FILE* log, long start, long end, FILE* stream) {
+    if (!log || end <= start || fseek(log, start, SEEK_SET) != 0) return;
+    char buffer[4096];
+    while (start < end) {
+        size_t want = end - start < (long)sizeof(buffer) ? (size_t)(end - start) : sizeof(buffer);
+        size_t got = fread(buffer, 1, want, log);
+        if (got == 0) break;
+        fwrite(buffer, 1, got, stream);
+        start += got;
+    }
+}
+
+// Append a worker's code for a function. Its new strings join the table
+// in order, as they would have when generating it here, and the indexes
+// written for them are renumbered to their places in the table.
+static void spliceResult(FunctionResult* result, int firstString) {
+    const ResultHeader* header = &result->header;
+    int* mapped = (int*)nccMalloc(MEM_CODEGEN, (header->stringCount + 1) * sizeof(int));
+    if (!mapped) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < header->stringCount; i++) {
+        mapped[i] = internStringLiteral(result->strings[i]);
+        result->strings[i] = NULL;
+    }
+
+    long at = 0;
+    for (int i = 0; i < header->referenceCount; i++) {
+        const StringReference* reference = &result->references[i];
+        fwrite(result->code + at, 1, reference->offset - at, asmFile);
+        int index = reference->index;
+        if (index >= firstString && index - firstString < header->stringCount) {
+            index = mapped[index - firstString];
+        }
+        fprintf(asmFile, "%d", index);
+        at = reference->offset;
+        while (at < header->codeLength && isdigit((unsigned char)result->code[at])) at++;
+    }
+    fwrite(result->code + at, 1, header->codeLength - at, asmFile);
+    nccFree(mapped);
+}
+
+typedef struct {
+    int function;
+    long weight;
+} Assignment;
+
+// Heaviest first; ties in source order
+static int compareAssignments(const void* a, const void* b) {
+    const Assignment* x = (const Assignment*)a;
+    const Assignment* y = (const Assignment*)b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    return x->function - y->function;
+}
+
+ASTNode* generateFunctionsInParallel(ASTNode* first, TopLevelGenerator generate) {
+    if (codegenJobs <= 1 || !first) return first;
+
+    // The run: everything up to the next special function. Only the
+    // functions in it go to workers.
+    int count = 0;
+    int functionCount = 0;
+    ASTNode* end = first;
+    while (end && (end->type != NODE_FUNCTION || !isSpecialFunction(end))) {
+        if (end->type == NODE_FUNCTION) functionCount++;
+        count++;
+        end = end->next;
+    }
+    if (functionCount < 2) return first;
+
+    int workerCount = codegenJobs < functionCount ? codegenJobs : functionCount;
+    ASTNode** nodes = (ASTNode**)nccMalloc(MEM_CODEGEN, count * sizeof(ASTNode*));
+    int* owner = (int*)nccMalloc(MEM_CODEGEN, count * sizeof(int));
+    Assignment* order = (Assignment*)nccMalloc(MEM_CODEGEN, count * sizeof(Assignment));
+    Worker* workers = (Worker*)nccCalloc(MEM_CODEGEN, workerCount, sizeof(Worker));
+    FunctionResult* results = (FunctionResult*)nccCalloc(MEM_CODEGEN, count, sizeof(FunctionResult));
+    if (!nodes || !owner || !order || !workers || !results) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Longest bodies first, each to the least loaded worker; other nodes
+    // are left to this process (owner -1)
+    int weighted = 0;
+    ASTNode* node = first;
+    for (int i = 0; i < count; i++, node = node->next) {
+        nodes[i] = node;
+        owner[i] = -1;
+        if (node->type != NODE_FUNCTION) continue;
+        order[weighted].function = i;
+        order[weighted].weight = 1;
+        if (node->function.body && node->function.body_end > node->function.body_start) {
+            order[weighted].weight += node->function.body_end - node->function.body_start;
+        }
+        weighted++;
+    }
+    qsort(order, weighted, sizeof(Assignment), compareAssignments);
+    for (int i = 0; i < weighted; i++) {
+        int lightest = 0;
+        for (int w = 1; w < workerCount; w++) {
+            if (workers[w].load < workers[lightest].load) lightest = w;
+        }
+        owner[order[i].function] = lightest;
+        workers[lightest].load += order[i].weight;
+    }
+
+    // Nothing buffered before the fork may be written twice
+    fflush(NULL);
+    int firstString = stringLiteralCount;
+    for (int w = 0; w < workerCount; w++) {
+        Worker* worker = &workers[w];
+        worker->results = tmpfile();
+        worker->out = tmpfile();
+        worker->err = tmpfile();
+        worker->pid = worker->results ? fork() : -1;
+        if (worker->pid == 0) {
+            runWorker(nodes, owner, count, w, worker, generate);
+        }
+    }
+
+    // Collect what every worker that finished cleanly produced
+    for (int w = 0; w < workerCount; w++) {
+        Worker* worker = &workers[w];
+        if (worker->pid <= 0) continue;
+        int status = 0;
+        if (waitpid(worker->pid, &status, 0) != worker->pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            continue;
+        }
+        rewind(worker->results);
+        FunctionResult result;
+        memset(&result, 0, sizeof(result));
+        while (readResult(worker->results, &result)) {
+            int i = result.header.function;
+            if (i < 0 || i >= count || owner[i] != w || results[i].loaded) break;
+            results[i] = result;
+            results[i].loaded = 1;
+            memset(&result, 0, sizeof(result));
+        }
+        freeResult(&result);
+    }
+
+    // Merge in source order; the other nodes and anything a worker could
+    // not do are generated here. A function generated here that adds
+    // arrays changes what the later ones would generate, so from there on
+    // the workers' results are not used.
+    int diverged = 0;
+    for (int i = 0; i < count; i++) {
+        FunctionResult* result = &results[i];
+        if (nodes[i]->type != NODE_FUNCTION) {
+            generate(nodes[i]);
+        } else if (diverged || !result->loaded || result->header.redo) {
+            int savedArrayCount = arrayCount;
+            int savedMarkers = markerState();
+            generate(nodes[i]);
+            if (arrayCount != savedArrayCount || markerState() != savedMarkers) diverged = 1;
+        } else {
+            Worker* worker = &workers[owner[i]];
+            replayRange(worker->out, result->header.outStart, result->header.outEnd, stdout);
+            replayRange(worker->err, result->header.errStart, result->header.errEnd, stderr);
+            spliceResult(result, firstString);
+            if (result->header.frameless) recordFramelessFunction(nodes[i]->function.func_name);
+        }
+        freeResult(result);
+    }
+
+    for (int w = 0; w < workerCount; w++) {
+        if (workers[w].results) fclose(workers[w].results);
+        if (workers[w].out) fclose(workers[w].out);
+        if (workers[w].err) fclose(workers[w].err);
+    }
+    nccFree(results);
+    nccFree(workers);
+    nccFree(order);
+    nccFree(owner);
+    nccFree(nodes);
+    return end;
+}
+
+#endif
@@ -5,8 +5,10 @@
 #include "token_debug.h"
 #include "attributes.h"
 #include "type_checker.h"
+#include "symbol_table.h"
 #include "struct_support.h"
 #include "struct_parser.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +16,9 @@
 // Global program root for checking deprecated functions 
 ASTNode* g_program_root = NULL;
 
+// Set by the switch parser while it reads a case value
+extern int parsingCaseLabel;
+
 // Forward declarations
 ASTNode* parseLogicalAndExpression();
 ASTNode* parseLogicalOrExpression();
@@ -171,9 +176,13 @@ ASTNode* parseDeclaration() {
         hasAttributes = 1;
     }
     
-    // Check for struct definition
+    // Check for struct definition; a struct that is already defined
+    // starts a variable declaration instead
     if (tokenIs(TOKEN_STRUCT)) {
-        return parseStructDefinition();
+        Token structName = peekNextToken();
+        if (structName.type != TOKEN_IDENTIFIER || !findStructDefinition(structName.value)) {
+            return parseStructDefinition();
+        }
     }
     
     // Parse the type
@@ -190,7 +199,7 @@ ASTNode* parseDeclaration() {
         exit(1);
     }
     
-    char* name = strdupc(getCurrentToken().value);
+    char* name = nccStrdup(MEM_AST, getCurrentToken().value);
     consume(TOKEN_IDENTIFIER);
     
     // Check if this is a function definition
@@ -220,7 +229,7 @@ ASTNode* parseParameter() {
         exit(1);
     }
     
-    char* name = strdupc(getCurrentToken().value);
+    char* name = nccStrdup(MEM_AST, getCurrentToken().value);
     consume(TOKEN_IDENTIFIER);
     
     // Check if trying to declare a parameter of type void (which is invalid)
@@ -258,6 +267,9 @@ ASTNode* parseFunctionDefinition(char* name, TypeInfo returnType) {
     if (tokenIs(TOKEN_ATTRIBUTE) || tokenIs(TOKEN_ATTR_OPEN)) {
         parseFunctionAttributes(&node->function.info);
     }
+    // Parameters are visible in the body only
+    int scope = beginSymbolScope();
+    
     // Parse parameters
     expect(TOKEN_LPAREN);
     
@@ -296,7 +308,10 @@ ASTNode* parseFunctionDefinition(char* name, TypeInfo returnType) {
     parseFunctionAttributes(&node->function.info);
     
     // Parse function body
+    node->function.body_start = getCurrentToken().pos;
     node->function.body = parseBlock();
+    node->function.body_end = getCurrentToken().pos;
+    endSymbolScope(scope);
     
     return node;
 }
@@ -346,7 +361,7 @@ ASTNode* parseVariableDeclaration(char* name, TypeInfo typeInfo) {
             // Parse comma-separated expressions until closing brace
             if (!tokenIs(TOKEN_RBRACE)) {
                 // First initializer
-                initializers = parseExpression();
+                initializers = parseAssignmentExpression();
                 lastInitializer = initializers;
                 initCount = 1;
                 
@@ -356,7 +371,7 @@ ASTNode* parseVariableDeclaration(char* name, TypeInfo typeInfo) {
                     if (tokenIs(TOKEN_RBRACE)) {
                         break; // Allow trailing comma
                     }
-                    ASTNode* expr = parseExpression();
+                    ASTNode* expr = parseAssignmentExpression();
                     lastInitializer->next = expr;
                     lastInitializer = expr;
                     initCount++;
@@ -380,14 +395,14 @@ ASTNode* parseVariableDeclaration(char* name, TypeInfo typeInfo) {
             // Parse comma-separated expressions until closing brace
             if (!tokenIs(TOKEN_RBRACE)) {
                 // First initializer
-                initializers = parseExpression();
+                initializers = parseAssignmentExpression();
                 lastInitializer = initializers;
                 initCount = 1;
                 
                 // Parse additional initializers
                 while (tokenIs(TOKEN_COMMA)) {
                     consume(TOKEN_COMMA);
-                    ASTNode* expr = parseExpression();
+                    ASTNode* expr = parseAssignmentExpression();
                     lastInitializer->next = expr;
                     lastInitializer = expr;
                     initCount++;
@@ -422,6 +437,7 @@ ASTNode* parseBlock() {
     ASTNode* lastStatement = NULL;
     
     expect(TOKEN_LBRACE);
+    int scope = beginSymbolScope();
     
     // Parse statements until closing brace
     while (!tokenIs(TOKEN_RBRACE) && !tokenIs(TOKEN_EOF)) {
@@ -438,6 +454,7 @@ ASTNode* parseBlock() {
         lastStatement = statement;
     }
     
+    endSymbolScope(scope);
     expect(TOKEN_RBRACE);
     return node;
 }
@@ -466,7 +483,7 @@ ASTNode* parseInlineAssembly() {
         exit(1);
     }
     
-    node->asm_stmt.code = strdupc(getCurrentToken().value);
+    node->asm_stmt.code = nccStrdup(MEM_AST, getCurrentToken().value);
     consume(TOKEN_STRING);
     
     // Check for extended syntax with colons for operands: __asm("instr %0" : : "r"(var))
@@ -479,8 +496,8 @@ ASTNode* parseInlineAssembly() {
             
             // Allocate initial space for operands and constraints
             node->asm_stmt.operand_count = 0;
-            node->asm_stmt.operands = (ASTNode**)malloc(sizeof(ASTNode*) * 8); // Start with space for 8 operands
-            node->asm_stmt.constraints = (char**)malloc(sizeof(char*) * 8);
+            node->asm_stmt.operands = (ASTNode**)nccMalloc(MEM_AST, sizeof(ASTNode*) * 8); // Start with space for 8 operands
+            node->asm_stmt.constraints = (char**)nccMalloc(MEM_AST, sizeof(char*) * 8);
             
             if (!node->asm_stmt.operands || !node->asm_stmt.constraints) {
                 reportError(getCurrentToken().pos, "Memory allocation failed for assembly operands");
@@ -507,7 +524,7 @@ ASTNode* parseInlineAssembly() {
                 }
                 
                 // Store the constraint
-                node->asm_stmt.constraints[node->asm_stmt.operand_count] = strdupc(getCurrentToken().value);
+                node->asm_stmt.constraints[node->asm_stmt.operand_count] = nccStrdup(MEM_AST, getCurrentToken().value);
                 consume(TOKEN_STRING);
                 
                 // Parse operand expression: (variable)
@@ -521,8 +538,8 @@ ASTNode* parseInlineAssembly() {
                 // Resize arrays if needed
                 if (node->asm_stmt.operand_count % 8 == 0) {
                     int new_size = node->asm_stmt.operand_count + 8;
-                    node->asm_stmt.operands = (ASTNode**)realloc(node->asm_stmt.operands, sizeof(ASTNode*) * new_size);
-                    node->asm_stmt.constraints = (char**)realloc(node->asm_stmt.constraints, sizeof(char*) * new_size);
+                    node->asm_stmt.operands = (ASTNode**)nccRealloc(MEM_AST, node->asm_stmt.operands, sizeof(ASTNode*) * new_size);
+                    node->asm_stmt.constraints = (char**)nccRealloc(MEM_AST, node->asm_stmt.constraints, sizeof(char*) * new_size);
                     
                     if (!node->asm_stmt.operands || !node->asm_stmt.constraints) {
                         reportError(getCurrentToken().pos, "Memory allocation failed for assembly operands");
@@ -548,6 +565,12 @@ ASTNode* parseStatement() {
         return parseBlock();    } else if (tokenIs(TOKEN_IF)) {
         // If statement
         return parseIfStatement();
+    } else if (tokenIs(TOKEN_SWITCH)) {
+        // Switch statement
+        return parseSwitchStatement();
+    } else if (tokenIs(TOKEN_CASE) || tokenIs(TOKEN_DEFAULT)) {
+        // Case or default label
+        return parseCaseLabel();
     } else if (tokenIs(TOKEN_WHILE)) {
         // While statement
         return parseWhileStatement();
@@ -568,15 +591,19 @@ ASTNode* parseStatement() {
     } else if (tokenIs(TOKEN_ASM)) {
         // Inline assembly
         return parseInlineAssembly();    } else if (tokenIs(TOKEN_STATIC) || tokenIs(TOKEN_INT) || tokenIs(TOKEN_SHORT) || 
-               tokenIs(TOKEN_CHAR) || tokenIs(TOKEN_VOID) || tokenIs(TOKEN_UNSIGNED)) {
-        // Check for static keyword in local variable declarations
-        if (tokenIs(TOKEN_STATIC)) {
-            reportWarning(peekNextToken().pos, "Static local variables are not supported - 'static' ignored in local context");
-            consume(TOKEN_STATIC);
-        }
+               tokenIs(TOKEN_LONG) || tokenIs(TOKEN_CHAR) || tokenIs(TOKEN_VOID) || tokenIs(TOKEN_UNSIGNED)) {
+        // Static local arrays keep data section storage; other static locals are
+        // not supported and fall back to the stack
+        int staticPos = tokenIs(TOKEN_STATIC) ? peekNextToken().pos : -1;
         
         // Declaration
-        return parseDeclaration();
+        ASTNode* decl = parseDeclaration();
+        if (staticPos >= 0 && decl && decl->type == NODE_DECLARATION &&
+            !decl->declaration.type_info.is_array) {
+            reportWarning(staticPos, "Static local variables are not supported - 'static' ignored in local context");
+            decl->declaration.type_info.is_static = 0;
+        }
+        return decl;
     } else {
         // Expression statement
         return parseExpressionStatement();
@@ -636,7 +663,7 @@ ASTNode* parseAsmBlock() {
     expect(TOKEN_ASM);
     expect(TOKEN_LBRACE);
 
-    char* asmCode = malloc(1);
+    char* asmCode = nccMalloc(MEM_AST, 1);
     asmCode[0] = '\0';
 
     int braceCount = 1;
@@ -654,7 +681,7 @@ ASTNode* parseAsmBlock() {
         // Append token text
         size_t oldLen = strlen(asmCode);
         size_t tokenLen = strlen(text);
-        asmCode = realloc(asmCode, oldLen + tokenLen + 2);
+        asmCode = nccRealloc(MEM_AST, asmCode, oldLen + tokenLen + 2);
         strcat(asmCode, text);
         strcat(asmCode, " ");
 
@@ -968,7 +995,7 @@ ASTNode* parseShiftExpression() {
 ASTNode* parsePrimaryExpression() {
     if (tokenIs(TOKEN_IDENTIFIER)) {
         // Check if this is a function call
-        char* name = strdupc(getCurrentToken().value);
+        char* name = nccStrdup(MEM_AST, getCurrentToken().value);
         consume(TOKEN_IDENTIFIER);
         
         if (tokenIs(TOKEN_LPAREN)) {
@@ -1044,8 +1071,9 @@ ASTNode* parsePrimaryExpression() {
         
         consume(TOKEN_NUMBER);
         
-        // Check for segment:offset syntax for far pointers
-        if (tokenIs(TOKEN_COLON)) {
+        // Check for segment:offset syntax for far pointers; a case label
+        // owns the colon that follows its value
+        if (tokenIs(TOKEN_COLON) && !parsingCaseLabel) {
             consume(TOKEN_COLON);
             
             if (!tokenIs(TOKEN_NUMBER)) {                Token token = getCurrentToken();
@@ -1088,9 +1116,9 @@ ASTNode* parsePrimaryExpression() {
         // Store the string value including quotes
         const char* tokenValue = getCurrentToken().value;
         if (tokenValue) {
-            node->literal.string_value = strdupc(tokenValue);
+            node->literal.string_value = nccStrdup(MEM_AST, tokenValue);
         } else {
-            node->literal.string_value = strdupc(""); // Empty string as fallback
+            node->literal.string_value = nccStrdup(MEM_AST, ""); // Empty string as fallback
         }
         
         consume(TOKEN_STRING);
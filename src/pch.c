@@ -0,0 +1,263 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "pch.h"
+#include "preprocessor.h"
+#include "version.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// File layout, all numbers 4-byte little-endian:
+//   "NCCPCH1\n"
+//   compiler build string, NUL-terminated
+//   hash of the macro table the header was compiled against
+//   macro count, then per macro: defined flag byte, name\0, value\0
+//   file count, then per file: path\0
+#define PCH_MAGIC "NCCPCH1\n"
+#define PCH_MAGIC_LEN 8
+
+typedef struct {
+    char* data;
+    size_t used;
+    size_t capacity;
+} PchBuffer;
+
+static void putBytes(PchBuffer* buffer, const void* data, size_t length) {
+    if (buffer->used + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->used + length) capacity *= 2;
+        buffer->data = (char*)nccRealloc(MEM_MACROS, buffer->data, capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->used, data, length);
+    buffer->used += length;
+}
+
+static void putWord(PchBuffer* buffer, unsigned int value) {
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i++) bytes[i] = (value >> (8 * i)) & 0xFF;
+    putBytes(buffer, bytes, sizeof(bytes));
+}
+
+static void putString(PchBuffer* buffer, const char* text) {
+    putBytes(buffer, text, strlen(text) + 1);
+}
+
+// Whether the header defined, redefined or undefined table entry i.
+// Macros are never removed from the table, so entry i before the header
+// is still entry i after it.
+static int macroChanged(const Macro* table, const Macro* before, int beforeCount, int i) {
+    if (strcmp(table[i].name, "__FILE__") == 0) return 0;
+    return i >= beforeCount || before[i].defined != table[i].defined ||
+           strcmp(before[i].value, table[i].value) != 0;
+}
+
+int writePrecompiledHeader(const char* headerPath, const char* outputPath) {
+    initPreprocessor();
+    addIncludePath(".");
+
+    // Remember the table before the header so only its changes are saved
+    int beforeCount;
+    const Macro* table = getMacros(&beforeCount);
+    Macro* before = (Macro*)nccMalloc(MEM_MACROS, (beforeCount + 1) * sizeof(Macro));
+    if (!before) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return 1;
+    }
+    memcpy(before, table, beforeCount * sizeof(Macro));
+    unsigned int stateHash = hashMacroState();
+
+    char* processed = preprocessFile(headerPath);
+    if (!processed) {
+        nccFree(before);
+        return 1;
+    }
+    nccFree(processed);
+
+    int count;
+    table = getMacros(&count);
+    int changed = 0;
+    for (int i = 0; i < count; i++) {
+        if (macroChanged(table, before, beforeCount, i)) changed++;
+    }
+
+    PchBuffer buffer = {NULL, 0, 0};
+    putBytes(&buffer, PCH_MAGIC, PCH_MAGIC_LEN);
+    putString(&buffer, compilerBuildId());
+    putWord(&buffer, stateHash);
+
+    putWord(&buffer, (unsigned int)changed);
+    for (int i = 0; i < count; i++) {
+        if (!macroChanged(table, before, beforeCount, i)) continue;
+        unsigned char defined = table[i].defined ? 1 : 0;
+        putBytes(&buffer, &defined, 1);
+        putString(&buffer, table[i].name);
+        putString(&buffer, table[i].value);
+    }
+    nccFree(before);
+
+    int files = 0;
+    while (getIncludedFile(files)) files++;
+    putWord(&buffer, (unsigned int)files);
+    for (int i = 0; i < files; i++) {
+        putString(&buffer, getIncludedFile(i));
+    }
+
+    FILE* out = fopen(outputPath, "wb");
+    int written = out && fwrite(buffer.data, 1, buffer.used, out) == buffer.used;
+    if (out && fclose(out) != 0) written = 0;
+    nccFree(buffer.data);
+    if (!written) {
+        fprintf(stderr, "Error: Could not write precompiled header %s\n", outputPath);
+        remove(outputPath);
+        return 1;
+    }
+
+#ifndef QUIET_MODE
+    printf("Precompiled header statistics:\n");
+    printf("  - Macros saved: %d\n", changed);
+    printf("  - Files saved: %d\n", files);
+#endif
+    return 0;
+}
+
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    int ok;
+} PchReader;
+
+static unsigned int readWord(PchReader* reader) {
+    if (reader->end - reader->p < 4) {
+        reader->ok = 0;
+        return 0;
+    }
+    unsigned int value = reader->p[0] | (reader->p[1] << 8) | (reader->p[2] << 16) | ((unsigned int)reader->p[3] << 24);
+    reader->p += 4;
+    return value;
+}
+
+static const char* readString(PchReader* reader) {
+    const unsigned char* nul = reader->ok ? memchr(reader->p, '\0', reader->end - reader->p) : NULL;
+    if (!nul) {
+        reader->ok = 0;
+        return "";
+    }
+    const char* text = (const char*)reader->p;
+    reader->p = nul + 1;
+    return text;
+}
+
+static int readByte(PchReader* reader) {
+    if (!reader->ok || reader->p >= reader->end) {
+        reader->ok = 0;
+        return 0;
+    }
+    return *reader->p++;
+}
+
+// Check the header and apply the saved state
+static int restoreState(const unsigned char* data, size_t size, const char* pchPath) {
+    PchReader reader = {data, data + size, 1};
+    if (size < PCH_MAGIC_LEN || memcmp(data, PCH_MAGIC, PCH_MAGIC_LEN) != 0) {
+        fprintf(stderr, "Error: %s is not a precompiled header\n", pchPath);
+        return 1;
+    }
+    reader.p += PCH_MAGIC_LEN;
+
+    const char* build = readString(&reader);
+    if (reader.ok && strcmp(build, compilerBuildId()) != 0) {
+        fprintf(stderr, "Error: %s was built by a different compiler (%s), rebuild it\n", pchPath, build);
+        return 1;
+    }
+    unsigned int stateHash = readWord(&reader);
+    if (reader.ok && stateHash != hashMacroState()) {
+        fprintf(stderr, "Error: Macros defined here differ from when %s was built, rebuild it\n", pchPath);
+        return 1;
+    }
+
+    unsigned int macroCount = readWord(&reader);
+    for (unsigned int i = 0; reader.ok && i < macroCount; i++) {
+        int defined = readByte(&reader);
+        const char* name = readString(&reader);
+        const char* value = readString(&reader);
+        if (!reader.ok) break;
+        if (defined) {
+            defineMacro(name, value);
+        } else {
+            undefineMacro(name);
+        }
+    }
+
+    unsigned int fileCount = readWord(&reader);
+    for (unsigned int i = 0; reader.ok && i < fileCount; i++) {
+        const char* path = readString(&reader);
+        if (reader.ok) markFileIncluded(path);
+    }
+
+    if (!reader.ok) {
+        fprintf(stderr, "Error: Precompiled header %s is truncated\n", pchPath);
+        return 1;
+    }
+    return 0;
+}
+
+int loadPrecompiledHeader(const char* pchPath) {
+#ifdef _WIN32
+    FILE* file = fopen(pchPath, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open precompiled header %s\n", pchPath);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)nccMalloc(MEM_MACROS, size > 0 ? size : 1);
+    if (!data) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        fclose(file);
+        return 1;
+    }
+    size_t got = fread(data, 1, size, file);
+    fclose(file);
+    int result = restoreState(data, got, pchPath);
+    nccFree(data);
+    return result;
+#else
+    int fd = open(pchPath, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open precompiled header %s\n", pchPath);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        fprintf(stderr, "Error: %s is not a precompiled header\n", pchPath);
+        return 1;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map precompiled header %s\n", pchPath);
+        return 1;
+    }
+    int result = restoreState((const unsigned char*)data, (size_t)info.st_size, pchPath);
+    munmap(data, (size_t)info.st_size);
+    return result;
+#endif
+}
@@ -1,10 +1,16 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include "preprocessor.h"
 #include "error_manager.h"
 #include "ast.h"
+#include "time_report.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/stat.h>
 
 // Global array of macros
 static Macro macros[MAX_MACROS];
@@ -18,6 +24,75 @@ static int numIncludePaths = 0;
 static char includedFiles[MAX_INCLUDED_FILES][MAX_FILENAME_LEN];
 static int numIncludedFiles = 0;
 
+// Contents of every file read so far, hashed by path. The cache outlives
+// initPreprocessor, so a header is read from disk once per process and
+// batch workers forked after preloadIncludes() share it. A long-lived
+// process (the compile server) turns on validation, which re-reads a
+// file when its inode, size or modification time changes.
+#define FILE_CACHE_BUCKETS 256
+
+typedef struct CachedFile {
+    char* path;
+    char* content;
+    struct stat info;   // File identity when it was read (with validation on)
+    unsigned int version;   // Distinguishes this read from earlier ones of the path
+    int preloadPass;    // Last preloadIncludes() walk that visited it
+    struct HeaderEffect* effects;   // What including it did, by state
+    struct CachedFile* next;
+} CachedFile;
+
+// A file a header read while its effect was recorded
+typedef struct {
+    char* path;
+    unsigned int version;
+} FileRead;
+
+// What preprocessing a header did, replayed when it is included again in
+// the same state: same macros, include paths and included files
+typedef struct HeaderEffect {
+    unsigned int stateHash;     // includeStateHash() before the header
+    Macro* macros;              // Entries it defined, redefined or undefined
+    int macroCount;
+    char** includedFiles;       // Files it marked as included
+    int includedCount;
+    char** dependencies;        // Headers it added to the dependency list
+    int dependencyCount;
+    FileRead* reads;            // Files it read; a change to any of them voids it
+    int readCount;
+    struct HeaderEffect* next;
+} HeaderEffect;
+
+// Headers named by an #include that was not skipped, for -M/-MD
+static char** dependencies = NULL;
+static int numDependencies = 0;
+static int dependencyCapacity = 0;
+
+// -M only needs the directives; -E streams the main file's output
+static int directivesOnly = 0;
+static FILE* streamOutput = NULL;
+static int sourceDepth = 0;
+
+// Bytes collected before a streaming preprocess writes them out
+#define STREAM_CHUNK 65536
+
+static int validateCachedFiles = 0;
+static int preloadPass = 0;
+static unsigned int fileVersion = 0;
+static CachedFile* fileCache[FILE_CACHE_BUCKETS];
+
+// Header effects are recorded and replayed only when enabled. Files read
+// while recording go to readLog, which is emptied when the outermost
+// recording ends.
+static int headerEffectCache = 0;
+static int recordingDepth = 0;
+static FileRead* readLog = NULL;
+static int readLogCount = 0;
+static int readLogCapacity = 0;
+
+// Problems reported while following directives, counted even when
+// diagnostics are suppressed; a header that has any is never replayed
+static int directiveProblems = 0;
+
 // Initialize the preprocessor
 void initPreprocessor() {
     // Reset macro table
@@ -26,7 +101,7 @@ void initPreprocessor() {
     
     // Reset include paths
     for (int i = 0; i < numIncludePaths; i++) {
-        free(includePaths[i]);
+        nccFree(includePaths[i]);
     }
     memset(includePaths, 0, sizeof(includePaths));
     numIncludePaths = 0;
@@ -35,6 +110,12 @@ void initPreprocessor() {
     memset(includedFiles, 0, sizeof(includedFiles));
     numIncludedFiles = 0;
     
+    // Reset dependency tracking
+    for (int i = 0; i < numDependencies; i++) {
+        nccFree(dependencies[i]);
+    }
+    numDependencies = 0;
+    
     // Define some built-in macros
     defineMacro("__NCC__", "65536");      // Compiler ID
     defineMacro("__NCC_MAJOR__", "1");    // Major version (1 == First Release)
@@ -51,13 +132,11 @@ void addIncludePath(const char* path) {
         return;
     }
     
-    includePaths[numIncludePaths++] = strdupc(path);
+    includePaths[numIncludePaths++] = nccStrdup(MEM_MACROS, path);
 }
 
-// Check if a file has been included with #pragma once
-static int isFileAlreadyIncluded(const char* filename) {
-    char normalizedPath[MAX_FILENAME_LEN];
-    
+// The form of a path kept for #pragma once
+static void normalizeIncludedPath(const char* filename, char* normalizedPath) {
     // Simple normalization - converting to lowercase for case-insensitive comparison
     // In a real implementation, you'd want to use absolute paths
     strncpy(normalizedPath, filename, MAX_FILENAME_LEN - 1);
@@ -66,13 +145,27 @@ static int isFileAlreadyIncluded(const char* filename) {
     for (int i = 0; normalizedPath[i]; i++) {
         normalizedPath[i] = tolower(normalizedPath[i]);
     }
-    
-    // Check if this file has already been included
+}
+
+// Check a normalized path against the included files without adding it
+static int wasFileIncluded(const char* normalizedPath) {
     for (int i = 0; i < numIncludedFiles; i++) {
         if (strcmp(normalizedPath, includedFiles[i]) == 0) {
             return 1;
         }
     }
+    return 0;
+}
+
+// Check if a file has been included with #pragma once
+static int isFileAlreadyIncluded(const char* filename) {
+    char normalizedPath[MAX_FILENAME_LEN];
+    normalizeIncludedPath(filename, normalizedPath);
+    
+    // Check if this file has already been included
+    if (wasFileIncluded(normalizedPath)) {
+        return 1;
+    }
     
     // If not, add it to our list
     if (numIncludedFiles < MAX_INCLUDED_FILES) {
@@ -84,11 +177,77 @@ static int isFileAlreadyIncluded(const char* filename) {
     return 0;
 }
 
+// Remember a header for the dependency list, once
+static void addDependency(const char* path) {
+    for (int i = 0; i < numDependencies; i++) {
+        if (strcmp(dependencies[i], path) == 0) return;
+    }
+    if (numDependencies == dependencyCapacity) {
+        dependencyCapacity = dependencyCapacity ? dependencyCapacity * 2 : 32;
+        dependencies = (char**)nccRealloc(MEM_MACROS, dependencies, dependencyCapacity * sizeof(char*));
+        if (!dependencies) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    dependencies[numDependencies++] = nccStrdup(MEM_MACROS, path);
+}
+
+// Write a path for a Makefile, escaping spaces and '$'
+static void writeMakePath(FILE* out, const char* path) {
+    for (const char* p = path; *p; p++) {
+        if (*p == ' ') fputc('\\', out);
+        else if (*p == '$') fputc('$', out);
+        fputc(*p, out);
+    }
+}
+
+// Write a Makefile rule making target depend on the source and the
+// headers it included
+void writeDependencies(FILE* out, const char* target, const char* sourceFile) {
+    writeMakePath(out, target);
+    fputs(":", out);
+    int column = (int)strlen(target) + 1;
+    for (int i = -1; i < numDependencies; i++) {
+        const char* path = i < 0 ? sourceFile : dependencies[i];
+        if (column + (int)strlen(path) + 1 > 78) {
+            fputs(" \\\n ", out);
+            column = 1;
+        }
+        fputc(' ', out);
+        writeMakePath(out, path);
+        column += (int)strlen(path) + 1;
+    }
+    fputc('\n', out);
+}
+
+// Only follow directives, without substituting macros in or keeping text
+void setDirectivesOnly(int enabled) {
+    directivesOnly = enabled;
+}
+
+// Write the output of the outermost file to stream as it is produced
+void setPreprocessOutput(FILE* stream) {
+    streamOutput = stream;
+}
+
+// Files processed so far, in the normalized form used for #pragma once;
+// returns NULL past the end
+const char* getIncludedFile(int index) {
+    return index < numIncludedFiles ? includedFiles[index] : NULL;
+}
+
+// Treat a file as already included, so #include of it adds nothing
+void markFileIncluded(const char* filename) {
+    isFileAlreadyIncluded(filename);
+}
+
 // Define a macro
 void defineMacro(const char* name, const char* value) {
     // Check if we've reached the maximum number of macros
     if (numMacros >= MAX_MACROS) {
         fprintf(stderr, "Error: Too many macro definitions, limit is %d\n", MAX_MACROS);
+        directiveProblems++;
         return;
     }
     
@@ -111,6 +270,38 @@ void defineMacro(const char* name, const char* value) {
     numMacros++;
 }
 
+// Mark a macro as undefined if it exists
+void undefineMacro(const char* name) {
+    for (int i = 0; i < numMacros; i++) {
+        if (strcmp(macros[i].name, name) == 0) {
+            macros[i].defined = 0;
+            return;
+        }
+    }
+}
+
+// The macro table, in the order the macros were first defined
+const Macro* getMacros(int* count) {
+    *count = numMacros;
+    return macros;
+}
+
+// Hash of the macro table. __FILE__ changes with every file processed
+// and says nothing about the state a header sees, so it is left out.
+unsigned int hashMacroState() {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < numMacros; i++) {
+        if (strcmp(macros[i].name, "__FILE__") == 0) continue;
+        const unsigned char* p;
+        hash = (hash ^ (unsigned char)macros[i].defined) * 16777619u;
+        for (p = (const unsigned char*)macros[i].name; *p; p++) hash = (hash ^ *p) * 16777619u;
+        hash = (hash ^ 0) * 16777619u;
+        for (p = (const unsigned char*)macros[i].value; *p; p++) hash = (hash ^ *p) * 16777619u;
+        hash = (hash ^ 0) * 16777619u;
+    }
+    return hash;
+}
+
 // Check if a macro is defined
 int isMacroDefined(const char* name) {
     for (int i = 0; i < numMacros; i++) {
@@ -176,35 +367,8 @@ static char* extractMacroValue(const char* line, int* pos) {
     return buffer;
 }
 
-// Find the include file in include paths
-static char* findIncludeFile(const char* filename, int isSystemHeader) {
-    FILE* file = NULL;
-    char fullPath[MAX_FILENAME_LEN];
-    
-    // If the filename is an absolute path or a path relative to current directory
-    if (!isSystemHeader) {
-        file = fopen(filename, "r");
-        if (file) {
-            fclose(file);
-            return strdupc(filename);
-        }
-    }
-    
-    // Try each include path
-    for (int i = 0; i < numIncludePaths; i++) {
-        snprintf(fullPath, MAX_FILENAME_LEN, "%s/%s", includePaths[i], filename);
-        file = fopen(fullPath, "r");
-        if (file) {
-            fclose(file);
-            return strdupc(fullPath);
-        }
-    }
-    
-    return NULL;
-}
-
 // Read a file into memory
-static char* readFileToString(const char* filename) {
+static char* readFileFromDisk(const char* filename) {
     FILE* file = fopen(filename, "rb");
     if (!file) {
         return NULL;
@@ -216,7 +380,7 @@ static char* readFileToString(const char* filename) {
     fseek(file, 0, SEEK_SET);
     
     // Allocate buffer for file content plus null terminator
-    char* buffer = (char*)malloc(fileSize + 1);
+    char* buffer = (char*)nccMalloc(MEM_SOURCE, fileSize + 1);
     if (!buffer) {
         fclose(file);
         return NULL;
@@ -230,17 +394,203 @@ static char* readFileToString(const char* filename) {
     return buffer;
 }
 
+static unsigned int hashPath(const char* path) {
+    unsigned int hash = 2166136261u;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 16777619u;
+    }
+    return hash & (FILE_CACHE_BUCKETS - 1);
+}
+
+static int sameFileInfo(const struct stat* a, const struct stat* b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+           a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+static void freeHeaderEffects(HeaderEffect* effect) {
+    while (effect) {
+        HeaderEffect* next = effect->next;
+        for (int i = 0; i < effect->includedCount; i++) nccFree(effect->includedFiles[i]);
+        for (int i = 0; i < effect->dependencyCount; i++) nccFree(effect->dependencies[i]);
+        for (int i = 0; i < effect->readCount; i++) nccFree(effect->reads[i].path);
+        nccFree(effect->macros);
+        nccFree(effect->includedFiles);
+        nccFree(effect->dependencies);
+        nccFree(effect->reads);
+        nccFree(effect);
+        effect = next;
+    }
+}
+
+// Find a cached file. With validation on, an entry for a file that
+// changed or disappeared is dropped and NULL returned.
+static CachedFile* findCachedFile(const char* filename) {
+    CachedFile** link = &fileCache[hashPath(filename)];
+    for (; *link; link = &(*link)->next) {
+        if (strcmp((*link)->path, filename) == 0) break;
+    }
+
+    CachedFile* entry = *link;
+    if (!entry || !validateCachedFiles) return entry;
+
+    struct stat info;
+    if (stat(filename, &info) == 0 && sameFileInfo(&info, &entry->info)) {
+        return entry;
+    }
+
+    *link = entry->next;
+    freeHeaderEffects(entry->effects);
+    nccFree(entry->path);
+    nccFree(entry->content);
+    nccFree(entry);
+    return NULL;
+}
+
+// Get a file through the cache, reading it from disk if needed.
+// Returns NULL if the file cannot be read.
+static CachedFile* loadCachedFile(const char* filename) {
+    CachedFile* entry = findCachedFile(filename);
+    if (entry) return entry;
+
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+    if (validateCachedFiles && stat(filename, &info) != 0) return NULL;
+
+    char* content = readFileFromDisk(filename);
+    if (!content) return NULL;
+
+    entry = (CachedFile*)nccCalloc(MEM_SOURCE, 1, sizeof(CachedFile));
+    if (!entry) {
+        fprintf(stderr, "Error: Out of memory in preprocessor\n");
+        exit(1);
+    }
+    unsigned int bucket = hashPath(filename);
+    entry->path = nccStrdup(MEM_SOURCE, filename);
+    entry->content = content;
+    entry->info = info;
+    entry->version = ++fileVersion;
+    entry->next = fileCache[bucket];
+    fileCache[bucket] = entry;
+    return entry;
+}
+
+// Check if a file exists, without touching the disk for cached files
+static int fileExists(const char* filename) {
+    if (findCachedFile(filename)) return 1;
+
+    FILE* file = fopen(filename, "r");
+    if (!file) return 0;
+    fclose(file);
+    return 1;
+}
+
+// Find the include file in include paths
+static char* findIncludeFile(const char* filename, int isSystemHeader) {
+    char fullPath[MAX_FILENAME_LEN];
+    
+    // If the filename is an absolute path or a path relative to current directory
+    if (!isSystemHeader && fileExists(filename)) {
+        return nccStrdup(MEM_MACROS, filename);
+    }
+    
+    // Try each include path
+    for (int i = 0; i < numIncludePaths; i++) {
+        snprintf(fullPath, MAX_FILENAME_LEN, "%s/%s", includePaths[i], filename);
+        if (fileExists(fullPath)) {
+            return nccStrdup(MEM_MACROS, fullPath);
+        }
+    }
+    
+    return NULL;
+}
+
+// Read a file into memory; the caller frees the copy. Reads made while a
+// header effect is recorded are logged.
+static char* readFileToString(const char* filename) {
+    CachedFile* entry = loadCachedFile(filename);
+    if (!entry) return NULL;
+
+    if (recordingDepth > 0) {
+        if (readLogCount == readLogCapacity) {
+            readLogCapacity = readLogCapacity ? readLogCapacity * 2 : 32;
+            readLog = (FileRead*)nccRealloc(MEM_MACROS, readLog, readLogCapacity * sizeof(FileRead));
+            if (!readLog) {
+                fprintf(stderr, "Error: Out of memory in preprocessor\n");
+                exit(1);
+            }
+        }
+        readLog[readLogCount].path = nccStrdup(MEM_MACROS, entry->path);
+        readLog[readLogCount].version = entry->version;
+        readLogCount++;
+    }
+    return nccStrdup(MEM_SOURCE, entry->content);
+}
+
+static void preloadFile(const char* filename) {
+    CachedFile* entry = loadCachedFile(filename);
+    if (!entry || entry->preloadPass == preloadPass) return;
+    entry->preloadPass = preloadPass;
+
+    // 'entry' stays valid: nothing below drops this file from the cache
+    for (const char* line = entry->content; line; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+
+        const char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p++ != '#') continue;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, "include", 7) != 0) continue;
+        p += 7;
+        while (*p == ' ' || *p == '\t') p++;
+
+        char close = *p == '<' ? '>' : (*p == '"' ? '"' : 0);
+        if (!close) continue;
+        const char* start = ++p;
+        while (*p && *p != close && *p != '\n') p++;
+        if (*p != close || p - start >= MAX_FILENAME_LEN) continue;
+
+        char includePath[MAX_FILENAME_LEN];
+        memcpy(includePath, start, p - start);
+        includePath[p - start] = '\0';
+
+        char* resolvedPath = findIncludeFile(includePath, close == '>');
+        if (resolvedPath) {
+            preloadFile(resolvedPath);
+            nccFree(resolvedPath);
+        }
+    }
+}
+
+// Read a source file and every header it names in an #include into the
+// cache, following includes in all conditional branches
+void preloadIncludes(const char* filename) {
+    preloadPass++;
+    preloadFile(filename);
+}
+
+// Re-check cached files against the disk before using them
+void setFileCacheValidation(int enabled) {
+    validateCachedFiles = enabled;
+}
+
+// Replay the effects of headers included again in the same state
+void setHeaderEffectCache(int enabled) {
+    headerEffectCache = enabled;
+}
+
 // Process a file and return its content after preprocessing
 char* preprocessFile(const char* filename) {
     // Check if the file was already processed with #pragma once
     if (isFileAlreadyIncluded(filename)) {
-        return strdupc(""); // Return empty string for already included files
+        return nccStrdup(MEM_SOURCE, ""); // Return empty string for already included files
     }
     
     // Read file content
     char* fileContent = readFileToString(filename);
     if (!fileContent) {
         fprintf(stderr, "Error: Cannot read file '%s'\n", filename);
+        directiveProblems++;
         return NULL;
     }
     
@@ -251,11 +601,148 @@ char* preprocessFile(const char* filename) {
     
     // Process file content
     char* processedContent = preprocessSource(fileContent);
-    free(fileContent);
+    nccFree(fileContent);
     
     return processedContent;
 }
 
+// Fold a string, with its terminator, into an FNV-1a hash
+static unsigned int hashText(unsigned int hash, const char* text) {
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) hash = (hash ^ *p) * 16777619u;
+    return (hash ^ 0) * 16777619u;
+}
+
+// Everything that decides what an #include does besides the header
+// itself: the macros, the include paths and the files already included
+static unsigned int includeStateHash() {
+    unsigned int hash = hashMacroState();
+    for (int i = 0; i < numIncludePaths; i++) hash = hashText(hash, includePaths[i]);
+    hash = (hash ^ 0xFF) * 16777619u;
+    for (int i = 0; i < numIncludedFiles; i++) hash = hashText(hash, includedFiles[i]);
+    return hash;
+}
+
+// An effect holds while every file it read is unchanged
+static int headerEffectIsCurrent(const HeaderEffect* effect) {
+    for (int i = 0; i < effect->readCount; i++) {
+        CachedFile* entry = findCachedFile(effect->reads[i].path);
+        if (!entry || entry->version != effect->reads[i].version) return 0;
+    }
+    return 1;
+}
+
+static void replayHeaderEffect(const HeaderEffect* effect) {
+    // Macros are replayed in table order, so new ones get the same slots
+    for (int i = 0; i < effect->macroCount; i++) {
+        defineMacro(effect->macros[i].name, effect->macros[i].value);
+        if (!effect->macros[i].defined) undefineMacro(effect->macros[i].name);
+    }
+    for (int i = 0; i < effect->includedCount; i++) markFileIncluded(effect->includedFiles[i]);
+    for (int i = 0; i < effect->dependencyCount; i++) addDependency(effect->dependencies[i]);
+}
+
+// Save what preprocessing header 'path' just did, given the macro table
+// and counts from before it, on the header's cache entry
+static void saveHeaderEffect(const char* path, unsigned int stateHash, const Macro* before, int beforeCount,
+                             int includedBefore, int dependenciesBefore, int readsBefore) {
+    // The header's own read comes first in the log
+    CachedFile* entry = findCachedFile(path);
+    if (readLogCount <= readsBefore || !entry || entry->version != readLog[readsBefore].version) return;
+
+    HeaderEffect* effect = (HeaderEffect*)nccCalloc(MEM_MACROS, 1, sizeof(HeaderEffect));
+    if (!effect) return;
+    effect->stateHash = stateHash;
+
+    int includedCount = numIncludedFiles - includedBefore;
+    int dependencyCount = numDependencies - dependenciesBefore;
+    int readCount = readLogCount - readsBefore;
+    effect->macros = (Macro*)nccMalloc(MEM_MACROS, (numMacros + 1) * sizeof(Macro));
+    effect->includedFiles = (char**)nccCalloc(MEM_MACROS, includedCount + 1, sizeof(char*));
+    effect->dependencies = (char**)nccCalloc(MEM_MACROS, dependencyCount + 1, sizeof(char*));
+    effect->reads = (FileRead*)nccCalloc(MEM_MACROS, readCount + 1, sizeof(FileRead));
+    if (!effect->macros || !effect->includedFiles || !effect->dependencies || !effect->reads) {
+        freeHeaderEffects(effect);
+        return;
+    }
+
+    for (int i = 0; i < numMacros; i++) {
+        if (i >= beforeCount || before[i].defined != macros[i].defined ||
+            strcmp(before[i].value, macros[i].value) != 0) {
+            effect->macros[effect->macroCount++] = macros[i];
+        }
+    }
+    for (; effect->includedCount < includedCount; effect->includedCount++) {
+        effect->includedFiles[effect->includedCount] =
+            nccStrdup(MEM_MACROS, includedFiles[includedBefore + effect->includedCount]);
+    }
+    for (; effect->dependencyCount < dependencyCount; effect->dependencyCount++) {
+        effect->dependencies[effect->dependencyCount] =
+            nccStrdup(MEM_MACROS, dependencies[dependenciesBefore + effect->dependencyCount]);
+    }
+    for (; effect->readCount < readCount; effect->readCount++) {
+        effect->reads[effect->readCount].path = nccStrdup(MEM_MACROS, readLog[readsBefore + effect->readCount].path);
+        effect->reads[effect->readCount].version = readLog[readsBefore + effect->readCount].version;
+    }
+
+    // Replace an outdated effect for the same state
+    for (HeaderEffect** link = &entry->effects; *link; link = &(*link)->next) {
+        if ((*link)->stateHash == stateHash) {
+            HeaderEffect* old = *link;
+            *link = old->next;
+            old->next = NULL;
+            freeHeaderEffects(old);
+            break;
+        }
+    }
+    effect->next = entry->effects;
+    entry->effects = effect;
+}
+
+// Preprocess an #include'd header, or replay what it did when it was
+// last included in the same state
+static char* preprocessInclude(const char* path) {
+    char normalizedPath[MAX_FILENAME_LEN];
+    normalizeIncludedPath(path, normalizedPath);
+    if (!headerEffectCache || wasFileIncluded(normalizedPath)) {
+        return preprocessFile(path);
+    }
+
+    unsigned int stateHash = includeStateHash();
+    CachedFile* entry = loadCachedFile(path);
+    HeaderEffect* effect = entry ? entry->effects : NULL;
+    while (effect && effect->stateHash != stateHash) effect = effect->next;
+    if (effect && headerEffectIsCurrent(effect)) {
+        replayHeaderEffect(effect);
+        return nccStrdup(MEM_SOURCE, "");
+    }
+
+    // Record the effect. Diagnostics are not replayed, so a header that
+    // reports any is processed every time.
+    int beforeCount;
+    const Macro* table = getMacros(&beforeCount);
+    Macro* before = (Macro*)nccMalloc(MEM_MACROS, (beforeCount + 1) * sizeof(Macro));
+    if (!before) return preprocessFile(path);
+    memcpy(before, table, beforeCount * sizeof(Macro));
+    int includedBefore = numIncludedFiles;
+    int dependenciesBefore = numDependencies;
+    int readsBefore = readLogCount;
+    int problemsBefore = directiveProblems + getExpressionProblemCount();
+
+    recordingDepth++;
+    char* content = preprocessFile(path);
+    recordingDepth--;
+    if (content && directiveProblems + getExpressionProblemCount() == problemsBefore) {
+        saveHeaderEffect(path, stateHash, before, beforeCount, includedBefore, dependenciesBefore, readsBefore);
+    }
+    nccFree(before);
+
+    if (recordingDepth == 0) {
+        for (int i = 0; i < readLogCount; i++) nccFree(readLog[i].path);
+        readLogCount = 0;
+    }
+    return content;
+}
+
 // Process a single preprocessor directive line
 static void processDirective(const char* line, int* ifLevel, int* skipLevel, const char* currentFilename) {
     int pos = 0;
@@ -312,13 +799,7 @@ static void processDirective(const char* line, int* ifLevel, int* skipLevel, con
         fprintf(stderr, "  Undefining macro %s\n", macroName);
         #endif
         
-        // Mark the macro as undefined if it exists
-        for (int i = 0; i < numMacros; i++) {
-            if (strcmp(macros[i].name, macroName) == 0) {
-                macros[i].defined = 0;
-                break;
-            }
-        }
+        undefineMacro(macroName);
     } 
     else if (strncmp(line + pos, "ifdef", 5) == 0 && isspace(line[pos+5])) {
         // #ifdef directive
@@ -515,6 +996,7 @@ static void processDirective(const char* line, int* ifLevel, int* skipLevel, con
             
             if (line[pos] != '>') {
                 fprintf(stderr, "Error: Malformed #include directive, missing closing >\n");
+                directiveProblems++;
                 return;
             }
         }
@@ -529,11 +1011,13 @@ static void processDirective(const char* line, int* ifLevel, int* skipLevel, con
             
             if (line[pos] != '"') {
                 fprintf(stderr, "Error: Malformed #include directive, missing closing \"\n");
+                directiveProblems++;
                 return;
             }
         }
         else {
             fprintf(stderr, "Error: Malformed #include directive, expected < or \"\n");
+            directiveProblems++;
             return;
         }
         
@@ -545,21 +1029,26 @@ static void processDirective(const char* line, int* ifLevel, int* skipLevel, con
         char* resolvedPath = findIncludeFile(includePath, isSystemHeader);
         if (!resolvedPath) {
             reportError(-1, "Cannot find include file '%s'", includePath);
+            directiveProblems++;
             return;
         }
         
         // Process the include file recursively
-        char* includedContent = preprocessFile(resolvedPath);
-        free(resolvedPath);
+        addDependency(resolvedPath);
+        startTimer(PHASE_PREPROCESS, resolvedPath);
+        char* includedContent = preprocessInclude(resolvedPath);
+        stopTimer();
+        nccFree(resolvedPath);
         
         if (!includedContent) {
             fprintf(stderr, "Error: Failed to preprocess include file '%s'\n", includePath);
+            directiveProblems++;
             return;
         }
         
         // The included content will be inserted in place of the #include directive
         // by the calling function
-        free(includedContent);
+        nccFree(includedContent);
     }
     else if (strncmp(line + pos, "pragma", 6) == 0 && isspace(line[pos+6])) {
         pos += 6;  // Skip "pragma"
@@ -604,10 +1093,15 @@ char* preprocessSource(const char* source) {
     if (!source) return NULL;
     
     // Output buffer that will grow as needed
-    size_t outCapacity = strlen(source) * 2;  // Initial capacity (2x source length)
-    char* output = (char*)malloc(outCapacity);
+    size_t outCapacity = strlen(source) * 2 + 1;  // Initial capacity (2x source length)
+    char* output = (char*)nccMalloc(MEM_SOURCE, outCapacity);
     if (!output) return NULL;
     
+    // Only the file the preprocess started with streams its output;
+    // included files contribute nothing but their directives
+    FILE* stream = sourceDepth == 0 ? streamOutput : NULL;
+    sourceDepth++;
+    
     size_t outLen = 0;  // Current length of output
     int lineStart = 1;  // Flag to indicate start of a line
     int skipLevel = 0;  // Current level of code skipping (for #ifdef/#ifndef)
@@ -648,6 +1142,17 @@ char* preprocessSource(const char* source) {
             continue;
         }
         
+        // Without output, only the start of the next line matters
+        if (directivesOnly) {
+            lineStart = c == '\n' || c == '\r' || (lineStart && isspace(c));
+            continue;
+        }
+        
+        if (stream && outLen >= STREAM_CHUNK) {
+            fwrite(output, 1, outLen, stream);
+            outLen = 0;
+        }
+        
         // Check if this is the start of a new line
         if (c == '\n' || c == '\r') {
             lineStart = 1;
@@ -658,7 +1163,7 @@ char* preprocessSource(const char* source) {
             // Add newline to output
             if (outLen + 1 >= outCapacity) {
                 outCapacity *= 2;
-                output = (char*)realloc(output, outCapacity);
+                output = (char*)nccRealloc(MEM_SOURCE, output, outCapacity);
                 if (!output) return NULL;
             }
             output[outLen++] = c;
@@ -702,7 +1207,7 @@ char* preprocessSource(const char* source) {
                     for (size_t k = 0; value[k]; k++) {
                         if (outLen + 1 >= outCapacity) {
                             outCapacity *= 2;
-                            output = (char*)realloc(output, outCapacity);
+                            output = (char*)nccRealloc(MEM_SOURCE, output, outCapacity);
                             if (!output) return NULL;
                         }
                         output[outLen++] = value[k];
@@ -715,16 +1220,22 @@ char* preprocessSource(const char* source) {
         // Add the character to output
         if (outLen + 1 >= outCapacity) {
             outCapacity *= 2;
-            output = (char*)realloc(output, outCapacity);
+            output = (char*)nccRealloc(MEM_SOURCE, output, outCapacity);
             if (!output) return NULL;
         }
         output[outLen++] = c;
     }
     
+    sourceDepth--;
+    if (stream) {
+        fwrite(output, 1, outLen, stream);
+        outLen = 0;
+    }
+    
     // Add null terminator
     if (outLen + 1 >= outCapacity) {
         outCapacity++;
-        output = (char*)realloc(output, outCapacity);
+        output = (char*)nccRealloc(MEM_SOURCE, output, outCapacity);
         if (!output) return NULL;
     }
     output[outLen] = '\0';
@@ -740,7 +1251,7 @@ void cleanupPreprocessor() {
     
     // Free include paths
     for (int i = 0; i < numIncludePaths; i++) {
-        free(includePaths[i]);
+        nccFree(includePaths[i]);
     }
     numIncludePaths = 0;
     
@@ -5,6 +5,9 @@
 #include <string.h>
 #include <ctype.h>
 
+// Errors and warnings printed so far
+static int expressionProblems = 0;
+
 // Forward declarations
 static int evaluateExpression(const char** expr);
 static int evaluateTerm(const char** expr);
@@ -46,6 +49,7 @@ static int evaluateDefinedOperator(const char** expr) {
             (*expr)++;
         } else {
             fprintf(stderr, "Error: Missing closing parenthesis in defined() operator\n");
+            expressionProblems++;
         }
     }
     
@@ -59,6 +63,7 @@ static int evaluateSizeofOperator(const char** expr) {
     
     if (**expr != '(') {
         fprintf(stderr, "Error: Expected opening parenthesis after sizeof\n");
+        expressionProblems++;
         return 0;
     }
     (*expr)++;
@@ -80,6 +85,7 @@ static int evaluateSizeofOperator(const char** expr) {
         (*expr)++;
     } else {
         fprintf(stderr, "Error: Missing closing parenthesis in sizeof() operator\n");
+        expressionProblems++;
     }
     
     // Determine size based on type name
@@ -96,6 +102,7 @@ static int evaluateSizeofOperator(const char** expr) {
         return 0;
     } else {
         fprintf(stderr, "Warning: Unknown type '%s' in sizeof(), assuming 2 bytes\n", typeName);
+        expressionProblems++;
         return 2;
     }
 }
@@ -144,6 +151,7 @@ static int evaluateFactor(const char** expr) {
             (*expr)++;
         } else {
             fprintf(stderr, "Error: Missing closing parenthesis in expression\n");
+            expressionProblems++;
         }
         return value;
     } else if (isdigit(**expr)) {
@@ -187,6 +195,7 @@ static int evaluateFactor(const char** expr) {
     }
     
     fprintf(stderr, "Error: Unexpected character in preprocessor expression: %c\n", **expr);
+    expressionProblems++;
     return 0;
 }
 
@@ -205,6 +214,7 @@ static int evaluateTerm(const char** expr) {
             int right = evaluateFactor(expr);
             if (right == 0) {
                 fprintf(stderr, "Error: Division by zero in preprocessor expression\n");
+                expressionProblems++;
                 return 0;
             }
             left /= right;
@@ -213,6 +223,7 @@ static int evaluateTerm(const char** expr) {
             int right = evaluateFactor(expr);
             if (right == 0) {
                 fprintf(stderr, "Error: Modulo by zero in preprocessor expression\n");
+                expressionProblems++;
                 return 0;
             }
             left %= right;
@@ -422,6 +433,7 @@ static int evaluateCondExpr(const char** expr) {
             return condition ? trueValue : falseValue;
         } else {
             fprintf(stderr, "Error: Missing ':' in conditional expression\n");
+            expressionProblems++;
             return condition ? trueValue : 0;
         }
     }
@@ -438,3 +450,7 @@ static int evaluateExpression(const char** expr) {
 int evaluatePreprocessorExpression(const char* expr) {
     return evaluateExpression(&expr);
 }
+
+int getExpressionProblemCount() {
+    return expressionProblems;
+}
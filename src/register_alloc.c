@@ -0,0 +1,741 @@
+#include "register_alloc.h"
+#include "frame_analysis.h"
+#include "codegen.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Program root, used to look up callees
+extern ASTNode* g_program_root;
+
+// Registers the allocator hands out, in order of preference. BX, CX and DX
+// are scratch registers for expression code, so only SI and DI survive
+// between statements.
+static const struct {
+    int bit;
+    const char* name;
+} allocatableRegisters[] = {
+    { REG_SI, "si" },
+    { REG_DI, "di" },
+};
+#define ALLOCATABLE_COUNT (int)(sizeof(allocatableRegisters) / sizeof(allocatableRegisters[0]))
+#define ALLOCATABLE_ALL (REG_SI | REG_DI)
+
+// Why a variable stayed in memory
+typedef enum {
+    KEEP_NONE,
+    KEEP_TYPE,          // Not a word-sized scalar
+    KEEP_ADDRESS_TAKEN, // &x needs a memory address
+    KEEP_ASM_OPERAND,   // Inline assembly reads or writes its slot directly
+    KEEP_COLD,          // Too few uses to pay for the register
+    KEEP_PRESSURE       // Spilled: hotter variables took the registers
+} KeepReason;
+
+static const char* keepReasonNames[] = {
+    "",
+    "not a word scalar",
+    "address taken",
+    "asm operand",
+    "too few uses",
+    "spilled under pressure"
+};
+
+// One variable's live range in statement positions
+typedef struct {
+    ASTNode* decl;      // Declaration (or parameter) node
+    int isParam;
+    int start;          // Position of the declaration (0 for parameters)
+    int end;            // Position of the last use, extended over loops
+    int weight;         // Uses, each scaled by its loop depth
+    int clobberCost;    // Saves needed around clobbering nodes in the range
+    KeepReason keep;
+    int reg;
+} LiveInterval;
+
+// A node that may overwrite allocated registers
+typedef struct {
+    ASTNode* node;
+    int pos;
+    int weight;         // Loop depth scaling, like uses
+    int clobbers;       // Allocatable registers it may overwrite
+} ClobberPoint;
+
+static LiveInterval* intervals = NULL;
+static int intervalCount = 0;
+static int intervalCapacity = 0;
+
+static ClobberPoint* clobberPoints = NULL;
+static int clobberCount = 0;
+static int clobberCapacity = 0;
+
+// Variables visible at the current point of the walk (interval indices)
+static int* scopeStack = NULL;
+static int scopeDepth = 0;
+static int scopeCapacity = 0;
+
+static int position = 0;
+static int loopDepth = 0;
+static int blockedRegisters = 0;   // Registers inline asm uses for itself
+static int dumpAllocation = 0;
+
+// Print every allocation decision to stdout (-dr)
+void setRegisterAllocationDump(int enabled) {
+    dumpAllocation = enabled;
+}
+
+// Name of an allocatable register bit
+const char* getAllocatedRegisterName(int reg) {
+    for (int i = 0; i < ALLOCATABLE_COUNT; i++) {
+        if (allocatableRegisters[i].bit == reg) return allocatableRegisters[i].name;
+    }
+    return NULL;
+}
+
+// Grow a table by doubling, exiting on allocation failure
+static void* growTable(void* table, int* capacity, size_t elementSize) {
+    int newCapacity = *capacity ? *capacity * 2 : 16;
+    void* grown = nccRealloc(MEM_CODEGEN, table, newCapacity * elementSize);
+    if (!grown) {
+        fprintf(stderr, "Error: Memory allocation failed for register allocation\n");
+        exit(1);
+    }
+    *capacity = newCapacity;
+    return grown;
+}
+
+// Uses inside loops run many times, so they count for more
+static int currentUseWeight() {
+    int depth = loopDepth > 3 ? 3 : loopDepth;
+    return 1 << (3 * depth);
+}
+
+// Word-sized scalars are the only values that fit SI/DI
+static int isAllocatableType(TypeInfo* type, int isParam) {
+    if (type->is_array || type->is_static || type->is_far_pointer) return 0;
+    if (type->is_pointer) return 1;
+
+    switch (type->type) {
+        case TYPE_INT:
+        case TYPE_SHORT:
+        case TYPE_UNSIGNED_INT:
+        case TYPE_UNSIGNED_SHORT:
+            return 1;
+        case TYPE_CHAR:
+        case TYPE_UNSIGNED_CHAR:
+        case TYPE_BOOL:
+            // Parameters always occupy a full word; byte locals are packed
+            return isParam;
+        default:
+            return 0;
+    }
+}
+
+// Start a live range for a declaration and make it visible
+static void declareVariable(ASTNode* decl, int isParam) {
+    if (intervalCount >= intervalCapacity) {
+        intervals = growTable(intervals, &intervalCapacity, sizeof(LiveInterval));
+    }
+    LiveInterval* interval = &intervals[intervalCount];
+    memset(interval, 0, sizeof(LiveInterval));
+    interval->decl = decl;
+    interval->isParam = isParam;
+    interval->start = isParam ? 0 : position;
+    interval->end = interval->start;
+    if (!isAllocatableType(&decl->declaration.type_info, isParam)) {
+        interval->keep = KEEP_TYPE;
+    }
+    decl->declaration.alloc_reg = 0;
+
+    if (scopeDepth >= scopeCapacity) {
+        scopeStack = growTable(scopeStack, &scopeCapacity, sizeof(int));
+    }
+    scopeStack[scopeDepth++] = intervalCount++;
+}
+
+// Find the innermost visible variable with this name
+static LiveInterval* lookupVariable(const char* name) {
+    for (int i = scopeDepth - 1; i >= 0; i--) {
+        LiveInterval* interval = &intervals[scopeStack[i]];
+        if (strcmp(interval->decl->declaration.var_name, name) == 0) {
+            return interval;
+        }
+    }
+    return NULL;
+}
+
+// Record a read or write of a variable at the current position
+static void useVariable(const char* name) {
+    LiveInterval* interval = lookupVariable(name);
+    if (!interval) return; // Global
+    interval->end = position;
+    interval->weight += currentUseWeight();
+}
+
+// Keep a variable in memory for the given reason
+static void keepInMemory(const char* name, KeepReason reason) {
+    LiveInterval* interval = lookupVariable(name);
+    if (interval && interval->keep == KEEP_NONE) {
+        interval->keep = reason;
+    }
+}
+
+// Record a node that may overwrite allocated registers
+static void addClobberPoint(ASTNode* node, int clobbers) {
+    if (clobberCount >= clobberCapacity) {
+        clobberPoints = growTable(clobberPoints, &clobberCapacity, sizeof(ClobberPoint));
+    }
+    ClobberPoint* point = &clobberPoints[clobberCount++];
+    point->node = node;
+    point->pos = position;
+    point->weight = currentUseWeight();
+    point->clobbers = clobbers;
+}
+
+// SI/DI are callee-saved in every compiled function, but only for the
+// registers that function allocated itself; stackframe functions also save
+// whatever their own body writes. So a function may return with SI/DI
+// changed if it is naked, has inline assembly (which may leave by its own
+// ret) outside a stackframe function, calls something this file doesn't
+// define (including through a pointer), or calls such a function.
+typedef struct {
+    const char* name;
+    ASTNode* func;
+    int clobbers;
+    int* callers;       // Indices of the functions that call this one
+    int callerCount;
+    int callerCapacity;
+    int* callees;       // Indices of the defined functions it calls
+    int calleeCount;
+    int calleeCapacity;
+} CallGraphNode;
+
+static ASTNode* callGraphRoot = NULL;
+static CallGraphNode* callGraph = NULL;
+static int callGraphCount = 0;
+
+static int compareCallGraphNames(const void* a, const void* b) {
+    return strcmp(((const CallGraphNode*)a)->name, ((const CallGraphNode*)b)->name);
+}
+
+static CallGraphNode* findCallGraphNode(const char* name) {
+    CallGraphNode key;
+    key.name = name;
+    return bsearch(&key, callGraph, callGraphCount, sizeof(CallGraphNode), compareCallGraphNames);
+}
+
+// Record the calls made anywhere under a node by the function 'caller'
+static void collectCalls(ASTNode* node, int caller) {
+    while (node) {
+        switch (node->type) {
+            case NODE_CALL: {
+                CallGraphNode* callee = findCallGraphNode(node->call.func_name);
+                if (!callee) {
+                    callGraph[caller].clobbers = 1;
+                } else {
+                    if (callee->callerCount >= callee->callerCapacity) {
+                        callee->callers = growTable(callee->callers, &callee->callerCapacity, sizeof(int));
+                    }
+                    callee->callers[callee->callerCount++] = caller;
+                    CallGraphNode* from = &callGraph[caller];
+                    if (from->calleeCount >= from->calleeCapacity) {
+                        from->callees = growTable(from->callees, &from->calleeCapacity, sizeof(int));
+                    }
+                    from->callees[from->calleeCount++] = (int)(callee - callGraph);
+                }
+                collectCalls(node->call.args, caller);
+                break;
+            }
+            case NODE_DECLARATION:
+                collectCalls(node->declaration.initializer, caller);
+                break;
+            case NODE_ASM:
+                for (int i = 0; i < node->asm_stmt.operand_count; i++) {
+                    collectCalls(node->asm_stmt.operands[i], caller);
+                }
+                break;
+            case NODE_RETURN:
+                collectCalls(node->return_stmt.expr, caller);
+                break;
+            case NODE_FOR:
+                collectCalls(node->for_loop.init, caller);
+                collectCalls(node->for_loop.condition, caller);
+                collectCalls(node->for_loop.update, caller);
+                collectCalls(node->for_loop.body, caller);
+                break;
+            case NODE_WHILE:
+                collectCalls(node->while_loop.condition, caller);
+                collectCalls(node->while_loop.body, caller);
+                break;
+            case NODE_DO_WHILE:
+                collectCalls(node->do_while_loop.condition, caller);
+                collectCalls(node->do_while_loop.body, caller);
+                break;
+            case NODE_SWITCH:
+                collectCalls(node->switch_stmt.condition, caller);
+                collectCalls(node->switch_stmt.body, caller);
+                break;
+            case NODE_IF:
+                collectCalls(node->if_stmt.condition, caller);
+                collectCalls(node->if_stmt.if_body, caller);
+                collectCalls(node->if_stmt.else_body, caller);
+                break;
+            case NODE_TERNARY:
+                collectCalls(node->ternary.condition, caller);
+                collectCalls(node->ternary.true_expr, caller);
+                collectCalls(node->ternary.false_expr, caller);
+                break;
+            default:
+                collectCalls(node->left, caller);
+                collectCalls(node->right, caller);
+                break;
+        }
+        node = node->next;
+    }
+}
+
+// Build the call graph of the program once and mark every function that
+// may return with SI/DI changed, directly or through its callees
+static void buildCallGraph() {
+    if (callGraphRoot == g_program_root) return;
+    for (int i = 0; i < callGraphCount; i++) {
+        nccFree(callGraph[i].callers);
+        nccFree(callGraph[i].callees);
+    }
+    nccFree(callGraph);
+    callGraph = NULL;
+    callGraphCount = 0;
+    callGraphRoot = g_program_root;
+    if (!g_program_root) return;
+
+    int capacity = 0;
+    for (ASTNode* node = g_program_root->left; node; node = node->next) {
+        if (node->type == NODE_FUNCTION && node->function.body) capacity++;
+    }
+    callGraph = (CallGraphNode*)nccMalloc(MEM_CODEGEN, sizeof(CallGraphNode) * (capacity + 1));
+    if (!callGraph) {
+        fprintf(stderr, "Error: Memory allocation failed for register allocation\n");
+        exit(1);
+    }
+    for (ASTNode* node = g_program_root->left; node; node = node->next) {
+        if (node->type != NODE_FUNCTION || !node->function.body) continue;
+        CallGraphNode* entry = &callGraph[callGraphCount++];
+        memset(entry, 0, sizeof(CallGraphNode));
+        entry->name = node->function.func_name;
+        entry->func = node;
+    }
+    qsort(callGraph, callGraphCount, sizeof(CallGraphNode), compareCallGraphNames);
+
+    for (int i = 0; i < callGraphCount; i++) {
+        ASTNode* func = callGraph[i].func;
+        FrameAnalysis frame;
+        analyzeFunctionFrame(func, &frame);
+        if (func->function.info.is_naked || (frame.hasAsm && !func->function.info.is_stackframe)) {
+            callGraph[i].clobbers = 1;
+        }
+        collectCalls(func->function.body, i);
+    }
+
+    // Spread the clobbers from each function to its callers
+    int* worklist = (int*)nccMalloc(MEM_CODEGEN, sizeof(int) * (callGraphCount + 1));
+    if (!worklist) {
+        fprintf(stderr, "Error: Memory allocation failed for register allocation\n");
+        exit(1);
+    }
+    int pending = 0;
+    for (int i = 0; i < callGraphCount; i++) {
+        if (callGraph[i].clobbers) worklist[pending++] = i;
+    }
+    while (pending > 0) {
+        CallGraphNode* callee = &callGraph[worklist[--pending]];
+        for (int i = 0; i < callee->callerCount; i++) {
+            CallGraphNode* caller = &callGraph[callee->callers[i]];
+            if (!caller->clobbers) {
+                caller->clobbers = 1;
+                worklist[pending++] = callee->callers[i];
+            }
+        }
+    }
+    nccFree(worklist);
+}
+
+// Check whether a call to the named function leaves SI/DI as they were
+int calleePreservesRegisters(const char* name) {
+    buildCallGraph();
+    CallGraphNode* callee = findCallGraphNode(name);
+    return callee && !callee->clobbers;
+}
+
+// Describe whether each defined function a function calls preserves SI/DI
+char* describeCalleeRegisters(ASTNode* func) {
+    buildCallGraph();
+    CallGraphNode* node = func ? findCallGraphNode(func->function.func_name) : NULL;
+    size_t size = 1;
+    for (int i = 0; node && i < node->calleeCount; i++) {
+        size += strlen(callGraph[node->callees[i]].name) + 4;
+    }
+    char* description = (char*)nccMalloc(MEM_CODEGEN, size);
+    if (!description) {
+        fprintf(stderr, "Error: Memory allocation failed for register allocation\n");
+        exit(1);
+    }
+    size_t used = 0;
+    description[0] = '\0';
+    for (int i = 0; node && i < node->calleeCount; i++) {
+        CallGraphNode* callee = &callGraph[node->callees[i]];
+        used += (size_t)sprintf(description + used, "%s:%d ", callee->name, callee->clobbers ? 0 : 1);
+    }
+    return description;
+}
+
+// Registers that inline assembly names itself may carry values from one
+// asm statement to the next, so they are not allocated at all. Calls and
+// interrupts inside asm, and operand registers that reach SI/DI, only
+// clobber: live registers are saved around the statement.
+static void scanAsmClobbers(ASTNode* node, const char* code, int wordOperands) {
+    int explicitWrites = scanExplicitRegisters(code) & ALLOCATABLE_ALL;
+    blockedRegisters |= explicitWrites;
+
+    int clobbers = (scanWrittenRegisters(code) & ALLOCATABLE_ALL) & ~explicitWrites;
+    if (wordOperands > 4) clobbers |= REG_SI;
+    if (wordOperands > 5) clobbers |= REG_DI;
+    if (!clobbers) return;
+
+    // Wrapping asm that leaves values on the stack in push/pop would
+    // swap them with the saved registers
+    if (asmStackDelta(code) != 0) {
+        blockedRegisters |= clobbers;
+    } else {
+        addClobberPoint(node, clobbers);
+    }
+}
+
+static void walkNode(ASTNode* node);
+
+// Walk a statement list in its own scope
+static void walkScope(ASTNode* statements) {
+    int mark = scopeDepth;
+    walkNode(statements);
+    scopeDepth = mark;
+}
+
+// A variable used inside a loop but declared outside it stays live for
+// the whole loop, since the next iteration reads it again
+static void walkLoop(ASTNode* condition, ASTNode* body, ASTNode* update, int conditionFirst) {
+    int outerVariables = scopeDepth;
+    int loopStart = ++position;
+
+    loopDepth++;
+    if (conditionFirst) walkNode(condition);
+    if (body) walkScope(body->type == NODE_BLOCK ? body->left : body);
+    walkNode(update);
+    if (!conditionFirst) walkNode(condition);
+    loopDepth--;
+
+    int loopEnd = ++position;
+    for (int i = 0; i < outerVariables; i++) {
+        LiveInterval* interval = &intervals[scopeStack[i]];
+        if (interval->end >= loopStart && interval->end < loopEnd) {
+            interval->end = loopEnd;
+        }
+    }
+}
+
+// Walk a node and its siblings in evaluation order, numbering positions
+static void walkNode(ASTNode* node) {
+    while (node) {
+        position++;
+        switch (node->type) {
+            case NODE_DECLARATION:
+                walkNode(node->declaration.initializer);
+                declareVariable(node, 0);
+                if (node->declaration.initializer) {
+                    intervals[intervalCount - 1].weight += currentUseWeight();
+                }
+                break;
+            case NODE_IDENTIFIER:
+                useVariable(node->identifier);
+                break;
+            case NODE_ASSIGNMENT:
+                walkNode(node->right);
+                position++;
+                walkNode(node->left);
+                break;
+            case NODE_UNARY_OP:
+                if (node->unary_op.op == UNARY_ADDRESS_OF && node->right &&
+                    node->right->type == NODE_IDENTIFIER) {
+                    keepInMemory(node->right->identifier, KEEP_ADDRESS_TAKEN);
+                }
+                walkNode(node->left);
+                walkNode(node->right);
+                break;
+            case NODE_CALL:
+                walkNode(node->call.args);
+                position++;
+                if (!calleePreservesRegisters(node->call.func_name)) {
+                    addClobberPoint(node, ALLOCATABLE_ALL);
+                }
+                break;
+            case NODE_ASM_BLOCK:
+                scanAsmClobbers(node, node->asm_block.code, 0);
+                break;
+            case NODE_ASM: {
+                int wordOperands = 0;
+                for (int i = 0; i < node->asm_stmt.operand_count; i++) {
+                    ASTNode* operand = node->asm_stmt.operands[i];
+                    if (operand->type == NODE_IDENTIFIER) {
+                        keepInMemory(operand->identifier, KEEP_ASM_OPERAND);
+                    }
+                    walkNode(operand);
+                    if (node->asm_stmt.constraints[i][strspn(node->asm_stmt.constraints[i], "=")] == 'r') {
+                        wordOperands++;
+                    }
+                }
+                position++;
+                scanAsmClobbers(node, node->asm_stmt.code, wordOperands);
+                break;
+            }
+            case NODE_BLOCK:
+                walkScope(node->left);
+                break;
+            case NODE_RETURN:
+                walkNode(node->return_stmt.expr);
+                break;
+            case NODE_SWITCH:
+                walkNode(node->switch_stmt.condition);
+                walkNode(node->switch_stmt.body);
+                break;
+            case NODE_IF:
+                walkNode(node->if_stmt.condition);
+                walkNode(node->if_stmt.if_body);
+                walkNode(node->if_stmt.else_body);
+                break;
+            case NODE_WHILE:
+                walkLoop(node->while_loop.condition, node->while_loop.body, NULL, 1);
+                break;
+            case NODE_DO_WHILE:
+                walkLoop(node->do_while_loop.condition, node->do_while_loop.body, NULL, 0);
+                break;
+            case NODE_FOR: {
+                // The init declaration is visible to the whole loop only
+                int mark = scopeDepth;
+                walkNode(node->for_loop.init);
+                walkLoop(node->for_loop.condition, node->for_loop.body, node->for_loop.update, 1);
+                scopeDepth = mark;
+                break;
+            }
+            case NODE_TERNARY:
+                walkNode(node->ternary.condition);
+                walkNode(node->ternary.true_expr);
+                walkNode(node->ternary.false_expr);
+                break;
+            default:
+                walkNode(node->left);
+                walkNode(node->right);
+                break;
+        }
+
+        // Statement and argument lists continue through next; the operands
+        // of an expression never do
+        node = node->next;
+    }
+}
+
+// Order intervals by start for the scan
+static int compareIntervalStart(const void* a, const void* b) {
+    const LiveInterval* left = *(const LiveInterval* const*)a;
+    const LiveInterval* right = *(const LiveInterval* const*)b;
+    return left->start - right->start;
+}
+
+// Benefit of keeping a variable in a register
+static int intervalScore(LiveInterval* interval) {
+    return interval->weight - interval->clobberCost;
+}
+
+// Print the allocation decisions for review
+static void dumpDecisions(const char* funcName) {
+    printf("Register allocation for %s:\n", funcName);
+    if (intervalCount == 0) {
+        printf("  (no locals or parameters)\n");
+    }
+    for (int i = 0; i < intervalCount; i++) {
+        LiveInterval* interval = &intervals[i];
+        printf("  %-16s %-5s [%4d, %4d] weight %-5d saves %-4d ",
+               interval->decl->declaration.var_name,
+               interval->isParam ? "param" : "local",
+               interval->start, interval->end,
+               interval->weight, interval->clobberCost);
+        if (interval->reg) {
+            printf("-> %s\n", getAllocatedRegisterName(interval->reg));
+        } else {
+            printf("memory (%s)\n", keepReasonNames[interval->keep]);
+        }
+    }
+    if (blockedRegisters) {
+        printf("  registers reserved for inline asm:%s%s\n",
+               (blockedRegisters & REG_SI) ? " si" : "",
+               (blockedRegisters & REG_DI) ? " di" : "");
+    }
+}
+
+// Assign the hottest scalar locals and parameters to SI/DI
+int allocateFunctionRegisters(ASTNode* func) {
+    intervalCount = 0;
+    clobberCount = 0;
+    scopeDepth = 0;
+    position = 0;
+    loopDepth = 0;
+    blockedRegisters = 0;
+
+    if (!func || func->type != NODE_FUNCTION || !func->function.body) return 0;
+
+    // Inline assembly that leaves the stack unbalanced can't be wrapped
+    // in saves, and naked functions have no prologue to save registers in
+    FrameAnalysis frame;
+    analyzeFunctionFrame(func, &frame);
+    int enabled = optimizationState.allocateRegisters &&
+                  !func->function.info.is_naked && frame.asmStackBalance == 0;
+
+    for (ASTNode* param = func->function.params; param; param = param->next) {
+        if (param->type == NODE_DECLARATION) {
+            declareVariable(param, 1);
+        }
+    }
+    walkNode(func->function.body->left);
+
+    if (!enabled) {
+        return 0;
+    }
+
+    // Charge each variable for the saves its range would need
+    for (int i = 0; i < intervalCount; i++) {
+        LiveInterval* interval = &intervals[i];
+        for (int c = 0; c < clobberCount; c++) {
+            if (clobberPoints[c].pos > interval->start && clobberPoints[c].pos < interval->end) {
+                interval->clobberCost += clobberPoints[c].weight;
+            }
+        }
+
+        // Parameters pay a load in the prologue on top of the callee save
+        int threshold = interval->isParam ? 3 : 2;
+        if (interval->keep == KEEP_NONE && intervalScore(interval) < threshold) {
+            interval->keep = KEEP_COLD;
+        }
+    }
+
+    // Linear scan over the candidates in order of their start
+    LiveInterval** sorted = (LiveInterval**)nccMalloc(MEM_CODEGEN, sizeof(LiveInterval*) * (intervalCount + 1));
+    if (!sorted) {
+        fprintf(stderr, "Error: Memory allocation failed for register allocation\n");
+        exit(1);
+    }
+    int candidateCount = 0;
+    for (int i = 0; i < intervalCount; i++) {
+        if (intervals[i].keep == KEEP_NONE) sorted[candidateCount++] = &intervals[i];
+    }
+    qsort(sorted, candidateCount, sizeof(LiveInterval*), compareIntervalStart);
+
+    LiveInterval* active[ALLOCATABLE_COUNT] = { NULL };
+    for (int i = 0; i < candidateCount; i++) {
+        LiveInterval* current = sorted[i];
+
+        // Free the registers of ranges that ended before this one starts
+        for (int r = 0; r < ALLOCATABLE_COUNT; r++) {
+            if (active[r] && active[r]->end < current->start) active[r] = NULL;
+        }
+
+        int chosen = -1;
+        for (int r = 0; r < ALLOCATABLE_COUNT; r++) {
+            if (!active[r] && !(blockedRegisters & allocatableRegisters[r].bit)) {
+                chosen = r;
+                break;
+            }
+        }
+
+        if (chosen < 0) {
+            // Spill whichever of the active ranges is coldest, if colder than this one
+            int coldest = -1;
+            for (int r = 0; r < ALLOCATABLE_COUNT; r++) {
+                if (active[r] && (coldest < 0 || intervalScore(active[r]) < intervalScore(active[coldest]))) {
+                    coldest = r;
+                }
+            }
+            if (coldest >= 0 && intervalScore(active[coldest]) < intervalScore(current)) {
+                active[coldest]->reg = 0;
+                active[coldest]->keep = KEEP_PRESSURE;
+                chosen = coldest;
+            } else {
+                current->keep = KEEP_PRESSURE;
+                continue;
+            }
+        }
+
+        current->reg = allocatableRegisters[chosen].bit;
+        active[chosen] = current;
+    }
+    nccFree(sorted);
+
+    int used = 0;
+    for (int i = 0; i < intervalCount; i++) {
+        intervals[i].decl->declaration.alloc_reg = intervals[i].reg;
+        used |= intervals[i].reg;
+    }
+
+    if (dumpAllocation) {
+        dumpDecisions(func->function.func_name);
+    }
+    return used;
+}
+
+// Write the variables that got registers as an assembly comment
+void emitAllocationSummary(FILE* out) {
+    int first = 1;
+    for (int i = 0; i < intervalCount; i++) {
+        if (!intervals[i].reg) continue;
+        fprintf(out, "%s%s in %s", first ? "    ; Register variables: " : ", ",
+                intervals[i].decl->declaration.var_name,
+                getAllocatedRegisterName(intervals[i].reg));
+        first = 0;
+    }
+    if (!first) fprintf(out, "\n");
+}
+
+// Find the clobber point recorded for a node
+static ClobberPoint* findClobberPoint(ASTNode* node) {
+    for (int i = 0; i < clobberCount; i++) {
+        if (clobberPoints[i].node == node) return &clobberPoints[i];
+    }
+    return NULL;
+}
+
+// Push the allocated registers that are live across a clobbering node
+int emitSaveLiveRegisters(FILE* out, ASTNode* node) {
+    ClobberPoint* point = findClobberPoint(node);
+    if (!point) return 0;
+
+    int live = 0;
+    for (int i = 0; i < intervalCount; i++) {
+        LiveInterval* interval = &intervals[i];
+        if (interval->reg && interval->start < point->pos && point->pos < interval->end) {
+            live |= interval->reg;
+        }
+    }
+    live &= point->clobbers;
+
+    for (int r = 0; r < ALLOCATABLE_COUNT; r++) {
+        if (live & allocatableRegisters[r].bit) {
+            fprintf(out, "    push %s ; Live across clobber\n", allocatableRegisters[r].name);
+        }
+    }
+    return live;
+}
+
+// Pop the registers saved by emitSaveLiveRegisters
+void emitRestoreLiveRegisters(FILE* out, int saved) {
+    for (int r = ALLOCATABLE_COUNT - 1; r >= 0; r--) {
+        if (saved & allocatableRegisters[r].bit) {
+            fprintf(out, "    pop %s\n", allocatableRegisters[r].name);
+        }
+    }
+}
@@ -0,0 +1,379 @@
+#include "strength_reduction.h"
+#include "codegen.h"
+#include "codegen_stats.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+// Forward declarations from codegen.c
+extern FILE* asmFile;
+
+// Multiply and divide are by far the slowest 8086 instructions (well over
+// 100 clocks), so a constant operand is lowered into shift/add chains,
+// masks, or a multiply by the reciprocal, whichever the cost model says is
+// cheapest. Each instruction costs the larger of its execution clocks and
+// the clocks needed to fetch its bytes, since code that runs from the
+// prefetch queue is usually bound by the bus.
+
+#define MAX_SEQUENCE 48
+#define COST_INFINITE 1000000
+
+typedef struct {
+    char text[MAX_SEQUENCE][64];
+    int count;
+    int cost;
+} Sequence;
+
+// Clocks of the multiply/divide instructions (register operand) per target
+typedef struct {
+    int mul, imul, div, idiv;
+    int busClocksPerByte;
+} CpuTiming;
+
+static const CpuTiming* getTiming() {
+    static const CpuTiming timing8086 = { 124, 141, 153, 174, 4 };
+    static const CpuTiming timing186 = { 36, 37, 39, 46, 2 };
+    static const CpuTiming timing386 = { 22, 22, 22, 27, 2 };
+    switch (getTargetCpu()) {
+        case CPU_8086: return &timing8086;
+        case CPU_186: return &timing186;
+        default: return &timing386;
+    }
+}
+
+static int instructionCost(int clocks, int bytes) {
+    int fetch = bytes * getTiming()->busClocksPerByte;
+    return clocks > fetch ? clocks : fetch;
+}
+
+static void append(Sequence* seq, int clocks, int bytes, const char* format, ...) {
+    if (seq->count >= MAX_SEQUENCE) {
+        seq->cost = COST_INFINITE;
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(seq->text[seq->count++], sizeof(seq->text[0]), format, args);
+    va_end(args);
+    seq->cost += instructionCost(clocks, bytes);
+}
+
+// Shift a register by a constant. CL may only be used when CX is free.
+static void appendShift(Sequence* seq, const char* op, const char* reg, int count, int cxFree) {
+    if (count <= 0) return;
+    if (count >= 16) {
+        if (op[1] == 'a') {
+            count = 15; // An arithmetic shift saturates to the sign
+        } else {
+            append(seq, 3, 2, "xor %s, %s ; Shifted out completely", reg, reg);
+            return;
+        }
+    }
+
+    if (getTargetCpu() >= CPU_186) {
+        if (count == 1) append(seq, 2, 2, "%s %s, 1", op, reg);
+        else append(seq, 5 + count, 3, "%s %s, %d", op, reg, count);
+        return;
+    }
+
+    // The 8086 can only shift by 1 or by CL
+    int repeatCost = count * instructionCost(2, 2);
+    int clCost = instructionCost(4, 2) + instructionCost(8 + 4 * count, 2);
+    if (cxFree && clCost < repeatCost) {
+        append(seq, 4, 2, "mov cl, %d", count);
+        append(seq, 8 + 4 * count, 2, "%s %s, cl", op, reg);
+    } else {
+        for (int i = 0; i < count; i++) append(seq, 2, 2, "%s %s, 1", op, reg);
+    }
+}
+
+// Horner evaluation of AX * sum(digits[j] * 2^j) with a copy of AX in BX
+static void appendMultiplyDigits(Sequence* seq, const int* digits, int cxFree) {
+    int top = 16;
+    while (top >= 0 && digits[top] == 0) top--;
+    if (top < 0) {
+        append(seq, 3, 2, "xor ax, ax ; Multiply by 0");
+        return;
+    }
+
+    int hasMore = 0;
+    for (int j = top - 1; j >= 0; j--) if (digits[j]) hasMore = 1;
+    if (hasMore) append(seq, 2, 2, "mov bx, ax ; Keep multiplicand");
+
+    int position = top;
+    for (int j = top - 1; j >= 0; j--) {
+        if (!digits[j]) continue;
+        appendShift(seq, "shl", "ax", position - j, cxFree);
+        if (digits[j] > 0) append(seq, 3, 2, "add ax, bx");
+        else append(seq, 3, 2, "sub ax, bx");
+        position = j;
+    }
+    appendShift(seq, "shl", "ax", position, cxFree);
+}
+
+// Plain binary digits of a multiplier
+static void binaryDigits(unsigned int value, int* digits) {
+    for (int j = 0; j <= 16; j++) digits[j] = (value >> j) & 1;
+}
+
+// Non-adjacent form: digits in {-1, 0, 1}, so runs of ones become a subtraction
+static void nafDigits(unsigned int value, int* digits) {
+    for (int j = 0; j <= 16; j++) {
+        digits[j] = 0;
+        if (value & 1) {
+            digits[j] = 2 - (int)(value & 3);
+            value -= digits[j];
+        }
+        value >>= 1;
+    }
+}
+
+// Cheapest shift/add chain that multiplies AX by a constant (low 16 bits)
+static void buildMultiply(Sequence* best, int constant, int cxFree) {
+    unsigned int value = (unsigned int)constant & 0xFFFF;
+    unsigned int magnitude = (0x10000 - value) & 0xFFFF;
+    int digits[17];
+
+    best->count = 0;
+    best->cost = COST_INFINITE;
+    for (int variant = 0; variant < 4; variant++) {
+        int negate = variant >= 2;
+        if (negate && !(value & 0x8000)) break;
+
+        Sequence seq = { .count = 0, .cost = 0 };
+        if (variant % 2 == 0) binaryDigits(negate ? magnitude : value, digits);
+        else nafDigits(negate ? magnitude : value, digits);
+        appendMultiplyDigits(&seq, digits, cxFree);
+        if (negate) append(&seq, 3, 2, "neg ax");
+        if (seq.cost < best->cost) *best = seq;
+    }
+}
+
+static int isPowerOfTwo(unsigned int value) {
+    return value && !(value & (value - 1));
+}
+
+static int log2Floor(unsigned int value) {
+    int bits = 0;
+    while (value >>= 1) bits++;
+    return bits;
+}
+
+// Unsigned AX / constant or AX % constant
+static int buildUnsignedDivide(Sequence* seq, OperatorType op, unsigned int divisor) {
+    int isMod = op == OP_MOD;
+    if (divisor == 0) return 0;
+    if (divisor == 1) {
+        if (isMod) append(seq, 3, 2, "xor ax, ax ; Remainder of division by 1");
+        return 1;
+    }
+    if (isPowerOfTwo(divisor)) {
+        if (isMod) append(seq, 4, 4, "and ax, %u ; Unsigned remainder by %u", divisor - 1, divisor);
+        else appendShift(seq, "shr", "ax", log2Floor(divisor), 1);
+        return 1;
+    }
+
+    // q = (x * M) >> (16 + s) with M = ceil(2^(16+s) / d); the error
+    // M*d - 2^(16+s) must stay within 2^s for the result to be exact.
+    int l = log2Floor(divisor) + 1;
+    int shift = -1;
+    unsigned long long magic = 0;
+    for (int s = 0; s <= l; s++) {
+        unsigned long long p = 1ULL << (16 + s);
+        magic = (p + divisor - 1) / divisor;
+        if (magic >= 0x10000) break;
+        if (magic * divisor - p <= (1ULL << s)) {
+            shift = s;
+            break;
+        }
+    }
+
+    if (isMod || shift < 0) append(seq, 2, 2, "mov cx, ax ; Keep dividend");
+    if (shift >= 0) {
+        append(seq, 4, 3, "mov bx, %llu ; Reciprocal of %u", magic, divisor);
+        append(seq, getTiming()->mul, 2, "mul bx ; High word of x * M");
+        appendShift(seq, "shr", "dx", shift, !isMod);
+        append(seq, 2, 2, "mov ax, dx ; Quotient");
+    } else {
+        // The magic number needs 17 bits: add its top bit back in as x
+        magic = ((1ULL << (16 + l)) + divisor - 1) / divisor - 0x10000;
+        append(seq, 4, 3, "mov bx, %llu ; Reciprocal of %u (low 16 bits)", magic, divisor);
+        append(seq, getTiming()->mul, 2, "mul bx ; High word of x * M");
+        append(seq, 2, 2, "mov ax, cx");
+        append(seq, 3, 2, "sub ax, dx");
+        append(seq, 2, 2, "shr ax, 1");
+        append(seq, 3, 2, "add ax, dx");
+        appendShift(seq, "shr", "ax", l - 1, !isMod);
+    }
+
+    if (isMod) {
+        Sequence product;
+        buildMultiply(&product, (int)divisor, 0);
+        for (int i = 0; i < product.count; i++) append(seq, 0, 0, "%s", product.text[i]);
+        seq->cost += product.cost;
+        append(seq, 3, 2, "sub cx, ax ; x - (x / d) * d");
+        append(seq, 2, 2, "mov ax, cx ; Remainder");
+    }
+    return 1;
+}
+
+// Signed AX / constant or AX % constant, rounding toward zero
+static int buildSignedDivide(Sequence* seq, OperatorType op, int divisor) {
+    int isMod = op == OP_MOD;
+    divisor = (short)divisor;
+    if (divisor == 0) return 0;
+    if (divisor == 1 || divisor == -1) {
+        if (isMod) append(seq, 3, 2, "xor ax, ax ; Remainder of division by %d", divisor);
+        else if (divisor < 0) append(seq, 3, 2, "neg ax ; Divide by -1");
+        return 1;
+    }
+
+    unsigned int magnitude = divisor < 0 ? (unsigned int)-divisor : (unsigned int)divisor;
+    if (isPowerOfTwo(magnitude)) {
+        // Bias negative dividends by d - 1 so the shift rounds toward zero
+        int k = log2Floor(magnitude);
+        append(seq, 5, 1, "cwd ; DX = -1 for negative dividends");
+        if (isMod) {
+            append(seq, 4, 4, "and dx, %u", magnitude - 1);
+            append(seq, 3, 2, "add ax, dx");
+            append(seq, 4, 4, "and ax, %u", magnitude - 1);
+            append(seq, 3, 2, "sub ax, dx ; Signed remainder by %u", magnitude);
+            return 1;
+        }
+        if (k == 1) {
+            append(seq, 3, 2, "sub ax, dx");
+        } else {
+            append(seq, 4, 4, "and dx, %u", magnitude - 1);
+            append(seq, 3, 2, "add ax, dx");
+        }
+        appendShift(seq, "sar", "ax", k, 1);
+        if (divisor < 0) append(seq, 3, 2, "neg ax");
+        return 1;
+    }
+
+    // q = ((x * M) >> (16 + s)) + (x < 0) with M = ceil(2^(16+s) / |d|);
+    // exact for |x| <= 2^15 as long as (M*|d| - 2^(16+s)) * 2^15 < 2^(16+s)
+    unsigned long long magic = 0;
+    int shift = -1;
+    for (int s = 0; s < 16; s++) {
+        unsigned long long p = 1ULL << (16 + s);
+        magic = (p + magnitude - 1) / magnitude;
+        if (magic >= 0x10000) return 0;
+        if ((magic * magnitude - p) < (1ULL << (s + 1))) {
+            shift = s;
+            break;
+        }
+    }
+    if (shift < 0) return 0;
+
+    append(seq, 2, 2, "mov cx, ax ; Keep dividend");
+    append(seq, 4, 3, "mov bx, %llu ; Reciprocal of %u", magic, magnitude);
+    append(seq, getTiming()->imul, 2, "imul bx ; High word of x * M");
+    if (magic >= 0x8000) append(seq, 3, 2, "add dx, cx ; M does not fit a signed word");
+    appendShift(seq, "sar", "dx", shift, 0);
+    append(seq, 2, 2, "mov ax, cx");
+    append(seq, 2, 2, "shl ax, 1 ; CF = sign of dividend");
+    append(seq, 4, 3, "adc dx, 0 ; Round toward zero");
+    append(seq, 2, 2, "mov ax, dx ; Quotient");
+    if (divisor < 0) append(seq, 3, 2, "neg ax");
+
+    if (isMod) {
+        Sequence product;
+        buildMultiply(&product, divisor, 0);
+        for (int i = 0; i < product.count; i++) append(seq, 0, 0, "%s", product.text[i]);
+        seq->cost += product.cost;
+        append(seq, 3, 2, "sub cx, ax ; x - (x / d) * d");
+        append(seq, 2, 2, "mov ax, cx ; Remainder");
+    }
+    return 1;
+}
+
+// Get the value of a constant integer operand (a literal, possibly negated)
+int getConstantOperand(ASTNode* expr, int* value) {
+    if (!expr) return 0;
+    if (expr->type == NODE_LITERAL && expr->literal.data_type == TYPE_INT) {
+        *value = expr->literal.int_value;
+        return 1;
+    }
+    if (expr->type == NODE_UNARY_OP && expr->unary_op.op == UNARY_NEGATE &&
+        getConstantOperand(expr->right, value)) {
+        *value = -*value;
+        return 1;
+    }
+    return 0;
+}
+
+// Build the reduced sequence and the cost of the generic instruction it replaces
+static int buildConstantOperation(Sequence* seq, OperatorType op, int constant, int isUnsigned,
+                                  int* genericCost) {
+    const CpuTiming* timing = getTiming();
+    seq->count = 0;
+    seq->cost = 0;
+
+    *genericCost = instructionCost(4, 3); // mov bx, constant
+    if (op == OP_MUL) {
+        *genericCost += instructionCost(timing->imul, 2);
+        buildMultiply(seq, constant, 1);
+        return 1;
+    }
+    if (op != OP_DIV && op != OP_MOD) return 0;
+
+    if (isUnsigned) {
+        *genericCost += instructionCost(3, 2) + instructionCost(timing->div, 2);
+    } else {
+        *genericCost += instructionCost(5, 1) + instructionCost(timing->idiv, 2);
+    }
+    if (op == OP_MOD) *genericCost += instructionCost(2, 2);
+
+    if (isUnsigned) return buildUnsignedDivide(seq, op, (unsigned int)constant & 0xFFFF);
+    return buildSignedDivide(seq, op, constant);
+}
+
+static void emitSequence(const Sequence* seq, OperatorType op, int constant) {
+    const char* symbol = op == OP_MUL ? "*" : (op == OP_DIV ? "/" : "%");
+    fprintf(asmFile, "    ; %s %d reduced to shifts, adds or a reciprocal\n", symbol, constant);
+    for (int i = 0; i < seq->count; i++) {
+        fprintf(asmFile, "    %s\n", seq->text[i]);
+    }
+}
+
+// Apply *, / or % by a constant to AX
+int emitConstantOperation(OperatorType op, int constant, int isUnsigned) {
+    Sequence seq;
+    int genericCost;
+    if (!buildConstantOperation(&seq, op, constant, isUnsigned, &genericCost)) return 0;
+    if (seq.cost >= genericCost) return 0;
+    emitSequence(&seq, op, constant);
+    return 1;
+}
+
+static int emitConstantMulDivMod(ASTNode* node, int isUnsigned);
+
+int generateConstantMulDivMod(ASTNode* node, int isUnsigned) {
+    int mark = enterCodegen("generateConstantMulDivMod", node);
+    int handled = emitConstantMulDivMod(node, isUnsigned);
+    leaveCodegen(mark);
+    return handled;
+}
+
+// Generate a binary *, / or % with a constant operand
+static int emitConstantMulDivMod(ASTNode* node, int isUnsigned) {
+    OperatorType op = node->operation.op;
+    ASTNode* operand = node->left;
+    int constant;
+
+    if (op != OP_MUL && op != OP_DIV && op != OP_MOD) return 0;
+    if (!getConstantOperand(node->right, &constant)) {
+        // Multiplication commutes, so the constant may be on the left
+        if (op != OP_MUL || !getConstantOperand(node->left, &constant)) return 0;
+        operand = node->right;
+    }
+
+    Sequence seq;
+    int genericCost;
+    if (!buildConstantOperation(&seq, op, constant, isUnsigned, &genericCost)) return 0;
+    if (seq.cost >= genericCost) return 0;
+
+    generateExpression(operand);
+    emitSequence(&seq, op, constant);
+    return 1;
+}
@@ -1,6 +1,7 @@
 #include "codegen.h"
 #include "ast.h"
 #include "error_manager.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,7 +26,7 @@ extern int arrayMarkerFound;
 // Function to sanitize filename for use as identifier prefix
 char* getSanitizedFilenamePrefix() {
     const char* filename = getCurrentSourceFilename();
-    char* prefix = (char*)malloc(strlen(filename) + 1);
+    char* prefix = (char*)nccMalloc(MEM_STRINGS, strlen(filename) + 1);
     if (!prefix) return NULL;
     
     strcpy(prefix, filename);
@@ -50,7 +51,7 @@ char* escapeStringForAsm(const char* input) {
     
     size_t len = strlen(input);
     // Allocate memory for worst case (every char needs escaping)
-    char* output = (char*)malloc(2 * len + 1);
+    char* output = (char*)nccMalloc(MEM_STRINGS, 2 * len + 1);
     if (!output) return NULL;
     
     size_t j = 0;
@@ -80,6 +81,125 @@ char* escapeStringForAsm(const char* input) {
     return output;
 }
 
+// Hash table for string deduplication. The bucket array doubles once
+// entries outnumber buckets, so lookups stay constant time.
+typedef struct StringEntry {
+    char* string;
+    int index;
+    unsigned int hash;
+    struct StringEntry* next;
+} StringEntry;
+
+static StringEntry** stringHashTable = NULL;
+static int stringHashSize = 0;
+static int stringEntryCount = 0;
+
+// Hash function for strings
+static unsigned int hashString(const char* str) {
+    unsigned int hash = 0;
+    while (*str) {
+        hash = hash * 31 + (unsigned char)(*str++);
+    }
+    return hash;
+}
+
+static void growStringHashTable() {
+    int newSize = stringHashSize ? stringHashSize * 2 : 64;
+    StringEntry** newTable = (StringEntry**)nccCalloc(MEM_STRINGS, newSize, sizeof(StringEntry*));
+    if (!newTable) {
+        fprintf(stderr, "Debug: Failed to allocate memory for string hash table\n");
+        exit(1);
+    }
+    
+    for (int i = 0; i < stringHashSize; i++) {
+        StringEntry* entry = stringHashTable[i];
+        while (entry) {
+            StringEntry* next = entry->next;
+            entry->next = newTable[entry->hash & (newSize - 1)];
+            newTable[entry->hash & (newSize - 1)] = entry;
+            entry = next;
+        }
+    }
+    
+    nccFree(stringHashTable);
+    stringHashTable = newTable;
+    stringHashSize = newSize;
+}
+
+// Remember the index of a string for later merging
+static void addStringEntry(const char* str, int index) {
+    if (stringEntryCount >= stringHashSize) {
+        growStringHashTable();
+    }
+    
+    StringEntry* entry = (StringEntry*)nccMalloc(MEM_STRINGS, sizeof(StringEntry));
+    if (!entry) return;
+    
+    entry->string = nccStrdup(MEM_STRINGS, str);
+    entry->index = index;
+    entry->hash = hashString(str);
+    entry->next = stringHashTable[entry->hash & (stringHashSize - 1)];
+    stringHashTable[entry->hash & (stringHashSize - 1)] = entry;
+    stringEntryCount++;
+}
+
+// Find the index of an identical string, -1 if there is none
+static int findStringIndex(const char* str) {
+    if (!stringHashSize) return -1;
+    
+    unsigned int hash = hashString(str);
+    StringEntry* entry = stringHashTable[hash & (stringHashSize - 1)];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->string, str) == 0) {
+            return entry->index;
+        }
+        entry = entry->next;
+    }
+    return -1;
+}
+
+// Forget strings whose index is at least 'count'
+static void dropStringEntries(int count) {
+    for (int i = 0; i < stringHashSize; i++) {
+        StringEntry** link = &stringHashTable[i];
+        while (*link) {
+            StringEntry* entry = *link;
+            if (entry->index >= count) {
+                *link = entry->next;
+                nccFree(entry->string);
+                nccFree(entry);
+                stringEntryCount--;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+// Add string to hash table or get existing index
+static int getStringIndex(const char* str, int newIndex) {
+    // When redefining and we're already past the redefinition point,
+    // don't try to deduplicate strings - assign sequential indices
+    extern int redefineLocalsFound;
+    extern int redefineStringStartIndex;
+    
+    if (redefineLocalsFound && stringLiteralCount > redefineStringStartIndex && 
+        newIndex >= redefineStringStartIndex) {
+        // For new strings after redefinition, just use the provided index
+        addStringEntry(str, newIndex);
+        return newIndex;
+    }
+    
+    // Normal string deduplication for original strings
+    int existing = findStringIndex(str);
+    if (existing >= 0) {
+        return existing;
+    }
+    
+    addStringEntry(str, newIndex);
+    return newIndex;
+}
+
 // Add a string literal to the string table and return its index
 int addStringLiteral(const char* str) {
     if (!str) {
@@ -88,7 +208,7 @@ int addStringLiteral(const char* str) {
     }
     
     // Make a copy of the string to work with
-    char* workStr = strdupc(str);
+    char* workStr = nccStrdup(MEM_STRINGS, str);
     if (!workStr) {
         fprintf(stderr, "Debug: Failed to allocate memory for string copy\n");
         return -1;
@@ -101,16 +221,16 @@ int addStringLiteral(const char* str) {
     // Check if the string has surrounding quotes
     if (len >= 2 && workStr[0] == '\"' && workStr[len-1] == '\"') {
         // Remove the surrounding quotes
-        unquoted = (char*)malloc(len - 1); // -2 for quotes, +1 for null
+        unquoted = (char*)nccMalloc(MEM_STRINGS, len - 1); // -2 for quotes, +1 for null
         if (!unquoted) {
             fprintf(stderr, "Debug: Failed to allocate memory for unquoted string\n");
-            free(workStr);
+            nccFree(workStr);
             return -1;
         }
         
         strncpy(unquoted, workStr + 1, len - 2);
         unquoted[len - 2] = '\0';
-        free(workStr);
+        nccFree(workStr);
     } else {
         // No quotes, use as is
         unquoted = workStr;
@@ -118,37 +238,45 @@ int addStringLiteral(const char* str) {
     
     // Process escape sequences
     char* escaped = escapeStringForAsm(unquoted);
-    free(unquoted);
+    nccFree(unquoted);
     
     if (!escaped) {
         fprintf(stderr, "Debug: Failed to process escape sequences\n");
         return -1;
     }
     
-    // Check if string merging is enabled and look for identical strings
+    return internStringLiteral(escaped);
+}
+
+// Add an already escaped string, reusing an identical one when strings
+// are merged; the table takes ownership
+int internStringLiteral(char* escaped) {
+    // Check if string merging is enabled and look for an identical string
     if (optimizationState.mergeStrings) {
-        for (int i = 0; i < stringLiteralCount; i++) {
-            if (strcmp(stringLiterals[i], escaped) == 0) {
-                // Found an identical string, reuse it
-                free(escaped);
-                return i;
-            }
+        int existing = findStringIndex(escaped);
+        if (existing >= 0) {
+            nccFree(escaped);
+            return existing;
         }
     }
     
-    // Add to string table
+    return appendStringLiteral(escaped);
+}
+
+// Append an already escaped string to the table, which takes ownership
+int appendStringLiteral(char* escaped) {
     if (stringLiterals == NULL) {
-        stringLiterals = (char**)malloc(sizeof(char*));
+        stringLiterals = (char**)nccMalloc(MEM_STRINGS, sizeof(char*));
         if (!stringLiterals) {
             fprintf(stderr, "Debug: Failed to allocate memory for string table\n");
-            free(escaped);
+            nccFree(escaped);
             return -1;
         }
     } else {
-        char** newTable = (char**)realloc(stringLiterals, (stringLiteralCount + 1) * sizeof(char*));
+        char** newTable = (char**)nccRealloc(MEM_STRINGS, stringLiterals, (stringLiteralCount + 1) * sizeof(char*));
         if (!newTable) {
             fprintf(stderr, "Debug: Failed to reallocate memory for string table\n");
-            free(escaped);
+            nccFree(escaped);
             return -1;
         }
         stringLiterals = newTable;
@@ -157,6 +285,10 @@ int addStringLiteral(const char* str) {
     stringLiterals[stringLiteralCount] = escaped;
     int index = stringLiteralCount++;
     
+    if (optimizationState.mergeStrings) {
+        addStringEntry(escaped, index);
+    }
+    
     return index;
 }
 
@@ -164,20 +296,20 @@ int addStringLiteral(const char* str) {
 int addArrayDeclaration(const char* name, int size, DataType type, const char* funcName) {
     // Initialize arrays if first time
     if (arrayNames == NULL) {
-        arrayNames = (char**)malloc(sizeof(char*));
-        arraySizes = (int*)malloc(sizeof(int));
-        arrayTypes = (DataType*)malloc(sizeof(DataType));
-        arrayFunctions = (char**)malloc(sizeof(char*));
+        arrayNames = (char**)nccMalloc(MEM_ARRAYS, sizeof(char*));
+        arraySizes = (int*)nccMalloc(MEM_ARRAYS, sizeof(int));
+        arrayTypes = (DataType*)nccMalloc(MEM_ARRAYS, sizeof(DataType));
+        arrayFunctions = (char**)nccMalloc(MEM_ARRAYS, sizeof(char*));
         if (!arrayNames || !arraySizes || !arrayTypes || !arrayFunctions) {
             fprintf(stderr, "Debug: Failed to allocate memory for array tracking\n");
             return -1;
         }
     } else {
         // Expand arrays
-        char** newNames = (char**)realloc(arrayNames, (arrayCount + 1) * sizeof(char*));
-        int* newSizes = (int*)realloc(arraySizes, (arrayCount + 1) * sizeof(int));
-        DataType* newTypes = (DataType*)realloc(arrayTypes, (arrayCount + 1) * sizeof(DataType));
-        char** newFuncs = (char**)realloc(arrayFunctions, (arrayCount + 1) * sizeof(char*));
+        char** newNames = (char**)nccRealloc(MEM_ARRAYS, arrayNames, (arrayCount + 1) * sizeof(char*));
+        int* newSizes = (int*)nccRealloc(MEM_ARRAYS, arraySizes, (arrayCount + 1) * sizeof(int));
+        DataType* newTypes = (DataType*)nccRealloc(MEM_ARRAYS, arrayTypes, (arrayCount + 1) * sizeof(DataType));
+        char** newFuncs = (char**)nccRealloc(MEM_ARRAYS, arrayFunctions, (arrayCount + 1) * sizeof(char*));
         if (!newNames || !newSizes || !newTypes || !newFuncs) {
             fprintf(stderr, "Debug: Failed to reallocate memory for array tracking\n");
             return -1;
@@ -189,15 +321,15 @@ int addArrayDeclaration(const char* name, int size, DataType type, const char* f
     }
     
     // Store array info
-    arrayNames[arrayCount] = strdupc(name);
+    arrayNames[arrayCount] = nccStrdup(MEM_ARRAYS, name);
     if (!arrayNames[arrayCount]) {
         fprintf(stderr, "Debug: Failed to allocate memory for array name\n");
         return -1;
     }
-    arrayFunctions[arrayCount] = funcName ? strdupc(funcName) : strdupc("global");
+    arrayFunctions[arrayCount] = funcName ? nccStrdup(MEM_ARRAYS, funcName) : nccStrdup(MEM_ARRAYS, "global");
     if (!arrayFunctions[arrayCount]) {
         fprintf(stderr, "Debug: Failed to allocate memory for array function name\n");
-        free(arrayNames[arrayCount]);
+        nccFree(arrayNames[arrayCount]);
         return -1;
     }
     arraySizes[arrayCount] = size;
@@ -213,6 +345,7 @@ typedef struct {
 } ArrayInitializerInfo;
 
 static ArrayInitializerInfo* arrayInitializers = NULL;
+static int arrayInitializerCapacity = 0;
 
 // External function for writing array initializers
 extern void writeArrayWithInitializers(FILE* outFile, const char* arrayName, int arraySize,
@@ -225,16 +358,21 @@ int addArrayDeclarationWithInitializers(const char* name, int size, DataType typ
     int arrayIndex = addArrayDeclaration(name, size, type, funcName);
     
     // Create or resize the initializers array if needed
-    if (arrayInitializers == NULL) {
-        arrayInitializers = (ArrayInitializerInfo*)malloc(sizeof(ArrayInitializerInfo) * (arrayIndex + 1));
-    } else {
-        arrayInitializers = (ArrayInitializerInfo*)realloc(
+    if (arrayIndex >= arrayInitializerCapacity) {
+        arrayInitializers = (ArrayInitializerInfo*)nccRealloc(MEM_ARRAYS, 
             arrayInitializers, sizeof(ArrayInitializerInfo) * (arrayIndex + 1));
-    }
-    
-    if (!arrayInitializers) {
-        reportError(-1, "Memory allocation failed for array initializer info");
-        return -1;
+        
+        if (!arrayInitializers) {
+            reportError(-1, "Memory allocation failed for array initializer info");
+            return -1;
+        }
+        
+        // Arrays declared in between have no initializers
+        for (int i = arrayInitializerCapacity; i < arrayIndex; i++) {
+            arrayInitializers[i].initializer = NULL;
+            arrayInitializers[i].is_static = 0;
+        }
+        arrayInitializerCapacity = arrayIndex + 1;
     }
     
     // Store the initializer
@@ -244,70 +382,6 @@ int addArrayDeclarationWithInitializers(const char* name, int size, DataType typ
     return arrayIndex;
 }
 
-// Hash table for string deduplication
-typedef struct StringEntry {
-    char* string;
-    int index;
-    struct StringEntry* next;
-} StringEntry;
-
-#define STRING_HASH_SIZE 64
-StringEntry* stringHashTable[STRING_HASH_SIZE] = {NULL};
-
-// Hash function for strings
-static unsigned int hashString(const char* str) {
-    unsigned int hash = 0;
-    while (*str) {
-        hash = hash * 31 + (*str++);
-    }
-    return hash % STRING_HASH_SIZE;
-}
-
-// Add string to hash table or get existing index
-static int getStringIndex(const char* str, int newIndex) {
-    // When redefining and we're already past the redefinition point,
-    // don't try to deduplicate strings - assign sequential indices
-    extern int redefineLocalsFound;
-    extern int redefineStringStartIndex;
-    
-    if (redefineLocalsFound && stringLiteralCount > redefineStringStartIndex && 
-        newIndex >= redefineStringStartIndex) {
-        // For new strings after redefinition, just use the provided index
-        unsigned int hash = hashString(str);
-        StringEntry* entry = (StringEntry*)malloc(sizeof(StringEntry));
-        if (entry) {
-            entry->string = strdupc(str);
-            entry->index = newIndex;
-            entry->next = stringHashTable[hash];
-            stringHashTable[hash] = entry;
-        }
-        return newIndex;
-    }
-    
-    // Normal string deduplication for original strings
-    unsigned int hash = hashString(str);
-    StringEntry* entry = stringHashTable[hash];
-    
-    // Look for existing entry
-    while (entry) {
-        if (strcmp(entry->string, str) == 0) {
-            return entry->index;
-        }
-        entry = entry->next;
-    }
-    
-    // Add new entry
-    entry = (StringEntry*)malloc(sizeof(StringEntry));
-    if (entry) {
-        entry->string = strdupc(str);
-        entry->index = newIndex;
-        entry->next = stringHashTable[hash];
-        stringHashTable[hash] = entry;
-    }
-    
-    return newIndex;
-}
-
 // Hash table for string label deduplication
 typedef struct StringLabelEntry {
     char* label;
@@ -339,9 +413,9 @@ static int stringLabelExists(const char* label) {
     }
     
     // Add new entry
-    entry = (StringLabelEntry*)malloc(sizeof(StringLabelEntry));
+    entry = (StringLabelEntry*)nccMalloc(MEM_STRINGS, sizeof(StringLabelEntry));
     if (entry) {
-        entry->label = strdupc(label);
+        entry->label = nccStrdup(MEM_STRINGS, label);
         entry->next = stringLabelHashTable[hash];
         stringLabelHashTable[hash] = entry;
     }
@@ -349,6 +423,145 @@ static int stringLabelExists(const char* label) {
     return 0; // Not found, added now
 }
 
+// Bytes that suffix sharing kept out of the string data
+static int sharedStringBytes = 0;
+
+// Ordering state for the suffix sharing sort
+static int* suffixHost = NULL;
+
+// Compare two strings from their last character backwards, so every
+// string sorts directly before the strings that end with it
+static int compareReversed(const void* a, const void* b) {
+    const char* x = stringLiterals[*(const int*)a];
+    const char* y = stringLiterals[*(const int*)b];
+    size_t i = strlen(x);
+    size_t j = strlen(y);
+    while (i > 0 && j > 0) {
+        unsigned char cx = (unsigned char)x[--i];
+        unsigned char cy = (unsigned char)y[--j];
+        if (cx != cy) return cx < cy ? -1 : 1;
+    }
+    if (i != j) return i < j ? -1 : 1;
+    return *(const int*)a - *(const int*)b;
+}
+
+// Group strings by the string that holds them, longest first
+static int compareByHost(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    if (suffixHost[x] != suffixHost[y]) return suffixHost[x] - suffixHost[y];
+    size_t lx = strlen(stringLiterals[x]);
+    size_t ly = strlen(stringLiterals[y]);
+    if (lx != ly) return lx > ly ? -1 : 1;
+    return x - y;
+}
+
+// Check if 'shorter' is the tail end of 'longer'
+static int isStringSuffix(const char* shorter, const char* longer) {
+    size_t ls = strlen(shorter);
+    size_t ll = strlen(longer);
+    return ls <= ll && memcmp(longer + ll - ls, shorter, ls) == 0;
+}
+
+// Output bytes [from, to) of a string, with the null terminator if asked
+static void writeStringBytes(const char* str, size_t from, size_t to, int terminate) {
+    fprintf(asmFile, "#db ");
+    for (size_t j = from; j < to; j++) {
+        fprintf(asmFile, "%d", (unsigned char)str[j]);
+        if (j < to - 1 || terminate) {
+            fprintf(asmFile, ", ");
+        }
+    }
+    if (terminate) {
+        fprintf(asmFile, "0  ; null terminator\n");
+    } else {
+        fprintf(asmFile, " ; continued below\n");
+    }
+}
+
+// Output string literals [start, stringLiteralCount). With string merging
+// a string that is the tail of a longer one gets no bytes of its own; its
+// label is placed inside the longer string instead.
+static void writeStringLiterals(const char* prefix, int start) {
+    int count = stringLiteralCount - start;
+    if (count <= 0) return;
+    
+    if (!optimizationState.mergeStrings) {
+        for (int i = start; i < stringLiteralCount; i++) {
+            fprintf(asmFile, "%s_string_%d: ", prefix, i);
+            writeStringBytes(stringLiterals[i], 0, strlen(stringLiterals[i]), 1);
+        }
+        return;
+    }
+    
+    int* order = (int*)nccMalloc(MEM_STRINGS, count * sizeof(int));
+    suffixHost = (int*)nccMalloc(MEM_STRINGS, stringLiteralCount * sizeof(int));
+    if (!order || !suffixHost) {
+        fprintf(stderr, "Debug: Failed to allocate memory for string sharing\n");
+        exit(1);
+    }
+    for (int k = 0; k < count; k++) {
+        order[k] = start + k;
+    }
+    
+    // After sorting by reversed text, a string that is a suffix of any
+    // other is a suffix of its successor, so hosts chain backwards
+    qsort(order, count, sizeof(int), compareReversed);
+    for (int k = count - 1; k >= 0; k--) {
+        int i = order[k];
+        if (k + 1 < count && isStringSuffix(stringLiterals[i], stringLiterals[order[k + 1]])) {
+            suffixHost[i] = suffixHost[order[k + 1]];
+            sharedStringBytes += (int)strlen(stringLiterals[i]) + 1;
+        } else {
+            suffixHost[i] = i;
+        }
+    }
+    
+    // Each host is written once, with the labels of its suffixes inside
+    qsort(order, count, sizeof(int), compareByHost);
+    for (int k = 0; k < count; ) {
+        const char* host = stringLiterals[order[k]];
+        size_t hostLen = strlen(host);
+        int end = k;
+        while (end < count && suffixHost[order[end]] == suffixHost[order[k]]) {
+            end++;
+        }
+        
+        for (; k < end; k++) {
+            size_t offset = hostLen - strlen(stringLiterals[order[k]]);
+            fprintf(asmFile, "%s_string_%d:", prefix, order[k]);
+            
+            // Labels at the same offset share the bytes that follow
+            if (k + 1 < end && hostLen - strlen(stringLiterals[order[k + 1]]) == offset) {
+                fprintf(asmFile, "\n");
+                continue;
+            }
+            
+            size_t next = k + 1 < end ? hostLen - strlen(stringLiterals[order[k + 1]]) : hostLen;
+            fprintf(asmFile, " ");
+            writeStringBytes(host, offset, next, k + 1 == end);
+        }
+    }
+    
+    nccFree(order);
+    nccFree(suffixHost);
+    suffixHost = NULL;
+}
+
+// Report how much string data suffix sharing saved
+void reportStringStats(FILE* asmOut) {
+    if (!optimizationState.mergeStrings) return;
+    
+    if (asmOut) {
+        fprintf(asmOut, "; String suffix sharing: %d bytes saved\n", sharedStringBytes);
+    }
+    
+    #ifndef QUIET_MODE
+    printf("  - String suffix sharing: %d bytes saved\n", sharedStringBytes);
+    #endif
+    sharedStringBytes = 0;
+}
+
 #ifdef __GNUC__
 #pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 #endif
@@ -370,7 +583,7 @@ void generateStringsAtMarker() {
     
     // Get sanitized filename prefix
     char* prefix = getSanitizedFilenamePrefix();
-    if (!prefix) prefix = strdupc("unknown");
+    if (!prefix) prefix = nccStrdup(MEM_STRINGS, "unknown");
     
     // First build the hash table of existing string labels if redefining
     if (redefineLocalsFound && redefineStringStartIndex > 0) {
@@ -395,16 +608,7 @@ void generateStringsAtMarker() {
     if (redefineLocalsFound) {
         // In redefine case, clear any existing content deduplication
         // to ensure each string gets its own index
-        for (int i = 0; i < STRING_HASH_SIZE; i++) {
-            StringEntry* entry = stringHashTable[i];
-            while (entry) {
-                StringEntry* temp = entry->next;
-                free(entry->string);
-                free(entry);
-                entry = temp;
-            }
-            stringHashTable[i] = NULL;
-        }
+        dropStringEntries(0);
         
         // Register all string indices up to the redefinition point
         for (int i = 0; i < redefineStringStartIndex; i++) {
@@ -417,6 +621,12 @@ void generateStringsAtMarker() {
         startIdx = redefineStringStartIndex;
     }
     
+    // Without redefinition every string is new, so tails can be shared
+    if (!redefineLocalsFound) {
+        writeStringLiterals(prefix, 0);
+        startIdx = stringLiteralCount;
+    }
+    
     // Generate strings after the redefine marker (if applicable)
     for (int i = startIdx; i < stringLiteralCount; i++) {
         // For each string, get or create its index
@@ -432,20 +642,11 @@ void generateStringsAtMarker() {
         }
         
         // Output the string
-        fprintf(asmFile, "%s: #db ", labelName);
-        
-        // Output each byte of the string as a decimal value
-        size_t len = strlen(stringLiterals[i]);
-        for (size_t j = 0; j < len; j++) {
-            fprintf(asmFile, "%d", (unsigned char)stringLiterals[i][j]);
-            if (j < len - 1) {
-                fprintf(asmFile, ", ");
-            }
-        }
-        fprintf(asmFile, ", 0  ; null terminator\n");
+        fprintf(asmFile, "%s: ", labelName);
+        writeStringBytes(stringLiterals[i], 0, strlen(stringLiterals[i]), 1);
     }
     
-    free(prefix);
+    nccFree(prefix);
     fprintf(asmFile, "; String literal location marker%s\n", redefineLocalsFound ? " (redefined)" : "");
 }
 
@@ -486,9 +687,9 @@ static int arrayExists(const char* name) {
     }
     
     // Add new entry
-    entry = (ArrayEntry*)malloc(sizeof(ArrayEntry));
+    entry = (ArrayEntry*)nccMalloc(MEM_ARRAYS, sizeof(ArrayEntry));
     if (entry) {
-        entry->name = strdupc(name);
+        entry->name = nccStrdup(MEM_STRINGS, name);
         entry->next = arrayHashTable[hash];
         arrayHashTable[hash] = entry;
     }
@@ -513,7 +714,7 @@ void generateArraysAtMarker() {
     
     // Get sanitized filename prefix
     char* prefix = getSanitizedFilenamePrefix();
-    if (!prefix) prefix = strdupc("unknown");
+    if (!prefix) prefix = nccStrdup(MEM_STRINGS, "unknown");
       // First, build the hash table of existing arrays if redefining
     if (redefineLocalsFound && redefineArrayStartIndex > 0) {        for (int i = 0; i < redefineArrayStartIndex; i++) {
             char fullName[256];
@@ -548,7 +749,7 @@ void generateArraysAtMarker() {
         fprintf(asmFile, "%s: ", fullName);
         
         // Check if this array has initializers
-        if (arrayInitializers && i < arrayCount && arrayInitializers[i].initializer) {
+        if (arrayInitializers && i < arrayInitializerCapacity && arrayInitializers[i].initializer) {
             // Generate with initializers
             writeArrayWithInitializers(asmFile, arrayNames[i], arraySizes[i], 
                                       arrayTypes[i], arrayInitializers[i].initializer);
@@ -576,7 +777,7 @@ void generateArraysAtMarker() {
         }
     }
     
-    free(prefix);
+    nccFree(prefix);
 }
 
 // Generate data section with string literals and arrays
@@ -592,23 +793,12 @@ void generateStringLiteralsSection() {
         
         // Get sanitized filename prefix
         char* prefix = getSanitizedFilenamePrefix();
-        if (!prefix) prefix = strdupc("unknown");
+        if (!prefix) prefix = nccStrdup(MEM_STRINGS, "unknown");
         
-        for (int i = 0; i < stringLiteralCount; i++) {
-            fprintf(asmFile, "%s_string_%d: #db ", prefix, i);
-            
-            // Output each byte of the string as a decimal value
-            size_t len = strlen(stringLiterals[i]);
-            for (size_t j = 0; j < len; j++) {
-                fprintf(asmFile, "%d", (unsigned char)stringLiterals[i][j]);
-                if (j < len - 1) {
-                    fprintf(asmFile, ", ");
-                }            }
-            fprintf(asmFile, ", 0  ; null terminator\n");
-        }
+        writeStringLiterals(prefix, 0);
         
         // Free the prefix
-        free(prefix);
+        nccFree(prefix);
     }
     
     // Generate array declarations if not already done
@@ -617,7 +807,7 @@ void generateStringLiteralsSection() {
         
         // Get sanitized filename prefix
         char* prefix = getSanitizedFilenamePrefix();
-        if (!prefix) prefix = strdupc("unknown");        
+        if (!prefix) prefix = nccStrdup(MEM_STRINGS, "unknown");        
         for (int i = 0; i < arrayCount; i++) {
             char fullName[256];
             // Label format depends on whether it's a global array or local array
@@ -634,7 +824,7 @@ void generateStringLiteralsSection() {
             fprintf(asmFile, "%s: ", fullName);
             
             // Check if this array has initializers
-            if (arrayInitializers && i < arrayCount && arrayInitializers[i].initializer) {
+            if (arrayInitializers && i < arrayInitializerCapacity && arrayInitializers[i].initializer) {
                 // Generate with initializers
                 writeArrayWithInitializers(asmFile, arrayNames[i], arraySizes[i], 
                                           arrayTypes[i], arrayInitializers[i].initializer);
@@ -662,7 +852,7 @@ void generateStringLiteralsSection() {
             }
         }
         
-        free(prefix);
+        nccFree(prefix);
     }
 }
 
@@ -670,9 +860,9 @@ void cleanupStringAndArrayTables() {
     // Free stringLiterals
     if (stringLiterals) {
         for (int i = 0; i < stringLiteralCount; i++) {
-            free(stringLiterals[i]);
+            nccFree(stringLiterals[i]);
         }
-        free(stringLiterals);
+        nccFree(stringLiterals);
         stringLiterals = NULL;
     }
     stringLiteralCount = 0;
@@ -680,45 +870,41 @@ void cleanupStringAndArrayTables() {
     // Free array tracking
     if (arrayNames) {
         for (int i = 0; i < arrayCount; i++) {
-            free(arrayNames[i]);
+            nccFree(arrayNames[i]);
         }
-        free(arrayNames);
+        nccFree(arrayNames);
         arrayNames = NULL;
     }
     if (arraySizes) {
-        free(arraySizes);
+        nccFree(arraySizes);
         arraySizes = NULL;
     }
     if (arrayTypes) {
-        free(arrayTypes);
+        nccFree(arrayTypes);
         arrayTypes = NULL;
     }
     if (arrayFunctions) {
         for (int i = 0; i < arrayCount; i++) {
-            free(arrayFunctions[i]);
+            nccFree(arrayFunctions[i]);
         }
-        free(arrayFunctions);
+        nccFree(arrayFunctions);
         arrayFunctions = NULL;
     }
     arrayCount = 0;
 
     // Free stringHashTable
-    for (int i = 0; i < STRING_HASH_SIZE; i++) {
-        StringEntry* entry = stringHashTable[i];
-        while (entry) {
-            StringEntry* temp = entry->next;
-            free(entry->string);
-            free(entry);
-            entry = temp;
-        }
-        stringHashTable[i] = NULL;
-    }    // Free arrayHashTable
+    dropStringEntries(0);
+    nccFree(stringHashTable);
+    stringHashTable = NULL;
+    stringHashSize = 0;
+
+    // Free arrayHashTable
     for (int i = 0; i < ARRAY_HASH_SIZE; i++) {
         ArrayEntry* aEntry = arrayHashTable[i];
         while (aEntry) {
             ArrayEntry* temp = aEntry->next;
-            free(aEntry->name);
-            free(aEntry);
+            nccFree(aEntry->name);
+            nccFree(aEntry);
             aEntry = temp;
         }
         arrayHashTable[i] = NULL;
@@ -729,8 +915,8 @@ void cleanupStringAndArrayTables() {
         StringLabelEntry* entry = stringLabelHashTable[i];
         while (entry) {
             StringLabelEntry* temp = entry->next;
-            free(entry->label);
-            free(entry);
+            nccFree(entry->label);
+            nccFree(entry);
             entry = temp;
         }
         stringLabelHashTable[i] = NULL;
@@ -738,7 +924,37 @@ void cleanupStringAndArrayTables() {
     
     // Free array initializers tracking
     if (arrayInitializers) {
-        free(arrayInitializers);
+        nccFree(arrayInitializers);
         arrayInitializers = NULL;
     }
+    arrayInitializerCapacity = 0;
+}
+
+// Drop string literals added after the first 'count' entries
+void truncateStringLiterals(int count) {
+    dropStringEntries(count);
+    for (int i = count; i < stringLiteralCount; i++) {
+        nccFree(stringLiterals[i]);
+        stringLiterals[i] = NULL;
+    }
+    if (count < stringLiteralCount) {
+        stringLiteralCount = count;
+    }
+}
+
+// Drop array declarations added after the first 'count' entries
+void truncateArrayDeclarations(int count) {
+    for (int i = count; i < arrayCount; i++) {
+        nccFree(arrayNames[i]);
+        nccFree(arrayFunctions[i]);
+        arrayNames[i] = NULL;
+        arrayFunctions[i] = NULL;
+        if (i < arrayInitializerCapacity) {
+            arrayInitializers[i].initializer = NULL;
+            arrayInitializers[i].is_static = 0;
+        }
+    }
+    if (count < arrayCount) {
+        arrayCount = count;
+    }
 }
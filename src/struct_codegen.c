@@ -2,21 +2,29 @@
 #include "codegen.h"
 #include "struct_support.h"
 #include "error_manager.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // External declarations
 extern TypeInfo* getTypeInfoFromExpression(ASTNode* expr);
-extern TypeInfo* getTypeInfo(const char* name);
+extern StructMember* getAccessedMember(ASTNode* expr);
 extern const char* getCurrentFunctionName();
-extern int localVarCount;
 extern FILE* asmFile;
 extern int getLocalVarOffset(const char* name);
 
+static void emitAddressOf(ASTNode* expr);
+
+void generateAddressOf(ASTNode* expr) {
+    int mark = enterCodegen("generateAddressOf", expr);
+    emitAddressOf(expr);
+    leaveCodegen(mark);
+}
+
 // Generate code to load the address of an expression into AX
 // This is useful for struct member access and address-of operations
-void generateAddressOf(ASTNode* expr) {
+static void emitAddressOf(ASTNode* expr) {
     if (!expr) return;
     
     switch (expr->type) {
@@ -54,7 +62,8 @@ void generateAddressOf(ASTNode* expr) {
                 // Get the struct type
                 TypeInfo* baseType = getTypeInfoFromExpression(expr->left);
                 if (baseType && baseType->type == TYPE_STRUCT) {
-                    int offset = getMemberOffset(baseType->struct_info, expr->member_access.member_name);
+                    StructMember* member = getAccessedMember(expr);
+                    int offset = member ? member->offset : 0;
                     if (offset > 0) {
                         fprintf(asmFile, "    add ax, %d  ; Add member offset to struct address\n", offset);
                     }
@@ -66,7 +75,8 @@ void generateAddressOf(ASTNode* expr) {
                 // Get the struct pointer type
                 TypeInfo* baseType = getTypeInfoFromExpression(expr->left);
                 if (baseType && baseType->type == TYPE_STRUCT && baseType->is_pointer) {
-                    int offset = getMemberOffset(baseType->struct_info, expr->member_access.member_name);
+                    StructMember* member = getAccessedMember(expr);
+                    int offset = member ? member->offset : 0;
                     if (offset > 0) {
                         fprintf(asmFile, "    add ax, %d  ; Add member offset to struct pointer\n", offset);
                     }
@@ -4,6 +4,7 @@
 #include "struct_support.h"
 #include "error_manager.h"
 #include "ast.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,7 +30,7 @@ TypeInfo parseStructType() {
         exit(1);
     }
     
-    char* structName = strdupc(getCurrentToken().value);
+    char* structName = nccStrdup(MEM_SYMBOLS, getCurrentToken().value);
     consume(TOKEN_IDENTIFIER);
     
     // Find the struct definition by name
@@ -71,7 +72,7 @@ ASTNode* parseStructDefinition() {
         exit(1);
     }
     
-    node->struct_def.struct_name = strdupc(getCurrentToken().value);
+    node->struct_def.struct_name = nccStrdup(MEM_AST, getCurrentToken().value);
     consume(TOKEN_IDENTIFIER);
     
     // Check for duplicate struct definition
@@ -81,12 +82,12 @@ ASTNode* parseStructDefinition() {
     }
     
     // Create struct info
-    StructInfo* structInfo = (StructInfo*)malloc(sizeof(StructInfo));
+    StructInfo* structInfo = (StructInfo*)nccCalloc(MEM_SYMBOLS, 1, sizeof(StructInfo));
     if (!structInfo) {
         reportError(-1, "Memory allocation failed for struct info");
         exit(1);
     }
-    structInfo->name = strdupc(node->struct_def.struct_name);
+    structInfo->name = nccStrdup(MEM_AST, node->struct_def.struct_name);
     structInfo->members = NULL;
     structInfo->size = 0;
     
@@ -111,7 +112,7 @@ ASTNode* parseStructDefinition() {
             exit(1);
         }
         
-        char* memberName = strdupc(getCurrentToken().value);
+        char* memberName = nccStrdup(MEM_SYMBOLS, getCurrentToken().value);
         consume(TOKEN_IDENTIFIER);
         
         // Check for array declaration
@@ -144,7 +145,7 @@ ASTNode* parseStructDefinition() {
         
         // Create AST node for member declaration
         ASTNode* memberNode = createNode(NODE_DECLARATION);
-        memberNode->declaration.var_name = strdupc(memberName);
+        memberNode->declaration.var_name = nccStrdup(MEM_AST, memberName);
         memberNode->declaration.type_info = memberTypeInfo;
         
         // Add to member list in AST
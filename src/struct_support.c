@@ -1,51 +1,94 @@
 #include "struct_support.h"
 #include "error_manager.h"
 #include "ast.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Global table of struct definitions
-StructInfo* g_struct_table[MAX_STRUCT_DEFS];
-int g_struct_count = 0;
+// Struct definitions hashed by name. The bucket array doubles once
+// definitions outnumber buckets, so there is no fixed limit.
+static StructInfo** structBuckets = NULL;
+static int structBucketCount = 0;
+static int structCount = 0;
+
+// FNV-1a
+static unsigned int hashStructName(const char* name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void growStructBuckets() {
+    int newCount = structBucketCount ? structBucketCount * 2 : 32;
+    StructInfo** newBuckets = (StructInfo**)nccCalloc(MEM_SYMBOLS, newCount, sizeof(StructInfo*));
+    if (!newBuckets) {
+        reportError(-1, "Memory allocation failed for struct registry");
+        exit(1);
+    }
+    
+    for (int i = 0; i < structBucketCount; i++) {
+        StructInfo* info = structBuckets[i];
+        while (info) {
+            StructInfo* next = info->bucket_next;
+            StructInfo** slot = &newBuckets[info->hash & (newCount - 1)];
+            info->bucket_next = *slot;
+            *slot = info;
+            info = next;
+        }
+    }
+    
+    nccFree(structBuckets);
+    structBuckets = newBuckets;
+    structBucketCount = newCount;
+}
 
 // Function to add a struct definition to the global table
 void addStructDefinition(StructInfo* structInfo) {
-    if (g_struct_count >= MAX_STRUCT_DEFS) {
-        reportError(-1, "Maximum number of struct definitions (%d) exceeded", MAX_STRUCT_DEFS);
+    // Check for duplicate struct name
+    if (findStructDefinition(structInfo->name)) {
+        reportError(-1, "Duplicate struct definition for '%s'", structInfo->name);
         exit(1);
     }
     
-    // Check for duplicate struct name
-    for (int i = 0; i < g_struct_count; i++) {
-        if (strcmp(g_struct_table[i]->name, structInfo->name) == 0) {
-            reportError(-1, "Duplicate struct definition for '%s'", structInfo->name);
-            exit(1);
-        }
+    if (structCount >= structBucketCount) {
+        growStructBuckets();
     }
     
-    g_struct_table[g_struct_count++] = structInfo;
+    structInfo->hash = hashStructName(structInfo->name);
+    StructInfo** slot = &structBuckets[structInfo->hash & (structBucketCount - 1)];
+    structInfo->bucket_next = *slot;
+    *slot = structInfo;
+    structCount++;
 }
 
 // Function to find a struct definition by name
 StructInfo* findStructDefinition(const char* name) {
-    for (int i = 0; i < g_struct_count; i++) {
-        if (strcmp(g_struct_table[i]->name, name) == 0) {
-            return g_struct_table[i];
+    if (!structBucketCount) return NULL;
+    
+    unsigned int hash = hashStructName(name);
+    StructInfo* info = structBuckets[hash & (structBucketCount - 1)];
+    while (info) {
+        if (info->hash == hash && strcmp(info->name, name) == 0) {
+            return info;
         }
+        info = info->bucket_next;
     }
     return NULL;
 }
 
 // Function to create a struct member
 StructMember* createStructMember(const char* name, TypeInfo typeInfo, int offset) {
-    StructMember* member = (StructMember*)malloc(sizeof(StructMember));
+    StructMember* member = (StructMember*)nccMalloc(MEM_SYMBOLS, sizeof(StructMember));
     if (!member) {
         reportError(-1, "Memory allocation failed for struct member");
         exit(1);
     }
     
-    member->name = strdupc(name);
+    member->name = nccStrdup(MEM_SYMBOLS, name);
     member->type_info = typeInfo;
     member->offset = offset;
     member->next = NULL;
@@ -53,6 +96,40 @@ StructMember* createStructMember(const char* name, TypeInfo typeInfo, int offset
     return member;
 }
 
+// Hash the members of a struct into an open-addressed index that is
+// at most half full, so lookups stop at the first empty slot
+static void indexStructMembers(StructInfo* structInfo) {
+    int memberCount = 0;
+    for (StructMember* m = structInfo->members; m; m = m->next) {
+        memberCount++;
+    }
+    
+    int buckets = 4;
+    while (buckets < memberCount * 2) {
+        buckets *= 2;
+    }
+    
+    nccFree(structInfo->member_index);
+    structInfo->member_index = (StructMember**)nccCalloc(MEM_SYMBOLS, buckets, sizeof(StructMember*));
+    if (!structInfo->member_index) {
+        reportError(-1, "Memory allocation failed for struct member index");
+        exit(1);
+    }
+    structInfo->member_buckets = buckets;
+    
+    for (StructMember* m = structInfo->members; m; m = m->next) {
+        int slot = hashStructName(m->name) & (buckets - 1);
+        while (structInfo->member_index[slot]) {
+            if (strcmp(structInfo->member_index[slot]->name, m->name) == 0) {
+                reportError(-1, "Duplicate member '%s' in struct '%s'", m->name, structInfo->name);
+                exit(1);
+            }
+            slot = (slot + 1) & (buckets - 1);
+        }
+        structInfo->member_index[slot] = m;
+    }
+}
+
 // Function to compute the size and member offsets of a struct
 void layoutStruct(StructInfo* structInfo) {
     int currentOffset = 0;
@@ -121,34 +198,34 @@ void layoutStruct(StructInfo* structInfo) {
     
     // Store the total size of the struct
     structInfo->size = currentOffset;
+    
+    indexStructMembers(structInfo);
 }
 
-// Function to get member offset within a struct
-int getMemberOffset(StructInfo* structInfo, const char* memberName) {
-    if (!structInfo) return -1;
+// Function to find a member of a struct by name, NULL if there is none
+StructMember* findStructMember(StructInfo* structInfo, const char* memberName) {
+    if (!structInfo || !structInfo->member_index) return NULL;
     
-    StructMember* current = structInfo->members;
-    while (current) {
-        if (strcmp(current->name, memberName) == 0) {
-            return current->offset;
+    int mask = structInfo->member_buckets - 1;
+    int slot = hashStructName(memberName) & mask;
+    while (structInfo->member_index[slot]) {
+        if (strcmp(structInfo->member_index[slot]->name, memberName) == 0) {
+            return structInfo->member_index[slot];
         }
-        current = current->next;
+        slot = (slot + 1) & mask;
     }
     
-    return -1; // Member not found
+    return NULL; // Member not found
+}
+
+// Function to get member offset within a struct
+int getMemberOffset(StructInfo* structInfo, const char* memberName) {
+    StructMember* member = findStructMember(structInfo, memberName);
+    return member ? member->offset : -1;
 }
 
 // Function to get member type within a struct
 TypeInfo* getMemberType(StructInfo* structInfo, const char* memberName) {
-    if (!structInfo) return NULL;
-    
-    StructMember* current = structInfo->members;
-    while (current) {
-        if (strcmp(current->name, memberName) == 0) {
-            return &current->type_info;
-        }
-        current = current->next;
-    }
-    
-    return NULL; // Member not found
+    StructMember* member = findStructMember(structInfo, memberName);
+    return member ? &member->type_info : NULL;
 }
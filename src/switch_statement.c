@@ -0,0 +1,100 @@
+#include "parser.h"
+#include "lexer.h"
+#include "ast.h"
+#include "error_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Forward declarations to resolve circular dependencies
+extern ASTNode* parseStatement();
+extern ASTNode* parseExpression();
+extern ASTNode* parseTernaryExpression();
+
+// Set while a case value is parsed so "case 0:" is not read as a far pointer
+int parsingCaseLabel = 0;
+
+// Fold a constant integer expression. Returns 0 if it is not constant.
+static int evaluateCaseValue(ASTNode* expr, int* value) {
+    int left, right;
+
+    if (!expr) return 0;
+
+    switch (expr->type) {
+        case NODE_LITERAL:
+            if (expr->literal.data_type != TYPE_INT) return 0;
+            *value = expr->literal.int_value;
+            return 1;
+        case NODE_UNARY_OP:
+            if (!evaluateCaseValue(expr->right, &right)) return 0;
+            switch (expr->unary_op.op) {
+                case UNARY_NEGATE: *value = -right; return 1;
+                case UNARY_BITWISE_NOT: *value = ~right; return 1;
+                case UNARY_NOT: *value = !right; return 1;
+                default: return 0;
+            }
+        case NODE_BINARY_OP:
+            if (!evaluateCaseValue(expr->left, &left) ||
+                !evaluateCaseValue(expr->right, &right)) return 0;
+            switch (expr->operation.op) {
+                case OP_ADD: *value = left + right; return 1;
+                case OP_SUB: *value = left - right; return 1;
+                case OP_MUL: *value = left * right; return 1;
+                case OP_DIV: if (!right) return 0; *value = left / right; return 1;
+                case OP_MOD: if (!right) return 0; *value = left % right; return 1;
+                case OP_BITWISE_AND: *value = left & right; return 1;
+                case OP_BITWISE_OR: *value = left | right; return 1;
+                case OP_BITWISE_XOR: *value = left ^ right; return 1;
+                case OP_LEFT_SHIFT: *value = left << right; return 1;
+                case OP_RIGHT_SHIFT: *value = left >> right; return 1;
+                default: return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+// Parse a switch statement: switch (expression) body
+ASTNode* parseSwitchStatement() {
+    ASTNode* node = createNode(NODE_SWITCH);
+
+    // Consume the 'switch' keyword
+    consume(TOKEN_SWITCH);
+
+    // Parse the controlling expression
+    expect(TOKEN_LPAREN);
+    node->switch_stmt.condition = parseExpression();
+    expect(TOKEN_RPAREN);
+
+    // Parse the body; case labels inside it are ordinary statements
+    node->switch_stmt.body = parseStatement();
+
+    return node;
+}
+
+// Parse a case or default label: case constant: / default:
+ASTNode* parseCaseLabel() {
+    ASTNode* node = createNode(NODE_CASE);
+
+    if (consume(TOKEN_DEFAULT)) {
+        node->case_label.is_default = 1;
+    } else {
+        consume(TOKEN_CASE);
+
+        Token token = getCurrentToken();
+        parsingCaseLabel = 1;
+        ASTNode* expr = parseTernaryExpression();
+        parsingCaseLabel = 0;
+        if (!evaluateCaseValue(expr, &node->case_label.value)) {
+            reportError(token.pos, "case label does not reduce to an integer constant");
+            exit(1);
+        }
+
+        // Case values compare against a 16-bit register
+        node->case_label.value = (short)node->case_label.value;
+    }
+
+    expect(TOKEN_COLON);
+
+    return node;
+}
@@ -0,0 +1,292 @@
+#include "codegen.h"
+#include "ast.h"
+#include "type_checker.h"
+#include "error_manager.h"
+#include "mem_report.h"
+#include "codegen_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Forward declarations from codegen.c
+extern FILE* asmFile;
+extern char* generateLabel(const char* prefix);
+extern void generateStatement(ASTNode* node);
+extern void generateExpression(ASTNode* node);
+extern void generateBlock(ASTNode* node);
+extern void pushLoopContext(const char* continueLabel, const char* breakLabel);
+extern void popLoopContext();
+extern const char* getCurrentContinueLabel();
+
+// Dispatch strategy thresholds. A jump table costs a fixed seven
+// instructions plus two bytes per slot, so it needs a few cases and
+// must not be mostly holes; above TREE_MIN_CASES a binary decision tree
+// beats a linear compare chain.
+#define TABLE_MIN_CASES 4
+#define TABLE_MAX_SLOTS_PER_CASE 3
+#define TREE_MIN_CASES 5
+
+typedef struct {
+    int key;          // Value in comparison order (zero-extended when unsigned)
+    ASTNode* node;    // The NODE_CASE it belongs to
+} SwitchCase;
+
+typedef struct {
+    SwitchCase* cases;
+    int count;
+    int capacity;
+    ASTNode* defaultCase;
+} CaseList;
+
+// A jump table waiting to be emitted after the switch body. nas only
+// resolves #dw labels that are already defined, so the tables follow
+// the case labels they point at.
+typedef struct {
+    char* label;
+    int lo;
+    int hi;
+} PendingTable;
+
+typedef struct {
+    SwitchCase* cases;
+    int isUnsigned;
+    const char* defaultLabel;
+    const char* holeLabel;    // Table target for values without a case
+    PendingTable* tables;
+    int tableCount;
+} Dispatch;
+
+// Collect the case labels of one switch, skipping nested switches
+static void collectCases(ASTNode* stmt, CaseList* list) {
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->type) {
+            case NODE_CASE:
+                if (stmt->case_label.is_default) {
+                    if (list->defaultCase) {
+                        reportError(-1, "multiple default labels in one switch");
+                        exit(1);
+                    }
+                    list->defaultCase = stmt;
+                } else {
+                    if (list->count == list->capacity) {
+                        list->capacity = list->capacity ? list->capacity * 2 : 16;
+                        list->cases = nccRealloc(MEM_CODEGEN, list->cases, list->capacity * sizeof(SwitchCase));
+                        if (!list->cases) {
+                            fprintf(stderr, "Error: Out of memory collecting case labels\n");
+                            exit(1);
+                        }
+                    }
+                    list->cases[list->count].node = stmt;
+                    list->count++;
+                }
+                break;
+            case NODE_BLOCK:
+                collectCases(stmt->left, list);
+                break;
+            case NODE_IF:
+                collectCases(stmt->if_stmt.if_body, list);
+                collectCases(stmt->if_stmt.else_body, list);
+                break;
+            case NODE_WHILE:
+                collectCases(stmt->while_loop.body, list);
+                break;
+            case NODE_DO_WHILE:
+                collectCases(stmt->do_while_loop.body, list);
+                break;
+            case NODE_FOR:
+                collectCases(stmt->for_loop.body, list);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static int compareCases(const void* a, const void* b) {
+    int x = ((const SwitchCase*)a)->key;
+    int y = ((const SwitchCase*)b)->key;
+    return (x > y) - (x < y);
+}
+
+// Jump through a table of case labels when [lo, hi] is dense enough
+static int emitJumpTable(Dispatch* dispatch, int lo, int hi) {
+    SwitchCase* cases = dispatch->cases;
+    int count = hi - lo + 1;
+    int range = cases[hi].key - cases[lo].key + 1;
+    if (count < TABLE_MIN_CASES || range > count * TABLE_MAX_SLOTS_PER_CASE) return 0;
+
+    PendingTable* table = &dispatch->tables[dispatch->tableCount++];
+    table->label = generateLabel("switch_table");
+    table->lo = lo;
+    table->hi = hi;
+
+    fprintf(asmFile, "    ; Jump table for %d cases over %d slots\n", count, range);
+    if (cases[lo].key != 0) {
+        fprintf(asmFile, "    sub ax, %d\n", cases[lo].key & 0xFFFF);
+    }
+    fprintf(asmFile, "    cmp ax, %d\n", range - 1);
+    fprintf(asmFile, "    ja %s ; Outside the table\n", dispatch->defaultLabel);
+    fprintf(asmFile, "    shl ax, 1\n");
+    fprintf(asmFile, "    mov bx, %s\n", table->label);
+    fprintf(asmFile, "    add bx, ax\n");
+    // jmp [bx], written as bytes: nas assembles any indirect jmp as a
+    // direct jmp to offset 0 without an error, and output still goes to nas
+    // with -nas or when the built-in assembler gives up
+    fprintf(asmFile, "    #db 0xFF, 0x27 ; jmp [bx]: Jump to the case\n");
+    return 1;
+}
+
+// Emit a pending jump table; holes go to the default label
+static void emitTableData(Dispatch* dispatch, PendingTable* table) {
+    SwitchCase* cases = dispatch->cases;
+    int range = cases[table->hi].key - cases[table->lo].key + 1;
+    int next = table->lo;
+
+    fprintf(asmFile, "%s:\n", table->label);
+    for (int slot = 0; slot < range; slot++) {
+        const char* target = dispatch->holeLabel;
+        if (cases[next].key - cases[table->lo].key == slot) {
+            target = cases[next].node->case_label.label;
+            next++;
+        }
+        fprintf(asmFile, "    #dw %s\n", target);
+    }
+    nccFree(table->label);
+}
+
+// Dispatch AX to the sorted cases [lo, hi], falling back to the default.
+// Dense runs become jump tables, long sparse runs are split in half and
+// short runs are compared one by one.
+static void emitDispatch(Dispatch* dispatch, int lo, int hi) {
+    SwitchCase* cases = dispatch->cases;
+    int count = hi - lo + 1;
+
+    if (emitJumpTable(dispatch, lo, hi)) return;
+
+    if (count >= TREE_MIN_CASES) {
+        int mid = lo + count / 2;
+        char* lowerLabel = generateLabel("switch_lower");
+
+        fprintf(asmFile, "    cmp ax, %d\n", cases[mid].key & 0xFFFF);
+        fprintf(asmFile, "    je %s\n", cases[mid].node->case_label.label);
+        fprintf(asmFile, "    %s %s\n", dispatch->isUnsigned ? "jb" : "jl", lowerLabel);
+        emitDispatch(dispatch, mid + 1, hi);
+        fprintf(asmFile, "%s:\n", lowerLabel);
+        emitDispatch(dispatch, lo, mid - 1);
+
+        nccFree(lowerLabel);
+        return;
+    }
+
+    for (int i = lo; i <= hi; i++) {
+        fprintf(asmFile, "    cmp ax, %d\n", cases[i].key & 0xFFFF);
+        fprintf(asmFile, "    je %s\n", cases[i].node->case_label.label);
+    }
+    fprintf(asmFile, "    jmp %s\n", dispatch->defaultLabel);
+}
+
+static void emitSwitchStatement(ASTNode* node);
+
+void generateSwitchStatement(ASTNode* node) {
+    int mark = enterCodegen("generateSwitchStatement", node);
+    emitSwitchStatement(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a switch statement
+static void emitSwitchStatement(ASTNode* node) {
+    if (!node || node->type != NODE_SWITCH) return;
+
+    char* endLabel = generateLabel("switch_end");
+    CaseList list = {0};
+
+    fprintf(asmFile, "    ; Switch statement\n");
+
+    // Comparisons follow the signedness of the controlling expression
+    TypeInfo* typeInfo = getTypeInfoFromExpression(node->switch_stmt.condition);
+    int isUnsigned = isPointerType(node->switch_stmt.condition) ||
+                     (typeInfo && (typeInfo->type == TYPE_UNSIGNED_INT ||
+                                   typeInfo->type == TYPE_UNSIGNED_SHORT ||
+                                   typeInfo->type == TYPE_UNSIGNED_CHAR));
+
+    // Give every case a label and sort them by value
+    collectCases(node->switch_stmt.body, &list);
+    for (int i = 0; i < list.count; i++) {
+        ASTNode* caseNode = list.cases[i].node;
+        caseNode->case_label.label = generateLabel("switch_case");
+        list.cases[i].key = isUnsigned ? (caseNode->case_label.value & 0xFFFF)
+                                       : caseNode->case_label.value;
+    }
+    qsort(list.cases, list.count, sizeof(SwitchCase), compareCases);
+    for (int i = 1; i < list.count; i++) {
+        if (list.cases[i].key == list.cases[i - 1].key) {
+            reportError(-1, "duplicate case value %d in switch", list.cases[i].node->case_label.value);
+            exit(1);
+        }
+    }
+
+    Dispatch dispatch = {0};
+    dispatch.cases = list.cases;
+    dispatch.isUnsigned = isUnsigned;
+    dispatch.defaultLabel = endLabel;
+    if (list.defaultCase) {
+        list.defaultCase->case_label.label = generateLabel("switch_default");
+        dispatch.defaultLabel = list.defaultCase->case_label.label;
+    }
+
+    // Each table covers at least TABLE_MIN_CASES cases
+    dispatch.tables = nccMalloc(MEM_CODEGEN, (list.count / TABLE_MIN_CASES + 1) * sizeof(PendingTable));
+    if (!dispatch.tables) {
+        fprintf(stderr, "Error: Out of memory building switch tables\n");
+        exit(1);
+    }
+
+    // Evaluate the controlling expression and dispatch on AX
+    generateExpression(node->switch_stmt.condition);
+    if (list.count > 0) {
+        emitDispatch(&dispatch, 0, list.count - 1);
+    } else {
+        fprintf(asmFile, "    jmp %s\n", dispatch.defaultLabel);
+    }
+
+    // break leaves the switch; continue still targets the enclosing loop
+    pushLoopContext(getCurrentContinueLabel(), endLabel);
+
+    if (node->switch_stmt.body) {
+        if (node->switch_stmt.body->type == NODE_BLOCK) {
+            generateBlock(node->switch_stmt.body);
+        } else {
+            generateStatement(node->switch_stmt.body);
+        }
+    }
+
+    // Jump tables sit after the body, skipped by code falling out of it.
+    // Without a default, holes land on that skipping jump.
+    if (dispatch.tableCount > 0) {
+        char* skipLabel = generateLabel("switch_skip");
+        dispatch.holeLabel = list.defaultCase ? dispatch.defaultLabel : skipLabel;
+        fprintf(asmFile, "%s:\n", skipLabel);
+        fprintf(asmFile, "    jmp %s\n", endLabel);
+        for (int i = 0; i < dispatch.tableCount; i++) {
+            emitTableData(&dispatch, &dispatch.tables[i]);
+        }
+        nccFree(skipLabel);
+    }
+    nccFree(dispatch.tables);
+
+    fprintf(asmFile, "%s:\n", endLabel);
+
+    popLoopContext();
+
+    // The labels are only needed while generating the body
+    for (int i = 0; i < list.count; i++) {
+        nccFree(list.cases[i].node->case_label.label);
+        list.cases[i].node->case_label.label = NULL;
+    }
+    if (list.defaultCase) {
+        nccFree(list.defaultCase->case_label.label);
+        list.defaultCase->case_label.label = NULL;
+    }
+    nccFree(list.cases);
+    nccFree(endLabel);
+}
@@ -0,0 +1,158 @@
+#include "symbol_table.h"
+#include "mem_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Visible names hashed by name. A bucket only holds the innermost
+// declaration of each name; outer ones hang off its 'shadowed' link.
+static Symbol** buckets = NULL;
+static int bucketCount = 0;
+static int visibleCount = 0;
+
+// Every live declaration in declaration order, so closing a scope
+// can unwind it newest first
+static Symbol** declared = NULL;
+static int declaredCount = 0;
+static int declaredCapacity = 0;
+
+// Index into 'declared' where each open scope starts
+static int* scopeStarts = NULL;
+static int scopeDepth = 0;
+static int scopeCapacity = 0;
+
+static void* growArray(void* array, int* capacity, size_t elementSize, int initial) {
+    *capacity = *capacity ? *capacity * 2 : initial;
+    array = nccRealloc(MEM_SYMBOLS, array, *capacity * elementSize);
+    if (!array) {
+        fprintf(stderr, "Error: Out of memory in symbol table\n");
+        exit(1);
+    }
+    return array;
+}
+
+// FNV-1a
+static unsigned int hashName(const char* name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Double the bucket array once names outnumber buckets
+static void rehash() {
+    int newCount = bucketCount ? bucketCount * 2 : 64;
+    Symbol** newBuckets = nccCalloc(MEM_SYMBOLS, newCount, sizeof(Symbol*));
+    if (!newBuckets) {
+        fprintf(stderr, "Error: Out of memory in symbol table\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < bucketCount; i++) {
+        Symbol* symbol = buckets[i];
+        while (symbol) {
+            Symbol* next = symbol->bucketNext;
+            Symbol** slot = &newBuckets[symbol->hash & (newCount - 1)];
+            symbol->bucketNext = *slot;
+            *slot = symbol;
+            symbol = next;
+        }
+    }
+
+    nccFree(buckets);
+    buckets = newBuckets;
+    bucketCount = newCount;
+}
+
+// Find the bucket link that points at the visible declaration of a name
+static Symbol** findLink(const char* name, unsigned int hash) {
+    if (!bucketCount) return NULL;
+
+    Symbol** link = &buckets[hash & (bucketCount - 1)];
+    while (*link) {
+        if ((*link)->hash == hash && strcmp((*link)->name, name) == 0) {
+            return link;
+        }
+        link = &(*link)->bucketNext;
+    }
+    return link;
+}
+
+// Open a block scope; returns the level to pass to endSymbolScope
+int beginSymbolScope() {
+    if (scopeDepth == scopeCapacity) {
+        scopeStarts = growArray(scopeStarts, &scopeCapacity, sizeof(int), 16);
+    }
+    scopeStarts[scopeDepth] = declaredCount;
+    return scopeDepth++;
+}
+
+// Close the scope opened at 'level' and every scope inside it
+void endSymbolScope(int level) {
+    if (level < 0 || level >= scopeDepth) return;
+
+    int start = scopeStarts[level];
+    while (declaredCount > start) {
+        Symbol* symbol = declared[--declaredCount];
+
+        // Put the declaration it hid back in its place
+        Symbol** link = findLink(symbol->name, symbol->hash);
+        if (symbol->shadowed) {
+            symbol->shadowed->bucketNext = symbol->bucketNext;
+            *link = symbol->shadowed;
+        } else {
+            *link = symbol->bucketNext;
+            visibleCount--;
+        }
+
+        nccFree(symbol->name);
+        nccFree(symbol);
+    }
+    scopeDepth = level;
+}
+
+// Check if no block scope is open
+int isGlobalSymbolScope() {
+    return scopeDepth == 0;
+}
+
+// Declare a name in the innermost scope, hiding outer declarations
+Symbol* addSymbol(const char* name, SymbolKind kind, TypeInfo type) {
+    if (visibleCount >= bucketCount) {
+        rehash();
+    }
+    if (declaredCount == declaredCapacity) {
+        declared = growArray(declared, &declaredCapacity, sizeof(Symbol*), 64);
+    }
+
+    Symbol* symbol = nccCalloc(MEM_SYMBOLS, 1, sizeof(Symbol));
+    if (!symbol) {
+        fprintf(stderr, "Error: Out of memory in symbol table\n");
+        exit(1);
+    }
+    symbol->name = nccStrdup(MEM_SYMBOLS, name);
+    symbol->kind = kind;
+    symbol->type = type;
+    symbol->hash = hashName(name);
+
+    // Take the place of any visible declaration of the same name
+    Symbol** link = findLink(name, symbol->hash);
+    symbol->shadowed = *link;
+    if (*link) {
+        symbol->bucketNext = (*link)->bucketNext;
+    } else {
+        visibleCount++;
+    }
+    *link = symbol;
+
+    declared[declaredCount++] = symbol;
+    return symbol;
+}
+
+// Find the innermost visible declaration of a name, NULL if there is none
+Symbol* findSymbol(const char* name) {
+    Symbol** link = findLink(name, hashName(name));
+    return link ? *link : NULL;
+}
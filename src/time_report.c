@@ -0,0 +1,292 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "time_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Deepest nesting that is timed; spans below it are ignored
+#define MAX_SPAN_DEPTH 128
+
+// Functions listed by name in the report, the slowest first
+#define REPORT_FUNCTIONS 20
+
+static const char* phaseNames[PHASE_COUNT] = {
+    "preprocess", "lex", "parse", "type check", "codegen",
+    "data emission", "assemble", "nas", "cache"
+};
+
+typedef struct {
+    int phase;
+    char* label;        // NULL for counted-only spans
+    int isFunction;
+    double wallStart;   // Microseconds since beginTimeReport
+    double cpuStart;
+    double childWall;   // Time spent in the spans inside this one
+    double childCpu;
+} Span;
+
+typedef struct {
+    char* name;
+    const char* category;
+    double start;
+    double duration;
+} TraceEvent;
+
+typedef struct {
+    char* name;
+    double wall;
+    double cpu;
+} FunctionTime;
+
+static int timing = 0;
+static int printReport = 0;
+static char* tracePath = NULL;
+
+static Span spans[MAX_SPAN_DEPTH];
+static int spanDepth = 0;
+
+static double phaseWall[PHASE_COUNT];
+static double phaseCpu[PHASE_COUNT];
+
+static TraceEvent* events = NULL;
+static int eventCount = 0;
+static int eventCapacity = 0;
+
+static FunctionTime* functions = NULL;
+static int functionCount = 0;
+static int functionCapacity = 0;
+
+#ifdef _WIN32
+static LARGE_INTEGER wallOrigin;
+#else
+static struct timespec wallOrigin;
+#endif
+static clock_t cpuOrigin;
+
+static double wallNow() {
+#ifdef _WIN32
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (double)(now.QuadPart - wallOrigin.QuadPart) * 1e6 / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - wallOrigin.tv_sec) * 1e6 + (double)(now.tv_nsec - wallOrigin.tv_nsec) / 1e3;
+#endif
+}
+
+static double cpuNow() {
+    return (double)(clock() - cpuOrigin) * 1e6 / CLOCKS_PER_SEC;
+}
+
+static char* copyLabel(const char* label) {
+    char* copy = (char*)malloc(strlen(label) + 1);
+    if (copy) strcpy(copy, label);
+    return copy;
+}
+
+void beginTimeReport(int report, const char* traceFile) {
+    timing = report || traceFile;
+    printReport = report;
+    free(tracePath);
+    tracePath = traceFile ? copyLabel(traceFile) : NULL;
+    spanDepth = 0;
+    eventCount = 0;
+    functionCount = 0;
+    memset(phaseWall, 0, sizeof(phaseWall));
+    memset(phaseCpu, 0, sizeof(phaseCpu));
+    if (!timing) return;
+
+#ifdef _WIN32
+    QueryPerformanceCounter(&wallOrigin);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &wallOrigin);
+#endif
+    cpuOrigin = clock();
+}
+
+static void pushSpan(int phase, const char* label, int isFunction) {
+    if (spanDepth < MAX_SPAN_DEPTH) {
+        Span* span = &spans[spanDepth];
+        span->phase = phase;
+        span->label = label ? copyLabel(label) : NULL;
+        span->isFunction = isFunction;
+        span->wallStart = wallNow();
+        span->cpuStart = span->label ? cpuNow() : span->wallStart;
+        span->childWall = 0;
+        span->childCpu = 0;
+    }
+    spanDepth++;
+}
+
+void startTimer(int phase, const char* label) {
+    if (timing) pushSpan(phase, label, 0);
+}
+
+void startFunctionTimer(const char* name) {
+    if (timing) pushSpan(PHASE_CODEGEN, name, 1);
+}
+
+static void addEvent(char* name, const char* category, double start, double duration) {
+    if (eventCount == eventCapacity) {
+        int capacity = eventCapacity ? eventCapacity * 2 : 256;
+        TraceEvent* grown = (TraceEvent*)realloc(events, capacity * sizeof(TraceEvent));
+        if (!grown) {
+            free(name);
+            return;
+        }
+        events = grown;
+        eventCapacity = capacity;
+    }
+    events[eventCount].name = name;
+    events[eventCount].category = category;
+    events[eventCount].start = start;
+    events[eventCount].duration = duration;
+    eventCount++;
+}
+
+static void addFunction(const char* name, double wall, double cpu) {
+    if (functionCount == functionCapacity) {
+        int capacity = functionCapacity ? functionCapacity * 2 : 64;
+        FunctionTime* grown = (FunctionTime*)realloc(functions, capacity * sizeof(FunctionTime));
+        if (!grown) return;
+        functions = grown;
+        functionCapacity = capacity;
+    }
+    char* copy = copyLabel(name);
+    if (!copy) return;
+    functions[functionCount].name = copy;
+    functions[functionCount].wall = wall;
+    functions[functionCount].cpu = cpu;
+    functionCount++;
+}
+
+void stopTimer() {
+    if (!timing || spanDepth == 0) return;
+    spanDepth--;
+    if (spanDepth >= MAX_SPAN_DEPTH) return;
+
+    Span* span = &spans[spanDepth];
+    double wall = wallNow() - span->wallStart;
+    double cpu = span->label ? cpuNow() - span->cpuStart : wall;
+
+    // Only the time not spent in nested spans is this phase's
+    phaseWall[span->phase] += wall - span->childWall;
+    phaseCpu[span->phase] += cpu - span->childCpu;
+    if (spanDepth > 0) {
+        spans[spanDepth - 1].childWall += wall;
+        spans[spanDepth - 1].childCpu += cpu;
+    }
+
+    if (span->label) {
+        if (span->isFunction) addFunction(span->label, wall, cpu);
+        if (tracePath) {
+            addEvent(span->label, phaseNames[span->phase], span->wallStart, wall);
+        } else {
+            free(span->label);
+        }
+        span->label = NULL;
+    }
+}
+
+static int compareFunctionTime(const void* a, const void* b) {
+    const FunctionTime* left = (const FunctionTime*)a;
+    const FunctionTime* right = (const FunctionTime*)b;
+    if (left->wall != right->wall) return left->wall > right->wall ? -1 : 1;
+    return strcmp(left->name, right->name);
+}
+
+static void writeReport(const char* sourceFile, double totalWall, double totalCpu) {
+    fprintf(stderr, "Time report for %s:\n", sourceFile);
+    fprintf(stderr, "  %-16s %10s %10s %7s\n", "Phase", "Wall ms", "CPU ms", "Wall %");
+
+    double timedWall = 0;
+    double timedCpu = 0;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        timedWall += phaseWall[i];
+        timedCpu += phaseCpu[i];
+        if (phaseWall[i] <= 0 && phaseCpu[i] <= 0) continue;
+        fprintf(stderr, "  %-16s %10.3f %10.3f %6.1f%%\n", phaseNames[i], phaseWall[i] / 1e3, phaseCpu[i] / 1e3,
+                totalWall > 0 ? phaseWall[i] * 100 / totalWall : 0.0);
+    }
+    double otherWall = totalWall - timedWall;
+    double otherCpu = totalCpu - timedCpu;
+    fprintf(stderr, "  %-16s %10.3f %10.3f %6.1f%%\n", "other", (otherWall > 0 ? otherWall : 0) / 1e3,
+            (otherCpu > 0 ? otherCpu : 0) / 1e3, totalWall > 0 && otherWall > 0 ? otherWall * 100 / totalWall : 0.0);
+    fprintf(stderr, "  %-16s %10.3f %10.3f\n", "total", totalWall / 1e3, totalCpu / 1e3);
+
+    if (functionCount == 0) return;
+    qsort(functions, functionCount, sizeof(FunctionTime), compareFunctionTime);
+    fprintf(stderr, "Code generation by function:\n");
+    fprintf(stderr, "  %-24s %10s %10s\n", "Function", "Wall ms", "CPU ms");
+    for (int i = 0; i < functionCount && i < REPORT_FUNCTIONS; i++) {
+        fprintf(stderr, "  %-24s %10.3f %10.3f\n", functions[i].name, functions[i].wall / 1e3, functions[i].cpu / 1e3);
+    }
+    if (functionCount > REPORT_FUNCTIONS) {
+        fprintf(stderr, "  ... %d more functions\n", functionCount - REPORT_FUNCTIONS);
+    }
+}
+
+static void writeJsonString(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Chrome trace-event format: one complete ("X") event per span, times in
+// microseconds. Nesting follows from the times.
+static int writeTrace(const char* sourceFile, double totalWall) {
+    FILE* out = fopen(tracePath, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write time trace %s\n", tracePath);
+        return 1;
+    }
+    fprintf(out, "{\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":");
+    writeJsonString(out, sourceFile);
+    fprintf(out, ",\"cat\":\"compile\",\"ph\":\"X\",\"ts\":0,\"dur\":%.3f,\"pid\":1,\"tid\":1}", totalWall);
+    for (int i = 0; i < eventCount; i++) {
+        fprintf(out, ",\n{\"name\":");
+        writeJsonString(out, events[i].name);
+        fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                events[i].category, events[i].start, events[i].duration);
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(out) != 0;
+}
+
+int endTimeReport(const char* sourceFile) {
+    if (!timing) return 0;
+
+    // Close spans left open by an early return
+    while (spanDepth > 0) stopTimer();
+    double totalWall = wallNow();
+    double totalCpu = cpuNow();
+
+    int status = 0;
+    if (printReport) writeReport(sourceFile, totalWall, totalCpu);
+    if (tracePath) status = writeTrace(sourceFile, totalWall);
+
+    for (int i = 0; i < eventCount; i++) free(events[i].name);
+    for (int i = 0; i < functionCount; i++) free(functions[i].name);
+    eventCount = 0;
+    functionCount = 0;
+    timing = 0;
+    return status;
+}
@@ -20,6 +20,9 @@ const char* getTokenName(TokenType type) {
         case TOKEN_RETURN: return "TOKEN_RETURN";
         case TOKEN_BREAK: return "TOKEN_BREAK";
         case TOKEN_CONTINUE: return "TOKEN_CONTINUE";
+        case TOKEN_SWITCH: return "TOKEN_SWITCH";
+        case TOKEN_CASE: return "TOKEN_CASE";
+        case TOKEN_DEFAULT: return "TOKEN_DEFAULT";
         case TOKEN_BOOL: return "TOKEN_BOOL";
         case TOKEN_TRUE: return "TOKEN_TRUE";        case TOKEN_FALSE: return "TOKEN_FALSE";
         case TOKEN_STRUCT: return "TOKEN_STRUCT";
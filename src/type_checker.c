@@ -1,41 +1,25 @@
 #include "ast.h"
+#include "type_checker.h"
 #include "error_manager.h"
 #include "struct_support.h"
 #include "struct_codegen.h"
+#include "symbol_table.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Structure to store global symbols for type checking
-typedef struct {
-    char* name;
-    TypeInfo type;
-} TypeSymbol;
+extern ASTNode* g_program_root;
 
-#define MAX_SYMBOLS 256
-static TypeSymbol symbols[MAX_SYMBOLS];
-static int symbolCount = 0;
-
-// Add a symbol to the table
+// Add a symbol to the innermost open scope
 void addTypeSymbol(const char* name, TypeInfo type) {
-    if (symbolCount >= MAX_SYMBOLS) {
-        fprintf(stderr, "Error: Symbol table full\n");
-        return;
-    }
-    
-    symbols[symbolCount].name = strdupc(name);
-    symbols[symbolCount].type = type;
-    symbolCount++;
+    addSymbol(name, isGlobalSymbolScope() ? SYMBOL_GLOBAL : SYMBOL_LOCAL, type);
 }
 
-// Find a symbol in the table
+// Find the visible declaration of a symbol
 TypeInfo* findTypeSymbol(const char* name) {
-    for (int i = 0; i < symbolCount; i++) {
-        if (strcmp(symbols[i].name, name) == 0) {
-            return &symbols[i].type;
-        }
-    }
-    return NULL;
+    Symbol* symbol = findSymbol(name);
+    return symbol ? &symbol->type : NULL;
 }
 
 // Get type information for a symbol (for use in codegen)
@@ -43,6 +27,17 @@ TypeInfo* getTypeInfo(const char* name) {
     return findTypeSymbol(name);
 }
 
+// Find the definition or prototype of a function in the program
+ASTNode* findFunctionDeclaration(const char* name) {
+    if (!g_program_root || !name) return NULL;
+    for (ASTNode* node = g_program_root->left; node; node = node->next) {
+        if (node->type == NODE_FUNCTION && strcmp(node->function.func_name, name) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
 // Function to check if a node's type is a void pointer
 int isVoidPointer(ASTNode* node) {
     // If it's an identifier, we need to find its type
@@ -76,8 +71,9 @@ int isVoidPointerDereference(ASTNode* node) {
     return 0;
 }
 
-// Get type information from an expression
-TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
+// Work out the type of an expression from its operands. Results of
+// operators live in static buffers until annotateTypes() interns them.
+static TypeInfo* computeExpressionType(ASTNode* expr) {
     if (!expr) return NULL;
     
     // Handle simple cases directly
@@ -144,6 +140,11 @@ TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
             return &derefTypeInfo;
         }
         
+        // Negation and complement keep the operand's type
+        if (expr->unary_op.op == UNARY_NEGATE || expr->unary_op.op == UNARY_BITWISE_NOT) {
+            return getTypeInfoFromExpression(expr->right);
+        }
+        
         // Handle type casting
         if (expr->unary_op.op == UNARY_CAST) {
             static TypeInfo castTypeInfo;
@@ -178,15 +179,16 @@ TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
                 return NULL;
             }
             
-            // Get the member type from the struct
-            TypeInfo* memberType = getMemberType(baseType->struct_info, expr->member_access.member_name);
-            if (!memberType) {
+            // Find the member once; code generation reuses it
+            StructMember* member = findStructMember(baseType->struct_info, expr->member_access.member_name);
+            if (!member) {
                 reportError(-1, "Struct '%s' has no member named '%s'", 
                            baseType->struct_info->name, expr->member_access.member_name);
                 return NULL;
             }
             
-            return memberType;
+            expr->member_access.member = member;
+            return &member->type_info;
         }
         // Handle direct struct access (.)
         else if (expr->member_access.op == OP_DOT) {
@@ -195,15 +197,24 @@ TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
                 return NULL;
             }
             
-            // Get the member type from the struct
-            TypeInfo* memberType = getMemberType(baseType->struct_info, expr->member_access.member_name);
-            if (!memberType) {
+            // Find the member once; code generation reuses it
+            StructMember* member = findStructMember(baseType->struct_info, expr->member_access.member_name);
+            if (!member) {
                 reportError(-1, "Struct '%s' has no member named '%s'", 
                            baseType->struct_info->name, expr->member_access.member_name);
                 return NULL;
             }
             
-            return memberType;
+            expr->member_access.member = member;
+            return &member->type_info;
+        }
+    }
+    
+    // A call has its function's return type
+    if (expr->type == NODE_CALL) {
+        ASTNode* func = findFunctionDeclaration(expr->call.func_name);
+        if (func) {
+            return &func->function.info.return_type;
         }
     }
     
@@ -240,3 +251,189 @@ TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
     
     return &defaultTypeInfo;
 }
+
+// Get type information from an expression
+TypeInfo* getTypeInfoFromExpression(ASTNode* expr) {
+    if (!expr) return NULL;
+    
+    // Annotated nodes answer from the cache
+    if (expr->expr_type) return expr->expr_type;
+    
+    return computeExpressionType(expr);
+}
+
+// Interned types, so equal types share one TypeInfo
+static TypeInfo** internedTypes = NULL;
+static int internedCount = 0;
+static int internedCapacity = 0;
+
+static int sameType(const TypeInfo* a, const TypeInfo* b) {
+    return a->type == b->type &&
+           a->is_pointer == b->is_pointer &&
+           a->is_far_pointer == b->is_far_pointer &&
+           a->is_array == b->is_array &&
+           a->array_size == b->array_size &&
+           a->is_stackframe == b->is_stackframe &&
+           a->is_far == b->is_far &&
+           a->is_static == b->is_static &&
+           a->struct_info == b->struct_info;
+}
+
+// Get the canonical copy of a type
+static TypeInfo* internType(const TypeInfo* type) {
+    for (int i = 0; i < internedCount; i++) {
+        if (sameType(internedTypes[i], type)) {
+            return internedTypes[i];
+        }
+    }
+    
+    if (internedCount == internedCapacity) {
+        internedCapacity = internedCapacity ? internedCapacity * 2 : 32;
+        internedTypes = nccRealloc(MEM_SYMBOLS, internedTypes, internedCapacity * sizeof(TypeInfo*));
+        if (!internedTypes) {
+            fprintf(stderr, "Error: Out of memory interning types\n");
+            exit(1);
+        }
+    }
+    
+    TypeInfo* canonical = nccMalloc(MEM_SYMBOLS, sizeof(TypeInfo));
+    if (!canonical) {
+        fprintf(stderr, "Error: Out of memory interning types\n");
+        exit(1);
+    }
+    *canonical = *type;
+    internedTypes[internedCount++] = canonical;
+    return canonical;
+}
+
+// Declare a name for the rest of the current annotation scope
+static void declareName(ASTNode* decl, SymbolKind kind) {
+    addSymbol(decl->declaration.var_name, kind, decl->declaration.type_info);
+}
+
+static TypeInfo* lookupName(const char* name) {
+    Symbol* symbol = findSymbol(name);
+    return symbol ? internType(&symbol->type) : NULL;
+}
+
+static void annotateNode(ASTNode* node);
+
+// Annotate a list of nodes linked through 'next'
+static void annotateList(ASTNode* node) {
+    for (; node; node = node->next) {
+        annotateNode(node);
+    }
+}
+
+// Annotate a list of statements that forms its own scope
+static void annotateScope(ASTNode* statements) {
+    int scope = beginSymbolScope();
+    annotateList(statements);
+    endSymbolScope(scope);
+}
+
+static void annotateNode(ASTNode* node) {
+    if (!node) return;
+    
+    switch (node->type) {
+        case NODE_PROGRAM:
+            // Globals are already declared by the parser
+            for (ASTNode* item = node->left; item; item = item->next) {
+                if (item->type == NODE_DECLARATION) {
+                    annotateList(item->declaration.initializer);
+                } else {
+                    annotateNode(item);
+                }
+            }
+            return;
+        case NODE_FUNCTION: {
+            int scope = beginSymbolScope();
+            for (ASTNode* param = node->function.params; param; param = param->next) {
+                if (param->type == NODE_DECLARATION) declareName(param, SYMBOL_PARAMETER);
+            }
+            annotateNode(node->function.body);
+            endSymbolScope(scope);
+            return;
+        }
+        case NODE_DECLARATION:
+            // The initializer cannot see the name it initializes
+            annotateList(node->declaration.initializer);
+            declareName(node, SYMBOL_LOCAL);
+            return;
+        case NODE_BLOCK:
+            annotateScope(node->left);
+            return;
+        case NODE_STRUCT_DEF:
+            return;
+        case NODE_RETURN:
+            annotateNode(node->return_stmt.expr);
+            return;
+        case NODE_IF:
+            annotateNode(node->if_stmt.condition);
+            annotateScope(node->if_stmt.if_body);
+            annotateScope(node->if_stmt.else_body);
+            return;
+        case NODE_WHILE:
+            annotateNode(node->while_loop.condition);
+            annotateScope(node->while_loop.body);
+            return;
+        case NODE_DO_WHILE:
+            annotateScope(node->do_while_loop.body);
+            annotateNode(node->do_while_loop.condition);
+            return;
+        case NODE_FOR: {
+            // The init declaration is visible to the whole loop only
+            int scope = beginSymbolScope();
+            annotateNode(node->for_loop.init);
+            annotateNode(node->for_loop.condition);
+            annotateNode(node->for_loop.update);
+            annotateScope(node->for_loop.body);
+            endSymbolScope(scope);
+            return;
+        }
+        case NODE_SWITCH:
+            annotateNode(node->switch_stmt.condition);
+            annotateScope(node->switch_stmt.body);
+            return;
+        case NODE_ASM:
+            for (int i = 0; i < node->asm_stmt.operand_count; i++) {
+                annotateNode(node->asm_stmt.operands[i]);
+            }
+            return;
+        case NODE_CALL:
+            annotateList(node->call.args);
+            break;
+        case NODE_TERNARY:
+            annotateNode(node->ternary.condition);
+            annotateNode(node->ternary.true_expr);
+            annotateNode(node->ternary.false_expr);
+            break;
+        case NODE_IDENTIFIER:
+            node->expr_type = lookupName(node->identifier);
+            return;
+        default:
+            annotateNode(node->left);
+            annotateNode(node->right);
+            break;
+    }
+    
+    // Operands are typed by now, so this only combines their types
+    TypeInfo* type = computeExpressionType(node);
+    node->expr_type = type ? internType(type) : NULL;
+}
+
+// Get the struct member named by a member access. The annotation pass
+// resolves it; nodes built after that pass are resolved on first use.
+StructMember* getAccessedMember(ASTNode* expr) {
+    if (!expr || expr->type != NODE_MEMBER_ACCESS) return NULL;
+    if (!expr->member_access.member) {
+        computeExpressionType(expr);
+    }
+    return expr->member_access.member;
+}
+
+// Resolve the type of every expression once, after parsing, and cache it
+// on the node so code generation needs no symbol lookups
+void annotateTypes(ASTNode* root) {
+    annotateNode(root);
+}
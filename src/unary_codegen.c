@@ -2,6 +2,7 @@
 #include "ast.h"
 #include "error_manager.h"
 #include "type_checker.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,8 +11,12 @@
 extern FILE* asmFile;
 extern int getVariableOffset(const char* name);
 extern int isParameter(const char* name);
+extern const char* getVariableRegister(const char* name);
+extern void emitLoadLocal(const char* name, int offset);
+extern void emitStoreLocal(const char* name, int offset, const char* reg);
 extern int getNextLabelId();
 extern int labelCounter;
+extern const char* getLabelScope();
 extern void generateExpression(ASTNode* node);
 
 // External array info from string_literals.c
@@ -38,8 +43,16 @@ static int isOptimizableArrayAccess(ASTNode* array, ASTNode* index) {
 #pragma GCC diagnostic pop
 #endif
 
-// Generate optimized code for array indexing with literal index
+static void emitOptimizedArrayAccess(ASTNode* array, ASTNode* index);
+
 static void generateOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
+    int mark = enterCodegen("generateOptimizedArrayAccess", NULL);
+    emitOptimizedArrayAccess(array, index);
+    leaveCodegen(mark);
+}
+
+// Generate optimized code for array indexing with literal index
+static void emitOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
     // Determine array element type and size
     TypeInfo* arrTypeInfo = getTypeInfoFromExpression(array);
     int elemSize = 2; // Default to word size (int)
@@ -53,7 +66,11 @@ static void generateOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
     if (array->type == NODE_IDENTIFIER) {
         char* name = array->identifier;
         
-        if (isParameter(name)) {
+        if (getVariableRegister(name)) {
+            // Pointer kept in a register by the allocator
+            fprintf(asmFile, "    mov bx, %s ; Load array pointer from register variable %s\n", 
+                  getVariableRegister(name), name);
+        } else if (isParameter(name)) {
             // Parameter array - get address from BP + offset
             fprintf(asmFile, "    ; Array parameter %s\n", name);
             fprintf(asmFile, "    mov bx, [bp+%d] ; Load array pointer from parameter\n", 
@@ -107,8 +124,16 @@ static void generateOptimizedArrayAccess(ASTNode* array, ASTNode* index) {
     }
 }
 
-// Generate code for unary operations
+static void emitUnaryOp(ASTNode* node);
+
 void generateUnaryOp(ASTNode* node) {
+    int mark = enterCodegen("generateUnaryOp", node);
+    emitUnaryOp(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for unary operations
+static void emitUnaryOp(ASTNode* node) {
     if (!node || node->type != NODE_UNARY_OP) return;
     switch (node->unary_op.op) {
         case UNARY_DEREFERENCE:
@@ -141,7 +166,7 @@ void generateUnaryOp(ASTNode* node) {
                 
                 // Check for null pointer
                 fprintf(asmFile, "    cmp bx, 0 ; Check for null pointer\n");
-                fprintf(asmFile, "    je null_ptr_deref_%d\n", labelId);
+                fprintf(asmFile, "    je %snull_ptr_deref_%d\n", getLabelScope(), labelId);
                 
                 // Determine load size based on pointed-to type
                 TypeInfo* typeInfo = getTypeInfoFromExpression(node->right);
@@ -152,11 +177,11 @@ void generateUnaryOp(ASTNode* node) {
                     // Default to loading a word (int/short)
                     fprintf(asmFile, "    mov ax, [bx] ; Load word from memory\n");
                 }
-                fprintf(asmFile, "    jmp ptr_deref_end_%d\n", labelId);
-                fprintf(asmFile, "null_ptr_deref_%d:\n", labelId);
+                fprintf(asmFile, "    jmp %sptr_deref_end_%d\n", getLabelScope(), labelId);
+                fprintf(asmFile, "%snull_ptr_deref_%d:\n", getLabelScope(), labelId);
                 fprintf(asmFile, "    ; Null pointer dereference detected\n");
                 fprintf(asmFile, "    mov ax, 0 ; Return 0 for null deref\n");
-                fprintf(asmFile, "ptr_deref_end_%d:\n", labelId);
+                fprintf(asmFile, "%sptr_deref_end_%d:\n", getLabelScope(), labelId);
                 
                 fprintf(asmFile, "    pop ds ; Restore DS\n");
             }// For identifiers that might be pointers
@@ -167,11 +192,10 @@ void generateUnaryOp(ASTNode* node) {
                 
                 // Add null pointer check
                 fprintf(asmFile, "    cmp bx, 0 ; Check for null pointer\n");
-                fprintf(asmFile, "    je null_ptr_deref_%d\n", labelId);
+                fprintf(asmFile, "    je %snull_ptr_deref_%d\n", getLabelScope(), labelId);
 
-                // Get type info based on identifier name
-                char* name = node->right->identifier;
-                TypeInfo* typeInfo = getTypeInfo(name);
+                // Get type info of the pointer variable
+                TypeInfo* typeInfo = getTypeInfoFromExpression(node->right);
                 if (typeInfo && typeInfo->is_pointer) {
                     // Determine load size based on pointed-to type
                     if (typeInfo->type == TYPE_CHAR || typeInfo->type == TYPE_UNSIGNED_CHAR || typeInfo->type == TYPE_BOOL) {
@@ -186,11 +210,11 @@ void generateUnaryOp(ASTNode* node) {
                     fprintf(asmFile, "    mov ax, [bx] ; Load word from memory\n");
                 }
 
-                fprintf(asmFile, "    jmp ptr_deref_end_%d\n", labelId);
-                fprintf(asmFile, "null_ptr_deref_%d:\n", labelId);
+                fprintf(asmFile, "    jmp %sptr_deref_end_%d\n", getLabelScope(), labelId);
+                fprintf(asmFile, "%snull_ptr_deref_%d:\n", getLabelScope(), labelId);
                 fprintf(asmFile, "    ; Null pointer dereference detected\n");
                 fprintf(asmFile, "    mov ax, 0 ; Return 0 for null deref\n");
-                fprintf(asmFile, "ptr_deref_end_%d:\n", labelId);
+                fprintf(asmFile, "%sptr_deref_end_%d:\n", getLabelScope(), labelId);
             }
             // For other expressions resulting in a pointer
             else {                fprintf(asmFile, "    ; Dereferencing pointer\n");
@@ -200,7 +224,7 @@ void generateUnaryOp(ASTNode* node) {
                 
                 // Add null pointer check
                 fprintf(asmFile, "    cmp bx, 0 ; Check for null pointer\n");
-                fprintf(asmFile, "    je null_ptr_deref_%d\n", labelId);
+                fprintf(asmFile, "    je %snull_ptr_deref_%d\n", getLabelScope(), labelId);
                 
                 // For complex expressions, we need to infer the type from context
                 // Get type info if available, otherwise default to word size
@@ -213,11 +237,11 @@ void generateUnaryOp(ASTNode* node) {
                     fprintf(asmFile, "    mov ax, [bx] ; Load word from memory\n");
                 }
                 
-                fprintf(asmFile, "    jmp ptr_deref_end_%d\n", labelId);
-                fprintf(asmFile, "null_ptr_deref_%d:\n", labelId);
+                fprintf(asmFile, "    jmp %sptr_deref_end_%d\n", getLabelScope(), labelId);
+                fprintf(asmFile, "%snull_ptr_deref_%d:\n", getLabelScope(), labelId);
                 fprintf(asmFile, "    ; Null pointer dereference detected\n");
                 fprintf(asmFile, "    mov ax, 0 ; Return 0 for null deref\n");
-                fprintf(asmFile, "ptr_deref_end_%d:\n", labelId);
+                fprintf(asmFile, "%sptr_deref_end_%d:\n", getLabelScope(), labelId);
             }
             break;
               case UNARY_SIZEOF:
@@ -227,8 +251,14 @@ void generateUnaryOp(ASTNode* node) {
                 // For identifier, check the type of the variable or parameter
                 char* name = node->right->identifier;
                 
-                // Check the symbol table to get the type information for this variable
-                TypeInfo* typeInfo = getTypeInfo(name);
+                // Use the declared type of the variable; copy it, since it
+                // may be adjusted below and the annotated type is shared
+                TypeInfo declaredType;
+                TypeInfo* typeInfo = getTypeInfoFromExpression(node->right);
+                if (typeInfo) {
+                    declaredType = *typeInfo;
+                    typeInfo = &declaredType;
+                }
                   if (typeInfo) {
                     fprintf(asmFile, "    ; sizeof for identifier %s with type info\n", name);
                     // Check for incomplete array information
@@ -477,17 +507,21 @@ void generateUnaryOp(ASTNode* node) {
             if (node->right->type == NODE_IDENTIFIER) {
                 char* name = node->right->identifier;
                 int offset = getVariableOffset(name);
+                const char* reg = getVariableRegister(name);
                 
-                if (isParameter(name)) {
+                if (reg) {
+                    fprintf(asmFile, "    inc %s ; Prefix increment of register variable %s\n", reg, name);
+                    fprintf(asmFile, "    mov ax, %s\n", reg);
+                } else if (isParameter(name)) {
                     fprintf(asmFile, "    ; Prefix increment of parameter %s\n", name);
                     fprintf(asmFile, "    mov ax, [bp+%d] ; Load parameter value\n", -offset);
                     fprintf(asmFile, "    inc ax ; Increment value\n");
                     fprintf(asmFile, "    mov [bp+%d], ax ; Store incremented value back\n", -offset);
                 } else {
                     fprintf(asmFile, "    ; Prefix increment of variable %s\n", name);
-                    fprintf(asmFile, "    mov ax, [bp-%d] ; Load variable value\n", offset);
+                    emitLoadLocal(name, offset);
                     fprintf(asmFile, "    inc ax ; Increment value\n");
-                    fprintf(asmFile, "    mov [bp-%d], ax ; Store incremented value back\n", offset);
+                    emitStoreLocal(name, offset, "ax");
                 }            } else if (node->right->type == NODE_UNARY_OP && 
                       node->right->unary_op.op == UNARY_DEREFERENCE) {
                 // Handle the case of ++(*ptr)
@@ -508,17 +542,21 @@ void generateUnaryOp(ASTNode* node) {
             if (node->right->type == NODE_IDENTIFIER) {
                 char* name = node->right->identifier;
                 int offset = getVariableOffset(name);
+                const char* reg = getVariableRegister(name);
                 
-                if (isParameter(name)) {
+                if (reg) {
+                    fprintf(asmFile, "    dec %s ; Prefix decrement of register variable %s\n", reg, name);
+                    fprintf(asmFile, "    mov ax, %s\n", reg);
+                } else if (isParameter(name)) {
                     fprintf(asmFile, "    ; Prefix decrement of parameter %s\n", name);
                     fprintf(asmFile, "    mov ax, [bp+%d] ; Load parameter value\n", -offset);
                     fprintf(asmFile, "    dec ax ; Decrement value\n");
                     fprintf(asmFile, "    mov [bp+%d], ax ; Store decremented value back\n", -offset);
                 } else {
                     fprintf(asmFile, "    ; Prefix decrement of variable %s\n", name);
-                    fprintf(asmFile, "    mov ax, [bp-%d] ; Load variable value\n", offset);
+                    emitLoadLocal(name, offset);
                     fprintf(asmFile, "    dec ax ; Decrement value\n");
-                    fprintf(asmFile, "    mov [bp-%d], ax ; Store decremented value back\n", offset);
+                    emitStoreLocal(name, offset, "ax");
                 }            } else if (node->right->type == NODE_UNARY_OP && 
                       node->right->unary_op.op == UNARY_DEREFERENCE) {
                 // Handle the case of --(*ptr)
@@ -544,8 +582,12 @@ void generateUnaryOp(ASTNode* node) {
             if (node->right->type == NODE_IDENTIFIER) {
                 char* name = node->right->identifier;
                 int offset = getVariableOffset(name);
+                const char* reg = getVariableRegister(name);
                 
-                if (isParameter(name)) {
+                if (reg) {
+                    fprintf(asmFile, "    mov ax, %s ; Postfix increment of register variable %s\n", reg, name);
+                    fprintf(asmFile, "    inc %s\n", reg);
+                } else if (isParameter(name)) {
                     fprintf(asmFile, "    ; Postfix increment of parameter %s\n", name);
                     fprintf(asmFile, "    mov ax, [bp+%d] ; Load parameter value\n", -offset);
                     fprintf(asmFile, "    mov bx, ax ; Save original value to BX\n");
@@ -554,10 +596,10 @@ void generateUnaryOp(ASTNode* node) {
                     // AX still contains original value
                 } else {
                     fprintf(asmFile, "    ; Postfix increment of variable %s\n", name);
-                    fprintf(asmFile, "    mov ax, [bp-%d] ; Load variable value\n", offset);
+                    emitLoadLocal(name, offset);
                     fprintf(asmFile, "    mov bx, ax ; Save original value to BX\n");
                     fprintf(asmFile, "    inc bx ; Increment value\n");
-                    fprintf(asmFile, "    mov [bp-%d], bx ; Store incremented value back\n", offset);
+                    emitStoreLocal(name, offset, "bx");
                     // AX still contains original value
                 }            } else if (node->right->type == NODE_UNARY_OP && 
                       node->right->unary_op.op == UNARY_DEREFERENCE) {                // Handle the case of (*ptr)++
@@ -580,8 +622,12 @@ void generateUnaryOp(ASTNode* node) {
             if (node->right->type == NODE_IDENTIFIER) {
                 char* name = node->right->identifier;
                 int offset = getVariableOffset(name);
+                const char* reg = getVariableRegister(name);
                 
-                if (isParameter(name)) {
+                if (reg) {
+                    fprintf(asmFile, "    mov ax, %s ; Postfix decrement of register variable %s\n", reg, name);
+                    fprintf(asmFile, "    dec %s\n", reg);
+                } else if (isParameter(name)) {
                     fprintf(asmFile, "    ; Postfix decrement of parameter %s\n", name);
                     fprintf(asmFile, "    mov ax, [bp+%d] ; Load parameter value\n", -offset);
                     fprintf(asmFile, "    mov bx, ax ; Save original value to BX\n");
@@ -590,10 +636,10 @@ void generateUnaryOp(ASTNode* node) {
                     // AX still contains original value
                 } else {
                     fprintf(asmFile, "    ; Postfix decrement of variable %s\n", name);
-                    fprintf(asmFile, "    mov ax, [bp-%d] ; Load variable value\n", offset);
+                    emitLoadLocal(name, offset);
                     fprintf(asmFile, "    mov bx, ax ; Save original value to BX\n");
                     fprintf(asmFile, "    dec bx ; Decrement value\n");
-                    fprintf(asmFile, "    mov [bp-%d], bx ; Store decremented value back\n", offset);
+                    emitStoreLocal(name, offset, "bx");
                     // AX still contains original value
                 }            } else if (node->right->type == NODE_UNARY_OP && 
                       node->right->unary_op.op == UNARY_DEREFERENCE) {
@@ -649,9 +695,9 @@ void generateUnaryOp(ASTNode* node) {
                     fprintf(asmFile, "    ; Cast to bool\n");
                     fprintf(asmFile, "    test ax, ax ; Check if not zero\n");
                     fprintf(asmFile, "    mov ax, 0 ; Default to false\n");
-                    fprintf(asmFile, "    jz cast_bool_end_%d\n", labelCounter);
+                    fprintf(asmFile, "    jz %scast_bool_end_%d\n", getLabelScope(), labelCounter);
                     fprintf(asmFile, "    mov ax, 1 ; Set to true if non-zero\n");
-                    fprintf(asmFile, "cast_bool_end_%d:\n", labelCounter++);
+                    fprintf(asmFile, "%scast_bool_end_%d:\n", getLabelScope(), labelCounter++);
                     break;
                     
                 default:
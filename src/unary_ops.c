@@ -3,6 +3,7 @@
 #include "ast.h"
 #include "error_manager.h"
 #include "type_checker.h"
+#include "mem_report.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -83,25 +84,25 @@ ASTNode* parseUnaryExpression() {
                 token = getCurrentToken();
                 
                 if (token.type == TOKEN_INT) {
-                    operand->identifier = strdupc("unsigned int");
+                    operand->identifier = nccStrdup(MEM_AST, "unsigned int");
                     consume(token.type);
                 } else if (token.type == TOKEN_CHAR) {
-                    operand->identifier = strdupc("unsigned char");
+                    operand->identifier = nccStrdup(MEM_AST, "unsigned char");
                     consume(token.type);
                 } else if (token.type == TOKEN_SHORT) {
-                    operand->identifier = strdupc("unsigned short");
+                    operand->identifier = nccStrdup(MEM_AST, "unsigned short");
                     consume(token.type);
                 } else {
-                    operand->identifier = strdupc("unsigned");
+                    operand->identifier = nccStrdup(MEM_AST, "unsigned");
                     // No need to consume anything else
                 }
             } else {
                 // Regular type
-                if (token.type == TOKEN_INT) operand->identifier = strdupc("int");
-                else if (token.type == TOKEN_CHAR) operand->identifier = strdupc("char");
-                else if (token.type == TOKEN_SHORT) operand->identifier = strdupc("short");
-                else if (token.type == TOKEN_VOID) operand->identifier = strdupc("void");
-                else if (token.type == TOKEN_BOOL) operand->identifier = strdupc("bool");
+                if (token.type == TOKEN_INT) operand->identifier = nccStrdup(MEM_AST, "int");
+                else if (token.type == TOKEN_CHAR) operand->identifier = nccStrdup(MEM_AST, "char");
+                else if (token.type == TOKEN_SHORT) operand->identifier = nccStrdup(MEM_AST, "short");
+                else if (token.type == TOKEN_VOID) operand->identifier = nccStrdup(MEM_AST, "void");
+                else if (token.type == TOKEN_BOOL) operand->identifier = nccStrdup(MEM_AST, "bool");
                 
                 consume(token.type);
             }
@@ -109,9 +110,9 @@ ASTNode* parseUnaryExpression() {
             // Handle pointer types (e.g., int*, char*)
             while (tokenIs(TOKEN_STAR)) {
                 char* oldType = operand->identifier;
-                char* newType = malloc(strlen(oldType) + 2);  // +2 for '*' and '\0'
+                char* newType = nccMalloc(MEM_AST, strlen(oldType) + 2);  // +2 for '*' and '\0'
                 sprintf(newType, "%s*", oldType);
-                free(oldType);
+                nccFree(oldType);
                 operand->identifier = newType;
                 consume(TOKEN_STAR);
             }
@@ -201,12 +202,13 @@ ASTNode* parsePostfixExpression() {
                 exit(1);
             }
             
-            char* memberName = getCurrentToken().value;
+            // The token's text is released once it is consumed
+            char* memberName = nccStrdup(MEM_AST, getCurrentToken().value);
             consume(TOKEN_IDENTIFIER);
             
             ASTNode* node = createNode(NODE_MEMBER_ACCESS);
             node->member_access.op = OP_DOT;
-            node->member_access.member_name = strdupc(memberName);
+            node->member_access.member_name = memberName;
             node->left = left;
             left = node;
         }
@@ -220,12 +222,13 @@ ASTNode* parsePostfixExpression() {
                 exit(1);
             }
             
-            char* memberName = getCurrentToken().value;
+            // The token's text is released once it is consumed
+            char* memberName = nccStrdup(MEM_AST, getCurrentToken().value);
             consume(TOKEN_IDENTIFIER);
             
             ASTNode* node = createNode(NODE_MEMBER_ACCESS);
             node->member_access.op = OP_ARROW;
-            node->member_access.member_name = strdupc(memberName);
+            node->member_access.member_name = memberName;
             node->left = left;
             left = node;
         }
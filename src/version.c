@@ -0,0 +1,56 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "version.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static char buildId[64];
+
+// The file the running compiler was loaded from, or 0 if unknown
+static int executablePath(char* path, size_t size) {
+#ifdef _WIN32
+    DWORD length = GetModuleFileNameA(NULL, path, (DWORD)size);
+    return length > 0 && length < size;
+#elif defined(__linux__)
+    // Still names the loaded image if the file has since been replaced
+    return snprintf(path, size, "/proc/self/exe") < (int)size;
+#else
+    return 0;
+#endif
+}
+
+// 64-bit FNV-1a over the file, or 0 if it cannot be read
+static int hashFile(const char* path, unsigned long long* hash) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    unsigned long long value = 14695981039346656037ULL;
+    unsigned char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < got; i++) value = (value ^ buffer[i]) * 1099511628211ULL;
+    }
+    int ok = !ferror(file);
+    fclose(file);
+    *hash = value;
+    return ok;
+}
+
+const char* compilerBuildId() {
+    if (buildId[0]) return buildId;
+
+    char path[4096];
+    unsigned long long hash;
+    if (executablePath(path, sizeof(path)) && hashFile(path, &hash)) {
+        snprintf(buildId, sizeof(buildId), "ncc %s %016llx", NCC_VERSION, hash);
+    } else {
+        // No way to find the executable: fall back to when this file was
+        // compiled, which misses rebuilds that leave it untouched
+        snprintf(buildId, sizeof(buildId), "ncc %s %s %s", NCC_VERSION, __DATE__, __TIME__);
+    }
+    return buildId;
+}
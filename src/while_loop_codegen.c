@@ -1,5 +1,7 @@
 #include "codegen.h"
 #include "ast.h"
+#include "mem_report.h"
+#include "codegen_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,8 +15,16 @@ extern void generateBlock(ASTNode* node);
 extern void pushLoopContext(const char* continueLabel, const char* breakLabel);
 extern void popLoopContext();
 
-// Generate code for a while loop
+static void emitWhileLoop(ASTNode* node);
+
 void generateWhileLoop(ASTNode* node) {
+    int mark = enterCodegen("generateWhileLoop", node);
+    emitWhileLoop(node);
+    leaveCodegen(mark);
+}
+
+// Generate code for a while loop
+static void emitWhileLoop(ASTNode* node) {
     if (!node || node->type != NODE_WHILE) return;
     
     // Generate labels for loop condition, loop body and end
@@ -61,7 +71,7 @@ void generateWhileLoop(ASTNode* node) {
     popLoopContext();
     
     // Free the allocated labels
-    free(condLabel);
-    free(bodyLabel);
-    free(endLabel);
+    nccFree(condLabel);
+    nccFree(bodyLabel);
+    nccFree(endLabel);
 }
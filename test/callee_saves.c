@@ -0,0 +1,34 @@
+// Register variables must survive a call whose callee reaches inline
+// assembly only through another function. Build with make test_callee_saves
+// and run callee_saves.com under DOS; it prints 20 (at -O0 as well).
+void main()
+{
+    int i = 0;
+    int sum = 0;
+    while (i < 4) {
+        sum = sum + 5;
+        outer();  // i and sum are in SI/DI here
+        i = i + 1;
+    }
+    putchar(48 + sum / 10);
+    putchar(48 + sum % 10);
+}
+
+// Allocates no registers, so it saves none itself
+void outer()
+{
+    inner();
+}
+
+void inner()
+{
+    __asm("mov si, 7");
+    __asm("mov di, 9");
+}
+
+void putchar(int c)
+{
+    __asm("mov dl, [bp+4]");  // Get 'c' argument from stack
+    __asm("mov ah, 0x02");    // Set AH = 02h (MS-DOS print character)
+    __asm("int 0x21");        // Call MS-DOS interrupt
+}
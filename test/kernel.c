@@ -77,7 +77,7 @@ uint16_t getChar()
 
 char *getString(bool newline)
 {
-    char buffer[256]; // Buffer for input string
+    static char buffer[256]; // Buffer for input string
     char *ptr = buffer;
 
     //clear buffer
@@ -0,0 +1,38 @@
+// Passes longs between functions under -m386. Build with make test_m386
+// and run long386.com under DOS; it prints
+//   100006
+//   105000
+//   65539
+void main()
+{
+    long sum = add(100000, 6);
+    putlong(sum);
+    putchar(10);
+    putlong(scale(3, 70000, 2));  // an int parameter between longs
+    putchar(10);
+    putlong(add(add(1, 2), 65536));  // a long result passed on
+    putchar(10);
+}
+
+long add(long a, long b)
+{
+    return a + b;
+}
+
+long scale(int factor, long value, long divisor)
+{
+    return value * factor / divisor;
+}
+
+void putlong(long value)
+{
+    if (value >= 10) putlong(value / 10);
+    putchar(48 + value % 10);
+}
+
+void putchar(int c)
+{
+    __asm("mov dl, [bp+4]");  // Get 'c' argument from stack
+    __asm("mov ah, 0x02");    // Set AH = 02h (MS-DOS print character)
+    __asm("int 0x21");        // Call MS-DOS interrupt
+}
@@ -0,0 +1,96 @@
+#!/bin/sh
+# Build the bootloader and kernel many times at once in one directory and
+# check that every image matches a serial build and that no ncc-* temp
+# file is left behind. Each image is built with the built-in assembler and
+# with -nas, which hands the assembly to nas through a temp file, so the
+# concurrent compiles race on those files.
+#
+#   test/parallel_builds.sh [ncc] [count]
+#
+# count (default 32) builds of each image and assembler run side by side. They share
+# the working directory and a private TMPDIR, so the temp assembly of
+# one compile cannot be mistaken for another's and leftovers are easy to
+# count.
+NCC=${1:-bin/ncc}
+COUNT=${2:-32}
+
+if [ ! -x "$NCC" ]; then
+    echo "Error: $NCC not found; run make first" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/ncc-parallel-builds.XXXXXX") || exit 1
+trap 'rm -rf "$WORK"' EXIT
+mkdir "$WORK/tmp"
+TMPDIR="$WORK/tmp"
+export TMPDIR
+
+build_boot() {
+    "$NCC" -disp 0x7C00 -I./test ./test/bootloader.c -o "$1" >/dev/null 2>&1
+}
+
+build_kernel() {
+    "$NCC" -disp 0x8000 -O1 -I./test ./test/kernel.c -o "$1" >/dev/null 2>&1
+}
+
+build_boot_nas() {
+    "$NCC" -disp 0x7C00 -nas -I./test ./test/bootloader.c -o "$1" >/dev/null 2>&1
+}
+
+build_kernel_nas() {
+    "$NCC" -disp 0x8000 -O1 -nas -I./test ./test/kernel.c -o "$1" >/dev/null 2>&1
+}
+
+# nas and the built-in assembler may pick different jump sizes, so each
+# is compared with its own serial build
+IMAGES="boot kernel boot_nas kernel_nas"
+
+if ! build_boot "$WORK/boot.bin" || ! build_kernel "$WORK/kernel.bin" ||
+   ! build_boot_nas "$WORK/boot_nas.bin" || ! build_kernel_nas "$WORK/kernel_nas.bin"; then
+    echo "Error: The serial build failed" >&2
+    exit 1
+fi
+
+pids=""
+i=1
+while [ "$i" -le "$COUNT" ]; do
+    for image in $IMAGES; do
+        "build_$image" "$WORK/${image}_$i.bin" &
+        pids="$pids $!"
+    done
+    i=$((i + 1))
+done
+
+failures=0
+for pid in $pids; do
+    wait "$pid" || failures=$((failures + 1))
+done
+if [ "$failures" -ne 0 ]; then
+    echo "Error: $failures of $((COUNT * 4)) parallel builds failed" >&2
+fi
+
+i=1
+while [ "$i" -le "$COUNT" ]; do
+    for image in $IMAGES; do
+        if ! cmp -s "$WORK/$image.bin" "$WORK/${image}_$i.bin"; then
+            echo "Error: ${image}_$i.bin differs from the serial build" >&2
+            failures=$((failures + 1))
+        fi
+    done
+    i=$((i + 1))
+done
+
+leftovers=$(find "$TMPDIR" -name 'ncc-*' | wc -l)
+if [ "$leftovers" -ne 0 ]; then
+    echo "Error: $leftovers ncc-* temp file(s) left in TMPDIR" >&2
+    failures=$((failures + 1))
+fi
+if [ -e temp.asm ]; then
+    echo "Error: A compile wrote temp.asm into the working directory" >&2
+    failures=$((failures + 1))
+fi
+
+if [ "$failures" -ne 0 ]; then
+    exit 1
+fi
+echo "$((COUNT * 4)) parallel builds match the serial builds; no temp files left"
@@ -17,7 +17,7 @@ void printstring(char* str)
 
 char* getuserinput()
 {
-    char input[256];  // Static buffer to hold user input
+    static char input[256];  // Static buffer to hold user input
     input[0] = 255;
     input[1] = 0;  // Initialize first two bytes to indicate empty string
     __asm("mov dx, %0" : : "r"(input));  // Load address of input buffer into DX